@@ -0,0 +1,275 @@
+// bench_cpu.c
+// micro-benchmark do executor de instruções da CPU
+// simulador de computador
+// so25b
+
+// executa programas de usuário (os que fazem E/S com chamadas de sistema,
+//   como ex1 e p1) repetidas vezes, só com memória, MMU e CPU, e mede o tempo
+//   gasto para executar as instruções
+// no lugar do SO tem uma função bem simples, chamada pelo tratador de
+//   interrupção (trata_int.maq, que deve estar no diretório), que inicia o
+//   programa, aceita as escritas sem fazer nada e termina na chamada de morte
+//   ou em caso de erro
+// serve para comparar as formas de despacho de instruções da CPU, compilando
+//   com e sem CPU_DESPACHO_THREADED e CPU_JIT (ver Makefile, alvo bench_cpu),
+//   e com e sem superinstruções (opção -f liga)
+//
+// uso: bench_cpu [-f] [-r repeticoes] programa.maq ...
+
+#include "cpu.h"
+#include "mmu.h"
+#include "tabpag.h"
+#include "memoria.h"
+#include "es.h"
+#include "irq.h"
+#include "instrucao.h"
+#include "programa.h"
+#include "so.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+// constantes
+#define MEM_TAM         10000 // tamanho da memória principal
+#define PRIMEIRO_QUADRO    10 // onde começa a memória do programa
+#define RAJADA           1000 // instruções por chamada a cpu_executa_n
+#define REPETICOES       1000 // número padrão de execuções de cada programa
+
+typedef struct {
+  mem_t *mem;
+  tabpag_t *tabpag;
+  mmu_t *mmu;
+  es_t *es;
+  cpu_t *cpu;
+  // endereço de início do programa sendo executado
+  int inicio;
+  // situação da execução do programa
+  enum { executando, terminou, falhou } estado;
+  // número de chamadas de sistema atendidas
+  long n_chamadas;
+} bench_t;
+
+
+// ---------------------------------------------------------------------
+// "SO" {{{1
+// ---------------------------------------------------------------------
+
+// função chamada pela instrução CHAMAC do tratador de interrupção
+// retorna 0 para continuar executando o programa ou 1 para parar a CPU
+static int bench_trata_interrupcao(void *arg, int reg_A)
+{
+  bench_t *self = arg;
+  irq_t irq = reg_A;
+  int chamada, erro;
+
+  switch (irq) {
+    case IRQ_RESET:
+      // inicia o programa, o tratador recupera o estado e executa RETI
+      mem_escreve(self->mem, CPU_END_PC, self->inicio);
+      mem_escreve(self->mem, CPU_END_A, 0);
+      mem_escreve(self->mem, CPU_END_erro, ERR_OK);
+      mem_escreve(self->mem, CPU_END_complemento, 0);
+      mem_escreve(self->mem, 59, 0);  // X, ver trata_int.asm
+      return 0;
+    case IRQ_SISTEMA:
+      self->n_chamadas++;
+      mem_le(self->mem, CPU_END_A, &chamada);
+      switch (chamada) {
+        case SO_MATA_PROC:
+          self->estado = terminou;
+          return 1;
+        case SO_LE:
+          mem_escreve(self->mem, CPU_END_A, '0');
+          return 0;
+        case SO_ESCR:
+          mem_escreve(self->mem, CPU_END_A, 0);
+          return 0;
+        default:
+          mem_escreve(self->mem, CPU_END_A, -1);
+          return 0;
+      }
+    case IRQ_ERR_CPU:
+      // programas sem SO (como o ex1) terminam executando PARA
+      mem_le(self->mem, CPU_END_erro, &erro);
+      self->estado = erro == ERR_INSTR_PRIV ? terminou : falhou;
+      return 1;
+    default:
+      self->estado = falhou;
+      return 1;
+  }
+}
+
+
+// ---------------------------------------------------------------------
+// CARGA {{{1
+// ---------------------------------------------------------------------
+
+// carrega um programa na memória física, a partir do endereço 'end_fis'
+// retorna o número de palavras carregadas, ou -1 em caso de erro
+static int carrega(mem_t *mem, char *nome, int end_fis, int *pinicio)
+{
+  programa_t *prog = prog_cria(nome);
+  if (prog == NULL) {
+    fprintf(stderr, "Erro na leitura do programa '%s'\n", nome);
+    return -1;
+  }
+  int end_ini = prog_end_carga(prog);
+  int tam = prog_tamanho(prog);
+  for (int i = 0; i < tam; i++) {
+    if (mem_escreve(mem, end_fis + i, prog_dado(prog, end_ini + i)) != ERR_OK) {
+      fprintf(stderr, "Erro na carga de '%s'\n", nome);
+      prog_destroi(prog);
+      return -1;
+    }
+  }
+  *pinicio = prog_end_inicio(prog);
+  prog_destroi(prog);
+  return tam;
+}
+
+static bench_t *bench_cria(void)
+{
+  bench_t *self = malloc(sizeof(*self));
+  if (self == NULL) return NULL;
+  self->mem = mem_cria(MEM_TAM);
+  self->tabpag = tabpag_cria();
+  self->mmu = mmu_cria(self->mem);
+  self->es = es_cria();
+  self->cpu = cpu_cria(self->mmu, self->es);
+  cpu_define_chamaC(self->cpu, bench_trata_interrupcao, self);
+
+  // a CPU começa em modo supervisor no endereço 0; para ela lá, cada
+  //   execução começa com uma interrupção de reset
+  mem_escreve(self->mem, CPU_END_RESET, PARA);
+  int inicio;
+  if (carrega(self->mem, "trata_int.maq", CPU_END_TRATADOR, &inicio) < 0) {
+    exit(1);
+  }
+  cpu_executa_1(self->cpu);
+  return self;
+}
+
+static void bench_destroi(bench_t *self)
+{
+  cpu_destroi(self->cpu);
+  es_destroi(self->es);
+  mmu_destroi(self->mmu);
+  tabpag_destroi(self->tabpag);
+  mem_destroi(self->mem);
+  free(self);
+}
+
+// carrega o programa, mapeado a partir da página 0 (os programas de usuário
+//   são montados no endereço 0)
+static bool bench_carrega_programa(bench_t *self, char *nome)
+{
+  int end_fis = PRIMEIRO_QUADRO * TAM_PAGINA;
+  int tam = carrega(self->mem, nome, end_fis, &self->inicio);
+  if (tam < 0) return false;
+  int n_paginas = (tam + TAM_PAGINA - 1) / TAM_PAGINA;
+  for (int pagina = 0; pagina < n_paginas; pagina++) {
+    tabpag_define_quadro(self->tabpag, pagina, PRIMEIRO_QUADRO + pagina);
+  }
+  mmu_define_tabpag(self->mmu, self->tabpag);
+  return true;
+}
+
+
+// ---------------------------------------------------------------------
+// EXECUÇÃO {{{1
+// ---------------------------------------------------------------------
+
+static double agora(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// executa o programa carregado do início até o fim
+// retorna o número de instruções executadas, ou -1 em caso de erro
+static long bench_executa(bench_t *self)
+{
+  long n_instr = 0;
+  self->estado = executando;
+  if (!cpu_interrompe(self->cpu, IRQ_RESET)) return -1;
+  while (self->estado == executando) {
+    n_instr += cpu_executa_n(self->cpu, RAJADA);
+  }
+  return self->estado == terminou ? n_instr : -1;
+}
+
+static bool bench_programa(bench_t *self, char *nome, int repeticoes)
+{
+  if (!bench_carrega_programa(self, nome)) return false;
+  self->n_chamadas = 0;
+  long n_instr = 0;
+  long despachos0, fundidas0;
+  cpu_estatisticas(self->cpu, &despachos0, &fundidas0);
+  double inicio = agora();
+  for (int r = 0; r < repeticoes; r++) {
+    long n = bench_executa(self);
+    if (n < 0) {
+      fprintf(stderr, "%s: erro na execução\n", nome);
+      return false;
+    }
+    n_instr += n;
+  }
+  double tempo = agora() - inicio;
+  long despachos, fundidas;
+  cpu_estatisticas(self->cpu, &despachos, &fundidas);
+  despachos -= despachos0;
+  fundidas -= fundidas0;
+  printf("%-14s %8d %12ld %12ld %6.1f%% %10ld %9.3f %8.2f %9.2f\n", nome,
+         repeticoes, n_instr, despachos, fundidas * 100.0 / n_instr,
+         self->n_chamadas, tempo, tempo * 1e9 / n_instr, n_instr / tempo / 1e6);
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  int repeticoes = REPETICOES;
+  bool fusao = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "fr:")) != -1) {
+    switch (opt) {
+      case 'r':
+        repeticoes = atoi(optarg);
+        break;
+      case 'f':
+        fusao = true;
+        break;
+      default:
+        fprintf(stderr, "uso: %s [-f] [-r repeticoes] programa.maq ...\n", argv[0]);
+        return 1;
+    }
+  }
+
+  bench_t *bench = bench_cria();
+  if (bench == NULL) return 1;
+  cpu_define_fusao(bench->cpu, fusao);
+
+#if defined(CPU_JIT)
+  printf("despacho: portável, com tradução para código nativo\n");
+#elif defined(CPU_DESPACHO_THREADED)
+  printf("despacho: threaded (goto computado)\n");
+#else
+  printf("despacho: portável (tabela de funções)\n");
+#endif
+  printf("superinstruções: %s\n", fusao ? "sim" : "não");
+  printf("%-14s %8s %12s %12s %7s %10s %9s %8s %9s\n", "programa", "repet",
+         "instruções", "despachos", "fundid", "chamadas", "tempo(s)",
+         "ns/instr", "Minstr/s");
+  int erros = 0;
+  for (int i = optind; i < argc; i++) {
+    if (!bench_programa(bench, argv[i], repeticoes)) erros++;
+  }
+
+  bench_destroi(bench);
+  return erros == 0 ? 0 : 1;
+}
+
+// vim: foldmethod=marker
@@ -0,0 +1,43 @@
+; carga_es.asm
+; carga para o benchmark (ver desempenho.c): bastante E/S
+; cria 2 processos, que executam p2 e p3 (os que fazem mais E/S), espera
+;   os 2 terminarem e se mata
+
+; chamadas de sistema (ver so.h)
+SO_CRIA_PROC   define 7
+SO_MATA_PROC   define 8
+SO_ESPERA_PROC define 9
+
+         ; cria os processos
+         cargi prog2
+         trax
+         cargi SO_CRIA_PROC
+         chamas
+         armm pid2
+         cargi prog3
+         trax
+         cargi SO_CRIA_PROC
+         chamas
+         armm pid3
+
+         ; espera os processos terminarem
+         cargm pid2
+         trax
+         cargi SO_ESPERA_PROC
+         chamas
+         cargm pid3
+         trax
+         cargi SO_ESPERA_PROC
+         chamas
+
+morre
+         cargi 0
+         trax
+         cargi SO_MATA_PROC
+         chamas
+         desv morre
+
+prog2    string 'p2.maq'
+prog3    string 'p3.maq'
+pid2     espaco 1
+pid3     espaco 1
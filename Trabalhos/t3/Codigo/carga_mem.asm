@@ -0,0 +1,43 @@
+; carga_mem.asm
+; carga para o benchmark (ver desempenho.c): muitas faltas de página
+; percorre várias vezes um vetor maior que a memória física (com a memória
+;   configurada pequena), escrevendo uma posição de cada página, e se mata
+
+; chamadas de sistema (ver so.h)
+SO_MATA_PROC   define 8
+
+TAM      define 2000  ; tamanho do vetor
+PASSO    define 10    ; uma posição por página (TAM_PAGINA)
+VOLTAS   define 5     ; quantas vezes percorre o vetor
+
+volta
+         cargi 0
+         trax
+pagina
+         ; vetor[X] = X (a página fica alterada, tem que ir para a swap)
+         cpxa
+         armx vetor
+         ; X += PASSO, enquanto X < TAM
+         soma passo
+         trax
+         cpxa
+         sub tam
+         desvn pagina
+         ; mais uma volta?
+         cargm voltas
+         sub um
+         armm voltas
+         desvnz volta
+
+morre
+         cargi 0
+         trax
+         cargi SO_MATA_PROC
+         chamas
+         desv morre
+
+passo    valor PASSO
+tam      valor TAM
+voltas   valor VOLTAS
+um       valor 1
+vetor    espaco TAM
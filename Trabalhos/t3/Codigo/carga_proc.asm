@@ -0,0 +1,39 @@
+; carga_proc.asm
+; carga para o benchmark (ver desempenho.c): criação de processos
+; cria N processos que executam filho.maq, um por vez, esperando cada um
+;   morrer, e se mata
+
+; chamadas de sistema (ver so.h)
+SO_CRIA_PROC   define 7
+SO_MATA_PROC   define 8
+SO_ESPERA_PROC define 9
+
+N        define 30  ; quantos processos criar (o SO tem um limite de pids)
+
+laco
+         ; cria um filho; desiste se o SO não conseguir
+         cargi prog
+         trax
+         cargi SO_CRIA_PROC
+         chamas
+         desvn morre
+         ; espera ele morrer (o pid está em A)
+         trax
+         cargi SO_ESPERA_PROC
+         chamas
+         ; mais um?
+         cargm faltam
+         sub um
+         armm faltam
+         desvnz laco
+
+morre
+         cargi 0
+         trax
+         cargi SO_MATA_PROC
+         chamas
+         desv morre
+
+prog     string 'filho.maq'
+faltam   valor N
+um       valor 1
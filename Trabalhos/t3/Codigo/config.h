@@ -14,6 +14,6 @@ enum EstadoProcesso {
     MORTO       /* 3 */
 };
 
-#define MAX_PROCESSOS 4
+#define MAX_PROCESSOS 32
 
 #endif
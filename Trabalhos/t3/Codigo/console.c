@@ -10,6 +10,8 @@
 #include "console.h"
 #include "terminal.h"
 #include "tela.h"
+#include "imagem.h"
+#include "escritor.h"
 
 #include <string.h>
 #include <stdarg.h>
@@ -17,6 +19,8 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <assert.h>
+#include <pthread.h>
+#include <time.h>
 
 
 // ---------------------------------------------------------------------
@@ -44,6 +48,15 @@
 // números de comandos para o controlador que podem ser guardados na console
 #define N_CMD_EXT 10
 
+// tamanho máximo de um texto impresso com console_printf
+#define TAM_PRINTF (N_LIN_CONSOLE * (N_COL + 1))
+
+// número máximo de vezes por segundo (de tempo real) que a tela é desenhada
+#define QUADROS_POR_SEGUNDO 30
+
+// tamanho do buffer do arquivo de log, em bytes (ver escritor.h)
+#define TAM_BUFFER_LOG (1 << 20)
+
 
 // ---------------------------------------------------------------------
 // DECLARAÇÃO {{{1
@@ -54,10 +67,40 @@ struct console_t {
   int cor_txt[N_TERM];
   int cor_cursor[N_TERM];
   char txt_status[N_COL+1];
-  char txt_console[N_LIN_CONSOLE][N_COL+1];
+  // as últimas n_historico linhas impressas na console, em um buffer
+  //   circular (só com tela): a linha i (contando desde o início) está na
+  //   posição i % n_historico
+  char (*historico)[N_COL+1];
+  int n_historico;
+  // número de linhas já impressas
+  long n_linhas;
+  // quantas linhas a área da console está mostrando acima da última (0
+  //   acompanha o que é impresso)
+  int rolagem;
   char txt_entrada[N_COL+1];
   char fila_de_comandos_externos[N_CMD_EXT];
-  FILE *arquivo_de_log;
+  // o arquivo de log é escrito por outra thread (ou NULL, sem log)
+  escritor_t *arquivo_de_log;
+  // false na execução em lote, sem teclado nem desenho na tela
+  bool com_tela;
+  // arquivos com a entrada de cada terminal, na execução em lote (ou NULL)
+  FILE *entrada_term[N_TERM];
+  // a console é usada pelo controlador e pelo SO, que pode estar executando
+  //   na thread de outra CPU; é recursiva porque as funções da console
+  //   também imprimem nela
+  pthread_mutex_t trava;
+  // gravação ou reprodução das entradas (ou NULL)
+  registro_t *registro;
+  // o texto de cada linha como está na tela, para só desenhar as linhas
+  //   que mudaram (tela_valida é false se a tela deve ser toda desenhada)
+  char txt_tela[N_LIN][N_COL+1];
+  bool tela_valida;
+  // momento (tempo real, em s) a partir do qual a tela pode ser desenhada
+  //   de novo
+  double prox_quadro;
+  // função que atualiza a linha de status, chamada antes de desenhar
+  void (*f_status)(void *);
+  void *arg_status;
 };
 
 
@@ -65,12 +108,15 @@ struct console_t {
 // CRIAÇÃO {{{1
 // ---------------------------------------------------------------------
 
-static console_t *console_global; // gambiarra para simplificar o uso de prints na console
-console_t *console_cria(void)
+// gambiarra para simplificar o uso de prints na console: console_printf
+//   imprime na console da thread, para que várias simulações possam
+//   executar ao mesmo tempo, cada uma em suas threads
+static _Thread_local console_t *console_da_thread;
+static console_t *console__cria(bool com_tela, char *nome_log, int n_historico)
 {
   console_t *self = malloc(sizeof(*self));
   assert(self != NULL);
-  console_global = self;
+  console_da_thread = self;
 
   for (int t = 0; t < N_TERM; t++) {
     self->term[t] = terminal_cria(N_COL);
@@ -82,34 +128,84 @@ console_t *console_cria(void)
       self->cor_cursor[t] = COR_CURSOR_IMPAR;
     }
   }
-  for (int l = 0; l < N_LIN_CONSOLE; l++) {
-    strcpy(self->txt_console[l], "");
+  self->historico = NULL;
+  self->n_historico = n_historico;
+  if (com_tela) {
+    self->historico = malloc(n_historico * sizeof(*self->historico));
+    assert(self->historico != NULL);
   }
+  self->n_linhas = 0;
+  self->rolagem = 0;
   strcpy(self->txt_entrada, "");
+  strcpy(self->txt_status, "");
   self->fila_de_comandos_externos[0] = '\0';
-  self->arquivo_de_log = fopen("log_da_console", "w");
+  self->arquivo_de_log = nome_log == NULL ? NULL : escritor_cria(nome_log, TAM_BUFFER_LOG);
+  self->com_tela = com_tela;
+  for (int t = 0; t < N_TERM; t++) {
+    self->entrada_term[t] = NULL;
+  }
+  self->registro = NULL;
+  self->tela_valida = false;
+  self->prox_quadro = 0;
+  self->f_status = NULL;
+  self->arg_status = NULL;
+
+  pthread_mutexattr_t atr;
+  pthread_mutexattr_init(&atr);
+  pthread_mutexattr_settype(&atr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&self->trava, &atr);
+  pthread_mutexattr_destroy(&atr);
 
-  tela_init();
+  if (com_tela) tela_init();
 
   return self;
 }
 
+console_t *console_cria(int n_historico)
+{
+  return console__cria(true, "log_da_console", n_historico);
+}
+
+console_t *console_cria_sem_tela(char *nome_log)
+{
+  return console__cria(false, nome_log, 0);
+}
+
+void console_usa_na_thread(console_t *self)
+{
+  console_da_thread = self;
+}
+
+void console_define_status(console_t *self, void (*f_status)(void *), void *arg)
+{
+  pthread_mutex_lock(&self->trava);
+  self->f_status = f_status;
+  self->arg_status = arg;
+  pthread_mutex_unlock(&self->trava);
+}
+
 static void console_desenha(console_t *self);
 
 void console_destroi(console_t *self)
 {
   console_desenha(self);
-  if (self->arquivo_de_log != NULL) fclose(self->arquivo_de_log);
-  tela_puts(COR_OCUPADO, "  digite ENTER para sair  ");
-  tela_atualiza();
-  while (tela_tecla() != '\n') {
-    ;
+  if (self->arquivo_de_log != NULL) escritor_destroi(self->arquivo_de_log);
+  if (self->com_tela) {
+    tela_puts(COR_OCUPADO, "  digite ENTER para sair  ");
+    tela_atualiza();
+    while (tela_tecla() != '\n') {
+      ;
+    }
+    tela_fim();
   }
-  tela_fim();
 
   for (int t = 0; t < N_TERM; t++) {
     terminal_destroi(self->term[t]);
+    if (self->entrada_term[t] != NULL) fclose(self->entrada_term[t]);
   }
+  pthread_mutex_destroy(&self->trava);
+  if (console_da_thread == self) console_da_thread = NULL;
+  free(self->historico);
   free(self);
   return;
 }
@@ -126,11 +222,57 @@ terminal_t *console_terminal(console_t *self, char id_terminal)
   return self->term[num_terminal];
 }
 
-static void atualiza_terminais(console_t *self)
+static void atualiza_terminais(console_t *self, int n)
+{
+  for (int t = 0; t < N_TERM; t++) {
+    terminal_tictac_n(self->term[t], n);
+  }
+}
+
+int console_prazo_terminais(console_t *self)
 {
+  int prazo = -1;
   for (int t = 0; t < N_TERM; t++) {
-    terminal_tictac(self->term[t]);
+    int p = terminal_prazo_tela(self->term[t]);
+    if (p >= 0 && (prazo < 0 || p < prazo)) prazo = p;
   }
+  return prazo;
+}
+
+bool console_salva(console_t *self, FILE *arq)
+{
+  if (!imagem_escreve_int(arq, N_TERM)) return false;
+  for (int t = 0; t < N_TERM; t++) {
+    if (!terminal_salva(self->term[t], arq)) return false;
+  }
+  return true;
+}
+
+bool console_recupera(console_t *self, FILE *arq)
+{
+  if (!imagem_confere_int(arq, N_TERM)) return false;
+  for (int t = 0; t < N_TERM; t++) {
+    if (!terminal_recupera(self->term[t], arq)) return false;
+  }
+  return true;
+}
+
+bool console_define_entrada(console_t *self, char id_terminal, char *nome_arquivo)
+{
+  int num_terminal = tolower(id_terminal) - 'a';
+  if (num_terminal < 0 || num_terminal >= N_TERM) return false;
+  FILE *arq = fopen(nome_arquivo, "r");
+  if (arq == NULL) return false;
+  if (self->entrada_term[num_terminal] != NULL) {
+    fclose(self->entrada_term[num_terminal]);
+  }
+  self->entrada_term[num_terminal] = arq;
+  return true;
+}
+
+void console_define_registro(console_t *self, registro_t *registro)
+{
+  self->registro = registro;
 }
 
 static void insere_string_no_terminal(console_t *self, char id_terminal, char *str)
@@ -164,16 +306,33 @@ static void limpa_saida_do_terminal(console_t *self, char id_terminal)
 // SAÍDA {{{1
 // ---------------------------------------------------------------------
 
+// rola a área da console 'n' linhas para cima (para trás no histórico), ou
+//   para baixo se 'n' for negativo, sem passar da primeira nem da última
+static void console_rola(console_t *self, int n)
+{
+  long guardadas = self->n_linhas < self->n_historico ? self->n_linhas
+                                                       : self->n_historico;
+  long max = guardadas - N_LIN_CONSOLE;
+  long rolagem = self->rolagem + n;
+  if (rolagem > max) rolagem = max;
+  if (rolagem < 0) rolagem = 0;
+  self->rolagem = rolagem;
+}
+
+// chamada com a trava, então só tem um produtor para o escritor do log
 static void insere_string_na_console(console_t *self, char *s)
 {
-  for(int l=0; l<N_LIN_CONSOLE-1; l++) {
-    strncpy(self->txt_console[l], self->txt_console[l+1], N_COL);
-    self->txt_console[l][N_COL] = '\0'; // quem definiu strncpy é estúpido!
+  // sem tela, ninguém vê as linhas da console
+  if (self->com_tela) {
+    char *linha = self->historico[self->n_linhas % self->n_historico];
+    strncpy(linha, s, N_COL);
+    linha[N_COL] = '\0'; // quem definiu strncpy é estúpido!
+    self->n_linhas++;
+    // se o operador está vendo linhas antigas, elas continuam no lugar
+    if (self->rolagem > 0) console_rola(self, 1);
   }
-  strncpy(self->txt_console[N_LIN_CONSOLE-1], s, N_COL);
-  self->txt_console[N_LIN_CONSOLE-1][N_COL] = '\0'; // grrrr
   if (self->arquivo_de_log != NULL) {
-    fprintf(self->arquivo_de_log, "%s\n", s);
+    escritor_escreve_linha(self->arquivo_de_log, s);
   }
 }
 
@@ -195,7 +354,9 @@ static void insere_strings_na_console(console_t *self, char *s)
 void console_print_status(console_t *self, char *txt)
 {
   // imprime alinhado a esquerda ("-"), max N_COL chars ("*")
+  pthread_mutex_lock(&self->trava);
   sprintf(self->txt_status, "%-*s", N_COL, txt);
+  pthread_mutex_unlock(&self->trava);
 }
 
 int console_printf(char *formato, ...)
@@ -203,12 +364,16 @@ int console_printf(char *formato, ...)
   // esta função usa número variável de argumentos, como o printf.
   // Se não sabe como é isso, dá uma olhada em:
   // https://www.geeksforgeeks.org/variadic-functions-in-c/
-  console_t *self = console_global; // gambiarra para simplificar o uso de prints na console
-  char s[sizeof(self->txt_console)];
+  console_t *self = console_da_thread;
+  if (self == NULL) return 0;
+  char s[TAM_PRINTF];
   va_list arg;
   va_start(arg, formato);
   int r = vsnprintf(s, sizeof(s), formato, arg);
+  va_end(arg);
+  pthread_mutex_lock(&self->trava);
   insere_strings_na_console(self, s);
+  pthread_mutex_unlock(&self->trava);
   return r;
 }
 
@@ -229,7 +394,9 @@ static void insere_comando_externo(console_t *self, char c)
 // wrapper público para permitir que outros módulos insiram comandos
 void console_insere_comando_externo(console_t *self, char c)
 {
+  pthread_mutex_lock(&self->trava);
   insere_comando_externo(self, c);
+  pthread_mutex_unlock(&self->trava);
 }
 
 static char remove_comando_externo(console_t *self)
@@ -255,6 +422,7 @@ static void interpreta_linha_entrada(console_t *self)
   // F     fim da simulação
 
   char *linha = self->txt_entrada;
+  if (self->registro != NULL) registro_grava_entrada(self->registro, 'L', linha);
   console_printf("CMD: '%s'", linha);
   char cmd = toupper(linha[0]);
   int val;
@@ -288,7 +456,11 @@ static void verifica_entrada(console_t *self)
 
   int l = strlen(self->txt_entrada);
 
-  if (ch == '\b' || ch == 127) {   // backspace ou del
+  if (ch == TELA_PAG_ACIMA) {
+    console_rola(self, N_LIN_CONSOLE - 1);
+  } else if (ch == TELA_PAG_ABAIXO) {
+    console_rola(self, -(N_LIN_CONSOLE - 1));
+  } else if (ch == '\b' || ch == 127) {   // backspace ou del
     if (l > 0) {
       self->txt_entrada[l - 1] = '\0';
     }
@@ -300,10 +472,78 @@ static void verifica_entrada(console_t *self)
   } // senão, ignora o caractere digitado
 }
 
+// na execução em lote, passa a próxima linha do arquivo de entrada de cada
+//   terminal que já consumiu a linha anterior
+static void verifica_arquivos_de_entrada(console_t *self)
+{
+  for (int t = 0; t < N_TERM; t++) {
+    FILE *arq = self->entrada_term[t];
+    if (arq == NULL) continue;
+    if (terminal_txt_entrada(self->term[t])[0] != '\0') continue;
+    char linha[N_COL + 1];
+    if (fgets(linha, sizeof(linha), arq) == NULL) {
+      fclose(arq);
+      self->entrada_term[t] = NULL;
+      continue;
+    }
+    linha[strcspn(linha, "\n")] = '\0';
+    if (self->registro != NULL) {
+      char dado[N_COL + 2];
+      sprintf(dado, "%c%s", 'a' + t, linha);
+      registro_grava_entrada(self->registro, 'T', dado);
+    }
+    insere_string_no_terminal(self, 'a' + t, linha);
+  }
+}
+
+// na reprodução, entrega as entradas gravadas no ponto atual, da mesma forma
+//   que foram entregues na gravação
+static void reproduz_entradas(console_t *self)
+{
+  char dado[N_COL + 2];
+  char tipo;
+  while ((tipo = registro_proxima_entrada(self->registro, dado, sizeof(dado))) != '\0') {
+    switch (tipo) {
+      case 'L':
+        strcpy(self->txt_entrada, dado);
+        interpreta_linha_entrada(self);
+        break;
+      case 'T':
+        insere_string_no_terminal(self, dado[0], &dado[1]);
+        break;
+      case 'C':
+        insere_comando_externo(self, dado[0]);
+        break;
+    }
+  }
+  if (registro_terminou(self->registro)) insere_comando_externo(self, 'F');
+}
+
+// verifica a entrada (teclado, arquivos ou registro), em um ponto do registro
+// 'arquivos' diz se é o ponto em que a entrada dos arquivos é verificada
+static void verifica_entradas(console_t *self, bool arquivos)
+{
+  if (self->registro != NULL) {
+    registro_ponto(self->registro);
+    if (registro_modo(self->registro) == registro_reproduz) {
+      reproduz_entradas(self);
+      return;
+    }
+  }
+  if (self->com_tela) {
+    verifica_entrada(self);
+  } else if (arquivos) {
+    verifica_arquivos_de_entrada(self);
+  }
+}
+
 char console_comando_externo(console_t *self)
 {
-  verifica_entrada(self);
-  return remove_comando_externo(self);
+  pthread_mutex_lock(&self->trava);
+  verifica_entradas(self, true);
+  char cmd = remove_comando_externo(self);
+  pthread_mutex_unlock(&self->trava);
+  return cmd;
 }
 
 
@@ -311,8 +551,22 @@ char console_comando_externo(console_t *self)
 // DESENHO {{{1
 // ---------------------------------------------------------------------
 
-static void desenha_linha_terminal(char *txt, int linha, int cor_txt, int cor_cursor)
+// true se a linha 'linha' da tela já tem o texto 'txt'; senão, guarda o
+//   texto como o da linha (que vai ser desenhada)
+static bool linha_igual(console_t *self, int linha, char *txt)
+{
+  char *na_tela = self->txt_tela[linha];
+  if (self->tela_valida && strncmp(na_tela, txt, N_COL) == 0) return true;
+  size_t n = strnlen(txt, N_COL);
+  memcpy(na_tela, txt, n);
+  na_tela[n] = '\0';
+  return false;
+}
+
+static void desenha_linha_terminal(console_t *self, char *txt, int linha,
+                                   int cor_txt, int cor_cursor)
 {
+  if (linha_igual(self, linha, txt)) return;
   tela_posiciona(linha, 0);
   tela_puts(cor_txt, txt);
   tela_limpa_linha();
@@ -326,23 +580,38 @@ static void desenha_terminais(console_t *self)
     int cor_txt = self->cor_txt[t];
     int cor_cursor = self->cor_cursor[t];
     int linha = LINHA_TERM + t * 2;
-    desenha_linha_terminal(terminal_txt_entrada(terminal), linha, cor_txt, cor_cursor);
-    desenha_linha_terminal(terminal_txt_saida(terminal), linha+1, cor_txt, cor_cursor);
+    desenha_linha_terminal(self, terminal_txt_entrada(terminal), linha, cor_txt, cor_cursor);
+    desenha_linha_terminal(self, terminal_txt_saida(terminal), linha+1, cor_txt, cor_cursor);
   }
 }
 
 static void desenha_status(console_t *self)
 {
+  if (linha_igual(self, LINHA_STATUS, self->txt_status)) return;
   tela_posiciona(LINHA_STATUS, 0);
   tela_puts(COR_STATUS, self->txt_status);
   tela_limpa_linha();
 }
 
+// mostra as N_LIN_CONSOLE linhas do histórico que terminam 'rolagem' linhas
+//   antes da última; a última linha da área diz quanto está rolado
 static void desenha_console(console_t *self)
 {
+  long primeira = self->n_linhas - self->rolagem - N_LIN_CONSOLE;
   for (int l=0; l<N_LIN_CONSOLE; l++) {
+    long i = primeira + l;
+    char *txt = "";
+    char aviso[N_COL+1];
+    if (self->rolagem > 0 && l == N_LIN_CONSOLE - 1) {
+      snprintf(aviso, sizeof(aviso), "--- %d linhas acima do fim (PgUp/PgDn) ---",
+               self->rolagem);
+      txt = aviso;
+    } else if (i >= 0 && i >= self->n_linhas - self->n_historico) {
+      txt = self->historico[i % self->n_historico];
+    }
+    if (linha_igual(self, LINHA_CONSOLE + l, txt)) continue;
     tela_posiciona(LINHA_CONSOLE + l, 0);
-    tela_puts(COR_CONSOLE, self->txt_console[l]);
+    tela_puts(COR_CONSOLE, txt);
     tela_limpa_linha();
   }
 }
@@ -350,26 +619,50 @@ static void desenha_console(console_t *self)
 static void desenha_entrada(console_t *self)
 {
   char txt_fixo[] = "P=para C=continua 1=passo F=fim  Ets=entra Zt=zera";
-  tela_posiciona(LINHA_ENTRADA, 0);
-  tela_puts(COR_ENTRADA, ""); // gambiarra para limpar na cor certa
-  tela_limpa_linha();
-  tela_posiciona(LINHA_ENTRADA, N_COL - sizeof(txt_fixo));
-  tela_puts(COR_ENTRADA, txt_fixo);
+  if (!linha_igual(self, LINHA_ENTRADA, self->txt_entrada)) {
+    tela_posiciona(LINHA_ENTRADA, 0);
+    tela_puts(COR_ENTRADA, ""); // gambiarra para limpar na cor certa
+    tela_limpa_linha();
+    tela_posiciona(LINHA_ENTRADA, N_COL - sizeof(txt_fixo));
+    tela_puts(COR_ENTRADA, txt_fixo);
+  }
+  // o cursor fica no fim da entrada
   tela_posiciona(LINHA_ENTRADA, 0);
   tela_puts(COR_ENTRADA, self->txt_entrada);
 }
 
+// desenha as linhas da tela que mudaram desde a última vez
 static void console_desenha(console_t *self)
 {
+  if (!self->com_tela) return;
   desenha_terminais(self);
   desenha_status(self);
   desenha_console(self);
   desenha_entrada(self);
+  self->tela_valida = true;
 
   // faz aparecer tudo que foi desenhado
   tela_atualiza();
 }
 
+static double agora(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// desenha a tela, se já passou o tempo de um quadro desde a última vez
+static void console_desenha_quadro(console_t *self)
+{
+  if (!self->com_tela) return;
+  double t = agora();
+  if (t < self->prox_quadro) return;
+  self->prox_quadro = t + 1.0 / QUADROS_POR_SEGUNDO;
+  if (self->f_status != NULL) self->f_status(self->arg_status);
+  console_desenha(self);
+}
+
 
 // ---------------------------------------------------------------------
 // TICTAC {{{1
@@ -377,9 +670,16 @@ static void console_desenha(console_t *self)
 
 void console_tictac(console_t *self)
 {
-  verifica_entrada(self);
-  atualiza_terminais(self);
-  console_desenha(self);
+  console_tictac_n(self, 1);
+}
+
+void console_tictac_n(console_t *self, int n)
+{
+  pthread_mutex_lock(&self->trava);
+  verifica_entradas(self, false);
+  atualiza_terminais(self, n);
+  console_desenha_quadro(self);
+  pthread_mutex_unlock(&self->trava);
 }
 
 // vim: foldmethod=marker
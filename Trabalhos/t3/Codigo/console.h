@@ -8,21 +8,41 @@
 
 #include <stdbool.h>
 #include "terminal.h"
+#include "registro.h"
 
 typedef struct console_t console_t;
 
 // cria e inicializa a console
-console_t *console_cria(void);
+// as últimas 'n_historico' linhas impressas são guardadas, para o operador
+//   poder voltar a elas (PgUp/PgDn)
+console_t *console_cria(int n_historico);
+
+// cria a console sem tela, para execução em lote
+// não lê o teclado nem desenha nada; o que seria impresso na console só vai
+//   para o arquivo de log 'nome_log' (ou para lugar nenhum, se for NULL), e
+//   a entrada dos terminais pode vir de arquivos (ver console_define_entrada)
+console_t *console_cria_sem_tela(char *nome_log);
+
+// define a console onde console_printf imprime, na thread que chama
+// a thread que cria uma console já passa a usá-la; as outras threads da
+//   mesma simulação (as das CPUs secundárias) devem chamar esta função
+void console_usa_na_thread(console_t *self);
 
 // destrói a console
 void console_destroi(console_t *self);
 
-// imprime na área geral do console
+// imprime na área geral da console da thread (ver console_usa_na_thread)
 int console_printf(char *fmt, ...);
 
 // imprime na linha de status
 void console_print_status(console_t *self, char *txt);
 
+// define a função que atualiza a linha de status (com console_print_status),
+//   chamada com 'arg' sempre que a tela vai ser desenhada
+// a tela é desenhada no máximo algumas dezenas de vezes por segundo (e
+//   nunca, sem tela), então a função pode ser cara
+void console_define_status(console_t *self, void (*f_status)(void *), void *arg);
+
 // retorna o próximo comando externo digitado pelo operador na console.
 // um comando externo é representado por um caractere, e não é executado internamente
 //   na console (é executado pelo controlador).
@@ -37,10 +57,42 @@ char console_comando_externo(console_t *self);
 // retorna o terminal identificado ('A', 'B', etc)
 terminal_t *console_terminal(console_t *self, char id_terminal);
 
+// define um arquivo de onde vem o que é digitado no terminal identificado,
+//   em uma console sem tela
+// cada linha do arquivo é inserida no terminal (seguida de um espaço, como
+//   no comando E da console) quando a entrada do terminal estiver vazia
+// retorna false se o terminal não existir ou o arquivo não puder ser aberto
+bool console_define_entrada(console_t *self, char id_terminal, char *nome_arquivo);
+
+// define o registro onde a console grava o que entra nela (o que o operador
+//   digita e as linhas dos arquivos de entrada), ou de onde reproduz essas
+//   entradas, no lugar do teclado e dos arquivos (ver registro.h)
+// cada verificação de entrada da console (em console_tictac_n e
+//   console_comando_externo) é um ponto do registro
+void console_define_registro(console_t *self, registro_t *registro);
+
 // esta função deve ser chamada periodicamente para que tela funcione
+// a entrada é verificada a cada chamada, mas a tela só é desenhada se já
+//   tiver passado o tempo de um quadro (em tempo real) desde a última vez,
+//   e só as linhas que mudaram
 void console_tictac(console_t *self);
 
+// como console_tictac, mas os terminais avançam n unidades de tempo
+// (a entrada e o desenho da tela são feitos uma vez só)
+void console_tictac_n(console_t *self, int n);
+
+// retorna o menor prazo de interrupção da tela dos terminais (ver
+//   terminal_prazo_tela), ou -1 se nenhum tem
+int console_prazo_terminais(console_t *self);
+
 // Insere um comando externo na fila (por exemplo 'F' para finalizar)
 void console_insere_comando_externo(console_t *self, char c);
 
+// salva o estado dos terminais na imagem 'arq' (ver imagem.h)
+// o que está na tela da console não faz parte do estado da máquina
+bool console_salva(console_t *self, FILE *arq);
+
+// recupera o estado dos terminais da imagem 'arq'
+bool console_recupera(console_t *self, FILE *arq);
+
 #endif // CONSOLE_H
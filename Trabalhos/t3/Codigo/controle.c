@@ -9,20 +9,42 @@
 #include <string.h>
 #include <stdio.h>
 #include <assert.h>
+#include <pthread.h>
+#include <time.h>
+
+// tempo que uma CPU secundária espera quando não tem o que fazer (em ns)
+#define ESPERA_SECUNDARIA 100000
+
+typedef enum { executando, passo, parado, fim } estado_t;
 
 struct controle_t {
   cpu_t *cpu;
   relogio_t *relogio;
+  pic_t *pic;
   console_t *console;
-  enum { executando, passo, parado, fim } estado;
+  // lido pelas threads das CPUs secundárias
+  _Atomic estado_t estado;
+  // tamanho máximo da rajada de instruções (1 executa uma instrução por vez)
+  int rajada_max;
+  // tempo em que a simulação deve terminar (0 se não tem limite)
+  int limite;
+  // numa CPU secundária, o controlador da principal (NULL na principal)
+  controle_t *principal;
+  // na principal, os controladores das secundárias
+  int n_secundarios;
+  controle_t *secundarios[CPU_MAX - 1];
+  // na secundária, a thread que executa o laço
+  pthread_t thread;
 };
 
 // funções auxiliares
+static int controle_tamanho_rajada(controle_t *self);
 static void controle_processa_comandos_da_console(controle_t *self);
-static void controle_atualiza_estado_na_console(controle_t *self);
+static void controle_atualiza_estado_na_console(void *arg);
 
 
-controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio)
+controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio,
+                          pic_t *pic)
 {
   controle_t *self = malloc(sizeof(*self));
   assert(self != NULL);
@@ -30,43 +52,177 @@ controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio)
   self->cpu = cpu;
   self->console = console;
   self->relogio = relogio;
+  self->pic = pic;
   self->estado = parado;
+  self->rajada_max = RAJADA_MAX;
+  self->limite = 0;
+  self->principal = NULL;
+  self->n_secundarios = 0;
+  // a linha de status é atualizada pela console, quando ela desenha a tela
+  if (console != NULL) {
+    console_define_status(console, controle_atualiza_estado_na_console, self);
+  }
 
   return self;
 }
 
+controle_t *controle_cria_secundario(controle_t *principal, cpu_t *cpu,
+                                     relogio_t *relogio, pic_t *pic)
+{
+  assert(principal->principal == NULL);
+  assert(principal->n_secundarios < CPU_MAX - 1);
+  controle_t *self = controle_cria(cpu, NULL, relogio, pic);
+  self->principal = principal;
+  principal->secundarios[principal->n_secundarios++] = self;
+  return self;
+}
+
 void controle_destroi(controle_t *self)
 {
   free(self);
 }
 
+void controle_define_rajada(controle_t *self, int rajada_max)
+{
+  assert(rajada_max > 0);
+  self->rajada_max = rajada_max;
+}
+
+void controle_define_limite(controle_t *self, int limite)
+{
+  assert(limite >= 0);
+  self->limite = limite;
+}
+
+// termina a simulação se o relógio chegou no limite
+static void controle_verifica_limite(controle_t *self)
+{
+  if (self->limite == 0) return;
+  int agora;
+  relogio_leitura(self->relogio, 0, &agora);
+  if (agora >= self->limite) {
+    console_printf("Limite de %d instruções atingido.", self->limite);
+    self->estado = fim;
+  }
+}
+
+// executa uma rajada de instruções na CPU, passa o tempo no relógio e
+//   entrega à CPU a interrupção pedida ao controlador de interrupções
+// retorna o tempo que passou
+static int controle_executa_rajada(controle_t *self)
+{
+  int n = controle_tamanho_rajada(self);
+  irq_t irq;
+  if (cpu_parada(self->cpu) && pic_proxima(self->pic, &irq)) {
+    // pedida depois da última rajada (por um terminal, na passagem do tempo
+    //   da console): acorda a CPU sem passar o tempo parada
+    cpu_interrompe(self->cpu, irq);
+  }
+  if (cpu_parada(self->cpu)) {
+    // a CPU só sai desse estado com uma interrupção; o tempo avança
+    //   direto até o relógio pedir a interrupção (a rajada é até lá)
+    // uma CPU secundária parada não passa à frente do relógio da principal,
+    //   para que os relógios das CPUs não se afastem muito
+    if (self->principal != NULL) {
+      int agora, agora_principal;
+      relogio_leitura(self->relogio, 0, &agora);
+      relogio_leitura(self->principal->relogio, 0, &agora_principal);
+      if (agora_principal - agora < n) n = agora_principal - agora;
+      if (n <= 0) return 0;
+    }
+    relogio_tictac_ocioso(self->relogio, n);
+  } else {
+    n = cpu_executa_n(self->cpu, n);
+    relogio_tictac_n(self->relogio, n);
+  }
+
+  // se a CPU não aceitar (está atendendo outra), a interrupção continua
+  //   pendente no controlador, e é entregue depois de outra rajada
+  if (pic_proxima(self->pic, &irq)) {
+    cpu_interrompe(self->cpu, irq);
+  }
+  return n;
+}
+
+// laço de uma CPU secundária, executado em uma thread própria
+// a CPU executa enquanto a principal estiver executando (no passo a passo,
+//   só a principal executa), até o fim da simulação
+static void *controle_laco_secundario(void *arg)
+{
+  controle_t *self = arg;
+  controle_t *principal = self->principal;
+  console_usa_na_thread(principal->console);
+  estado_t estado;
+  while ((estado = principal->estado) != fim) {
+    if (estado != executando || controle_executa_rajada(self) == 0) {
+      struct timespec espera = { 0, ESPERA_SECUNDARIA };
+      nanosleep(&espera, NULL);
+    }
+  }
+  return NULL;
+}
+
 void controle_laco(controle_t *self)
 {
-  // executa uma instrução por vez até a console dizer que chega
+  assert(self->principal == NULL);
+  for (int i = 0; i < self->n_secundarios; i++) {
+    controle_t *sec = self->secundarios[i];
+    int r = pthread_create(&sec->thread, NULL, controle_laco_secundario, sec);
+    assert(r == 0);
+  }
+
+  // um comando que já está esperando (o de começar, em lote) é atendido
+  //   antes da primeira volta, para que os terminais não andem parados (o
+  //   que, depois de recuperar uma imagem, mudaria o tempo deles)
+  controle_processa_comandos_da_console(self);
+
+  // executa rajadas de instruções até a console dizer que chega
+  // os dispositivos e a console são atualizados uma vez por rajada
   do {
+    int n = 0;
     if (self->estado == passo || self->estado == executando) {
-      cpu_executa_1(self->cpu);
-      relogio_tictac(self->relogio);
-
+      n = controle_executa_rajada(self);
       if (self->estado == passo) self->estado = parado;
-
-      // enquanto não tem controlador de interrupção, fala direto com o relógio
-      // o dispositivo 3 do relógio contém 1 se o timer expirou
-      int tem_int;
-      relogio_leitura(self->relogio, 3, &tem_int);
-      if (tem_int != 0) {
-        cpu_interrompe(self->cpu, IRQ_RELOGIO);
-      }
     }
-    console_tictac(self->console);
+    // parado, os terminais continuam andando uma unidade de tempo por volta
+    console_tictac_n(self->console, n > 0 ? n : 1);
 
     controle_processa_comandos_da_console(self);
-    controle_atualiza_estado_na_console(self);
+    controle_verifica_limite(self);
   } while (self->estado != fim);
+  controle_atualiza_estado_na_console(self);
 
+  for (int i = 0; i < self->n_secundarios; i++) {
+    pthread_join(self->secundarios[i]->thread, NULL);
+  }
   console_printf("Fim da execução.");
 }
- 
+
+// quantas instruções executar na próxima rajada
+// a rajada não passa do momento em que o relógio vai pedir interrupção ou
+//   disparar um evento, para que sejam atendidos no mesmo instante que se as
+//   instruções fossem executadas uma a uma
+// com a CPU parada, a rajada vai até lá, mesmo que passe do tamanho máximo,
+//   mas não passa do momento em que um terminal vai pedir interrupção (os
+//   terminais avançam depois da rajada, com a console)
+static int controle_tamanho_rajada(controle_t *self)
+{
+  if (self->estado == passo) return 1;
+  int n = self->rajada_max;
+  int prazo = relogio_proximo_prazo(self->relogio);
+  if (prazo >= 0) {
+    int agora;
+    relogio_leitura(self->relogio, 0, &agora);
+    int t_ate_prazo = prazo > agora ? prazo - agora : 1;
+    if (cpu_parada(self->cpu) || t_ate_prazo < n) n = t_ate_prazo;
+  }
+  if (cpu_parada(self->cpu) && self->principal == NULL) {
+    int t_terminal = console_prazo_terminais(self->console);
+    if (t_terminal > 0 && t_terminal < n) n = t_terminal;
+  }
+  return n;
+}
+
 
 static void controle_processa_comandos_da_console(controle_t *self)
 {
@@ -87,8 +243,9 @@ static void controle_processa_comandos_da_console(controle_t *self)
   }
 }
 
-static void controle_atualiza_estado_na_console(controle_t *self)
+static void controle_atualiza_estado_na_console(void *arg)
 {
+  controle_t *self = arg;
   char status[100];
   switch (self->estado) {
     case fim:        strcpy(status, "FIM    | "); break;
@@ -11,11 +11,36 @@ typedef struct controle_t controle_t;
 #include "cpu.h"
 #include "console.h"
 #include "relogio.h"
+#include "pic.h"
 
-controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio);
+// cria o controlador da CPU 'cpu', que passa o tempo em 'relogio' e entrega
+//   à CPU as interrupções pedidas a 'pic'
+controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio,
+                          pic_t *pic);
 void controle_destroi(controle_t *self);
 
-// o laço principal da simulação
+// cria o controlador de uma CPU secundária, que compartilha a memória com a
+//   CPU do controlador 'principal' e tem seu próprio relógio e controlador de
+//   interrupções
+// a CPU secundária é executada em uma thread própria durante o laço do
+//   controlador principal, e obedece aos comandos da console recebidos por ele
+controle_t *controle_cria_secundario(controle_t *principal, cpu_t *cpu,
+                                     relogio_t *relogio, pic_t *pic);
+
+// número máximo de instruções executadas em uma rajada, entre duas
+//   atualizações dos dispositivos e da console, se não for definido outro
+#define RAJADA_MAX 1000
+
+// define o número máximo de instruções executadas em cada rajada do laço
+//   principal (1 para atualizar dispositivos e console a cada instrução)
+void controle_define_rajada(controle_t *self, int rajada_max);
+
+// define um limite para o tempo simulado (em instruções): a simulação termina
+//   quando o relógio chegar nele (0, o padrão, é sem limite)
+void controle_define_limite(controle_t *self, int limite);
+
+// o laço principal da simulação (só para o controlador principal)
+// executa as CPUs secundárias nas suas threads, até o fim da simulação
 void controle_laco(controle_t *self);
 
 #endif // CONTROLE_H
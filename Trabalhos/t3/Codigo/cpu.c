@@ -11,17 +11,66 @@
 #include "err.h"
 #include "instrucao.h"
 #include "console.h"
+#include "jit.h"
+#include "imagem.h"
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 #include <assert.h>
+#include <stdatomic.h>
 
 
 // ---------------------------------------------------------------------
 // DECLARAÇÃO {{{1
 // ---------------------------------------------------------------------
 
+// tipo das funções que implementam as instruções
+// recebem o argumento da instrução (A1) já lido da memória; as instruções
+//   sem argumento ignoram esse valor
+typedef void (*op_t)(cpu_t *self, int A1);
+
+typedef struct instr_decod_t instr_decod_t;
+
+// tipo das funções que implementam as superinstruções (grupos de instruções
+//   que aparecem juntas com frequência, executadas com um só despacho)
+// retornam o número de instruções do grupo que foram executadas (menos que
+//   todas se uma delas colocar a CPU em erro)
+typedef int (*fusao_t)(cpu_t *self, instr_decod_t *instr);
+
+// número máximo de instruções e de argumentos em uma superinstrução
+#define FUSAO_MAX_INSTR 4
+#define FUSAO_MAX_ARGS  3
+// número máximo de palavras ocupadas por uma superinstrução
+#define FUSAO_MAX_TAM   (FUSAO_MAX_INSTR + FUSAO_MAX_ARGS)
+
+// uma instrução decodificada, como mantida na cache de instruções
+struct instr_decod_t {
+  // endereço físico do opcode (-1 se a entrada não contém instrução)
+  int end;
+  int opcode;
+  int A1;
+  // função que executa a instrução
+  op_t op;
+  // número de palavras de memória ocupadas pela instrução (ou pelo grupo)
+  int tam;
+  // se a instrução inicia uma superinstrução: a função que a executa, o
+  //   número de instruções do grupo e os argumentos delas, em ordem
+  fusao_t fusao;
+  int n_fusao;
+  int args[FUSAO_MAX_ARGS];
+};
+
+// número de entradas na cache de instruções decodificadas (potência de 2)
+// a cache é indexada pelo endereço físico da instrução, então não precisa
+//   ser esvaziada quando a MMU muda de tabela de páginas
+#define N_INSTR_DECOD 1024
+
+// número de vezes que um bloco de instruções deve ser executado para ser
+//   traduzido para código nativo (com CPU_JIT)
+#define JIT_QUENTE 16
+
 // uma CPU tem estado, memória, controlador de ES
 struct cpu_t {
   // registradores
@@ -40,8 +89,31 @@ struct cpu_t {
   // função e argumento para implementar instrução CHAMAC
   func_chamaC_t func_chamaC;
   void *arg_chamaC;
+  // cache de instruções decodificadas, para não ter que ler opcode e
+  //   argumento da memória (com tradução de endereço) a cada execução
+  instr_decod_t cache[N_INSTR_DECOD];
+  // faixa de endereços onde está o PC, para buscar instruções sem a MMU
+  mmu_janela_t janela;
+  // tradutor de blocos de instruções para código nativo (NULL se não tem)
+  jit_t *jit;
+  // se as superinstruções devem ser usadas
+  bool fusao;
+  // número de despachos (execuções de instrução ou superinstrução) e de
+  //   instruções executadas dentro de superinstruções
+  long n_despachos;
+  long n_fundidas;
+  // colocado em true quando outra CPU escreve em um endereço que esta tem
+  //   copiado na cache ou em bloco traduzido; as cópias são descartadas no
+  //   início da próxima rajada
+  atomic_bool esvaziar;
 };
 
+// a CPU que executa na thread (cada CPU executa em uma thread própria)
+static _Thread_local cpu_t *cpu_da_thread;
+
+static void cpu_aviso_escrita(void *arg, int endereco);
+static void descarta_janela(cpu_t *self);
+
 
 // ---------------------------------------------------------------------
 // CRIAÇÃO {{{1
@@ -74,12 +146,33 @@ cpu_t *cpu_cria(mmu_t *mmu, es_t *es)
   self->privilegiadas[RETI] = true;
   self->privilegiadas[CHAMAC] = true;
 
+  // inicializa a cache de instruções vazia, e pede para ser avisada das
+  //   alterações na memória, para invalidar instruções alteradas
+  for (int i = 0; i < N_INSTR_DECOD; i++) {
+    self->cache[i].end = -1;
+  }
+  bool ok = mmu_inclui_aviso_escrita(self->mmu, cpu_aviso_escrita, self);
+  assert(ok);
+  atomic_init(&self->esvaziar, false);
+  descarta_janela(self);
+  self->fusao = false;
+  self->n_despachos = 0;
+  self->n_fundidas = 0;
+
+#ifdef CPU_JIT
+  self->jit = jit_cria(JIT_QUENTE);
+#else
+  self->jit = NULL;
+#endif
+
   return self;
 }
 
 void cpu_destroi(cpu_t *self)
 {
   // quem criou mmu e e/s que destrua!
+  mmu_retira_aviso_escrita(self->mmu, self);
+  if (self->jit != NULL) jit_destroi(self->jit);
   free(self);
 }
 
@@ -89,6 +182,21 @@ void cpu_define_chamaC(cpu_t *self, func_chamaC_t func_chamaC, void *arg_chamaC)
   self->arg_chamaC = arg_chamaC;
 }
 
+void cpu_define_fusao(cpu_t *self, bool fusao)
+{
+  self->fusao = fusao;
+  // as instruções já decodificadas não procuraram (ou procuraram) padrões
+  for (int i = 0; i < N_INSTR_DECOD; i++) {
+    self->cache[i].end = -1;
+  }
+}
+
+void cpu_estatisticas(cpu_t *self, long *pdespachos, long *pfundidas)
+{
+  *pdespachos = self->n_despachos;
+  *pfundidas = self->n_fundidas;
+}
+
 
 // ---------------------------------------------------------------------
 // DESCRIÇÃO {{{1
@@ -188,23 +296,73 @@ static bool poe_es(cpu_t *self, int dispositivo, int val)
   return false;
 }
 
+// a CPU mantém a faixa de endereços onde está o PC (a página, em modo
+//   usuário), com acesso direto à memória física, para buscar instruções
+//   sem passar pela MMU enquanto o PC estiver nela
+// a tradução só muda quando o SO altera a tabela de páginas, o que só
+//   acontece entre rajadas de execução ou com a CPU em modo supervisor; por
+//   isso a janela é descartada no início de cada rajada e a cada mudança de
+//   modo, e as leituras pela janela não precisam marcar acesso (a página foi
+//   marcada quando a janela foi posicionada)
+
+static void descarta_janela(cpu_t *self)
+{
+  self->janela.ini = 0;
+  self->janela.fim = 0;
+}
+
+// traduz o endereço 'end' de busca de instrução, pela janela ou
+//   reposicionando a janela
+// retorna false se não for possível (a busca deve passar pela MMU)
+static bool traduz_busca(cpu_t *self, int end, int *pendfis)
+{
+  if (end < self->janela.ini || end >= self->janela.fim) {
+    if (mmu_janela(self->mmu, end, self->modo, &self->janela) != ERR_OK) {
+      descarta_janela(self);
+      return false;
+    }
+  }
+  *pendfis = end + self->janela.desloc;
+  return true;
+}
+
+// lê uma palavra de instrução, pela janela se estiver nela
+static bool pega_busca(cpu_t *self, int endereco, int *pval)
+{
+  if (endereco >= self->janela.ini && endereco < self->janela.fim) {
+    *pval = self->janela.mem[endereco - self->janela.ini];
+    return true;
+  }
+  return pega_mem(self, endereco, pval);
+}
+
+// verifica se a instrução com o opcode (válido) pode ser executada no modo
+//   atual da CPU (instrução privilegiada só em modo supervisor)
+static bool pode_executar(cpu_t *self, int opcode)
+{
+  if (self->modo == supervisor || !self->privilegiadas[opcode]) return true;
+  self->erro = ERR_INSTR_PRIV;
+  return false;
+}
+
 // lê o opcode da instrução no PC
 // retorna true se ele pode ser executado, ou põe em erro o motivo de não poder
 static bool pega_opcode(cpu_t *self, int *popc)
 {
   // não pode executar se houver erro na leitura da memória
-  if (!pega_mem(self, self->PC, popc)) return false;
-  // pode executar se tiver privilégio para isso
-  if (self->modo == supervisor || !self->privilegiadas[*popc]) return true;
-  // não pode executar instrução privilegiada em modo usuário
-  self->erro = ERR_INSTR_PRIV;
-  return false;
+  if (!pega_busca(self, self->PC, popc)) return false;
+  // não pode executar o que não é instrução
+  if (*popc < 0 || *popc >= N_OPCODE) {
+    self->erro = ERR_INSTR_INV;
+    return false;
+  }
+  return pode_executar(self, *popc);
 }
 
 // lê o argumento 1 da instrução no PC
 static bool pega_A1(cpu_t *self, int *pA1)
 {
-  return pega_mem(self, self->PC + 1, pA1);
+  return pega_busca(self, self->PC + 1, pA1);
 }
 
 
@@ -213,63 +371,59 @@ static bool pega_A1(cpu_t *self, int *pA1)
 // ---------------------------------------------------------------------
 
 // funções auxiliares para implementação de cada instrução
+// o argumento A1 já foi lido da memória, junto com o opcode
 
-static void op_NOP(cpu_t *self) // não faz nada
+static void op_NOP(cpu_t *self, int A1) // não faz nada
 {
   self->PC += 1;
 }
 
-static void op_PARA(cpu_t *self) // para a CPU
+static void op_PARA(cpu_t *self, int A1) // para a CPU
 {
   self->erro = ERR_CPU_PARADA;
 }
 
-static void op_CARGI(cpu_t *self) // carrega imediato
+static void op_CARGI(cpu_t *self, int A1) // carrega imediato
 {
-  int A1;
-  if (pega_A1(self, &A1)) {
-    self->A = A1;
-    self->PC += 2;
-  }
+  self->A = A1;
+  self->PC += 2;
 }
 
-static void op_CARGM(cpu_t *self) // carrega da memória
+static void op_CARGM(cpu_t *self, int A1) // carrega da memória
 {
-  int A1, mA1;
-  if (pega_A1(self, &A1) && pega_mem(self, A1, &mA1)) {
+  int mA1;
+  if (pega_mem(self, A1, &mA1)) {
     self->A = mA1;
     self->PC += 2;
   }
 }
 
-static void op_CARGX(cpu_t *self) // carrega indexado
+static void op_CARGX(cpu_t *self, int A1) // carrega indexado
 {
-  int A1, mA1mX;
+  int mA1mX;
   int X = self->X;
-  if (pega_A1(self, &A1) && pega_mem(self, A1 + X, &mA1mX)) {
+  if (pega_mem(self, A1 + X, &mA1mX)) {
     self->A = mA1mX;
     self->PC += 2;
   }
 }
 
-static void op_ARMM(cpu_t *self) // armazena na memória
+static void op_ARMM(cpu_t *self, int A1) // armazena na memória
 {
-  int A1;
-  if (pega_A1(self, &A1) && poe_mem(self, A1, self->A)) {
+  if (poe_mem(self, A1, self->A)) {
     self->PC += 2;
   }
 }
 
-static void op_ARMX(cpu_t *self) // armazena indexado
+static void op_ARMX(cpu_t *self, int A1) // armazena indexado
 {
-  int A1;
   int X = self->X;
-  if (pega_A1(self, &A1) && poe_mem(self, A1 + X, self->A)) {
+  if (poe_mem(self, A1 + X, self->A)) {
     self->PC += 2;
   }
 }
 
-static void op_TRAX(cpu_t *self) // troca A com X
+static void op_TRAX(cpu_t *self, int A1) // troca A com X
 {
   int A = self->A;
   int X = self->X;
@@ -278,142 +432,137 @@ static void op_TRAX(cpu_t *self) // troca A com X
   self->PC += 1;
 }
 
-static void op_CPXA(cpu_t *self) // copia X para A
+static void op_CPXA(cpu_t *self, int A1) // copia X para A
 {
   self->A = self->X;
   self->PC += 1;
 }
 
-static void op_INCX(cpu_t *self) // incrementa X
+static void op_INCX(cpu_t *self, int A1) // incrementa X
 {
   self->X += 1;
   self->PC += 1;
 }
 
-static void op_SOMA(cpu_t *self) // soma
+static void op_SOMA(cpu_t *self, int A1) // soma
 {
-  int A1, mA1;
-  if (pega_A1(self, &A1) && pega_mem(self, A1, &mA1)) {
+  int mA1;
+  if (pega_mem(self, A1, &mA1)) {
     self->A += mA1;
     self->PC += 2;
   }
 }
 
-static void op_SUB(cpu_t *self) // subtração
+static void op_SUB(cpu_t *self, int A1) // subtração
 {
-  int A1, mA1;
-  if (pega_A1(self, &A1) && pega_mem(self, A1, &mA1)) {
+  int mA1;
+  if (pega_mem(self, A1, &mA1)) {
     self->A -= mA1;
     self->PC += 2;
   }
 }
 
-static void op_MULT(cpu_t *self) // multiplicação
+static void op_MULT(cpu_t *self, int A1) // multiplicação
 {
-  int A1, mA1;
-  if (pega_A1(self, &A1) && pega_mem(self, A1, &mA1)) {
+  int mA1;
+  if (pega_mem(self, A1, &mA1)) {
     self->A *= mA1;
     self->PC += 2;
   }
 }
 
-static void op_DIV(cpu_t *self) // divisão
+static void op_DIV(cpu_t *self, int A1) // divisão
 {
-  int A1, mA1;
-  if (pega_A1(self, &A1) && pega_mem(self, A1, &mA1)) {
+  int mA1;
+  if (pega_mem(self, A1, &mA1)) {
     self->A /= mA1;
     self->PC += 2;
   }
 }
 
-static void op_RESTO(cpu_t *self) // resto
+static void op_RESTO(cpu_t *self, int A1) // resto
 {
-  int A1, mA1;
-  if (pega_A1(self, &A1) && pega_mem(self, A1, &mA1)) {
+  int mA1;
+  if (pega_mem(self, A1, &mA1)) {
     self->A %= mA1;
     self->PC += 2;
   }
 }
 
-static void op_NEG(cpu_t *self) // inverte sinal
+static void op_NEG(cpu_t *self, int A1) // inverte sinal
 {
   self->A = -self->A;
   self->PC += 1;
 }
 
-static void op_DESV(cpu_t *self) // desvio incondicional
+static void op_DESV(cpu_t *self, int A1) // desvio incondicional
 {
-  int A1;
-  if (pega_A1(self, &A1)) {
-    self->PC = A1;
-  }
+  self->PC = A1;
 }
 
-static void op_DESVZ(cpu_t *self) // desvio condicional
+static void op_DESVZ(cpu_t *self, int A1) // desvio condicional
 {
   if (self->A == 0) {
-    op_DESV(self);
+    op_DESV(self, A1);
   } else {
     self->PC += 2;
   }
 }
 
-static void op_DESVNZ(cpu_t *self) // desvio condicional
+static void op_DESVNZ(cpu_t *self, int A1) // desvio condicional
 {
   if (self->A != 0) {
-    op_DESV(self);
+    op_DESV(self, A1);
   } else {
     self->PC += 2;
   }
 }
 
-static void op_DESVN(cpu_t *self) // desvio condicional
+static void op_DESVN(cpu_t *self, int A1) // desvio condicional
 {
   if (self->A < 0) {
-    op_DESV(self);
+    op_DESV(self, A1);
   } else {
     self->PC += 2;
   }
 }
 
-static void op_DESVP(cpu_t *self) // desvio condicional
+static void op_DESVP(cpu_t *self, int A1) // desvio condicional
 {
   if (self->A > 0) {
-    op_DESV(self);
+    op_DESV(self, A1);
   } else {
     self->PC += 2;
   }
 }
 
-static void op_CHAMA(cpu_t *self) // chamada de subrotina
+static void op_CHAMA(cpu_t *self, int A1) // chamada de subrotina
 {
-  int A1;
-  if (pega_A1(self, &A1) && poe_mem(self, A1, self->PC + 2)) {
+  if (poe_mem(self, A1, self->PC + 2)) {
     self->PC = A1 + 1;
   }
 }
 
-static void op_RET(cpu_t *self) // retorno de subrotina
+static void op_RET(cpu_t *self, int A1) // retorno de subrotina
 {
-  int A1, mA1;
-  if (pega_A1(self, &A1) && pega_mem(self, A1, &mA1)) {
+  int mA1;
+  if (pega_mem(self, A1, &mA1)) {
     self->PC = mA1;
   }
 }
 
-static void op_LE(cpu_t *self) // leitura de E/S
+static void op_LE(cpu_t *self, int A1) // leitura de E/S
 {
-  int A1, dado;
-  if (pega_A1(self, &A1) && pega_es(self, A1, &dado)) {
+  int dado;
+  if (pega_es(self, A1, &dado)) {
     self->A = dado;
     self->PC += 2;
   }
 }
 
-static void op_ESCR(cpu_t *self) // escrita de E/S
+static void op_ESCR(cpu_t *self, int A1) // escrita de E/S
 {
-  int A1;
-  if (pega_A1(self, &A1) && poe_es(self, A1, self->A)) {
+  if (poe_es(self, A1, self->A)) {
     self->PC += 2;
   }
 }
@@ -421,12 +570,12 @@ static void op_ESCR(cpu_t *self) // escrita de E/S
 // RETI precisa de cpu_desinterrompe, que tá lá embaixo
 static void cpu_desinterrompe(cpu_t *self);
 
-static void op_RETI(cpu_t *self) // retorno de interrupção
+static void op_RETI(cpu_t *self, int A1) // retorno de interrupção
 {
   cpu_desinterrompe(self);
 }
 
-static void op_CHAMAC(cpu_t *self) // chama função em C
+static void op_CHAMAC(cpu_t *self, int A1) // chama função em C
 {
   if (self->func_chamaC == NULL) {
     self->erro = ERR_OP_INV;
@@ -438,7 +587,7 @@ static void op_CHAMAC(cpu_t *self) // chama função em C
   self->PC += 1;
 }
 
-static void op_CHAMAS(cpu_t *self) // chamada de sistema
+static void op_CHAMAS(cpu_t *self, int A1) // chamada de sistema
 {
   self->PC += 1;
   // causa uma interrupção, para forçar a execução do SO
@@ -447,72 +596,597 @@ static void op_CHAMAS(cpu_t *self) // chamada de sistema
 }
 
 
+// a função que implementa cada instrução, indexada pelo opcode
+// os opcodes sem função (as pseudo-instruções) são inválidos
+static op_t ops[N_OPCODE] = {
+  [NOP]    = op_NOP,
+  [PARA]   = op_PARA,
+  [CARGI]  = op_CARGI,
+  [CARGM]  = op_CARGM,
+  [CARGX]  = op_CARGX,
+  [ARMM]   = op_ARMM,
+  [ARMX]   = op_ARMX,
+  [TRAX]   = op_TRAX,
+  [CPXA]   = op_CPXA,
+  [INCX]   = op_INCX,
+  [SOMA]   = op_SOMA,
+  [SUB]    = op_SUB,
+  [MULT]   = op_MULT,
+  [DIV]    = op_DIV,
+  [RESTO]  = op_RESTO,
+  [NEG]    = op_NEG,
+  [DESV]   = op_DESV,
+  [DESVZ]  = op_DESVZ,
+  [DESVNZ] = op_DESVNZ,
+  [DESVN]  = op_DESVN,
+  [DESVP]  = op_DESVP,
+  [CHAMA]  = op_CHAMA,
+  [RET]    = op_RET,
+  [LE]     = op_LE,
+  [ESCR]   = op_ESCR,
+  [RETI]   = op_RETI,
+  [CHAMAC] = op_CHAMAC,
+  [CHAMAS] = op_CHAMAS,
+};
+
+
 // ---------------------------------------------------------------------
-// EXECUÇÃO DE UMA INSTRUÇÃO {{{1
+// SUPERINSTRUÇÕES {{{1
 // ---------------------------------------------------------------------
 
-static void executa_a_instrucao(cpu_t *self, int opcode)
+// o código gerado pelo montador tem algumas sequências de instruções que se
+//   repetem muito (chamadas de sistema, contadores em memória, o salvamento
+//   de X no tratador de interrupção)
+// quando uma instrução que inicia uma dessas sequências é colocada na cache,
+//   a sequência toda é decodificada junto, e é executada por uma função só,
+//   com uma só busca na cache e um só despacho
+// o grupo tem que estar todo no mesmo quadro (como as instruções com argumento
+//   na cache), e a execução tem que ter o mesmo efeito que a das instruções
+//   separadas: se uma delas der erro, as seguintes não são executadas
+
+// cargi x; trax; cargi y; chamas -- chamada de sistema y com argumento x
+static int fusao_CARGI_TRAX_CARGI_CHAMAS(cpu_t *self, instr_decod_t *instr)
+{
+  op_CARGI(self, instr->args[0]);
+  op_TRAX(self, 0);
+  op_CARGI(self, instr->args[1]);
+  op_CHAMAS(self, 0);
+  return 4;
+}
+
+// cargm a; soma b; armm c
+static int fusao_CARGM_SOMA_ARMM(cpu_t *self, instr_decod_t *instr)
+{
+  op_CARGM(self, instr->args[0]);
+  if (self->erro != ERR_OK) return 1;
+  op_SOMA(self, instr->args[1]);
+  if (self->erro != ERR_OK) return 2;
+  op_ARMM(self, instr->args[2]);
+  return 3;
+}
+
+static instr_decod_t *entrada_da_cache(cpu_t *self, int endfis);
+
+// trax; armm a; trax -- salva X na memória
+static int fusao_TRAX_ARMM_TRAX(cpu_t *self, instr_decod_t *instr)
+{
+  int end = instr->end;
+  op_TRAX(self, 0);
+  op_ARMM(self, instr->args[0]);
+  if (self->erro != ERR_OK) return 2;
+  // se a escrita alterou o próprio grupo, o último trax pode não existir mais
+  if (entrada_da_cache(self, end)->end != end) return 2;
+  op_TRAX(self, 0);
+  return 3;
+}
+
+// as sequências conhecidas
+static struct {
+  int n;
+  int opcodes[FUSAO_MAX_INSTR];
+  fusao_t fusao;
+} padroes[] = {
+  { 4, { CARGI, TRAX, CARGI, CHAMAS }, fusao_CARGI_TRAX_CARGI_CHAMAS },
+  { 3, { CARGM, SOMA, ARMM },          fusao_CARGM_SOMA_ARMM },
+  { 3, { TRAX, ARMM, TRAX },           fusao_TRAX_ARMM_TRAX },
+};
+#define N_PADROES (sizeof(padroes) / sizeof(padroes[0]))
+
+// verifica se a sequência que inicia no endereço físico 'endfis' é a do
+//   padrão p; se for, preenche a superinstrução em 'instr'
+static bool reconhece_padrao(cpu_t *self, int p, int endfis, instr_decod_t *instr)
+{
+  int fim_quadro = (endfis / TAM_PAGINA + 1) * TAM_PAGINA;
+  int end = endfis;
+  int n_args = 0;
+  for (int i = 0; i < padroes[p].n; i++) {
+    int opcode = padroes[p].opcodes[i];
+    int tam = 1 + instrucao_num_args(opcode);
+    if (end + tam > fim_quadro) return false;
+    int mem_opcode;
+    if (mmu_le(self->mmu, end, &mem_opcode, supervisor) != ERR_OK) return false;
+    if (mem_opcode != opcode) return false;
+    if (tam > 1) {
+      if (mmu_le(self->mmu, end + 1, &instr->args[n_args], supervisor) != ERR_OK) {
+        return false;
+      }
+      n_args++;
+    }
+    end += tam;
+  }
+  instr->fusao = padroes[p].fusao;
+  instr->n_fusao = padroes[p].n;
+  instr->tam = end - endfis;
+  return true;
+}
+
+// procura uma superinstrução que inicia com a instrução em 'instr', que está
+//   no endereço físico 'endfis'
+static void procura_fusao(cpu_t *self, int endfis, instr_decod_t *instr)
+{
+  for (int p = 0; p < N_PADROES; p++) {
+    if (padroes[p].opcodes[0] != instr->opcode) continue;
+    if (reconhece_padrao(self, p, endfis, instr)) return;
+  }
+}
+
+// true se a instrução deve ser executada como superinstrução, sendo que
+//   ainda podem ser executadas 'resto' instruções na rajada
+static bool usa_fusao(cpu_t *self, instr_decod_t *instr, int resto)
+{
+  return instr->fusao != NULL && self->fusao && instr->n_fusao <= resto;
+}
+
+
+// ---------------------------------------------------------------------
+// CACHE DE INSTRUÇÕES DECODIFICADAS {{{1
+// ---------------------------------------------------------------------
+
+// a cache guarda, para cada endereço físico onde foi executada uma instrução,
+//   o opcode, o argumento e a função que executa a instrução
+// com isso, uma instrução que está na cache é executada com uma só tradução
+//   de endereço (a do PC), sem ler a memória
+// a memória avisa a CPU a cada escrita (cpu_aviso_escrita), e as instruções
+//   alteradas são retiradas da cache
+// uma entrada pode conter uma superinstrução, que ocupa mais palavras
+
+static instr_decod_t *entrada_da_cache(cpu_t *self, int endfis)
+{
+  return &self->cache[endfis & (N_INSTR_DECOD - 1)];
+}
+
+// retorna a entrada da cache que ocupa o endereço 'endereco', ou NULL
+static instr_decod_t *entrada_que_ocupa(cpu_t *self, int endereco)
+{
+  for (int end = endereco - FUSAO_MAX_TAM + 1; end <= endereco; end++) {
+    instr_decod_t *entrada = entrada_da_cache(self, end);
+    if (entrada->end == end && endereco < end + entrada->tam) return entrada;
+  }
+  return NULL;
+}
+
+// chamada pela memória após cada escrita
+// invalida as entradas que ocupam o endereço alterado
+// se a escrita foi feita por outra CPU (ou pelo SO executando nela), esta
+//   pode estar executando, e a cache e os blocos traduzidos dela não podem
+//   ser consultados daqui: só marca para esvaziar as cópias no início da
+//   próxima rajada; até lá esta CPU não executa o endereço alterado, porque o
+//   SO não altera a memória de um processo que está em outra CPU
+static void cpu_aviso_escrita(void *arg, int endereco)
+{
+  cpu_t *self = arg;
+  if (self != cpu_da_thread) {
+    if (!atomic_load_explicit(&self->esvaziar, memory_order_relaxed)) {
+      atomic_store(&self->esvaziar, true);
+    }
+    return;
+  }
+  instr_decod_t *entrada;
+  while ((entrada = entrada_que_ocupa(self, endereco)) != NULL) {
+    entrada->end = -1;
+  }
+  if (self->jit != NULL) jit_aviso_escrita(self->jit, endereco);
+}
+
+// prepara a CPU para uma rajada de execução na thread corrente
+static void inicia_rajada(cpu_t *self)
+{
+  cpu_da_thread = self;
+  if (atomic_load_explicit(&self->esvaziar, memory_order_relaxed)) {
+    atomic_store(&self->esvaziar, false);
+    for (int i = 0; i < N_INSTR_DECOD; i++) {
+      self->cache[i].end = -1;
+    }
+    if (self->jit != NULL) jit_esvazia(self->jit);
+  }
+  descarta_janela(self);
+}
+
+// true se o opcode é de um desvio condicional que não vai ser tomado
+static bool desvio_nao_tomado(cpu_t *self, int opcode)
 {
   switch (opcode) {
-    case NOP:    op_NOP(self);    break;
-    case PARA:   op_PARA(self);   break;
-    case CARGI:  op_CARGI(self);  break;
-    case CARGM:  op_CARGM(self);  break;
-    case CARGX:  op_CARGX(self);  break;
-    case ARMM:   op_ARMM(self);   break;
-    case ARMX:   op_ARMX(self);   break;
-    case TRAX:   op_TRAX(self);   break;
-    case CPXA:   op_CPXA(self);   break;
-    case INCX:   op_INCX(self);   break;
-    case SOMA:   op_SOMA(self);   break;
-    case SUB:    op_SUB(self);    break;
-    case MULT:   op_MULT(self);   break;
-    case DIV:    op_DIV(self);    break;
-    case RESTO:  op_RESTO(self);  break;
-    case NEG:    op_NEG(self);    break;
-    case DESV:   op_DESV(self);   break;
-    case DESVZ:  op_DESVZ(self);  break;
-    case DESVNZ: op_DESVNZ(self); break;
-    case DESVN:  op_DESVN(self);  break;
-    case DESVP:  op_DESVP(self);  break;
-    case CHAMA:  op_CHAMA(self);  break;
-    case RET:    op_RET(self);    break;
-    case LE:     op_LE(self);     break;
-    case ESCR:   op_ESCR(self);   break;
-    case RETI:   op_RETI(self);   break;
-    case CHAMAC: op_CHAMAC(self); break;
-    case CHAMAS: op_CHAMAS(self); break;
-    default:     self->erro = ERR_INSTR_INV;
+    case DESVZ:  return self->A != 0;
+    case DESVNZ: return self->A == 0;
+    case DESVN:  return self->A >= 0;
+    case DESVP:  return self->A <= 0;
+    default:     return false;
   }
 }
 
-void cpu_executa_1(cpu_t *self)
+// pega a instrução apontada pelo PC, da cache ou, se não estiver lá, lendo
+//   da memória (e inserindo na cache)
+// retorna a entrada da cache com a instrução, ou 'aux' preenchida com ela se
+//   não for para a cache; retorna NULL se ela não pode ser executada, e põe em
+//   erro o motivo
+static instr_decod_t *pega_instrucao(cpu_t *self, instr_decod_t *aux)
 {
-  // não executa se CPU já estiver em erro
-  if (self->erro != ERR_OK) return;
+  // traduz o PC uma vez, para procurar na cache
+  // se a tradução falhar, a leitura abaixo vai gerar o erro correspondente
+  instr_decod_t *entrada = NULL;
+  int endfis = -1;
+  if (traduz_busca(self, self->PC, &endfis)) {
+    entrada = entrada_da_cache(self, endfis);
+    if (entrada->end == endfis) {
+      return pode_executar(self, entrada->opcode) ? entrada : NULL;
+    }
+  }
 
-  int opcode;
-  if (pega_opcode(self, &opcode)) {
-    // console_printf("Executando opcode %02d (%s)", opcode, instrucao_nome(opcode));
-    executa_a_instrucao(self, opcode);
+  // não está na cache, lê da memória
+  instr_decod_t *instr = aux;
+  if (!pega_opcode(self, &instr->opcode)) return NULL;
+  instr->op = ops[instr->opcode];
+  if (instr->op == NULL) {
+    self->erro = ERR_INSTR_INV;
+    return NULL;
   }
+  instr->A1 = 0;
+  instr->fusao = NULL;
+  if (instrucao_num_args(instr->opcode) > 0) {
+    // um desvio condicional que não vai desviar não lê o argumento (que pode
+    //   estar em uma página ausente); como a condição muda, não vai pra cache
+    if (desvio_nao_tomado(self, instr->opcode)) return instr;
+    if (!pega_A1(self, &instr->A1)) return NULL;
+    // só coloca na cache se o argumento estiver no mesmo quadro que o opcode
+    //   (se cruza uma página, o argumento pode mudar de lugar ou sumir sem
+    //   que haja escrita no endereço)
+    if (endfis % TAM_PAGINA == TAM_PAGINA - 1) return instr;
+  }
+  if (entrada == NULL) return instr;
+  instr->end = endfis;
+  instr->tam = 1 + instrucao_num_args(instr->opcode);
+  if (self->fusao) procura_fusao(self, endfis, instr);
+  *entrada = *instr;
+  return entrada;
+}
+
+// ---------------------------------------------------------------------
+// EXECUÇÃO DE INSTRUÇÕES {{{1
+// ---------------------------------------------------------------------
 
-  // se a CPU entrou em erro, causa uma interrupção
-  // a menos que a CPU tenha parado, porque a única forma de a CPU entrar nesse
-  //   estado é pela execução da instrução PARA em modo supervisor, e é a forma de
-  //   o SO dizer que não tem mais nada para fazer, e deve-se deixar a CPU dormindo
-  //   até que venha uma interrupção de E/S
+// se a CPU entrou em erro, causa uma interrupção
+// a menos que a CPU tenha parado, porque a única forma de a CPU entrar nesse
+//   estado é pela execução da instrução PARA em modo supervisor, e é a forma de
+//   o SO dizer que não tem mais nada para fazer, e deve-se deixar a CPU dormindo
+//   até que venha uma interrupção de E/S
+static void verifica_erro(cpu_t *self)
+{
   if (self->erro != ERR_OK && self->erro != ERR_CPU_PARADA) {
     // se a interrupção não é aceita nesse ponto, temos um problema grave...
     assert(cpu_interrompe(self, IRQ_ERR_CPU));
   }
 }
 
+// true se a instrução acessa dispositivos (diretamente ou pelo SO), e por
+//   isso precisa que o tempo dos dispositivos esteja em dia quando for executada
+static bool acessa_dispositivo(int opcode)
+{
+  return opcode == LE || opcode == ESCR || opcode == CHAMAC;
+}
+
+#ifdef CPU_JIT
+// ---------------------------------------------------------------------
+// TRADUÇÃO PARA CÓDIGO NATIVO {{{1
+// ---------------------------------------------------------------------
+
+// um bloco é uma sequência de instruções dentro de um quadro, que termina em
+//   um desvio, chamada, retorno, chamada de sistema ou PARA; as instruções
+//   que acessam dispositivos não entram em blocos
+// o bloco é identificado pelo endereço físico e modo da CPU: como está todo
+//   em um quadro, basta a tradução do PC no início para valer para ele todo
+// as instruções simples que só mexem em registradores são geradas
+//   diretamente, as outras chamam a função que as implementa; depois de cada
+//   uma dessas, se a CPU estiver em erro o bloco termina
+
+#define CAMPO(reg) offsetof(cpu_t, reg)
+
+// true se a instrução termina um bloco
+static bool termina_bloco(int opcode)
+{
+  switch (opcode) {
+    case DESV: case DESVZ: case DESVNZ: case DESVN: case DESVP:
+    case CHAMA: case RET: case CHAMAS: case RETI: case PARA:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// gera o código para a instrução, que é a n-ésima do bloco (a partir de 1)
+static void traduz_instrucao(cpu_t *self, int opcode, int A1, int n)
+{
+  jit_t *jit = self->jit;
+  switch (opcode) {
+    case NOP:
+      jit_emite_soma(jit, CAMPO(PC), 1);
+      break;
+    case CARGI:
+      jit_emite_atribui(jit, CAMPO(A), A1);
+      jit_emite_soma(jit, CAMPO(PC), 2);
+      break;
+    case TRAX:
+      jit_emite_troca(jit, CAMPO(A), CAMPO(X));
+      jit_emite_soma(jit, CAMPO(PC), 1);
+      break;
+    case CPXA:
+      jit_emite_copia(jit, CAMPO(A), CAMPO(X));
+      jit_emite_soma(jit, CAMPO(PC), 1);
+      break;
+    case INCX:
+      jit_emite_soma(jit, CAMPO(X), 1);
+      jit_emite_soma(jit, CAMPO(PC), 1);
+      break;
+    case NEG:
+      jit_emite_nega(jit, CAMPO(A));
+      jit_emite_soma(jit, CAMPO(PC), 1);
+      break;
+    default:
+      jit_emite_chamada(jit, (jit_funcao_t)ops[opcode], A1);
+      jit_emite_sai_se_nao_zero(jit, CAMPO(erro), n);
+      // instruções que escrevem na memória podem ter alterado código
+      if (opcode == ARMM || opcode == ARMX || opcode == CHAMA) {
+        jit_emite_sai_se_esvaziado(jit, n);
+      }
+  }
+}
+
+// traduz o bloco que inicia no endereço físico 'endfis'
+static void traduz_bloco(cpu_t *self, int endfis)
+{
+  int fim_quadro = (endfis / TAM_PAGINA + 1) * TAM_PAGINA;
+  int end = endfis;
+  int n = 0;
+  jit_inicia_bloco(self->jit, endfis, self->modo);
+  while (end < fim_quadro) {
+    // lê a instrução diretamente do endereço físico
+    int opcode, A1 = 0;
+    if (mmu_le(self->mmu, end, &opcode, supervisor) != ERR_OK) break;
+    if (opcode < 0 || opcode >= N_OPCODE || ops[opcode] == NULL) break;
+    if (self->modo == usuario && self->privilegiadas[opcode]) break;
+    if (acessa_dispositivo(opcode)) break;
+    int tam = 1 + instrucao_num_args(opcode);
+    if (end + tam > fim_quadro) break;
+    if (tam > 1 && mmu_le(self->mmu, end + 1, &A1, supervisor) != ERR_OK) break;
+    n++;
+    traduz_instrucao(self, opcode, A1, n);
+    end += tam;
+    if (termina_bloco(opcode)) break;
+  }
+  if (n == 0 || !jit_termina_bloco(self->jit, end, n)) {
+    jit_abandona_bloco(self->jit);
+  }
+}
+
+// executa o bloco traduzido que começa no PC, se houver e não tiver mais de
+//   'max' instruções
+// retorna o número de instruções executadas (0 se não executou)
+static int executa_bloco(cpu_t *self, int max)
+{
+  int endfis;
+  if (!traduz_busca(self, self->PC, &endfis)) return 0;
+  int n;
+  bool quente;
+  jit_bloco_t bloco = jit_bloco(self->jit, endfis, self->modo, &n, &quente);
+  if (bloco == NULL) {
+    if (quente) traduz_bloco(self, endfis);
+    return 0;
+  }
+  if (n > max) return 0;
+  return jit_executa(self->jit, bloco, self);
+}
+#endif // CPU_JIT
+
+
+// ---------------------------------------------------------------------
+// DESPACHO {{{1
+// ---------------------------------------------------------------------
+
+void cpu_executa_1(cpu_t *self)
+{
+  cpu_executa_n(self, 1);
+}
+
+#if defined(CPU_DESPACHO_THREADED) && !defined(CPU_JIT)
+// despacho "threaded", com goto computado (extensão do gcc)
+// em vez de voltar a um ponto único de despacho, cada instrução termina com
+//   o código que busca a próxima e desvia direto para a sua implementação;
+//   cada um desses desvios é previsto separadamente pelo processador
+//   hospedeiro, que acerta mais (a instrução seguinte a um CARGM, por exemplo,
+//   costuma ser sempre a mesma)
+// o comportamento é o mesmo da versão portável, abaixo
+// (com CPU_JIT, é usada a versão portável, que é onde os blocos traduzidos
+//   são executados)
+int cpu_executa_n(cpu_t *self, int n)
+{
+  static void *rotulo[N_OPCODE] = {
+    [NOP]    = &&l_NOP,
+    [PARA]   = &&l_PARA,
+    [CARGI]  = &&l_CARGI,
+    [CARGM]  = &&l_CARGM,
+    [CARGX]  = &&l_CARGX,
+    [ARMM]   = &&l_ARMM,
+    [ARMX]   = &&l_ARMX,
+    [TRAX]   = &&l_TRAX,
+    [CPXA]   = &&l_CPXA,
+    [INCX]   = &&l_INCX,
+    [SOMA]   = &&l_SOMA,
+    [SUB]    = &&l_SUB,
+    [MULT]   = &&l_MULT,
+    [DIV]    = &&l_DIV,
+    [RESTO]  = &&l_RESTO,
+    [NEG]    = &&l_NEG,
+    [DESV]   = &&l_DESV,
+    [DESVZ]  = &&l_DESVZ,
+    [DESVNZ] = &&l_DESVNZ,
+    [DESVN]  = &&l_DESVN,
+    [DESVP]  = &&l_DESVP,
+    [CHAMA]  = &&l_CHAMA,
+    [RET]    = &&l_RET,
+    [LE]     = &&l_LE,
+    [ESCR]   = &&l_ESCR,
+    [RETI]   = &&l_RETI,
+    [CHAMAC] = &&l_CHAMAC,
+    [CHAMAS] = &&l_CHAMAS,
+  };
+  cpu_modo_t modo = self->modo;
+  instr_decod_t aux, *instr;
+  int i = 0;
+
+// desvia para a implementação da instrução em 'instr' (ou da superinstrução)
+#define DESPACHA()                                                \
+    self->n_despachos++;                                          \
+    if (usa_fusao(self, instr, n - i)) goto l_fusao;              \
+    goto *rotulo[instr->opcode]
+
+// verifica se a rajada termina e despacha a próxima instrução
+#define PROXIMA()                                                 \
+    verifica_erro(self);                                          \
+    if (self->modo != modo || self->erro != ERR_OK) return i;     \
+    if (i >= n) return n;                                         \
+    instr = pega_instrucao(self, &aux);                           \
+    if (instr == NULL) goto erro_na_busca;                        \
+    if (acessa_dispositivo(instr->opcode)) return i;              \
+    DESPACHA()
+
+// executa a instrução em 'instr' e despacha a próxima
+#define EXECUTA(nome)                                             \
+  l_##nome:                                                       \
+    op_##nome(self, instr->A1);                                   \
+    i++;                                                          \
+    PROXIMA()
+
+  // não executa se CPU já estiver em erro (normalmente, parada)
+  if (n <= 0 || self->erro != ERR_OK) return n;
+  inicia_rajada(self);
+  instr = pega_instrucao(self, &aux);
+  if (instr == NULL) goto erro_na_busca;
+  DESPACHA();
+
+l_fusao:
+  {
+    int executadas = instr->fusao(self, instr);
+    self->n_fundidas += executadas;
+    i += executadas;
+  }
+  PROXIMA();
+
+  EXECUTA(NOP);
+  EXECUTA(PARA);
+  EXECUTA(CARGI);
+  EXECUTA(CARGM);
+  EXECUTA(CARGX);
+  EXECUTA(ARMM);
+  EXECUTA(ARMX);
+  EXECUTA(TRAX);
+  EXECUTA(CPXA);
+  EXECUTA(INCX);
+  EXECUTA(SOMA);
+  EXECUTA(SUB);
+  EXECUTA(MULT);
+  EXECUTA(DIV);
+  EXECUTA(RESTO);
+  EXECUTA(NEG);
+  EXECUTA(DESV);
+  EXECUTA(DESVZ);
+  EXECUTA(DESVNZ);
+  EXECUTA(DESVN);
+  EXECUTA(DESVP);
+  EXECUTA(CHAMA);
+  EXECUTA(RET);
+  EXECUTA(LE);
+  EXECUTA(ESCR);
+  EXECUTA(RETI);
+  EXECUTA(CHAMAC);
+  EXECUTA(CHAMAS);
+
+erro_na_busca:
+  verifica_erro(self);
+  return i + 1;
+#undef DESPACHA
+#undef PROXIMA
+#undef EXECUTA
+}
+#else // CPU_DESPACHO_THREADED
+// despacho portável, pela tabela de funções
+int cpu_executa_n(cpu_t *self, int n)
+{
+  cpu_modo_t modo = self->modo;
+  int i = 0;
+  inicia_rajada(self);
+  while (i < n) {
+    // não executa se CPU já estiver em erro (normalmente, parada)
+    // ela só sai desse estado com uma interrupção, que só pode vir depois
+    //   da rajada; o resto do tempo passa com ela dormindo
+    if (self->erro != ERR_OK) return n;
+
+    int executadas = 0;
+#ifdef CPU_JIT
+    // blocos traduzidos não contêm instruções que acessam dispositivos
+    if (self->jit != NULL) {
+      executadas = executa_bloco(self, n - i);
+      if (executadas > 0) self->n_despachos++;
+    }
+#endif
+    if (executadas == 0) {
+      instr_decod_t aux;
+      instr_decod_t *instr = pega_instrucao(self, &aux);
+      if (instr != NULL) {
+        // os dispositivos só são atualizados no final da rajada; uma instrução
+        //   que os acessa fica para o início da próxima
+        if (i > 0 && acessa_dispositivo(instr->opcode)) return i;
+        // console_printf("Executando opcode %02d (%s)", instr->opcode, instrucao_nome(instr->opcode));
+        self->n_despachos++;
+        if (usa_fusao(self, instr, n - i)) {
+          executadas = instr->fusao(self, instr);
+          self->n_fundidas += executadas;
+        } else {
+          instr->op(self, instr->A1);
+        }
+      }
+      if (executadas == 0) executadas = 1;
+    }
+    i += executadas;
+    verifica_erro(self);
+
+    // termina a rajada se mudou de modo (interrupção ou retorno de interrupção)
+    //   ou se a CPU parou, para que o controlador possa verificar as
+    //   interrupções pendentes
+    if (self->modo != modo || self->erro != ERR_OK) return i;
+  }
+  return n;
+}
+#endif // CPU_DESPACHO_THREADED
+
 
 // ---------------------------------------------------------------------
 // INTERRUPÇÃO {{{1
 // ---------------------------------------------------------------------
 
+bool cpu_parada(cpu_t *self)
+{
+  return self->erro == ERR_CPU_PARADA;
+}
+
 bool cpu_interrompe(cpu_t *self, irq_t irq)
 {
   // só aceita interrupção em modo usuário ou quando a CPU está dormindo
@@ -530,6 +1204,7 @@ bool cpu_interrompe(cpu_t *self, irq_t irq)
   //   e salvar o estado do processador em endereços físicos e não lógicos
   // além disso, o tratador de interrupção deve ser executado nesse modo
   self->modo = supervisor;
+  descarta_janela(self);
 
   // salva todo o estado interno da CPU
   //   atenção, nem todos os registradores são salvos pelo hardware
@@ -573,6 +1248,44 @@ static void cpu_desinterrompe(cpu_t *self)
   self->complemento = complemento;
   // coloca a CPU em modo usuário
   self->modo        = usuario;
+  descarta_janela(self);
+}
+
+
+// ---------------------------------------------------------------------
+// IMAGEM {{{1
+// ---------------------------------------------------------------------
+
+bool cpu_salva(cpu_t *self, FILE *arq)
+{
+  return imagem_escreve_int(arq, self->PC)
+      && imagem_escreve_int(arq, self->A)
+      && imagem_escreve_int(arq, self->X)
+      && imagem_escreve_int(arq, self->erro)
+      && imagem_escreve_int(arq, self->complemento)
+      && imagem_escreve_int(arq, self->modo);
+}
+
+bool cpu_recupera(cpu_t *self, FILE *arq)
+{
+  int PC, A, X, erro, complemento, modo;
+  if (!imagem_le_int(arq, &PC)
+      || !imagem_le_int(arq, &A)
+      || !imagem_le_int(arq, &X)
+      || !imagem_le_int(arq, &erro)
+      || !imagem_le_int(arq, &complemento)
+      || !imagem_le_int(arq, &modo)) {
+    return false;
+  }
+  self->PC          = PC;
+  self->A           = A;
+  self->X           = X;
+  self->erro        = erro;
+  self->complemento = complemento;
+  self->modo        = modo;
+  atomic_store(&self->esvaziar, true);
+  descarta_janela(self);
+  return true;
 }
 
 // vim: foldmethod=marker
@@ -14,6 +14,9 @@ typedef enum { supervisor, usuario } cpu_modo_t;
 // endereços na memória onde a CPU salva os valores dos registradores
 //   quando aceita uma interrupção, e de onde recupera esses valores
 //   quando retorna de uma interrupção
+// com várias CPUs, cada uma tem sua MMU, que desvia esses endereços (até
+//   antes de CPU_END_TRATADOR) para a área local da CPU (ver
+//   mmu_define_area_local)
 #define CPU_END_PC          50
 #define CPU_END_A           51
 #define CPU_END_erro        52
@@ -30,9 +33,15 @@ typedef enum { supervisor, usuario } cpu_modo_t;
 // endereço limite da memória protegida (não acessável em modo usuário)
 #define CPU_END_FIM_PROT    99
 
+// número máximo de CPUs compartilhando a memória
+// cada CPU é executada por uma thread diferente; as funções de uma CPU só
+//   devem ser chamadas pela thread que a executa
+#define CPU_MAX              4
+
 #include "es.h"
 #include "irq.h"
 #include "mmu.h"
+#include <stdio.h>
 
 // tipo da função a ser chamada quando executar a instrução CHAMAC
 typedef int (*func_chamaC_t)(void *argC, int reg_A);
@@ -51,6 +60,20 @@ void cpu_destroi(cpu_t *self);
 //     e causa uma interrupção
 void cpu_executa_1(cpu_t *self);
 
+// executa uma rajada de até n instruções, como n chamadas a cpu_executa_1
+// a rajada termina antes se a CPU parar ou mudar de modo (por causa de uma
+//   interrupção ou de um retorno de interrupção), e antes de uma
+//   instrução que acessa dispositivos (LE, ESCR, CHAMAC), a menos que seja a
+//   primeira da rajada (quem chama deve atualizar os dispositivos entre as
+//   rajadas, para que essas instruções os vejam no tempo certo)
+// retorna o número de unidades de tempo consumidas; se a CPU estiver parada,
+//   as n unidades são consumidas (a CPU dorme até o final da rajada)
+int cpu_executa_n(cpu_t *self, int n);
+
+// retorna true se a CPU está parada (executou PARA em modo supervisor), e
+//   só vai voltar a executar instruções depois de uma interrupção
+bool cpu_parada(cpu_t *self);
+
 // implementa uma interrupção
 // passa para modo supervisor, salva o estado da CPU no início da memória,
 //   altera A para identificar a requisição de interrupção, altera PC para
@@ -62,7 +85,26 @@ bool cpu_interrompe(cpu_t *self, irq_t irq);
 // e o argumento a passar para ela (normalmente, um ponteiro para o SO)
 void cpu_define_chamaC(cpu_t *self, func_chamaC_t func, void *argC);
 
+// liga ou desliga o uso de superinstruções (sequências frequentes de
+//   instruções executadas juntas, com um só despacho); começa desligado,
+//   porque nas medidas de make bench_cpu ficou mais lento com elas
+// o resultado da execução é o mesmo, só muda a velocidade
+void cpu_define_fusao(cpu_t *self, bool fusao);
+
+// coloca em *pdespachos o número de despachos feitos desde a criação da CPU
+//   (cada instrução, superinstrução ou bloco traduzido executado conta um) e em
+//   *pfundidas o número de instruções executadas dentro de superinstruções
+void cpu_estatisticas(cpu_t *self, long *pdespachos, long *pfundidas);
+
 // concatena a descrição do estado da CPU no final de str
 void cpu_concatena_descricao(cpu_t *self, char *str);
 
+// salva os registradores da CPU na imagem 'arq' (ver imagem.h)
+bool cpu_salva(cpu_t *self, FILE *arq);
+
+// recupera os registradores da CPU da imagem 'arq'
+// as instruções decodificadas e os blocos traduzidos são descartados no
+//   início da próxima rajada (a memória foi recuperada sem avisar a CPU)
+bool cpu_recupera(cpu_t *self, FILE *arq);
+
 #endif // CPU_H
@@ -0,0 +1,434 @@
+// desempenho.c
+// executa cargas de referência e mede o desempenho do simulador
+// simulador de computador
+// so25b
+
+// cada carga é uma simulação em lote, sem tela e sem log, com um programa
+//   fixo como init (e alguns parâmetros); as cargas são curtas (de décimos
+//   de ms a poucos ms), então cada medida repete a simulação até passar de
+//   TEMPO_MINIMO, e vale o tempo médio de uma simulação
+// cada carga é medida várias vezes, cada vez em um processo filho (para
+//   medir a memória usada por ela), e vale a medida mais rápida; a diferença
+//   entre a mais lenta e a mais rápida é a dispersão da carga
+// o resultado vai para um arquivo JSON; com -c, é comparado com o de uma
+//   execução anterior, e o programa termina com erro se alguma carga ficou
+//   mais lenta por instrução executada do que o limite, que é aumentado
+//   para a soma das dispersões da base e da atual, se for maior (a variação
+//   dentro da dispersão é ruído, não regressão)
+// o tempo em que as CPUs ficam paradas passa de uma vez, sem custo, e não
+//   conta como instrução
+// para medir, use o executor compilado com otimização (make bench)
+//
+// exemplo:
+//   ./desempenho -o base.json
+//   (altera o simulador)
+//   ./desempenho -o novo.json -c base.json
+
+#include "simulador.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+// versão do formato do arquivo de resultado
+// 2: 'instrucoes' não inclui mais o tempo parado, que vai em 'tempo_simulado'
+// 3: 'tempo_s' é o de uma simulação, a média de 'simulacoes_por_medida';
+//    'dispersao_pct' é novo; 'rss_kb' virou 'rss_acrescimo_kb'
+#define FORMATO 3
+
+// tempo mínimo de cada medida, em segundos
+#define TEMPO_MINIMO 0.1
+
+// as cargas de referência
+typedef struct {
+  char *nome;
+  char *init;
+  // parâmetros da simulação, no formato de simulador_config_define (ou NULL)
+  char *param;
+  char *valor;
+} carga_t;
+
+static carga_t cargas[] = {
+  // bastante CPU, pouca E/S
+  { "cpu",        "p1.maq",         NULL,      NULL   },
+  // bastante E/S nos terminais, um caractere por vez
+  { "es",         "carga_es.maq",   NULL,      NULL   },
+  // a mesma, com fila de saída nos terminais e escrita em bloco no SO
+  { "es_fila",    "carga_es.maq",   "fila",    "16"   },
+  // vetor maior que a memória: faltas de página e swap
+  { "memoria",    "carga_mem.maq",  "memoria", "1000" },
+  // criação e morte de processos
+  { "processos",  "carga_proc.maq", NULL,      NULL   },
+};
+#define N_CARGAS (sizeof(cargas) / sizeof(cargas[0]))
+
+// nome de cada tipo de interrupção no resultado
+static char *nomes_irq[N_IRQ + 1] = {
+  [IRQ_RESET]   = "reset",
+  [IRQ_ERR_CPU] = "erro_cpu",
+  [IRQ_SISTEMA] = "sistema",
+  [IRQ_RELOGIO] = "relogio",
+  [IRQ_TECLADO] = "teclado",
+  [IRQ_TELA]    = "tela",
+  [IRQ_DISCO]   = "disco",
+  [N_IRQ]       = "desconhecidas",
+};
+
+// o resultado de uma carga
+typedef struct {
+  bool ok;
+  // instruções executadas e tempo simulado (com o tempo parado), somando
+  //   todas as CPUs
+  long instrucoes;
+  long tempo_simulado;
+  // tempo real de uma simulação, em segundos, e quantas foram feitas na
+  //   medida
+  double tempo;
+  int simulacoes;
+  // (mais lenta - mais rápida) / mais rápida, em %, entre as medidas
+  double dispersao;
+  int faltas;
+  int trocas;
+  int interrupcoes[N_IRQ + 1];
+  // quanto a memória residente máxima do processo filho cresceu com a
+  //   primeira simulação, em kB (o filho começa com a memória do pai)
+  long rss;
+} resultado_t;
+
+
+// ---------------------------------------------------------------------
+// EXECUÇÃO {{{1
+// ---------------------------------------------------------------------
+
+// executa a carga uma vez no processo corrente
+static void simula(carga_t *carga, resultado_t *r)
+{
+  simulador_config_t config;
+  simulador_config_padrao(&config);
+  config.lote = true;
+  config.log = NULL;
+  r->ok = simulador_config_define(&config, "init", carga->init)
+       && (carga->param == NULL
+           || simulador_config_define(&config, carga->param, carga->valor));
+  if (!r->ok) return;
+  simulador_t *sim = simulador_cria(&config);
+  if (sim == NULL) {
+    r->ok = false;
+    return;
+  }
+  r->ok = simulador_executa(sim);
+  r->instrucoes = simulador_instrucoes(sim);
+  r->tempo_simulado = simulador_tempo_simulado(sim);
+  r->tempo = simulador_tempo(sim);
+  metricas *m = simulador_metricas(sim);
+  r->faltas = m->n_faltas_pagina;
+  r->trocas = 0;
+  for (int i = 0; i < CPU_MAX; i++) r->trocas += m->n_despachos_cpu[i];
+  memcpy(r->interrupcoes, m->n_interrupcoes_tipo, sizeof(r->interrupcoes));
+  simulador_destroi(sim);
+}
+
+// maior memória residente do processo corrente até agora, em kB
+static long rss_maximo(void)
+{
+  struct rusage uso;
+  getrusage(RUSAGE_SELF, &uso);
+  return uso.ru_maxrss;
+}
+
+// uma medida: executa a carga no processo corrente uma vez sem contar o
+//   tempo (para medir a memória e aquecer os caches), depois até passar de
+//   TEMPO_MINIMO; a simulação é determinística, as contagens são as de
+//   qualquer uma delas
+static void simula_varias(carga_t *carga, resultado_t *r)
+{
+  long rss_inicial = rss_maximo();
+  simula(carga, r);
+  if (!r->ok) return;
+  r->rss = rss_maximo() - rss_inicial;
+  double total = 0;
+  int n = 0;
+  do {
+    simula(carga, r);
+    if (!r->ok) return;
+    total += r->tempo;
+    n++;
+  } while (total < TEMPO_MINIMO);
+  r->tempo = total / n;
+  r->simulacoes = n;
+}
+
+// executa uma medida em um processo filho, que manda o resultado por um pipe
+static void simula_em_filho(carga_t *carga, resultado_t *r)
+{
+  int canal[2];
+  int ret = pipe(canal);
+  assert(ret == 0);
+  fflush(NULL);
+  pid_t pid = fork();
+  assert(pid >= 0);
+  if (pid == 0) {
+    close(canal[0]);
+    resultado_t res = { .ok = false };
+    simula_varias(carga, &res);
+    bool escreveu = write(canal[1], &res, sizeof(res)) == sizeof(res);
+    _exit(escreveu ? 0 : 1);
+  }
+  close(canal[1]);
+  bool leu = read(canal[0], r, sizeof(*r)) == sizeof(*r);
+  close(canal[0]);
+  int estado;
+  waitpid(pid, &estado, 0);
+  if (!leu || !WIFEXITED(estado) || WEXITSTATUS(estado) != 0) {
+    r->ok = false;
+  }
+}
+
+// mede a carga 'repeticoes' vezes; fica o menor tempo, a maior memória e
+//   a dispersão dos tempos
+static void mede(carga_t *carga, int repeticoes, resultado_t *r)
+{
+  double maior = 0;
+  for (int i = 0; i < repeticoes; i++) {
+    resultado_t atual;
+    simula_em_filho(carga, &atual);
+    if (!atual.ok) {
+      r->ok = false;
+      return;
+    }
+    if (i == 0) {
+      *r = atual;
+    } else {
+      if (atual.tempo < r->tempo) r->tempo = atual.tempo;
+      if (atual.rss > r->rss) r->rss = atual.rss;
+    }
+    if (atual.tempo > maior) maior = atual.tempo;
+  }
+  r->dispersao = r->tempo > 0 ? (maior - r->tempo) * 100 / r->tempo : 0;
+}
+
+
+// ---------------------------------------------------------------------
+// RESULTADO {{{1
+// ---------------------------------------------------------------------
+
+static double ns_por_instrucao(resultado_t *r)
+{
+  return r->instrucoes > 0 ? r->tempo * 1e9 / r->instrucoes : 0;
+}
+
+static double por_segundo(int n, resultado_t *r)
+{
+  return r->tempo > 0 ? n / r->tempo : 0;
+}
+
+static void escreve_json(FILE *arq, int repeticoes, resultado_t *res)
+{
+  fprintf(arq, "{\n");
+  fprintf(arq, "  \"formato\": %d,\n", FORMATO);
+  fprintf(arq, "  \"repeticoes\": %d,\n", repeticoes);
+  fprintf(arq, "  \"cargas\": [\n");
+  for (int c = 0; c < N_CARGAS; c++) {
+    resultado_t *r = &res[c];
+    fprintf(arq, "    {\n");
+    fprintf(arq, "      \"nome\": \"%s\",\n", cargas[c].nome);
+    fprintf(arq, "      \"init\": \"%s\",\n", cargas[c].init);
+    fprintf(arq, "      \"ok\": %s,\n", r->ok ? "true" : "false");
+    if (r->ok) {
+      fprintf(arq, "      \"instrucoes\": %ld,\n", r->instrucoes);
+      fprintf(arq, "      \"tempo_simulado\": %ld,\n", r->tempo_simulado);
+      fprintf(arq, "      \"tempo_s\": %.6f,\n", r->tempo);
+      fprintf(arq, "      \"simulacoes_por_medida\": %d,\n", r->simulacoes);
+      fprintf(arq, "      \"ns_por_instrucao\": %.2f,\n", ns_por_instrucao(r));
+      fprintf(arq, "      \"dispersao_pct\": %.1f,\n", r->dispersao);
+      fprintf(arq, "      \"faltas_de_pagina\": %d,\n", r->faltas);
+      fprintf(arq, "      \"faltas_por_segundo\": %.1f,\n", por_segundo(r->faltas, r));
+      fprintf(arq, "      \"trocas_de_contexto\": %d,\n", r->trocas);
+      fprintf(arq, "      \"trocas_por_segundo\": %.1f,\n", por_segundo(r->trocas, r));
+      fprintf(arq, "      \"interrupcoes\": {");
+      for (int i = 0; i <= N_IRQ; i++) {
+        fprintf(arq, "%s\"%s\": %d", i == 0 ? " " : ", ", nomes_irq[i], r->interrupcoes[i]);
+      }
+      fprintf(arq, " },\n");
+      fprintf(arq, "      \"rss_acrescimo_kb\": %ld\n", r->rss);
+    }
+    fprintf(arq, "    }%s\n", c < N_CARGAS - 1 ? "," : "");
+  }
+  fprintf(arq, "  ]\n");
+  fprintf(arq, "}\n");
+}
+
+
+// ---------------------------------------------------------------------
+// COMPARAÇÃO {{{1
+// ---------------------------------------------------------------------
+
+// lê o arquivo 'nome' inteiro para a memória (NULL se não conseguir)
+static char *le_arquivo(char *nome)
+{
+  FILE *arq = fopen(nome, "r");
+  if (arq == NULL) return NULL;
+  fseek(arq, 0, SEEK_END);
+  long tam = ftell(arq);
+  rewind(arq);
+  char *txt = malloc(tam + 1);
+  assert(txt != NULL);
+  if (fread(txt, 1, tam, arq) != tam) {
+    free(txt);
+    txt = NULL;
+  } else {
+    txt[tam] = '\0';
+  }
+  fclose(arq);
+  return txt;
+}
+
+// procura no resultado 'txt' o campo numérico 'campo' da carga 'carga'
+// não é um leitor de JSON, só entende o formato gerado por escreve_json
+static bool busca_campo(char *txt, char *carga, char *campo, double *pvalor)
+{
+  char chave[100];
+  snprintf(chave, sizeof(chave), "\"nome\": \"%s\"", carga);
+  char *p = strstr(txt, chave);
+  if (p == NULL) return false;
+  // o campo tem que estar antes do fim do objeto da carga
+  char *fim = strchr(p, '}');
+  snprintf(chave, sizeof(chave), "\"%s\":", campo);
+  p = strstr(p, chave);
+  if (p == NULL || (fim != NULL && p > fim)) return false;
+  return sscanf(p + strlen(chave), "%lf", pvalor) == 1;
+}
+
+// compara o resultado com o salvo no arquivo 'nome_base'
+// retorna o número de cargas que ficaram mais lentas do que 'limite' (em %),
+//   ou do que a soma das dispersões, se for maior
+static int compara(char *nome_base, resultado_t *res, double limite)
+{
+  char *base = le_arquivo(nome_base);
+  if (base == NULL) {
+    fprintf(stderr, "Erro na leitura de '%s'\n", nome_base);
+    exit(1);
+  }
+  double formato;
+  if (sscanf(base, " { \"formato\": %lf", &formato) != 1 || formato != FORMATO) {
+    fprintf(stderr, "'%s' não é um resultado no formato %d\n", nome_base, FORMATO);
+    exit(1);
+  }
+
+  int regressoes = 0;
+  printf("%-10s %12s %12s %9s %7s\n", "carga", "base ns/ins", "atual ns/ins", "variação", "limite");
+  for (int c = 0; c < N_CARGAS; c++) {
+    resultado_t *r = &res[c];
+    double ns_base, instrucoes_base, faltas_base, dispersao_base;
+    if (!r->ok || !busca_campo(base, cargas[c].nome, "ns_por_instrucao", &ns_base)
+        || !busca_campo(base, cargas[c].nome, "dispersao_pct", &dispersao_base)
+        || !busca_campo(base, cargas[c].nome, "instrucoes", &instrucoes_base)
+        || !busca_campo(base, cargas[c].nome, "faltas_de_pagina", &faltas_base)) {
+      printf("%-10s sem resultado para comparar\n", cargas[c].nome);
+      continue;
+    }
+    double ns = ns_por_instrucao(r);
+    double variacao = ns_base > 0 ? (ns - ns_base) * 100 / ns_base : 0;
+    double limite_carga = limite;
+    if (dispersao_base + r->dispersao > limite_carga) {
+      limite_carga = dispersao_base + r->dispersao;
+    }
+    bool regressao = variacao > limite_carga;
+    if (regressao) regressoes++;
+    printf("%-10s %12.2f %12.2f %+8.1f%% %6.1f%%%s\n", cargas[c].nome, ns_base, ns,
+           variacao, limite_carga, regressao ? "  REGRESSÃO" : "");
+    // a simulação é determinística: se mudou, a carga (ou o SO) mudou, e
+    //   o tempo por instrução pode não ser comparável
+    if (instrucoes_base != r->instrucoes || faltas_base != r->faltas) {
+      printf("%-10s   a carga mudou: %.0f -> %ld instruções, %.0f -> %d faltas\n",
+             "", instrucoes_base, r->instrucoes, faltas_base, r->faltas);
+    }
+  }
+  free(base);
+  return regressoes;
+}
+
+
+// ---------------------------------------------------------------------
+// MAIN {{{1
+// ---------------------------------------------------------------------
+
+static void uso(char *nome)
+{
+  fprintf(stderr, "uso: %s [-r repetições] [-o saida.json] [-c base.json] [-l limite]\n", nome);
+  fprintf(stderr, "  executa as cargas de referência e mede o desempenho\n");
+  fprintf(stderr, "  -r        quantas vezes medir cada carga (padrão: 5); cada medida\n");
+  fprintf(stderr, "            repete a simulação por pelo menos %.1f s\n", TEMPO_MINIMO);
+  fprintf(stderr, "  -o        arquivo JSON com o resultado (padrão: a saída padrão)\n");
+  fprintf(stderr, "  -c        compara com o resultado salvo em 'base.json'\n");
+  fprintf(stderr, "  -l        variação do tempo por instrução, em %%, a partir da qual\n");
+  fprintf(stderr, "            a comparação acusa regressão (padrão: 10), ou a soma das\n");
+  fprintf(stderr, "            dispersões da carga na base e na atual, se for maior\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  int repeticoes = 5;
+  char *saida = NULL;
+  char *base = NULL;
+  double limite = 10;
+  int opt;
+  // as simulações não têm tela nem log, as mensagens do SO não iriam para
+  //   lugar nenhum
+  log_define_niveis("nada");
+  while ((opt = getopt(argc, argv, "r:o:c:l:")) != -1) {
+    switch (opt) {
+      case 'r':
+        repeticoes = atoi(optarg);
+        if (repeticoes < 1) uso(argv[0]);
+        break;
+      case 'o':
+        saida = optarg;
+        break;
+      case 'c':
+        base = optarg;
+        break;
+      case 'l':
+        limite = atof(optarg);
+        if (limite < 0) uso(argv[0]);
+        break;
+      default:
+        uso(argv[0]);
+    }
+  }
+  if (optind < argc) uso(argv[0]);
+
+  resultado_t res[N_CARGAS];
+  int falhas = 0;
+  for (int c = 0; c < N_CARGAS; c++) {
+    mede(&cargas[c], repeticoes, &res[c]);
+    if (!res[c].ok) {
+      fprintf(stderr, "a carga '%s' falhou\n", cargas[c].nome);
+      falhas++;
+    }
+  }
+
+  FILE *arq = stdout;
+  if (saida != NULL) {
+    arq = fopen(saida, "w");
+    if (arq == NULL) {
+      fprintf(stderr, "Erro na abertura de '%s'\n", saida);
+      exit(1);
+    }
+  }
+  escreve_json(arq, repeticoes, res);
+  if (arq != stdout) fclose(arq);
+
+  int regressoes = 0;
+  if (base != NULL) regressoes = compara(base, res, limite);
+  return (falhas > 0 || regressoes > 0) ? 1 : 0;
+}
+
+// vim: foldmethod=marker
@@ -33,6 +33,11 @@ typedef enum {
   D_RELOGIO_REAL,
   D_RELOGIO_TIMER,
   D_RELOGIO_INTERRUPCAO,
+  D_RELOGIO_OCIOSO,
+  D_PIC_PENDENTES,
+  D_PIC_MASCARA,
+  D_PIC_RECONHECE,
+  D_PIC_PEDE,
   N_DISPOSITIVOS
 } dispositivo_id_t;
 
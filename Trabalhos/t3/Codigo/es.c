@@ -14,6 +14,8 @@ typedef struct {
    f_leitura_t f_leitura;
    // função para escrever um valor no dispositivo
    f_escrita_t f_escrita;
+   // função para escrever vários valores de uma vez (ou NULL)
+   f_escrita_bloco_t f_escrita_bloco;
    // controlador do dispositivo (argumento para as funções acima)
    void *controladora;
    // identificador do dispositivo (argumento para as funções acima)
@@ -46,6 +48,16 @@ bool es_registra_dispositivo(es_t *self, dispositivo_id_t dispositivo,
   self->dispositivos[dispositivo].id = id;
   self->dispositivos[dispositivo].f_leitura = f_leitura;
   self->dispositivos[dispositivo].f_escrita = f_escrita;
+  self->dispositivos[dispositivo].f_escrita_bloco = NULL;
+  return true;
+}
+
+bool es_registra_escrita_bloco(es_t *self, dispositivo_id_t dispositivo,
+                               f_escrita_bloco_t f_escrita_bloco)
+{
+  if (dispositivo < 0 || dispositivo >= N_DISPOSITIVOS) return false;
+  if (self->dispositivos[dispositivo].f_escrita == NULL) return false;
+  self->dispositivos[dispositivo].f_escrita_bloco = f_escrita_bloco;
   return true;
 }
 
@@ -66,3 +78,21 @@ err_t es_escreve(es_t *self, dispositivo_id_t dispositivo, int valor)
   int id = self->dispositivos[dispositivo].id;
   return self->dispositivos[dispositivo].f_escrita(controladora, id, valor);
 }
+
+err_t es_escreve_bloco(es_t *self, dispositivo_id_t dispositivo, int n,
+                       const int *valores, int *pn_escritos)
+{
+  *pn_escritos = 0;
+  if (dispositivo < 0 || dispositivo >= N_DISPOSITIVOS) return ERR_DISP_INV;
+  dispositivo_t *disp = &self->dispositivos[dispositivo];
+  if (disp->f_escrita == NULL) return ERR_OP_INV;
+  if (disp->f_escrita_bloco != NULL) {
+    return disp->f_escrita_bloco(disp->controladora, disp->id, n, valores, pn_escritos);
+  }
+  while (*pn_escritos < n) {
+    err_t err = disp->f_escrita(disp->controladora, disp->id, valores[*pn_escritos]);
+    if (err != ERR_OK) return err;
+    (*pn_escritos)++;
+  }
+  return ERR_OK;
+}
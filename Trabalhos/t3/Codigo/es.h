@@ -24,6 +24,13 @@ typedef struct es_t es_t; // declara o tipo como sendo uma estrutura opaca
 // a função de escrita recebe o valor a ser escrito.
 typedef err_t (*f_leitura_t)(void *controladora, int id, int *endereco);
 typedef err_t (*f_escrita_t)(void *controladora, int id, int valor);
+// um dispositivo pode também aceitar escritas em bloco: a função recebe 'n'
+//   valores e escreve quantos puder, em ordem, colocando em '*pn_escritos'
+//   quantos foram escritos; retorna o erro que impediu a escrita do
+//   seguinte (ERR_OCUP se o dispositivo não aceita mais agora), ou ERR_OK
+//   se escreveu todos
+typedef err_t (*f_escrita_bloco_t)(void *controladora, int id, int n,
+                                   const int *valores, int *pn_escritos);
 
 // aloca e inicializa um controlador de E/S
 // retorna NULL em caso de erro
@@ -44,6 +51,12 @@ bool es_registra_dispositivo(es_t *self, dispositivo_id_t dispositivo,
                              void *controladora, int id,
                              f_leitura_t f_leitura, f_escrita_t f_escrita);
 
+// registra a função de escrita em bloco do dispositivo 'dispositivo', que
+//   já deve ter sido registrado
+// retorna false se não foi possível registrar
+bool es_registra_escrita_bloco(es_t *self, dispositivo_id_t dispositivo,
+                               f_escrita_bloco_t f_escrita_bloco);
+
 // lê um inteiro de um dispositivo
 // retorna ERR_OK se bem sucedido, ou
 //   ERR_DISP_INV se dispositivo desconhecido
@@ -56,4 +69,12 @@ err_t es_le(es_t *self, dispositivo_id_t dispositivo, int *pvalor);
 //   ERR_OP_INV se operação inválida
 err_t es_escreve(es_t *self, dispositivo_id_t dispositivo, int valor);
 
+// escreve até 'n' inteiros em um dispositivo, em um só acesso se ele tiver
+//   escrita em bloco, senão um a um, até o primeiro erro
+// coloca em '*pn_escritos' quantos foram escritos
+// retorna ERR_OK se escreveu todos, ou o erro que impediu a escrita do
+//   seguinte (como em es_escreve)
+err_t es_escreve_bloco(es_t *self, dispositivo_id_t dispositivo, int n,
+                       const int *valores, int *pn_escritos);
+
 #endif // ES_H
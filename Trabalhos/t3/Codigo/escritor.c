@@ -0,0 +1,123 @@
+// escritor.c
+// escrita de um arquivo de log em uma thread separada
+// simulador de computador
+// so25b
+
+#include "escritor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+// quanto a thread dorme quando o buffer está vazio, em ns
+#define ESPERA_NS 1000000
+
+struct escritor_t {
+  FILE *arq;
+  char *buffer;
+  // tamanho do buffer menos 1 (o tamanho é potência de 2)
+  int mascara;
+  // número de bytes já colocados no buffer (só o produtor altera) e já
+  //   escritos no arquivo (só a thread do escritor altera); o que está no
+  //   buffer vai de cauda a cabeca, as posições são tomadas módulo o tamanho
+  atomic_long cabeca;
+  atomic_long cauda;
+  atomic_long descartadas;
+  // o produtor terminou, a thread deve esvaziar o buffer e terminar
+  atomic_bool fim;
+  pthread_t thread;
+};
+
+static void *escritor_thread(void *arg);
+
+escritor_t *escritor_cria(char *nome, int tam)
+{
+  assert(tam > 0 && (tam & (tam - 1)) == 0);
+  FILE *arq = fopen(nome, "w");
+  if (arq == NULL) return NULL;
+  escritor_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->arq = arq;
+  self->buffer = malloc(tam);
+  assert(self->buffer != NULL);
+  self->mascara = tam - 1;
+  atomic_init(&self->cabeca, 0);
+  atomic_init(&self->cauda, 0);
+  atomic_init(&self->descartadas, 0);
+  atomic_init(&self->fim, false);
+  int r = pthread_create(&self->thread, NULL, escritor_thread, self);
+  assert(r == 0);
+  return self;
+}
+
+void escritor_destroi(escritor_t *self)
+{
+  atomic_store(&self->fim, true);
+  pthread_join(self->thread, NULL);
+  long descartadas = atomic_load(&self->descartadas);
+  if (descartadas > 0) {
+    fprintf(self->arq, "[log: %ld linhas descartadas por falta de espaço no buffer]\n",
+            descartadas);
+  }
+  fclose(self->arq);
+  free(self->buffer);
+  free(self);
+}
+
+void escritor_escreve_linha(escritor_t *self, char *s)
+{
+  long tam = self->mascara + 1;
+  long n = strlen(s);
+  long cabeca = atomic_load_explicit(&self->cabeca, memory_order_relaxed);
+  long cauda = atomic_load_explicit(&self->cauda, memory_order_acquire);
+  if (cabeca - cauda + n + 1 > tam) {
+    atomic_fetch_add_explicit(&self->descartadas, 1, memory_order_relaxed);
+    return;
+  }
+  // copia em até dois pedaços, se passar do fim do buffer
+  int pos = cabeca & self->mascara;
+  long n1 = n < tam - pos ? n : tam - pos;
+  memcpy(self->buffer + pos, s, n1);
+  memcpy(self->buffer, s + n1, n - n1);
+  self->buffer[(cabeca + n) & self->mascara] = '\n';
+  // a thread só vê a linha depois de ela estar toda no buffer
+  atomic_store_explicit(&self->cabeca, cabeca + n + 1, memory_order_release);
+}
+
+long escritor_descartadas(escritor_t *self)
+{
+  return atomic_load_explicit(&self->descartadas, memory_order_relaxed);
+}
+
+// escreve tudo que está no buffer, até o produtor terminar
+static void *escritor_thread(void *arg)
+{
+  escritor_t *self = arg;
+  long tam = self->mascara + 1;
+  long cauda = atomic_load_explicit(&self->cauda, memory_order_relaxed);
+  for (;;) {
+    // se o fim foi pedido antes de ler a cabeça, o que o produtor escreveu
+    //   já está no buffer
+    bool fim = atomic_load(&self->fim);
+    long cabeca = atomic_load_explicit(&self->cabeca, memory_order_acquire);
+    if (cabeca == cauda) {
+      if (fim) break;
+      fflush(self->arq);
+      struct timespec espera = { 0, ESPERA_NS };
+      nanosleep(&espera, NULL);
+      continue;
+    }
+    // até o fim do buffer; o resto vai na próxima volta
+    int pos = cauda & self->mascara;
+    long n = cabeca - cauda;
+    if (n > tam - pos) n = tam - pos;
+    fwrite(self->buffer + pos, 1, n, self->arq);
+    cauda += n;
+    atomic_store_explicit(&self->cauda, cauda, memory_order_release);
+  }
+  return NULL;
+}
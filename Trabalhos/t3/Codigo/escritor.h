@@ -0,0 +1,39 @@
+// escritor.h
+// escrita de um arquivo de log em uma thread separada
+// simulador de computador
+// so25b
+
+#ifndef ESCRITOR_H
+#define ESCRITOR_H
+
+// o escritor recebe linhas de texto e as escreve em um arquivo, sem que
+//   quem escreve espere pelo arquivo: as linhas são copiadas para um buffer
+//   circular de tamanho fixo, que é esvaziado por uma thread do escritor,
+//   em blocos grandes
+// o buffer é compartilhado sem trava, e por isso só pode ter um produtor
+//   (uma thread de cada vez chamando escritor_escreve_linha; a console
+//   garante isso com a trava dela)
+// se o buffer estiver cheio, a linha é descartada (a memória usada é
+//   limitada, e quem escreve nunca espera); o número de linhas descartadas
+//   é escrito no fim do arquivo
+
+#include <stdbool.h>
+
+typedef struct escritor_t escritor_t;
+
+// cria um escritor para o arquivo 'nome' (que é truncado), com um buffer de
+//   'tam' bytes (uma potência de 2), e inicia a thread que escreve
+// retorna NULL se o arquivo não puder ser aberto
+escritor_t *escritor_cria(char *nome, int tam);
+
+// escreve o que ainda estiver no buffer, termina a thread e fecha o arquivo
+void escritor_destroi(escritor_t *self);
+
+// coloca a linha 's' (sem o '\n', que é acrescentado) no buffer, ou a
+//   descarta se não couber
+void escritor_escreve_linha(escritor_t *self, char *s);
+
+// número de linhas descartadas até agora
+long escritor_descartadas(escritor_t *self);
+
+#endif // ESCRITOR_H
@@ -0,0 +1,12 @@
+; filho.asm
+; carga para o benchmark (ver carga_proc.asm): um processo que só morre
+
+; chamadas de sistema (ver so.h)
+SO_MATA_PROC   define 8
+
+morre
+         cargi 0
+         trax
+         cargi SO_MATA_PROC
+         chamas
+         desv morre
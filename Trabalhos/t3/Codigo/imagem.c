@@ -0,0 +1,117 @@
+// imagem.c
+// leitura e escrita da imagem (checkpoint) do estado da máquina
+// simulador de computador
+// so25b
+
+#include "imagem.h"
+
+#include <string.h>
+
+// identificação do arquivo e versão do formato
+#define ASSINATURA "so25b-imagem"
+#define VERSAO 10
+
+FILE *imagem_cria(char *nome)
+{
+  FILE *arq = fopen(nome, "wb");
+  if (arq == NULL) return NULL;
+  if (!imagem_escreve_str(arq, ASSINATURA) || !imagem_escreve_int(arq, VERSAO)) {
+    fclose(arq);
+    return NULL;
+  }
+  return arq;
+}
+
+FILE *imagem_abre(char *nome)
+{
+  FILE *arq = fopen(nome, "rb");
+  if (arq == NULL) return NULL;
+  char assinatura[sizeof(ASSINATURA)];
+  if (!imagem_le_str(arq, sizeof(assinatura), assinatura)
+      || strcmp(assinatura, ASSINATURA) != 0
+      || !imagem_confere_int(arq, VERSAO)) {
+    fclose(arq);
+    return NULL;
+  }
+  return arq;
+}
+
+bool imagem_escreve_int(FILE *arq, int valor)
+{
+  return fwrite(&valor, sizeof(valor), 1, arq) == 1;
+}
+
+bool imagem_le_int(FILE *arq, int *pvalor)
+{
+  return fread(pvalor, sizeof(*pvalor), 1, arq) == 1;
+}
+
+bool imagem_confere_int(FILE *arq, int valor)
+{
+  int lido;
+  return imagem_le_int(arq, &lido) && lido == valor;
+}
+
+// o vetor é escrito como uma sequência de pares (zeros, n) seguidos de n
+//   valores: 'zeros' posições com zero e depois os n valores
+bool imagem_escreve_vetor(FILE *arq, int n, const int *v)
+{
+  if (!imagem_escreve_int(arq, n)) return false;
+  int i = 0;
+  while (i < n) {
+    int zeros = 0;
+    while (i + zeros < n && v[i + zeros] == 0) zeros++;
+    i += zeros;
+    int valores = 0;
+    while (i + valores < n && v[i + valores] != 0) valores++;
+    if (!imagem_escreve_int(arq, zeros) || !imagem_escreve_int(arq, valores)) {
+      return false;
+    }
+    if (fwrite(&v[i], sizeof(int), valores, arq) != valores) return false;
+    i += valores;
+  }
+  return true;
+}
+
+bool imagem_le_vetor(FILE *arq, int n, int *v)
+{
+  if (!imagem_confere_int(arq, n)) return false;
+  int i = 0;
+  while (i < n) {
+    int zeros, valores;
+    if (!imagem_le_int(arq, &zeros) || !imagem_le_int(arq, &valores)) return false;
+    if (zeros < 0 || valores < 0 || i + zeros + valores > n) return false;
+    memset(&v[i], 0, zeros * sizeof(int));
+    i += zeros;
+    if (fread(&v[i], sizeof(int), valores, arq) != valores) return false;
+    i += valores;
+  }
+  return true;
+}
+
+bool imagem_escreve_str(FILE *arq, const char *str)
+{
+  int tam = strlen(str);
+  return imagem_escreve_int(arq, tam) && fwrite(str, 1, tam, arq) == tam;
+}
+
+bool imagem_le_str(FILE *arq, int tam, char *str)
+{
+  int tam_lido;
+  if (!imagem_le_int(arq, &tam_lido) || tam_lido < 0 || tam_lido >= tam) {
+    return false;
+  }
+  if (fread(str, 1, tam_lido, arq) != tam_lido) return false;
+  str[tam_lido] = '\0';
+  return true;
+}
+
+bool imagem_escreve_bytes(FILE *arq, int tam, const void *p)
+{
+  return imagem_escreve_int(arq, tam) && fwrite(p, 1, tam, arq) == tam;
+}
+
+bool imagem_le_bytes(FILE *arq, int tam, void *p)
+{
+  return imagem_confere_int(arq, tam) && fread(p, 1, tam, arq) == tam;
+}
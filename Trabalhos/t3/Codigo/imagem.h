@@ -0,0 +1,53 @@
+// imagem.h
+// leitura e escrita da imagem (checkpoint) do estado da máquina
+// simulador de computador
+// so25b
+
+#ifndef IMAGEM_H
+#define IMAGEM_H
+
+// a imagem é um arquivo binário com o estado de todos os componentes da
+//   máquina simulada e do SO, para que uma simulação possa continuar de onde
+//   outra parou (por exemplo, depois da inicialização do sistema)
+// cada componente tem um par de funções _salva e _recupera, que escrevem e
+//   leem o seu estado com as funções abaixo, na mesma ordem; o que é
+//   configuração (tamanhos, ligações entre componentes) não vai na imagem,
+//   a máquina que recupera deve ter sido criada igual à que salvou
+//
+// todas as funções retornam false em caso de erro (de E/S ou se o que foi
+//   lido não é o esperado); depois de um erro, o conteúdo da imagem não
+//   deve mais ser usado
+
+#include <stdio.h>
+#include <stdbool.h>
+
+// abre o arquivo da imagem para escrita e escreve o cabeçalho
+// retorna NULL em caso de erro
+FILE *imagem_cria(char *nome);
+
+// abre o arquivo da imagem para leitura e confere o cabeçalho
+// retorna NULL em caso de erro (ou se não é uma imagem desta versão)
+FILE *imagem_abre(char *nome);
+
+// um inteiro
+bool imagem_escreve_int(FILE *arq, int valor);
+bool imagem_le_int(FILE *arq, int *pvalor);
+
+// um inteiro, que na leitura deve ser igual a 'valor' (para conferir
+//   marcas e tamanhos)
+bool imagem_confere_int(FILE *arq, int valor);
+
+// um vetor de 'n' inteiros; as sequências de zeros são compactadas (a
+//   memória é quase toda zero)
+bool imagem_escreve_vetor(FILE *arq, int n, const int *v);
+bool imagem_le_vetor(FILE *arq, int n, int *v);
+
+// uma string (na leitura, com até tam-1 caracteres)
+bool imagem_escreve_str(FILE *arq, const char *str);
+bool imagem_le_str(FILE *arq, int tam, char *str);
+
+// 'tam' bytes, para estruturas sem ponteiros
+bool imagem_escreve_bytes(FILE *arq, int tam, const void *p);
+bool imagem_le_bytes(FILE *arq, int tam, void *p);
+
+#endif // IMAGEM_H
@@ -13,11 +13,12 @@ typedef enum {
   // interrupções geradas internamente na CPU
   IRQ_ERR_CPU,       // erro interno na CPU (ver registrador de erro)
   IRQ_SISTEMA,       // chamada de sistema
-  // interrupções geradas por dispositivos de E/S
+  // interrupções geradas por dispositivos de E/S, entregues pelo
+  //   controlador de interrupções (ver pic.h)
   IRQ_RELOGIO,       // interrupção causada pelo relógio
-  // interrupções de E/S ainda não implementadas
   IRQ_TECLADO,       // interrupção causada pelo teclado
   IRQ_TELA,          // interrupção causada pela tela
+  IRQ_DISCO,         // fim de um acesso ao disco
   N_IRQ              // número de interrupções
 } irq_t;
 
@@ -0,0 +1,362 @@
+// jit.c
+// tradução de blocos de instruções para código nativo x86-64
+// simulador de computador
+// so25b
+
+// para memfd_create
+#define _GNU_SOURCE
+
+#include "jit.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__x86_64__)
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+// ---------------------------------------------------------------------
+// DECLARAÇÃO {{{1
+// ---------------------------------------------------------------------
+
+// tamanho do buffer de código; quando enche, todos os blocos são descartados
+#define TAM_CODIGO (1024 * 1024)
+// espaço que sempre deve sobrar no buffer antes de emitir uma instrução
+#define FOLGA 64
+// número de entradas na tabela de blocos (potência de 2)
+#define N_BLOCOS 1024
+// tamanho do mapa de endereços com código traduzido (potência de 2)
+// o mapa é indexado pelo endereço módulo esse valor; uma colisão só causa
+//   um descarte desnecessário
+#define N_MAPA 16384
+
+// informação sobre um endereço onde inicia um bloco
+typedef struct {
+  // endereço físico do início do bloco (-1 se a entrada está livre)
+  int end;
+  // modo da CPU para o qual o bloco foi (ou vai ser) traduzido
+  int modo;
+  // número de vezes que o bloco foi executado sem estar traduzido
+  int contador;
+  // código do bloco (NULL se ainda não traduzido) e número de instruções
+  jit_bloco_t bloco;
+  int n;
+} entrada_t;
+
+struct jit_t {
+  // buffer de código executável, e quanto dele já está ocupado
+  // a mesma memória é mapeada duas vezes (W^X): 'codigo' pode ser
+  //   executado e não alterado, 'escrita' pode ser alterado e não executado
+  unsigned char *codigo;
+  unsigned char *escrita;
+  int ocupado;
+  // número de execuções para um bloco ser traduzido
+  int quente;
+  // tabela de blocos, indexada pelo endereço físico
+  entrada_t tabela[N_BLOCOS];
+  // endereços que fazem parte de algum bloco traduzido
+  bool mapa[N_MAPA];
+  // é colocado em true quando os blocos são descartados; o código gerado
+  //   testa depois de instruções que podem escrever na memória
+  bool esvaziado;
+  // bloco em tradução
+  entrada_t *traducao;
+  int inicio_traducao;
+  bool estourou;
+};
+
+
+// ---------------------------------------------------------------------
+// CRIAÇÃO {{{1
+// ---------------------------------------------------------------------
+
+jit_t *jit_cria(int quente)
+{
+  jit_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+
+  // os dois mapeamentos são de um arquivo anônimo, que não precisa
+  //   continuar aberto depois deles
+  int fd = memfd_create("so25b-jit", MFD_CLOEXEC);
+  if (fd < 0 || ftruncate(fd, TAM_CODIGO) != 0) {
+    if (fd >= 0) close(fd);
+    free(self);
+    return NULL;
+  }
+  self->escrita = mmap(NULL, TAM_CODIGO, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  self->codigo = mmap(NULL, TAM_CODIGO, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+  close(fd);
+  if (self->escrita == MAP_FAILED || self->codigo == MAP_FAILED) {
+    // o sistema não permite memória executável
+    if (self->escrita != MAP_FAILED) munmap(self->escrita, TAM_CODIGO);
+    if (self->codigo != MAP_FAILED) munmap(self->codigo, TAM_CODIGO);
+    free(self);
+    return NULL;
+  }
+  self->quente = quente;
+  self->traducao = NULL;
+  jit_esvazia(self);
+
+  return self;
+}
+
+void jit_destroi(jit_t *self)
+{
+  munmap(self->codigo, TAM_CODIGO);
+  munmap(self->escrita, TAM_CODIGO);
+  free(self);
+}
+
+void jit_esvazia(jit_t *self)
+{
+  self->ocupado = 0;
+  for (int i = 0; i < N_BLOCOS; i++) {
+    self->tabela[i].end = -1;
+  }
+  memset(self->mapa, 0, sizeof(self->mapa));
+  self->esvaziado = true;
+}
+
+
+// ---------------------------------------------------------------------
+// TABELA DE BLOCOS {{{1
+// ---------------------------------------------------------------------
+
+static entrada_t *entrada(jit_t *self, int end)
+{
+  return &self->tabela[end & (N_BLOCOS - 1)];
+}
+
+jit_bloco_t jit_bloco(jit_t *self, int end, int modo, int *pn, bool *pquente)
+{
+  entrada_t *e = entrada(self, end);
+  if (e->end == end && e->modo == modo) {
+    if (e->bloco != NULL) {
+      *pn = e->n;
+      return e->bloco;
+    }
+    e->contador++;
+  } else {
+    // a entrada estava livre ou era de outro endereço, que perde a vez
+    e->end = end;
+    e->modo = modo;
+    e->contador = 1;
+    e->bloco = NULL;
+  }
+  *pquente = e->contador >= self->quente;
+  return NULL;
+}
+
+int jit_executa(jit_t *self, jit_bloco_t bloco, void *cpu)
+{
+  self->esvaziado = false;
+  return bloco(cpu);
+}
+
+void jit_aviso_escrita(jit_t *self, int end)
+{
+  if (jit_traduzido(self, end)) jit_esvazia(self);
+}
+
+bool jit_traduzido(jit_t *self, int end)
+{
+  return self->mapa[end & (N_MAPA - 1)];
+}
+
+
+// ---------------------------------------------------------------------
+// GERAÇÃO DE CÓDIGO {{{1
+// ---------------------------------------------------------------------
+
+// o código gerado mantém o ponteiro para a CPU em rbx (que é preservado
+//   pelas funções chamadas); o valor de retorno vai em eax
+
+static void emite_byte(jit_t *self, int b)
+{
+  self->escrita[self->ocupado++] = b;
+}
+
+static void emite_int(jit_t *self, int v)
+{
+  memcpy(&self->escrita[self->ocupado], &v, sizeof(v));
+  self->ocupado += sizeof(v);
+}
+
+static void emite_ponteiro(jit_t *self, void *p)
+{
+  memcpy(&self->escrita[self->ocupado], &p, sizeof(p));
+  self->ocupado += sizeof(p);
+}
+
+// verifica se tem espaço para mais uma instrução
+static bool tem_espaco(jit_t *self)
+{
+  if (self->estourou) return false;
+  if (self->ocupado + FOLGA > TAM_CODIGO) {
+    self->estourou = true;
+    return false;
+  }
+  return true;
+}
+
+// mov eax, n; pop rbx; ret
+static void emite_retorno(jit_t *self, int n)
+{
+  emite_byte(self, 0xb8); emite_int(self, n);
+  emite_byte(self, 0x5b);
+  emite_byte(self, 0xc3);
+}
+
+void jit_inicia_bloco(jit_t *self, int end, int modo)
+{
+  entrada_t *e = entrada(self, end);
+  e->end = end;
+  e->modo = modo;
+  e->contador = 0;
+  e->bloco = NULL;
+  self->traducao = e;
+  self->inicio_traducao = self->ocupado;
+  self->estourou = false;
+  if (!tem_espaco(self)) return;
+  // push rbx; mov rbx, rdi
+  emite_byte(self, 0x53);
+  emite_byte(self, 0x48); emite_byte(self, 0x89); emite_byte(self, 0xfb);
+}
+
+bool jit_termina_bloco(jit_t *self, int fim, int n)
+{
+  if (!tem_espaco(self)) {
+    // não coube: esvazia tudo, o bloco vai ser traduzido de novo mais tarde
+    jit_esvazia(self);
+    self->traducao = NULL;
+    return false;
+  }
+  emite_retorno(self, n);
+  entrada_t *e = self->traducao;
+  e->bloco = (jit_bloco_t)&self->codigo[self->inicio_traducao];
+  e->n = n;
+  for (int end = e->end; end < fim; end++) {
+    self->mapa[end & (N_MAPA - 1)] = true;
+  }
+  self->traducao = NULL;
+  return true;
+}
+
+void jit_abandona_bloco(jit_t *self)
+{
+  if (self->traducao == NULL) return;
+  self->ocupado = self->inicio_traducao;
+  self->traducao = NULL;
+}
+
+// as instruções que acessam um campo da CPU usam o endereçamento [rbx+disp32]
+// o byte modrm tem mod=10, rm=011 (rbx) e reg com o registrador ou extensão
+//   do opcode
+static void emite_modrm_campo(jit_t *self, int reg, int campo)
+{
+  emite_byte(self, 0x83 | (reg << 3));
+  emite_int(self, campo);
+}
+
+void jit_emite_atribui(jit_t *self, int campo, int valor)
+{
+  if (!tem_espaco(self)) return;
+  // mov dword [rbx+campo], valor
+  emite_byte(self, 0xc7); emite_modrm_campo(self, 0, campo); emite_int(self, valor);
+}
+
+void jit_emite_soma(jit_t *self, int campo, int valor)
+{
+  if (!tem_espaco(self)) return;
+  // add dword [rbx+campo], valor
+  emite_byte(self, 0x81); emite_modrm_campo(self, 0, campo); emite_int(self, valor);
+}
+
+void jit_emite_copia(jit_t *self, int campo_dest, int campo_orig)
+{
+  if (!tem_espaco(self)) return;
+  // mov eax, [rbx+campo_orig]; mov [rbx+campo_dest], eax
+  emite_byte(self, 0x8b); emite_modrm_campo(self, 0, campo_orig);
+  emite_byte(self, 0x89); emite_modrm_campo(self, 0, campo_dest);
+}
+
+void jit_emite_troca(jit_t *self, int campo1, int campo2)
+{
+  if (!tem_espaco(self)) return;
+  // mov eax, [rbx+campo1]; mov ecx, [rbx+campo2]
+  emite_byte(self, 0x8b); emite_modrm_campo(self, 0, campo1);
+  emite_byte(self, 0x8b); emite_modrm_campo(self, 1, campo2);
+  // mov [rbx+campo1], ecx; mov [rbx+campo2], eax
+  emite_byte(self, 0x89); emite_modrm_campo(self, 1, campo1);
+  emite_byte(self, 0x89); emite_modrm_campo(self, 0, campo2);
+}
+
+void jit_emite_nega(jit_t *self, int campo)
+{
+  if (!tem_espaco(self)) return;
+  // neg dword [rbx+campo]
+  emite_byte(self, 0xf7); emite_modrm_campo(self, 3, campo);
+}
+
+void jit_emite_chamada(jit_t *self, jit_funcao_t funcao, int arg)
+{
+  if (!tem_espaco(self)) return;
+  // mov rdi, rbx; mov esi, arg
+  emite_byte(self, 0x48); emite_byte(self, 0x89); emite_byte(self, 0xdf);
+  emite_byte(self, 0xbe); emite_int(self, arg);
+  // mov rax, funcao; call rax
+  emite_byte(self, 0x48); emite_byte(self, 0xb8); emite_ponteiro(self, funcao);
+  emite_byte(self, 0xff); emite_byte(self, 0xd0);
+}
+
+void jit_emite_sai_se_nao_zero(jit_t *self, int campo, int n)
+{
+  if (!tem_espaco(self)) return;
+  // cmp dword [rbx+campo], 0; je +7; (retorna n)
+  emite_byte(self, 0x83); emite_modrm_campo(self, 7, campo); emite_byte(self, 0);
+  emite_byte(self, 0x74); emite_byte(self, 7);
+  emite_retorno(self, n);
+}
+
+void jit_emite_sai_se_esvaziado(jit_t *self, int n)
+{
+  if (!tem_espaco(self)) return;
+  // mov rax, &esvaziado; cmp byte [rax], 0; je +7; (retorna n)
+  emite_byte(self, 0x48); emite_byte(self, 0xb8); emite_ponteiro(self, &self->esvaziado);
+  emite_byte(self, 0x80); emite_byte(self, 0x38); emite_byte(self, 0);
+  emite_byte(self, 0x74); emite_byte(self, 7);
+  emite_retorno(self, n);
+}
+
+#else // __x86_64__
+
+// não sabe gerar código para esta arquitetura
+
+jit_t *jit_cria(int quente) { return NULL; }
+void jit_destroi(jit_t *self) { }
+void jit_esvazia(jit_t *self) { }
+jit_bloco_t jit_bloco(jit_t *self, int end, int modo, int *pn, bool *pquente)
+{
+  *pquente = false;
+  return NULL;
+}
+int jit_executa(jit_t *self, jit_bloco_t bloco, void *cpu) { return 0; }
+void jit_aviso_escrita(jit_t *self, int end) { }
+bool jit_traduzido(jit_t *self, int end) { return false; }
+void jit_inicia_bloco(jit_t *self, int end, int modo) { }
+bool jit_termina_bloco(jit_t *self, int fim, int n) { return false; }
+void jit_abandona_bloco(jit_t *self) { }
+void jit_emite_atribui(jit_t *self, int campo, int valor) { }
+void jit_emite_soma(jit_t *self, int campo, int valor) { }
+void jit_emite_copia(jit_t *self, int campo_dest, int campo_orig) { }
+void jit_emite_troca(jit_t *self, int campo1, int campo2) { }
+void jit_emite_nega(jit_t *self, int campo) { }
+void jit_emite_chamada(jit_t *self, jit_funcao_t funcao, int arg) { }
+void jit_emite_sai_se_nao_zero(jit_t *self, int campo, int n) { }
+void jit_emite_sai_se_esvaziado(jit_t *self, int n) { }
+
+#endif // __x86_64__
+
+// vim: foldmethod=marker
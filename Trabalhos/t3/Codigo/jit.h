@@ -0,0 +1,109 @@
+// jit.h
+// tradução de blocos de instruções para código nativo x86-64
+// simulador de computador
+// so25b
+
+#ifndef JIT_H
+#define JIT_H
+
+// gerador de código para a CPU
+//
+// mantém um buffer de memória executável com blocos de instruções da CPU
+//   simulada traduzidos para código do processador hospedeiro, e uma tabela
+//   que associa o endereço físico (e o modo da CPU) do início de cada bloco
+//   ao seu código
+// o bloco traduzido é uma função que recebe a CPU e retorna o número de
+//   instruções executadas; ele termina antes do final se uma instrução
+//   colocar a CPU em erro
+//
+// o conteúdo das instruções fica por conta de quem usa (a CPU), que gera o
+//   código de cada instrução com as funções jit_emite_*, que sabem fazer
+//   poucas coisas: operar campos inteiros da CPU (identificados pela posição
+//   na estrutura) e chamar funções
+//
+// a tabela também conta quantas vezes cada endereço inicia um bloco que
+//   ainda não foi traduzido, para que só os blocos muito usados o sejam
+//
+// a memória avisa o jit das escritas (jit_aviso_escrita); se for escrito um
+//   endereço que faz parte de algum bloco traduzido, todos os blocos são
+//   descartados (é raro, acontece quando o SO carrega um programa ou página)
+//
+// o buffer de código nunca é alterável e executável no mesmo mapeamento
+//   (W^X): a memória é mapeada duas vezes, uma para gerar o código, outra
+//   para executá-lo
+//
+// só existe em x86-64 (linux e outros com a convenção de chamada SysV); em
+//   outras arquiteturas, jit_cria retorna NULL
+
+#include <stdbool.h>
+
+typedef struct jit_t jit_t;
+
+// o código de um bloco traduzido
+// recebe a CPU, retorna quantas instruções foram executadas
+typedef int (*jit_bloco_t)(void *cpu);
+
+// tipo das funções que o código gerado pode chamar
+typedef void (*jit_funcao_t)(void *cpu, int arg);
+
+// cria o gerador de código; 'quente' é o número de vezes que o início de um
+//   bloco deve ser executado antes de o bloco ser traduzido
+// retorna NULL se não for possível gerar código nesta máquina
+jit_t *jit_cria(int quente);
+
+// destrói o gerador de código
+void jit_destroi(jit_t *self);
+
+// retorna o bloco traduzido que começa no endereço físico 'end' para o modo
+//   'modo' da CPU, ou NULL se não tiver; em *pn coloca o número de instruções
+//   do bloco
+// se não tiver, conta mais uma execução do endereço, e coloca em *pquente
+//   se o bloco ficou quente e deve ser traduzido
+jit_bloco_t jit_bloco(jit_t *self, int end, int modo, int *pn, bool *pquente);
+
+// executa o bloco traduzido, retorna o número de instruções executadas
+int jit_executa(jit_t *self, jit_bloco_t bloco, void *cpu);
+
+// inicia a tradução de um bloco que começa no endereço físico 'end'
+void jit_inicia_bloco(jit_t *self, int end, int modo);
+
+// termina a tradução do bloco, que vai até o endereço físico 'fim' (exclusive)
+//   e tem 'n' instruções
+// retorna false se não foi possível (o bloco é descartado)
+bool jit_termina_bloco(jit_t *self, int fim, int n);
+
+// abandona a tradução do bloco
+void jit_abandona_bloco(jit_t *self);
+
+// geração de código para o bloco em tradução
+// os campos da CPU são identificados pela sua posição (offsetof) e são 'int'
+
+// campo = valor
+void jit_emite_atribui(jit_t *self, int campo, int valor);
+// campo += valor
+void jit_emite_soma(jit_t *self, int campo, int valor);
+// campo_dest = campo_orig
+void jit_emite_copia(jit_t *self, int campo_dest, int campo_orig);
+// troca os valores dos campos
+void jit_emite_troca(jit_t *self, int campo1, int campo2);
+// campo = -campo
+void jit_emite_nega(jit_t *self, int campo);
+// funcao(cpu, arg)
+void jit_emite_chamada(jit_t *self, jit_funcao_t funcao, int arg);
+// se campo != 0, o bloco termina retornando 'n'
+void jit_emite_sai_se_nao_zero(jit_t *self, int campo, int n);
+// se os blocos foram descartados durante a execução deste (por uma escrita
+//   em endereço com código traduzido), o bloco termina retornando 'n'
+void jit_emite_sai_se_esvaziado(jit_t *self, int n);
+
+// avisa que o endereço físico 'end' foi alterado
+void jit_aviso_escrita(jit_t *self, int end);
+
+// retorna true se o endereço físico 'end' pode fazer parte de algum bloco
+//   traduzido
+bool jit_traduzido(jit_t *self, int end);
+
+// descarta todos os blocos traduzidos
+void jit_esvazia(jit_t *self);
+
+#endif // JIT_H
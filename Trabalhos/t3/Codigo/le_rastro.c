@@ -0,0 +1,196 @@
+// le_rastro.c
+// traduz o rastro de eventos gravado pelo simulador (opção -t)
+// simulador de computador
+// so25b
+
+// sem opções, escreve um evento por linha, em texto; com -j, escreve no
+//   formato de rastro do Chrome (JSON), que pode ser aberto em
+//   chrome://tracing ou ui.perfetto.dev: cada CPU é uma linha do tempo, o
+//   tratamento de cada interrupção é um intervalo e os outros eventos são
+//   instantâneos; a unidade de tempo é a instrução (mostrada como µs)
+//
+// exemplo:
+//   ./main -l -t rastro && ./le_rastro -j -o rastro.json rastro
+
+#include "rastro.h"
+#include "irq.h"
+#include "cpu.h"
+#include "so.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+// o nome de uma chamada de sistema
+static char *nome_chamada(int id)
+{
+  switch (id) {
+    case SO_LE:          return "le";
+    case SO_ESCR:        return "escr";
+    case SO_CRIA_PROC:   return "cria_proc";
+    case SO_MATA_PROC:   return "mata_proc";
+    case SO_ESPERA_PROC: return "espera_proc";
+    case SO_AFINIDADE:   return "afinidade";
+    default:             return "desconhecida";
+  }
+}
+
+
+// ---------------------------------------------------------------------
+// TEXTO {{{1
+// ---------------------------------------------------------------------
+
+static void escreve_texto(rastro_t *rastro, FILE *arq)
+{
+  int n = rastro_n_registros(rastro);
+  fprintf(arq, "# %d eventos", n);
+  if (rastro_n_perdidos(rastro) > 0) {
+    fprintf(arq, " (os %ld anteriores foram perdidos)", rastro_n_perdidos(rastro));
+  }
+  fprintf(arq, "\n");
+  for (int i = 0; i < n; i++) {
+    rastro_registro_t *r = rastro_registro(rastro, i);
+    fprintf(arq, "%10d cpu%d pid%-3d %-10s", r->tempo, r->cpu, r->pid,
+            rastro_nome_evento(r->tipo));
+    switch (r->tipo) {
+      case RASTRO_IRQ_ENTRA:
+        fprintf(arq, " %s", irq_nome(r->arg1));
+        break;
+      case RASTRO_IRQ_SAI:
+        fprintf(arq, " %s, %s", irq_nome(r->arg1),
+                r->arg2 == 0 ? "executa processo" : "para a CPU");
+        break;
+      case RASTRO_CHAMADA:
+        fprintf(arq, " %d (%s)", r->arg1, nome_chamada(r->arg1));
+        break;
+      case RASTRO_FALTA:
+        fprintf(arq, " página %d", r->arg1);
+        break;
+      case RASTRO_SUBSTITUI:
+        fprintf(arq, " página %d, quadro %d", r->arg1, r->arg2);
+        break;
+      case RASTRO_DESPACHO:
+        fprintf(arq, " (antes: pid%d)", r->arg1);
+        break;
+    }
+    fprintf(arq, "\n");
+  }
+}
+
+
+// ---------------------------------------------------------------------
+// CHROME {{{1
+// ---------------------------------------------------------------------
+
+static void escreve_json(rastro_t *rastro, FILE *arq)
+{
+  // se cada CPU está dentro do SO (os intervalos que começaram antes do
+  //   início do rastro não têm começo, e seu fim é ignorado)
+  bool no_so[CPU_MAX] = { false };
+  bool usada[CPU_MAX] = { false };
+  int n = rastro_n_registros(rastro);
+  fprintf(arq, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  bool primeiro = true;
+  for (int i = 0; i < n; i++) {
+    rastro_registro_t *r = rastro_registro(rastro, i);
+    if (r->cpu < 0 || r->cpu >= CPU_MAX) continue;
+    usada[r->cpu] = true;
+    char *fase = "i";
+    char *nome = rastro_nome_evento(r->tipo);
+    switch (r->tipo) {
+      case RASTRO_IRQ_ENTRA:
+        fase = "B";
+        nome = irq_nome(r->arg1);
+        no_so[r->cpu] = true;
+        break;
+      case RASTRO_IRQ_SAI:
+        if (!no_so[r->cpu]) continue;
+        fase = "E";
+        nome = irq_nome(r->arg1);
+        no_so[r->cpu] = false;
+        break;
+      case RASTRO_CHAMADA:
+        nome = nome_chamada(r->arg1);
+        break;
+    }
+    fprintf(arq, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%s\",\"ts\":%d,"
+                 "\"pid\":1,\"tid\":%d", primeiro ? "" : ",\n", nome,
+            rastro_nome_evento(r->tipo), fase, r->tempo, r->cpu);
+    primeiro = false;
+    if (fase[0] == 'i') fprintf(arq, ",\"s\":\"t\"");
+    fprintf(arq, ",\"args\":{\"pid\":%d,\"arg1\":%d,\"arg2\":%d}}", r->pid, r->arg1, r->arg2);
+  }
+  // fecha os intervalos ainda abertos no fim do rastro, e dá nome às CPUs
+  int fim = n > 0 ? rastro_registro(rastro, n - 1)->tempo : 0;
+  for (int c = 0; c < CPU_MAX; c++) {
+    if (!usada[c]) continue;
+    if (no_so[c]) {
+      fprintf(arq, ",\n{\"ph\":\"E\",\"ts\":%d,\"pid\":1,\"tid\":%d}", fim, c);
+    }
+    fprintf(arq, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                 "\"args\":{\"name\":\"CPU %d\"}}", primeiro ? "" : ",\n", c, c);
+    primeiro = false;
+  }
+  fprintf(arq, "\n]}\n");
+}
+
+
+// ---------------------------------------------------------------------
+// MAIN {{{1
+// ---------------------------------------------------------------------
+
+static void uso(char *nome)
+{
+  fprintf(stderr, "uso: %s [-j] [-o saida] rastro\n", nome);
+  fprintf(stderr, "  traduz o rastro gravado com a opção -t do simulador\n");
+  fprintf(stderr, "  -j        no formato de rastro do Chrome (JSON), em vez de texto\n");
+  fprintf(stderr, "  -o        arquivo de saída (padrão: a saída padrão)\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  bool json = false;
+  char *saida = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "jo:")) != -1) {
+    switch (opt) {
+      case 'j':
+        json = true;
+        break;
+      case 'o':
+        saida = optarg;
+        break;
+      default:
+        uso(argv[0]);
+    }
+  }
+  if (optind != argc - 1) uso(argv[0]);
+
+  rastro_t *rastro = rastro_le(argv[optind]);
+  if (rastro == NULL) {
+    fprintf(stderr, "Erro na leitura do rastro '%s'\n", argv[optind]);
+    exit(1);
+  }
+  FILE *arq = stdout;
+  if (saida != NULL) {
+    arq = fopen(saida, "w");
+    if (arq == NULL) {
+      fprintf(stderr, "Erro na abertura de '%s'\n", saida);
+      exit(1);
+    }
+  }
+
+  if (json) {
+    escreve_json(rastro, arq);
+  } else {
+    escreve_texto(rastro, arq);
+  }
+
+  if (arq != stdout) fclose(arq);
+  rastro_destroi(rastro);
+  return 0;
+}
+
+// vim: foldmethod=marker
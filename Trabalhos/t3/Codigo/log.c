@@ -0,0 +1,68 @@
+// log.c
+// mensagens de log do SO, por nível e subsistema
+// simulador de computador
+// so25b
+
+#include "log.h"
+
+#include <string.h>
+
+int log_nivel[N_LOG_SUB] = {
+  [0 ... N_LOG_SUB - 1] = LOG_DEPURA
+};
+
+static char *nomes_nivel[] = { "erro", "aviso", "info", "depura" };
+static char *nomes_sub[N_LOG_SUB] = {
+  [LOG_SO]   = "so",
+  [LOG_ESC]  = "esc",
+  [LOG_MEM]  = "mem",
+  [LOG_PROC] = "proc",
+  [LOG_ES]   = "es",
+};
+
+// o nível com nome 'nome' (os 'tam' primeiros caracteres), ou -2
+static int nivel_do_nome(char *nome, int tam)
+{
+  if (tam == 4 && strncmp(nome, "nada", 4) == 0) return LOG_NADA;
+  for (int n = LOG_ERRO; n <= LOG_DEPURA; n++) {
+    if (strlen(nomes_nivel[n]) == tam && strncmp(nome, nomes_nivel[n], tam) == 0) {
+      return n;
+    }
+  }
+  return -2;
+}
+
+static int sub_do_nome(char *nome, int tam)
+{
+  for (int s = 0; s < N_LOG_SUB; s++) {
+    if (strlen(nomes_sub[s]) == tam && strncmp(nome, nomes_sub[s], tam) == 0) {
+      return s;
+    }
+  }
+  return -1;
+}
+
+bool log_define_niveis(char *spec)
+{
+  int novo[N_LOG_SUB];
+  memcpy(novo, log_nivel, sizeof(novo));
+  char *item = spec;
+  while (*item != '\0') {
+    int tam = strcspn(item, ",");
+    char *igual = memchr(item, '=', tam);
+    if (igual == NULL) {
+      int nivel = nivel_do_nome(item, tam);
+      if (nivel == -2) return false;
+      for (int s = 0; s < N_LOG_SUB; s++) novo[s] = nivel;
+    } else {
+      int sub = sub_do_nome(item, igual - item);
+      int nivel = nivel_do_nome(igual + 1, tam - (igual + 1 - item));
+      if (sub < 0 || nivel == -2) return false;
+      novo[sub] = nivel;
+    }
+    item += tam;
+    if (*item == ',') item++;
+  }
+  memcpy(log_nivel, novo, sizeof(novo));
+  return true;
+}
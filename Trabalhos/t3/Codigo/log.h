@@ -0,0 +1,78 @@
+// log.h
+// mensagens de log do SO, por nível e subsistema
+// simulador de computador
+// so25b
+
+#ifndef LOG_H
+#define LOG_H
+
+// as mensagens do SO vão para a console (e o arquivo de log) com
+//   console_printf, mas passam antes por um filtro de dois níveis:
+// - na compilação: as mensagens de nível acima de LOG_NIVEL_MAX (definido
+//   no Makefile, variável LOG) viram código morto e são retiradas pelo
+//   compilador; com LOG=erro, o SO não gera log nenhum nos caminhos de
+//   execução normais
+// - na execução: cada subsistema tem um nível (ver log_define_niveis), e
+//   as mensagens acima dele não são impressas
+// em nenhum dos casos os argumentos de uma mensagem filtrada são avaliados
+//   (não devem ter efeito colateral)
+//
+// os níveis são, do mais para o menos importante:
+//   erro   algo que não deveria acontecer (SO inconsistente, programa
+//          inválido)
+//   aviso  situação anormal mas prevista (limite de processos, memória
+//          cheia)
+//   info   eventos de mais alto nível (criação e morte de processos,
+//          carga de programas)
+//   depura o passo a passo do tratamento de cada interrupção
+
+#include "console.h"
+#include <stdbool.h>
+
+#define LOG_NADA   -1
+#define LOG_ERRO    0
+#define LOG_AVISO   1
+#define LOG_INFO    2
+#define LOG_DEPURA  3
+
+#ifndef LOG_NIVEL_MAX
+#define LOG_NIVEL_MAX LOG_DEPURA
+#endif
+
+// os subsistemas
+typedef enum {
+  LOG_SO,    // interrupções, relógio, inicialização
+  LOG_ESC,   // escalonamento e despacho
+  LOG_MEM,   // faltas de página, quadros, swap, carga de programas
+  LOG_PROC,  // criação, morte e espera de processos
+  LOG_ES,    // chamadas de leitura e escrita, bloqueio em dispositivos
+  N_LOG_SUB
+} log_sub_t;
+
+// o nível de execução de cada subsistema
+// vale para todas as simulações do programa, e só deve ser alterado antes
+//   de elas começarem
+extern int log_nivel[N_LOG_SUB];
+
+#define log_msg(sub, nivel, ...)                                      \
+  do {                                                                \
+    if ((nivel) <= LOG_NIVEL_MAX && (nivel) <= log_nivel[sub]) {      \
+      console_printf(__VA_ARGS__);                                    \
+    }                                                                 \
+  } while (0)
+
+#define log_erro(sub, ...)   log_msg(sub, LOG_ERRO, __VA_ARGS__)
+#define log_aviso(sub, ...)  log_msg(sub, LOG_AVISO, __VA_ARGS__)
+#define log_info(sub, ...)   log_msg(sub, LOG_INFO, __VA_ARGS__)
+#define log_depura(sub, ...) log_msg(sub, LOG_DEPURA, __VA_ARGS__)
+
+// altera os níveis de execução de acordo com 'spec', que é um nível (para
+//   todos os subsistemas) ou uma lista de subsistema=nível separados por
+//   vírgula, aplicados em ordem
+// os nomes dos níveis são nada, erro, aviso, info e depura; os dos
+//   subsistemas são so, esc, mem, proc e es
+// ex.: "aviso", "erro,mem=depura"
+// retorna false (sem alterar nada) se 'spec' for inválida
+bool log_define_niveis(char *spec);
+
+#endif // LOG_H
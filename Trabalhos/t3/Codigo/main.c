@@ -3,155 +3,139 @@
 // simulador de computador
 // so25b
 
-#include "controle.h"
-#include "programa.h"
-#include "memoria.h"
-#include "mmu.h"
+#include "simulador.h"
 #include "cpu.h"
-#include "relogio.h"
-#include "console.h"
-#include "terminal.h"
-#include "es.h"
-#include "dispositivos.h"
-#include "so.h"
+#include "log.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
 
-// constantes
-#define MEM_TAM 10000        // tamanho da memória principal
-
-// estrutura com os componentes do computador simulado
-typedef struct {
-  mem_t *mem;
-  mem_t *disco;
-  mmu_t *mmu;
-  cpu_t *cpu;
-  relogio_t *relogio;
-  console_t *console;
-  es_t *es;
-  controle_t *controle;
-} hardware_t;
-
-
-// registra no controlador de es os 4 dispositivos do terminal 'id_term'
-//   da console, com valores a partir de n_disp
-static void registra_terminal(hardware_t *hw, int n_disp, char id_term)
+static void uso(char *nome)
 {
-  terminal_t *terminal;
-  terminal = console_terminal(hw->console, id_term);
-  // por exemplo, depois de registrado, quando o controlador de ES receber um
-  //   pedido de leitura do dispositivo 'n_disp+TERM_TECLADO' (que é 4 para
-  //   o terminal 'B'), vai chamar a função 'terminal_leitura', passando como
-  //   argumentos o valor de 'terminal' (que é o terminal 'B' obtido acima) e
-  //   o valor TERM_TECLADO
-  es_registra_dispositivo(hw->es, n_disp + TERM_TECLADO,    terminal, TERM_TECLADO,    terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, n_disp + TERM_TECLADO_OK, terminal, TERM_TECLADO_OK, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, n_disp + TERM_TELA,       terminal, TERM_TELA,       NULL, terminal_escrita);
-  es_registra_dispositivo(hw->es, n_disp + TERM_TELA_OK,    terminal, TERM_TELA_OK,    terminal_leitura, NULL);
+  fprintf(stderr, "uso: %s [-l] [-a arq] [-b arq] [-c arq] [-d arq] [-m limite] [-n cpus]\n", nome);
+  fprintf(stderr, "       %s [opções] -p nome=valor ...\n", nome);
+  fprintf(stderr, "       %s [-l] [-a arq] ... -g registro\n", nome);
+  fprintf(stderr, "       %s -r registro\n", nome);
+  fprintf(stderr, "       %s [opções] [-k imagem] [-K imagem]\n", nome);
+  fprintf(stderr, "       %s [opções] -t rastro\n", nome);
+  fprintf(stderr, "       %s [opções] -e metricas.json|metricas.csv\n", nome);
+  fprintf(stderr, "  -l        execução em lote: sem tela, executa até todos os processos\n");
+  fprintf(stderr, "            morrerem e imprime um relatório\n");
+  fprintf(stderr, "  -a..-d    arquivo com a entrada do terminal A..D (com -l)\n");
+  fprintf(stderr, "  -m        termina a simulação depois de 'limite' instruções\n");
+  fprintf(stderr, "  -n        número de CPUs (1 a %d), cada uma executada por uma thread\n", CPU_MAX);
+  fprintf(stderr, "  -p        altera um parâmetro da simulação, no formato nome=valor;\n");
+  fprintf(stderr, "            os nomes são memoria, cpus, limite, rajada (instruções\n");
+  fprintf(stderr, "            entre atualizações da console, 1 é passo a passo),\n");
+  fprintf(stderr, "            intervalo, quantum,\n");
+  fprintf(stderr, "            escalonador (rr ou prioridade), substituicao (fifo ou sc),\n");
+  fprintf(stderr, "            fila (de saída dos terminais, 0 é sem fila, o padrão),\n");
+  fprintf(stderr, "            fila_entrada (caracteres digitados e não lidos, 0 é o\n");
+  fprintf(stderr, "            que cabe na linha), historico\n");
+  fprintf(stderr, "            (linhas da console guardadas para PgUp/PgDn) e init\n");
+  fprintf(stderr, "            (programa do primeiro processo)\n");
+  fprintf(stderr, "  -g        grava no arquivo 'registro' as entradas da execução (o que\n");
+  fprintf(stderr, "            é digitado, os arquivos dos terminais, o tempo real)\n");
+  fprintf(stderr, "  -r        reproduz, em lote, a execução gravada em 'registro'\n");
+  fprintf(stderr, "  -k        no final, salva a imagem da máquina (memória, disco, CPU,\n");
+  fprintf(stderr, "            relógio, terminais e SO) no arquivo 'imagem'\n");
+  fprintf(stderr, "  -K        começa a simulação do estado salvo no arquivo 'imagem'\n");
+  fprintf(stderr, "  -t        no final, grava no arquivo 'rastro' os últimos eventos do SO\n");
+  fprintf(stderr, "            (interrupções, chamadas, faltas, substituições, despachos),\n");
+  fprintf(stderr, "            para ser lido com o le_rastro\n");
+  fprintf(stderr, "  -e        no final, escreve as métricas do SO no arquivo, em JSON ou,\n");
+  fprintf(stderr, "            se o nome terminar em .csv, em CSV\n");
+  fprintf(stderr, "  -v        níveis do log do SO: um nível (nada, erro, aviso, info,\n");
+  fprintf(stderr, "            depura) ou subsistema=nível, separados por vírgula; os\n");
+  fprintf(stderr, "            subsistemas são so, esc, mem, proc e es (padrão: depura)\n");
+  fprintf(stderr, "  (-g, -r, -k e -K só com uma CPU)\n");
+  exit(1);
 }
 
-// inicializa a memória ROM com o conteúdo do programa em bios.maq
-static void inicializa_rom(mem_t *mem)
+static void le_opcoes(int argc, char *argv[], simulador_config_t *op)
 {
-  // programa para executar na nossa CPU
-  programa_t *prog = prog_cria("bios.maq");
-  if (prog == NULL) {
-    fprintf(stderr, "Erro na leitura da ROM ('bios.maq')\n");
-    exit(1);
-  }
-
-  int end_ini = prog_end_carga(prog);
-  if (end_ini != CPU_END_RESET) {
-    fprintf(stderr, "ROM não inicia no endereço %d (%d)\n", CPU_END_RESET, end_ini);
-    exit(1);
+  simulador_config_padrao(op);
+  int opt;
+  while ((opt = getopt(argc, argv, "la:b:c:d:m:n:p:g:r:k:K:t:e:v:")) != -1) {
+    switch (opt) {
+      case 'l':
+        op->lote = true;
+        break;
+      case 'a': case 'b': case 'c': case 'd':
+        op->entrada[opt - 'a'] = optarg;
+        break;
+      case 'm':
+        op->limite = atoi(optarg);
+        if (op->limite < 0) uso(argv[0]);
+        break;
+      case 'n':
+        op->n_cpus = atoi(optarg);
+        if (op->n_cpus < 1 || op->n_cpus > CPU_MAX) uso(argv[0]);
+        break;
+      case 'p': {
+        char *valor = strchr(optarg, '=');
+        if (valor == NULL) uso(argv[0]);
+        *valor++ = '\0';
+        if (!simulador_config_define(op, optarg, valor)) uso(argv[0]);
+        break;
+      }
+      case 'g':
+        op->registro = optarg;
+        op->modo_registro = registro_grava;
+        break;
+      case 'r':
+        op->registro = optarg;
+        op->modo_registro = registro_reproduz;
+        break;
+      case 'k':
+        op->salva_imagem = optarg;
+        break;
+      case 'K':
+        op->recupera_imagem = optarg;
+        break;
+      case 't':
+        op->rastro = optarg;
+        break;
+      case 'e':
+        op->metricas = optarg;
+        break;
+      case 'v':
+        if (!log_define_niveis(optarg)) uso(argv[0]);
+        break;
+      default:
+        uso(argv[0]);
+    }
   }
-  int end_fim = end_ini + prog_tamanho(prog);
-  if (end_fim > CPU_END_FIM_ROM) {
-    fprintf(stderr, "conteúdo da ROM muito grande (%d>%d)\n", end_fim, CPU_END_FIM_ROM);
-    exit(1);
+  if (optind < argc) uso(argv[0]);
+  if (op->registro != NULL && op->n_cpus != 1) uso(argv[0]);
+  if ((op->salva_imagem != NULL || op->recupera_imagem != NULL) && op->n_cpus != 1) {
+    uso(argv[0]);
   }
-
-  for (int end = end_ini; end < end_fim; end++) {
-    if (mem_escreve(mem, end, prog_dado(prog, end)) != ERR_OK) {
-      printf("Erro na carga da memória ROM, endereco %d\n", end);
-      exit(1);
+  if (op->registro != NULL && op->modo_registro == registro_reproduz) {
+    // as entradas dos terminais vêm do registro
+    for (int t = 0; t < 4; t++) {
+      if (op->entrada[t] != NULL) uso(argv[0]);
     }
+    op->lote = true;
   }
-  prog_destroi(prog);
-}
-
-static void inicializa_disco(mem_t *disco) {
-  for(int i = 0; i < mem_tam(disco); i++) mem_escreve(disco, i, 0);
 }
 
-static void cria_hardware(hardware_t *hw)
+int main(int argc, char *argv[])
 {
-  // cria a memória
-  hw->mem = mem_cria(MEM_TAM);
-  // cria o disco
-  hw->disco = mem_cria(MEM_TAM);
-  inicializa_disco(hw->disco);
-  // inicializa a ROM
-  inicializa_rom(hw->mem);
-  // cria a MMU
-  hw->mmu = mmu_cria(hw->mem);
+  simulador_config_t op;
+  le_opcoes(argc, argv, &op);
 
-  // cria dispositivos de E/S
-  hw->console = console_cria();
-  hw->relogio = relogio_cria();
+  // cria o hardware e o sistema operacional
+  simulador_t *sim = simulador_cria(&op);
+  if (sim == NULL) exit(1);
 
-  // cria o controlador de E/S e registra os dispositivos
-  //   por exemplo, o dispositivo 8 do controlador de E/S (e da CPU) será o
-  //   dispositivo 0 do relógio (que é o contador de instruções)
-  hw->es = es_cria();
-  // registra os 4 dispositivos de cada terminal
-  registra_terminal(hw, D_TERM_A, 'A');
-  registra_terminal(hw, D_TERM_B, 'B');
-  registra_terminal(hw, D_TERM_C, 'C');
-  registra_terminal(hw, D_TERM_D, 'D');
-  // registra os 4 dispositivos do relógio
-  es_registra_dispositivo(hw->es, D_RELOGIO_INSTRUCOES, hw->relogio, 0, relogio_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_RELOGIO_REAL      , hw->relogio, 1, relogio_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_RELOGIO_TIMER     , hw->relogio, 2, relogio_leitura, relogio_escrita);
-  es_registra_dispositivo(hw->es, D_RELOGIO_INTERRUPCAO,hw->relogio, 3, relogio_leitura, relogio_escrita);
-
-  // cria a unidade de execução e inicializa com a MMU e o controlador de E/S
-  hw->cpu = cpu_cria(hw->mmu, hw->es);
-
-  // cria o controlador da CPU e inicializa com a unidade de execução, a console e
-  //   o relógio
-  hw->controle = controle_cria(hw->cpu, hw->console, hw->relogio);
-}
-
-static void destroi_hardware(hardware_t *hw)
-{
-  controle_destroi(hw->controle);
-  cpu_destroi(hw->cpu);
-  es_destroi(hw->es);
-  relogio_destroi(hw->relogio);
-  console_destroi(hw->console);
-  mmu_destroi(hw->mmu);
-  mem_destroi(hw->mem);
-}
-
-int main()
-{
-  hardware_t hw;
-  so_t *so;
-
-  // cria o hardware
-  cria_hardware(&hw);
-  // cria o sistema operacional
-  so = so_cria(hw.cpu, hw.mem, hw.disco, hw.mmu, hw.es, hw.console, hw.relogio);
-
-  console_printf("indo pro laco  ");
-
-  // executa o laço principal do controlador
-  controle_laco(hw.controle);
+  bool ok = simulador_executa(sim);
+  if (op.lote) simulador_relatorio(sim, stdout);
 
   // destroi tudo
-  so_destroi(so);
-  destroi_hardware(&hw);
+  simulador_destroi(sim);
+  return ok ? 0 : 1;
 }
-
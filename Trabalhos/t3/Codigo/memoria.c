@@ -4,6 +4,7 @@
 // so25b
 
 #include "memoria.h"
+#include "imagem.h"
 
 #include <stdlib.h>
 #include <assert.h>
@@ -12,6 +13,12 @@
 struct mem_t {
   int tam;
   int *conteudo;
+  // quem deve ser avisado das escritas
+  int n_avisos;
+  struct {
+    mem_f_aviso_t func;
+    void *arg;
+  } avisos[MEM_MAX_AVISOS];
 };
 
 
@@ -27,6 +34,7 @@ mem_t *mem_cria(int tam)
   assert(self->conteudo != NULL);
 
   self->tam = tam;
+  self->n_avisos = 0;
 
   return self;
 }
@@ -46,6 +54,11 @@ int mem_tam(mem_t *self)
   return self->tam;
 }
 
+const int *mem_conteudo(mem_t *self)
+{
+  return self->conteudo;
+}
+
 // função auxiliar, verifica se endereço é válido
 static err_t verifica_permissao(mem_t *self, int endereco)
 {
@@ -69,6 +82,41 @@ err_t mem_escreve(mem_t *self, int endereco, int valor)
   err_t err = verifica_permissao(self, endereco);
   if (err == ERR_OK) {
     self->conteudo[endereco] = valor;
+    for (int i = 0; i < self->n_avisos; i++) {
+      self->avisos[i].func(self->avisos[i].arg, endereco);
+    }
   }
   return err;
 }
+
+bool mem_inclui_aviso_escrita(mem_t *self, mem_f_aviso_t func, void *arg)
+{
+  if (self->n_avisos >= MEM_MAX_AVISOS) return false;
+  self->avisos[self->n_avisos].func = func;
+  self->avisos[self->n_avisos].arg = arg;
+  self->n_avisos++;
+  return true;
+}
+
+void mem_retira_aviso_escrita(mem_t *self, void *arg)
+{
+  for (int i = 0; i < self->n_avisos; i++) {
+    if (self->avisos[i].arg == arg) {
+      self->n_avisos--;
+      for (int j = i; j < self->n_avisos; j++) {
+        self->avisos[j] = self->avisos[j + 1];
+      }
+      return;
+    }
+  }
+}
+
+bool mem_salva(mem_t *self, FILE *arq)
+{
+  return imagem_escreve_vetor(arq, self->tam, self->conteudo);
+}
+
+bool mem_recupera(mem_t *self, FILE *arq)
+{
+  return imagem_le_vetor(arq, self->tam, self->conteudo);
+}
@@ -13,16 +13,25 @@
 //
 // O único erro possível no acesso é uma tentativa de acesso a uma posição
 //   inexistente
+//
+// Quem mantém cópias do conteúdo da memória (como a CPU, com sua cache de
+//   instruções) pode pedir para ser avisado de cada escrita.
 
 #ifndef MEMORIA_H
 #define MEMORIA_H
 
 #include "err.h"
+#include <stdio.h>
+#include <stdbool.h>
+
 #define DISCO_TAM 10000000 // tamanho da memória secundária (disco)
 
 // tipo opaco que representa a memória
 typedef struct mem_t mem_t;
 
+// tipo da função chamada a cada escrita na memória, com o endereço alterado
+typedef void (*mem_f_aviso_t)(void *arg, int endereco);
+
 // cria uma região de memória com capacidade para 'tam' valores (inteiros)
 // retorna um ponteiro para um descritor, que deverá ser usado em todas
 //   as operações sobre essa memória
@@ -43,4 +52,31 @@ err_t mem_le(mem_t *self, int endereco, int *pvalor);
 // retorna erro ERR_END_INV se endereço inválido
 err_t mem_escreve(mem_t *self, int endereco, int valor);
 
+// retorna o conteúdo da memória, para leitura direta por quem precisa de
+//   velocidade (a CPU, na busca de instruções)
+// o valor do endereço 'e' está na posição 'e' do vetor; as escritas devem
+//   ser feitas com mem_escreve, para que sejam avisadas
+const int *mem_conteudo(mem_t *self);
+
+// número máximo de avisos de escrita em uma memória (uma memória pode ser
+//   compartilhada por várias CPUs, cada uma com sua cache)
+#define MEM_MAX_AVISOS 8
+
+// inclui uma função a ser chamada após cada escrita bem sucedida na memória,
+//   e o argumento a passar para ela
+// as funções são chamadas na ordem em que foram incluídas
+// retorna false se já tem MEM_MAX_AVISOS funções
+bool mem_inclui_aviso_escrita(mem_t *self, mem_f_aviso_t func, void *arg);
+
+// retira o aviso incluído com o argumento 'arg'
+void mem_retira_aviso_escrita(mem_t *self, void *arg);
+
+// salva o conteúdo da memória na imagem 'arq' (ver imagem.h)
+bool mem_salva(mem_t *self, FILE *arq);
+
+// recupera o conteúdo da memória da imagem 'arq'
+// a memória deve ter o mesmo tamanho da que foi salva
+// quem tem cópias do conteúdo não é avisado, deve descartá-las
+bool mem_recupera(mem_t *self, FILE *arq);
+
 #endif // MEMORIA_H
@@ -2,7 +2,8 @@
 #include <stdbool.h>
 
 #include "memoria_quadros.h"
-#include "console.h"
+#include "log.h"
+#include "imagem.h"
 
 typedef struct quadro {
     bool livre; 
@@ -55,6 +56,12 @@ int mem_quadros_tem_livre(mem_quadros_t *self) {
     return -1;
 }
 
+void mem_quadros_reserva(mem_quadros_t *self, int indice) {
+    self->quadros[indice].livre = 0;
+    self->quadros[indice].dono = -1; // restrito
+    self->quadros[indice].pagina = 0;
+}
+
 int mem_quadros_adiciona_fila(mem_quadros_t *self, int indice) {
     if (self->f_tam >= self->cap) return -1;
     self->f[(self->f_ini + self->f_tam) % self->cap].indice = indice;
@@ -130,11 +137,64 @@ int mem_quadros_pega_tam(mem_quadros_t *self) {
     return self->f_tam;
 }
 
+void mem_quadros_conta(mem_quadros_t *self, int *reservados, int *ocupados) {
+    *reservados = 0;
+    *ocupados = 0;
+    for (int i = 0; i < self->cap; i++) {
+        if (self->quadros[i].livre) continue;
+        if (self->quadros[i].dono == -1) {
+            (*reservados)++;
+        } else {
+            (*ocupados)++;
+        }
+    }
+}
+
 void mem_quadros_lista_fila(mem_quadros_t *self) {
     for (int i = self->f_ini; i < self->f_ini + self->f_tam; i++) {
         quadro q;
         q.dono = self->quadros[self->f[i % self->cap].indice].dono;
         q.pagina = self->quadros[self->f[i % self->cap].indice].pagina;
-        console_printf("DONO: %d, PAGINA: %d", q.dono, q.pagina);
+        log_depura(LOG_MEM, "DONO: %d, PAGINA: %d", q.dono, q.pagina);
+    }
+}
+
+bool mem_quadros_salva(mem_quadros_t *self, FILE *arq) {
+    if (!imagem_escreve_int(arq, self->cap)) return false;
+    for (int i = 0; i < self->cap; i++) {
+        quadro *q = &self->quadros[i];
+        if (!imagem_escreve_int(arq, q->livre) || !imagem_escreve_int(arq, q->dono)
+            || !imagem_escreve_int(arq, q->pagina)) {
+            return false;
+        }
+    }
+    // a fila é salva a partir do início, e recuperada começando em 0
+    if (!imagem_escreve_int(arq, self->f_tam)) return false;
+    for (int i = 0; i < self->f_tam; i++) {
+        if (!imagem_escreve_int(arq, self->f[(self->f_ini + i) % self->cap].indice)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool mem_quadros_recupera(mem_quadros_t *self, FILE *arq) {
+    if (!imagem_confere_int(arq, self->cap)) return false;
+    for (int i = 0; i < self->cap; i++) {
+        quadro *q = &self->quadros[i];
+        int livre;
+        if (!imagem_le_int(arq, &livre) || !imagem_le_int(arq, &q->dono)
+            || !imagem_le_int(arq, &q->pagina)) {
+            return false;
+        }
+        q->livre = livre;
+    }
+    int f_tam;
+    if (!imagem_le_int(arq, &f_tam) || f_tam < 0 || f_tam > self->cap) return false;
+    self->f_ini = 0;
+    self->f_tam = f_tam;
+    for (int i = 0; i < f_tam; i++) {
+        if (!imagem_le_int(arq, &self->f[i].indice)) return false;
     }
+    return true;
 }
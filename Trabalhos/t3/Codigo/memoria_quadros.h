@@ -1,6 +1,9 @@
 #ifndef MEMORIA_QUADROS_H
 #define MEMORIA_QUADROS_H
 
+#include <stdbool.h>
+#include <stdio.h>
+
 typedef struct mem_quadros_t mem_quadros_t;
 
 typedef enum {
@@ -11,12 +14,19 @@ typedef enum {
 mem_quadros_t *mem_quadros_cria(int cap, int quadro_livre, mem_q_tipo_t tipo);
 void mem_quadros_manda_fim_fila(mem_quadros_t *self);
 int mem_quadros_tem_livre(mem_quadros_t *self);
+// marca o quadro como restrito: fica ocupado e nunca é escolhido para substituição
+void mem_quadros_reserva(mem_quadros_t *self, int indice);
 void mem_quadros_muda_estado(mem_quadros_t *self, int indice, bool livre, int dono, int pagina);
 int mem_quadros_libera_quadro_fifo(mem_quadros_t *self);
 int mem_quadros_pega_dono(mem_quadros_t *self, int indice);
 int mem_quadros_pega_pagina(mem_quadros_t *self, int indice);
 void mem_quadros_remove_processo(mem_quadros_t *self, int pid);
 int mem_quadros_pega_tam(mem_quadros_t *self);
+// conta os quadros reservados e os ocupados por páginas de processos
+void mem_quadros_conta(mem_quadros_t *self, int *reservados, int *ocupados);
 void mem_quadros_lista_fila(mem_quadros_t *self);
+// salva e recupera os quadros e a fila de substituição na imagem (ver imagem.h)
+bool mem_quadros_salva(mem_quadros_t *self, FILE *arq);
+bool mem_quadros_recupera(mem_quadros_t *self, FILE *arq);
 
 #endif
@@ -1,10 +1,13 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
 #include "metrica.h"
+#include "imagem.h"
 
 metricas *cria_metrica() {
-    metricas *m = malloc(sizeof(metricas));
+    metricas *m = calloc(1, sizeof(metricas));
     if (m == NULL) {
         return NULL;
     }
@@ -12,47 +15,109 @@ metricas *cria_metrica() {
     return m;
 }
 
-void mostra_metricas(metricas *m) {
-    console_printf("Métricas do Sistema Operacional:");
-    console_printf("processos criados: %d\n", m->n_processos_criados);
-    console_printf("tempo total da execucao: %d\n", m->tempo_total_execucao);
-    console_printf("tempo total da ocioso: %d\n", m->tempo_total_ocioso);
-    console_printf("interrupcoes de reset: %d\n", m->n_interrupcoes_tipo[IRQ_RESET]);
-    console_printf("interrupcoes de CPU: %d\n", m->n_interrupcoes_tipo[IRQ_ERR_CPU]);
-    console_printf("interrupcoes de Relogio: %d\n", m->n_interrupcoes_tipo[IRQ_RELOGIO]);
-    console_printf("interrupcoes de Sistema: %d\n", m->n_interrupcoes_tipo[IRQ_SISTEMA]);
-    console_printf("interrupcoes de teclado: %d\n", m->n_interrupcoes_tipo[IRQ_TECLADO]);
-    console_printf("interrupcoes de tela: %d\n", m->n_interrupcoes_tipo[IRQ_TELA]);
-    console_printf("interrupcoes desconhecidas: %d\n", m->n_interrupcoes_tipo[6]);
-    console_printf("numero de preempcoes: %d\n", m->n_preempcao);
+// função que recebe cada linha do relatório de métricas
+typedef void (*escreve_linha_t)(void *arg, char *linha);
+
+// formata uma linha do relatório e passa para 'escreve'
+static void linha(escreve_linha_t escreve, void *arg, char *formato, ...) {
+    char txt[200];
+    va_list ap;
+    va_start(ap, formato);
+    vsnprintf(txt, sizeof(txt), formato, ap);
+    va_end(ap);
+    escreve(arg, txt);
+}
+
+// se o processo de índice i (pid i+1) chegou a ser criado
+static bool existiu(metricas *m, int i) {
+    return m->n_entradas_estado[i][PRONTO] + m->n_entradas_estado[i][EXECUTANDO]
+         + m->n_entradas_estado[i][BLOQUEADO] > 0 || m->tempo_retorno[i] > 0;
+}
+
+// gera o relatório de métricas, uma linha por vez
+static void escreve_metricas(metricas *m, escreve_linha_t escreve, void *arg) {
+    linha(escreve, arg, "Métricas do Sistema Operacional:");
+    linha(escreve, arg, "processos criados: %d", m->n_processos_criados);
+    linha(escreve, arg, "tempo total da execucao: %d", m->tempo_total_execucao);
+    linha(escreve, arg, "tempo total da ocioso: %d", m->tempo_total_ocioso);
+    linha(escreve, arg, "tempo com a CPU parada: %d", m->tempo_cpu_parada);
+    linha(escreve, arg, "interrupcoes de reset: %d", m->n_interrupcoes_tipo[IRQ_RESET]);
+    linha(escreve, arg, "interrupcoes de CPU: %d", m->n_interrupcoes_tipo[IRQ_ERR_CPU]);
+    linha(escreve, arg, "interrupcoes de Relogio: %d", m->n_interrupcoes_tipo[IRQ_RELOGIO]);
+    linha(escreve, arg, "interrupcoes de Sistema: %d", m->n_interrupcoes_tipo[IRQ_SISTEMA]);
+    linha(escreve, arg, "interrupcoes de teclado: %d", m->n_interrupcoes_tipo[IRQ_TECLADO]);
+    linha(escreve, arg, "interrupcoes de tela: %d", m->n_interrupcoes_tipo[IRQ_TELA]);
+    linha(escreve, arg, "interrupcoes de disco: %d", m->n_interrupcoes_tipo[IRQ_DISCO]);
+    linha(escreve, arg, "interrupcoes desconhecidas: %d", m->n_interrupcoes_tipo[N_IRQ]);
+    linha(escreve, arg, "numero de preempcoes: %d", m->n_preempcao);
+    linha(escreve, arg, "faltas de pagina: %d", m->n_faltas_pagina);
+    linha(escreve, arg, "bloqueios na leitura: %d", m->n_bloqueios_leitura);
+    linha(escreve, arg, "bloqueios na escrita: %d", m->n_bloqueios_escrita);
     for (int i = 0; i < MAX_PROCESSOS; i++) {
-        console_printf("processo %d: tempo de retorno: %d, numero de preempcoes: %d\n", i, m->tempo_retorno[i], m->n_preempcao_processo[i]);
+        if (!existiu(m, i)) continue;
+        linha(escreve, arg, "processo %d: tempo de retorno: %d, numero de preempcoes: %d", i, m->tempo_retorno[i], m->n_preempcao_processo[i]);
     }
     for (int i = 0; i < MAX_PROCESSOS; i++) {
-        console_printf("processo %d: entradas em estados - pronto: %d, bloqueado: %d, executando: %d\n", i, m->n_entradas_estado[i][PRONTO], m->n_entradas_estado[i][BLOQUEADO], m->n_entradas_estado[i][EXECUTANDO]);
+        if (!existiu(m, i)) continue;
+        linha(escreve, arg, "processo %d: entradas em estados - pronto: %d, bloqueado: %d, executando: %d", i, m->n_entradas_estado[i][PRONTO], m->n_entradas_estado[i][BLOQUEADO], m->n_entradas_estado[i][EXECUTANDO]);
     }
     for (int i = 0; i < MAX_PROCESSOS; i++) {
-        console_printf("processo %d: tempo em estados - pronto: %d, bloqueado: %d, executando: %d\n", i, m->tempo_estado[i][PRONTO], m->tempo_estado[i][BLOQUEADO], m->tempo_estado[i][EXECUTANDO]);
+        if (!existiu(m, i)) continue;
+        linha(escreve, arg, "processo %d: tempo em estados - pronto: %d, bloqueado: %d, executando: %d", i, m->tempo_estado[i][PRONTO], m->tempo_estado[i][BLOQUEADO], m->tempo_estado[i][EXECUTANDO]);
     }
     for (int i = 0; i < MAX_PROCESSOS; i++) {
+        if (!existiu(m, i)) continue;
         int entradas = m->n_entradas_estado[i][BLOQUEADO];
         int tempo = m->tempo_estado[i][BLOQUEADO];
         int media = (entradas > 0) ? (tempo / entradas) : 0;
-        console_printf("processo %d: tempo tempo medio de resposta: %d\n", i, media);
+        linha(escreve, arg, "processo %d: tempo tempo medio de resposta: %d", i, media);
+    }
+    if (m->n_cpus > 1) {
+        for (int i = 0; i < m->n_cpus; i++) {
+            int tempo = m->tempo_cpu[i];
+            int ocupada = tempo - m->tempo_cpu_parada_cpu[i];
+            int utilizacao = (tempo > 0) ? (ocupada * 100 / tempo) : 0;
+            linha(escreve, arg, "cpu %d: tempo: %d, parada: %d, utilizacao: %d%%", i, tempo, m->tempo_cpu_parada_cpu[i], utilizacao);
+            linha(escreve, arg, "cpu %d: despachos: %d, migracoes recebidas: %d, roubos: %d", i, m->n_despachos_cpu[i], m->n_migracoes_cpu[i], m->n_roubos_cpu[i]);
+        }
     }
 }
 
-void marca_preempcao(metricas *metri, es_t *relogio, int n_processo, int tempo_retorno) {
-    int tempo_atual = 0, tempo_inicio = 0;
-    
-    metri->n_preempcao++;
-    metri->n_preempcao_processo[n_processo]++;
-    metri->tempo_retorno[n_processo] += tempo_retorno;
+static void escreve_na_console(void *arg, char *txt) {
+    console_printf("%s", txt);
+}
+
+static void escreve_no_arquivo(void *arg, char *txt) {
+    fprintf(arg, "%s\n", txt);
+}
+
+void mostra_metricas(metricas *m) {
+    escreve_metricas(m, escreve_na_console, NULL);
+}
+
+void imprime_metricas(metricas *m, FILE *arq) {
+    escreve_metricas(m, escreve_no_arquivo, arq);
+}
 
-    es_le(relogio, D_RELOGIO_INSTRUCOES, &tempo_inicio);
-    tempo_atual = tempo_inicio - metri->tempo_retorno[n_processo];
+void marca_criacao(metricas *metri, es_t *relogio, int n_processo) {
+    int agora = 0;
+    es_le(relogio, D_RELOGIO_INSTRUCOES, &agora);
+    metri->n_processos_criados++;
+    metri->tempo_criacao[n_processo] = agora;
+    // o processo nasce pronto, sem passar por muda_estado_proc
+    metri->n_entradas_estado[n_processo][PRONTO]++;
+    metri->tempo_inicio_estado[n_processo][PRONTO] = agora;
+}
+
+void marca_morte(metricas *metri, es_t *relogio, int n_processo) {
+    int agora = 0;
+    es_le(relogio, D_RELOGIO_INSTRUCOES, &agora);
+    metri->tempo_retorno[n_processo] = agora - metri->tempo_criacao[n_processo];
+}
 
-    metri->tempo_retorno[n_processo] += tempo_atual;
+void marca_preempcao(metricas *metri, int n_processo) {
+    metri->n_preempcao++;
+    metri->n_preempcao_processo[n_processo]++;
 }
 
 void entrou_ocioso(metricas *metri, es_t *relogio) {
@@ -92,3 +157,211 @@ void verifica_ocioso(metricas *metri, processo *tabela_processos, es_t *relogio)
     
     
 }
+
+void marca_cpu_parada(metricas *metri, es_t *relogio) {
+    es_le(relogio, D_RELOGIO_INSTRUCOES, &metri->tempo_total_execucao);
+    es_le(relogio, D_RELOGIO_OCIOSO, &metri->tempo_cpu_parada);
+}
+
+void marca_uso_cpu(metricas *metri, int cpu, es_t *relogio) {
+    if (cpu >= metri->n_cpus) metri->n_cpus = cpu + 1;
+    es_le(relogio, D_RELOGIO_INSTRUCOES, &metri->tempo_cpu[cpu]);
+    es_le(relogio, D_RELOGIO_OCIOSO, &metri->tempo_cpu_parada_cpu[cpu]);
+}
+
+void marca_despacho(metricas *metri, int cpu) {
+    metri->n_despachos_cpu[cpu]++;
+}
+
+void marca_migracao(metricas *metri, int cpu, bool roubo) {
+    metri->n_migracoes_cpu[cpu]++;
+    if (roubo) metri->n_roubos_cpu[cpu]++;
+}
+
+void marca_quadros(metricas *metri, int total, int reservados, int ocupados) {
+    metri->n_quadros = total;
+    metri->n_quadros_reservados = reservados;
+    metri->quadros_ocupados = ocupados;
+    if (ocupados > metri->max_quadros_ocupados) metri->max_quadros_ocupados = ocupados;
+    metri->soma_quadros_ocupados += ocupados;
+    metri->n_amostras_quadros++;
+}
+
+
+// EXPORTAÇÃO
+
+// o mesmo código gera os dois formatos: em JSON, cada seção é um objeto ou
+//   uma lista de objetos (um por processo ou CPU); em CSV, cada campo é uma
+//   linha, com a seção e o índice do item
+typedef struct {
+    FILE *arq;
+    bool csv;
+    char *secao;
+    int indice;          // do item corrente, ou -1 fora de lista
+    bool primeiro_campo; // do objeto corrente (JSON)
+    bool primeiro_item;  // da lista corrente (JSON)
+} exportacao_t;
+
+static void exp_campo(exportacao_t *e, char *campo, char *valor) {
+    if (e->csv) {
+        if (e->indice >= 0) {
+            fprintf(e->arq, "%s,%d,%s,%s\n", e->secao, e->indice, campo, valor);
+        } else {
+            fprintf(e->arq, "%s,,%s,%s\n", e->secao, campo, valor);
+        }
+    } else {
+        fprintf(e->arq, "%s\"%s\": %s", e->primeiro_campo ? "" : ", ", campo, valor);
+        e->primeiro_campo = false;
+    }
+}
+
+static void exp_int(exportacao_t *e, char *campo, long valor) {
+    char txt[30];
+    snprintf(txt, sizeof(txt), "%ld", valor);
+    exp_campo(e, campo, txt);
+}
+
+static void exp_real(exportacao_t *e, char *campo, double valor) {
+    char txt[30];
+    snprintf(txt, sizeof(txt), "%.2f", valor);
+    exp_campo(e, campo, txt);
+}
+
+static void exp_secao(exportacao_t *e, char *secao, bool lista) {
+    e->secao = secao;
+    e->indice = -1;
+    e->primeiro_campo = true;
+    e->primeiro_item = true;
+    if (!e->csv) fprintf(e->arq, ",\n  \"%s\": %s", secao, lista ? "[" : "{ ");
+}
+
+static void exp_fim_secao(exportacao_t *e, bool lista) {
+    if (e->csv) return;
+    if (lista) {
+        fprintf(e->arq, "%s]", e->primeiro_item ? "" : "\n  ");
+    } else {
+        fprintf(e->arq, " }");
+    }
+}
+
+// inicia um item de uma lista; em JSON o índice é um campo do objeto
+static void exp_item(exportacao_t *e, char *nome_indice, int indice) {
+    e->indice = indice;
+    if (e->csv) return;
+    fprintf(e->arq, "%s\n    { ", e->primeiro_item ? "" : ",");
+    e->primeiro_item = false;
+    e->primeiro_campo = true;
+    exp_int(e, nome_indice, indice);
+}
+
+static void exp_fim_item(exportacao_t *e) {
+    if (!e->csv) fprintf(e->arq, " }");
+}
+
+// nome de cada tipo de interrupção na exportação
+static char *nomes_irq[N_IRQ + 1] = {
+    [IRQ_RESET]   = "reset",
+    [IRQ_ERR_CPU] = "erro_cpu",
+    [IRQ_SISTEMA] = "sistema",
+    [IRQ_RELOGIO] = "relogio",
+    [IRQ_TECLADO] = "teclado",
+    [IRQ_TELA]    = "tela",
+    [IRQ_DISCO]   = "disco",
+    [N_IRQ]       = "desconhecidas",
+};
+
+static void exporta_metricas(metricas *m, exportacao_t *e) {
+    if (e->csv) {
+        fprintf(e->arq, "secao,indice,campo,valor\n");
+        fprintf(e->arq, "esquema,,versao,%d\n", METRICA_VERSAO_ESQUEMA);
+    } else {
+        fprintf(e->arq, "{\n  \"esquema\": \"so25b-metricas\", \"versao\": %d",
+                METRICA_VERSAO_ESQUEMA);
+    }
+
+    exp_secao(e, "geral", false);
+    exp_int(e, "processos_criados", m->n_processos_criados);
+    exp_int(e, "tempo_total_execucao", m->tempo_total_execucao);
+    exp_int(e, "tempo_ocioso", m->tempo_total_ocioso);
+    exp_int(e, "tempo_cpu_parada", m->tempo_cpu_parada);
+    exp_int(e, "preempcoes", m->n_preempcao);
+    exp_int(e, "bloqueios_leitura", m->n_bloqueios_leitura);
+    exp_int(e, "bloqueios_escrita", m->n_bloqueios_escrita);
+    exp_fim_secao(e, false);
+
+    exp_secao(e, "memoria", false);
+    exp_int(e, "tam_memoria", m->tam_memoria);
+    exp_int(e, "tam_pagina", m->tam_pagina);
+    exp_int(e, "quadros", m->n_quadros);
+    exp_int(e, "quadros_reservados", m->n_quadros_reservados);
+    exp_int(e, "quadros_ocupados", m->quadros_ocupados);
+    exp_int(e, "max_quadros_ocupados", m->max_quadros_ocupados);
+    exp_real(e, "media_quadros_ocupados", m->n_amostras_quadros > 0
+             ? (double)m->soma_quadros_ocupados / m->n_amostras_quadros : 0);
+    exp_int(e, "amostras_quadros", m->n_amostras_quadros);
+    exp_int(e, "faltas_de_pagina", m->n_faltas_pagina);
+    exp_int(e, "substituicoes", m->n_substituicoes);
+    exp_int(e, "leituras_swap", m->n_leituras_swap);
+    exp_int(e, "escritas_swap", m->n_escritas_swap);
+    exp_fim_secao(e, false);
+
+    exp_secao(e, "interrupcoes", false);
+    for (int i = 0; i <= N_IRQ; i++) {
+        exp_int(e, nomes_irq[i], m->n_interrupcoes_tipo[i]);
+    }
+    exp_fim_secao(e, false);
+
+    exp_secao(e, "processos", true);
+    for (int i = 0; i < MAX_PROCESSOS; i++) {
+        if (!existiu(m, i)) continue;
+        int entradas = m->n_entradas_estado[i][BLOQUEADO];
+        int tempo = m->tempo_estado[i][BLOQUEADO];
+        exp_item(e, "pid", i + 1);
+        exp_int(e, "tempo_retorno", m->tempo_retorno[i]);
+        exp_int(e, "preempcoes", m->n_preempcao_processo[i]);
+        exp_int(e, "faltas_de_pagina", m->n_faltas_pagina_processo[i]);
+        exp_int(e, "entradas_pronto", m->n_entradas_estado[i][PRONTO]);
+        exp_int(e, "entradas_bloqueado", m->n_entradas_estado[i][BLOQUEADO]);
+        exp_int(e, "entradas_executando", m->n_entradas_estado[i][EXECUTANDO]);
+        exp_int(e, "tempo_pronto", m->tempo_estado[i][PRONTO]);
+        exp_int(e, "tempo_bloqueado", m->tempo_estado[i][BLOQUEADO]);
+        exp_int(e, "tempo_executando", m->tempo_estado[i][EXECUTANDO]);
+        exp_int(e, "tempo_medio_resposta", entradas > 0 ? tempo / entradas : 0);
+        exp_fim_item(e);
+    }
+    exp_fim_secao(e, true);
+
+    exp_secao(e, "cpus", true);
+    for (int i = 0; i < m->n_cpus; i++) {
+        exp_item(e, "cpu", i);
+        exp_int(e, "tempo", m->tempo_cpu[i]);
+        exp_int(e, "parada", m->tempo_cpu_parada_cpu[i]);
+        exp_int(e, "despachos", m->n_despachos_cpu[i]);
+        exp_int(e, "migracoes_recebidas", m->n_migracoes_cpu[i]);
+        exp_int(e, "roubos", m->n_roubos_cpu[i]);
+        exp_fim_item(e);
+    }
+    exp_fim_secao(e, true);
+
+    if (!e->csv) fprintf(e->arq, "\n}\n");
+}
+
+bool metrica_exporta(metricas *m, char *nome) {
+    FILE *arq = fopen(nome, "w");
+    if (arq == NULL) return false;
+    int tam = strlen(nome);
+    exportacao_t e = { .arq = arq };
+    e.csv = tam >= 4 && strcmp(nome + tam - 4, ".csv") == 0;
+    exporta_metricas(m, &e);
+    bool ok = !ferror(arq);
+    return fclose(arq) == 0 && ok;
+}
+
+// a estrutura não tem ponteiros, vai inteira
+bool metrica_salva(metricas *metri, FILE *arq) {
+    return imagem_escreve_bytes(arq, sizeof(*metri), metri);
+}
+
+bool metrica_recupera(metricas *metri, FILE *arq) {
+    return imagem_le_bytes(arq, sizeof(*metri), metri);
+}
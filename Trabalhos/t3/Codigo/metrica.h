@@ -3,34 +3,116 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include "config.h"  // Inclui definições compartilhadas
 #include "es.h"
 #include "irq.h"
+#include "cpu.h"
 #include "processo.h"
 
 
 typedef struct metricas {
     int n_processos_criados;
-    int tempo_total_execucao;
+    int tempo_total_execucao; // relógio da CPU principal, com o tempo parada
     int tempo_total_ocioso;
     bool esta_ocioso;
     int tempo_inicio_ocioso;
-    int n_interrupcoes_tipo[7];
+    int tempo_cpu_parada; // medido pelo relógio, com a CPU executando PARA
+    int n_interrupcoes_tipo[N_IRQ + 1]; // a última são as desconhecidas
     int n_preempcao;
-    int tempo_retorno[MAX_PROCESSOS];
+    int n_faltas_pagina;
+    int n_bloqueios_leitura;  // processos bloqueados em SO_LE, sem caractere
+    int n_bloqueios_escrita;  // processos bloqueados em SO_ESCR, tela ocupada
+    int n_substituicoes;      // páginas tiradas de um quadro para dar lugar a outra
+    int n_leituras_swap;      // páginas lidas da swap (faltas e carga do init)
+    int n_escritas_swap;      // páginas escritas na swap (substituições e carga de programas)
+    // memória (ver marca_quadros)
+    int tam_memoria;
+    int tam_pagina;
+    int n_quadros;
+    int n_quadros_reservados; // do SO e das CPUs, nunca substituídos
+    int quadros_ocupados;     // por páginas de processos, na última amostra
+    int max_quadros_ocupados;
+    long soma_quadros_ocupados;
+    int n_amostras_quadros;
+    int tempo_criacao[MAX_PROCESSOS];
+    int tempo_retorno[MAX_PROCESSOS]; // da criação à morte (0 se não morreu)
+    int n_faltas_pagina_processo[MAX_PROCESSOS];
     int n_preempcao_processo[MAX_PROCESSOS];
     int n_entradas_estado[MAX_PROCESSOS][3]; // 3 estados: pronto, bloqueado, executando
     int tempo_estado[MAX_PROCESSOS][3];
     int tempo_inicio_estado[MAX_PROCESSOS][3];
     int tempo_medio_resposta[MAX_PROCESSOS];
+    // por CPU (só aparecem no relatório com mais de uma CPU)
+    int n_cpus;
+    int tempo_cpu[CPU_MAX];          // relógio da CPU
+    int tempo_cpu_parada_cpu[CPU_MAX];
+    int n_despachos_cpu[CPU_MAX];    // processos colocados em execução
+    int n_migracoes_cpu[CPU_MAX];    // processos que vieram de outra CPU
+    int n_roubos_cpu[CPU_MAX];       // migrações feitas pela CPU ociosa
 } metricas;
 
 metricas *cria_metrica();
 
+// mostra as métricas na console
 void mostra_metricas(metricas *m);
 
-void marca_preempcao(metricas *metri, es_t *relogio, int n_processo, int tempo_retorno);
+// escreve as métricas no arquivo (as mesmas linhas mostradas na console)
+void imprime_metricas(metricas *m, FILE *arq);
+
+// o processo de índice 'n_processo' (pid n_processo+1) foi criado, já no
+//   estado PRONTO
+void marca_criacao(metricas *metri, es_t *relogio, int n_processo);
+
+// o processo de índice 'n_processo' morreu
+void marca_morte(metricas *metri, es_t *relogio, int n_processo);
+
+void marca_preempcao(metricas *metri, int n_processo);
 
 void verifica_ocioso(metricas *metri, processo *tabela_processos, es_t *relogio);
 
+// lê do relógio da CPU principal o tempo total e o tempo que ela passou parada
+void marca_cpu_parada(metricas *metri, es_t *relogio);
+
+// lê do relógio da CPU 'cpu' o tempo dela e o tempo que passou parada
+void marca_uso_cpu(metricas *metri, int cpu, es_t *relogio);
+
+void marca_despacho(metricas *metri, int cpu);
+
+// um processo passou para a fila da CPU 'cpu'; 'roubo' se foi ela que o pegou
+//   da fila de outra por estar sem processos prontos
+void marca_migracao(metricas *metri, int cpu, bool roubo);
+
+// registra uma amostra da ocupação dos quadros da memória principal:
+//   'total' quadros, dos quais 'reservados' são do SO e 'ocupados' têm
+//   páginas de processos
+void marca_quadros(metricas *metri, int total, int reservados, int ocupados);
+
+// versão do esquema das métricas exportadas; muda quando um campo muda de
+//   nome ou de significado, ou quando há campos novos
+// 2: geral.bloqueios_leitura e geral.bloqueios_escrita são novos: os
+//      processos bloqueados em SO_LE e em SO_ESCR
+//    interrupcoes.teclado e interrupcoes.tela são só as interrupções
+//      atendidas (na 1 eram os bloqueios, trocados: escrita em teclado,
+//      leitura em tela)
+//    geral.processos_criados e geral.tempo_total_execucao (relógio da CPU
+//      principal) eram sempre 0 na 1
+//    processos[].tempo_retorno é da criação à morte (na 1, uma soma feita
+//      a cada preempção); processos[].entradas_pronto conta a criação, e
+//      tempo_pronto começa nela
+//    na 1, a espera em SO_ESPERA_PROC contava duas vezes em
+//      processos[].entradas_bloqueado e sobrescrevia tempo_bloqueado, e o
+//      fim do quantum não entrava em entradas_pronto nem nos tempos
+#define METRICA_VERSAO_ESQUEMA 2
+
+// escreve as métricas no arquivo 'nome', em JSON, ou em CSV se o nome
+//   terminar em ".csv"; o CSV tem uma linha por valor, com as colunas
+//   secao,indice,campo,valor (o índice é o pid, a CPU ou vazio)
+// retorna false se o arquivo não puder ser escrito
+bool metrica_exporta(metricas *m, char *nome);
+
+// salva e recupera as métricas na imagem (ver imagem.h)
+bool metrica_salva(metricas *metri, FILE *arq);
+bool metrica_recupera(metricas *metri, FILE *arq);
+
 #endif
\ No newline at end of file
@@ -7,12 +7,38 @@
 #include <stdlib.h>
 #include <assert.h>
 
+// número de entradas na TLB (potência de 2)
+#define N_TLB 32
+
+// uma entrada da TLB: tradução de uma página e cópia dos seus bits
+// os bits servem para não marcar na tabela o que já está marcado
+typedef struct {
+  // página traduzida (-1 se a entrada está livre)
+  int pagina;
+  int quadro;
+  bool acessada;
+  bool alterada;
+} entrada_tlb_t;
+
 // tipo de dados opaco para representar uma MMU
 struct mmu_t {
   // memória física
   mem_t *mem;
   // tabela de páginas
   tabpag_t *tabpag;
+  // TLB, com traduções da tabela de páginas, indexada pelo número da página
+  // é válida para as versões 'versao' da tabela, que são conferidas com as
+  //   atuais, apontadas por 'pversao', a cada tradução
+  entrada_tlb_t tlb[N_TLB];
+  const tabpag_versao_t *pversao;
+  tabpag_versao_t versao;
+  // contadores de acertos, faltas e esvaziamentos da TLB
+  long tlb_acertos;
+  long tlb_faltas;
+  long tlb_esvaziamentos;
+  // diferença entre o endereço real da área local e o endereço físico
+  //   pelo qual ela é acessada (0 se a área local não foi mudada)
+  int desloc_local;
 };
 
 mmu_t *mmu_cria(mem_t *mem)
@@ -22,6 +48,16 @@ mmu_t *mmu_cria(mem_t *mem)
   assert(self != NULL);
   self->mem = mem;
   self->tabpag = NULL;
+  for (int i = 0; i < N_TLB; i++) {
+    self->tlb[i].pagina = -1;
+  }
+  self->pversao = NULL;
+  self->versao.mapa = 0;
+  self->versao.acesso = 0;
+  self->tlb_acertos = 0;
+  self->tlb_faltas = 0;
+  self->tlb_esvaziamentos = 0;
+  self->desloc_local = 0;
   return self;
 }
 
@@ -33,39 +69,223 @@ void mmu_destroi(mmu_t *self)
   }
 }
 
+// ---------------------------------------------------------------------
+// TLB {{{1
+// ---------------------------------------------------------------------
+
+// a TLB guarda as traduções mais recentes da tabela de páginas, junto com
+//   os bits de acesso e alteração que a MMU já marcou nela
+// a tabela de páginas pode ser alterada diretamente pelo SO, então a TLB é
+//   descartada quando muda o mapeamento da tabela, e quando muda a tabela
+// quando o SO zera bits de acesso, só as cópias desses bits são descartadas,
+//   para que o próximo acesso marque de novo na tabela
+
+static void mmu__esvazia_tlb(mmu_t *self)
+{
+  for (int i = 0; i < N_TLB; i++) {
+    self->tlb[i].pagina = -1;
+  }
+  if (self->pversao != NULL) self->versao = *self->pversao;
+  self->tlb_esvaziamentos++;
+}
+
+// atualiza a TLB depois de uma mudança de versão da tabela
+static void mmu__confere_versao(mmu_t *self)
+{
+  if (self->pversao->mapa != self->versao.mapa) {
+    mmu__esvazia_tlb(self);
+    return;
+  }
+  // só bits de acesso zerados, não se sabe quais
+  for (int i = 0; i < N_TLB; i++) {
+    self->tlb[i].acessada = false;
+  }
+  self->versao.acesso = self->pversao->acesso;
+}
+
+// retorna a entrada da TLB com a tradução da página, preenchendo-a a partir
+//   da tabela se necessário; retorna NULL se a página for inválida
+static entrada_tlb_t *mmu__tlb(mmu_t *self, int pagina)
+{
+  if (pagina < 0) return NULL;
+  if (self->pversao->mapa != self->versao.mapa
+      || self->pversao->acesso != self->versao.acesso) {
+    mmu__confere_versao(self);
+  }
+  entrada_tlb_t *entrada = &self->tlb[pagina & (N_TLB - 1)];
+  if (entrada->pagina == pagina) {
+    self->tlb_acertos++;
+    return entrada;
+  }
+  self->tlb_faltas++;
+  int quadro;
+  if (tabpag_traduz(self->tabpag, pagina, &quadro) != ERR_OK) return NULL;
+  entrada->pagina = pagina;
+  entrada->quadro = quadro;
+  entrada->acessada = tabpag_bit_acesso(self->tabpag, pagina);
+  entrada->alterada = tabpag_bit_alteracao(self->tabpag, pagina);
+  return entrada;
+}
+
+// marca o acesso à página da entrada na tabela, se ainda não estiver marcado
+static void mmu__marca_acesso(mmu_t *self, entrada_tlb_t *entrada, bool alteracao)
+{
+  if (entrada->acessada && (entrada->alterada || !alteracao)) return;
+  tabpag_marca_bit_acesso(self->tabpag, entrada->pagina, alteracao);
+  entrada->acessada = true;
+  if (alteracao) entrada->alterada = true;
+}
+
+void mmu_zera_bit_acesso(mmu_t *self, int pagina)
+{
+  if (self->tabpag == NULL) return;
+  // os bits zerados por outros têm que ser vistos antes de atualizar a versão
+  if (self->pversao->mapa != self->versao.mapa
+      || self->pversao->acesso != self->versao.acesso) {
+    mmu__confere_versao(self);
+  }
+  tabpag_zera_bit_acesso(self->tabpag, pagina);
+  self->versao.acesso = self->pversao->acesso;
+  entrada_tlb_t *entrada = &self->tlb[pagina & (N_TLB - 1)];
+  if (entrada->pagina == pagina) entrada->acessada = false;
+}
+
+void mmu_estatisticas_tlb(mmu_t *self, long *pacertos, long *pfaltas,
+                          long *pesvaziamentos)
+{
+  *pacertos = self->tlb_acertos;
+  *pfaltas = self->tlb_faltas;
+  *pesvaziamentos = self->tlb_esvaziamentos;
+}
+
+
+// ---------------------------------------------------------------------
+// ÁREA LOCAL {{{1
+// ---------------------------------------------------------------------
+
+// os acessos sem tradução aos endereços onde a CPU salva seu estado nas
+//   interrupções são desviados para a área local da CPU dona da MMU, para
+//   que várias CPUs possam compartilhar a mesma memória
+
+void mmu_define_area_local(mmu_t *self, int inicio)
+{
+  self->desloc_local = inicio - CPU_END_PC;
+}
+
+// retorna o endereço real correspondente ao endereço físico 'endfis'
+static inline int mmu__real(mmu_t *self, int endfis)
+{
+  if (endfis >= CPU_END_PC && endfis < CPU_END_TRATADOR) {
+    return endfis + self->desloc_local;
+  }
+  return endfis;
+}
+
+
+// ---------------------------------------------------------------------
+// TRADUÇÃO E ACESSO {{{1
+// ---------------------------------------------------------------------
+
 void mmu_define_tabpag(mmu_t *self, tabpag_t *tabpag)
 {
+  if (tabpag == self->tabpag) return;
   self->tabpag = tabpag;
+  self->pversao = tabpag == NULL ? NULL : tabpag_versao(tabpag);
+  mmu__esvazia_tlb(self);
 }
 
 // traduz o endereço virtual 'endvirt', colocando o endereço físico
-//   correspondente em 'pendfis'.
+//   correspondente em 'pendfis' e em '*pentrada' a entrada da TLB usada
 // retorna ERR_OK ou um erro se a tradução não for possível
-err_t mmu__traduz(mmu_t *self, int endvirt, int *pendfis)
+static err_t mmu__traduz_tlb(mmu_t *self, int endvirt, int *pendfis,
+                             entrada_tlb_t **pentrada)
 {
   int pagina = endvirt / TAM_PAGINA;
   int deslocamento = endvirt % TAM_PAGINA;
-  int quadro;
-  err_t err = tabpag_traduz(self->tabpag, pagina, &quadro);
+  entrada_tlb_t *entrada = mmu__tlb(self, pagina);
+  if (entrada == NULL) return ERR_PAG_AUSENTE;
+  *pendfis = entrada->quadro * TAM_PAGINA + deslocamento;
+  *pentrada = entrada;
+  return ERR_OK;
+}
+
+// traduz o endereço virtual 'endvirt', colocando o endereço físico
+//   correspondente em 'pendfis'.
+// retorna ERR_OK ou um erro se a tradução não for possível
+err_t mmu__traduz(mmu_t *self, int endvirt, int *pendfis)
+{
+  entrada_tlb_t *entrada;
+  return mmu__traduz_tlb(self, endvirt, pendfis, &entrada);
+}
+
+err_t mmu_traduz(mmu_t *self, int endvirt, int *pendfis, cpu_modo_t modo)
+{
+  if (modo == supervisor || self->tabpag == NULL) {
+    *pendfis = mmu__real(self, endvirt);
+    return ERR_OK;
+  }
+  entrada_tlb_t *entrada;
+  err_t err = mmu__traduz_tlb(self, endvirt, pendfis, &entrada);
   if (err == ERR_OK) {
-    *pendfis = quadro * TAM_PAGINA + deslocamento;
+    mmu__marca_acesso(self, entrada, false);
   }
   return err;
 }
 
+err_t mmu_janela(mmu_t *self, int endvirt, cpu_modo_t modo, mmu_janela_t *pjanela)
+{
+  int tam_mem = mem_tam(self->mem);
+  entrada_tlb_t *entrada = NULL;
+  int ini = 0;
+  int fim = tam_mem;
+  int desloc = 0;
+  if (modo == usuario && self->tabpag != NULL) {
+    if (endvirt < 0) return ERR_END_INV;
+    int endfis;
+    err_t err = mmu__traduz_tlb(self, endvirt, &endfis, &entrada);
+    if (err != ERR_OK) return err;
+    ini = entrada->pagina * TAM_PAGINA;
+    fim = ini + TAM_PAGINA;
+    desloc = endfis - endvirt;
+    // só os endereços que existem na memória física
+    if (ini + desloc < 0) ini = -desloc;
+    if (fim + desloc > tam_mem) fim = tam_mem - desloc;
+  } else if (self->desloc_local != 0) {
+    // sem tradução, a área local é uma faixa à parte
+    if (endvirt < CPU_END_PC) {
+      fim = CPU_END_PC;
+    } else if (endvirt >= CPU_END_TRATADOR) {
+      ini = CPU_END_TRATADOR;
+    } else {
+      ini = CPU_END_PC;
+      fim = CPU_END_TRATADOR;
+      desloc = self->desloc_local;
+      if (fim + desloc > tam_mem) fim = tam_mem - desloc;
+    }
+  }
+  if (endvirt < ini || endvirt >= fim) return ERR_END_INV;
+  if (entrada != NULL) mmu__marca_acesso(self, entrada, false);
+  pjanela->ini = ini;
+  pjanela->fim = fim;
+  pjanela->desloc = desloc;
+  pjanela->mem = mem_conteudo(self->mem) + ini + desloc;
+  return ERR_OK;
+}
+
 err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo)
 {
   // em modo supervisor ou se não tiver tabela de páginas,
   //   não faz tradução de endereços, nem marca o acesso
   if (modo == supervisor || self->tabpag == NULL) {
-    return mem_le(self->mem, endvirt, pvalor);
+    return mem_le(self->mem, mmu__real(self, endvirt), pvalor);
   }
   int endfis;
-  err_t err = mmu__traduz(self, endvirt, &endfis);
+  entrada_tlb_t *entrada;
+  err_t err = mmu__traduz_tlb(self, endvirt, &endfis, &entrada);
   if (err == ERR_OK) {
     err = mem_le(self->mem, endfis, pvalor);
     if (err == ERR_OK) {
-      tabpag_marca_bit_acesso(self->tabpag, endvirt / TAM_PAGINA, false);
+      mmu__marca_acesso(self, entrada, false);
     }
   }
   return err;
@@ -76,15 +296,28 @@ err_t mmu_escreve(mmu_t *self, int endvirt, int valor, cpu_modo_t modo)
   // em modo supervisor ou se não tiver tabela de páginas,
   //   não faz tradução de endereços, nem marca o acesso
   if (modo == supervisor || self->tabpag == NULL) {
-    return mem_escreve(self->mem, endvirt, valor);
+    return mem_escreve(self->mem, mmu__real(self, endvirt), valor);
   }
   int endfis;
-  err_t err = mmu__traduz(self, endvirt, &endfis);
+  entrada_tlb_t *entrada;
+  err_t err = mmu__traduz_tlb(self, endvirt, &endfis, &entrada);
   if (err == ERR_OK) {
     err = mem_escreve(self->mem, endfis, valor);
     if (err == ERR_OK) {
-      tabpag_marca_bit_acesso(self->tabpag, endvirt / TAM_PAGINA, true);
+      mmu__marca_acesso(self, entrada, true);
     }
   }
   return err;
 }
+
+bool mmu_inclui_aviso_escrita(mmu_t *self, mem_f_aviso_t func, void *arg)
+{
+  return mem_inclui_aviso_escrita(self->mem, func, arg);
+}
+
+void mmu_retira_aviso_escrita(mmu_t *self, void *arg)
+{
+  mem_retira_aviso_escrita(self->mem, arg);
+}
+
+// vim: foldmethod=marker
@@ -10,6 +10,8 @@
 // realiza a tradução de endereços virtuais do espaço de endereçamento
 //   de um processo em endereços físicos da memória principal
 // implementa memória virtual por paginação
+// mantém uma TLB com as traduções mais recentes, que é descartada quando
+//   muda a tabela de páginas ou o mapeamento dela (ver tabpag_versao)
 
 // tipo opaco que representa a MMU
 typedef struct mmu_t mmu_t;
@@ -40,6 +42,36 @@ void mmu_define_tabpag(mmu_t *self, tabpag_t *tabpag);
 
 err_t mmu__traduz(mmu_t *self, int endvirt, int *pendfis);
 
+// coloca em '*pendfis' o endereço físico correspondente ao endereço virtual
+//   'endvirt', fazendo a mesma tradução que mmu_le faria para esse acesso
+//   (em modo supervisor ou sem tabela de páginas, não há tradução)
+// marca a página como acessada se a tradução for bem sucedida
+// não verifica se o endereço físico existe na memória
+// retorna erro se a tradução não for possível (ver tabpag_traduz)
+err_t mmu_traduz(mmu_t *self, int endvirt, int *pendfis, cpu_modo_t modo);
+
+// uma faixa de endereços virtuais mapeada em endereços físicos contíguos,
+//   com acesso direto ao conteúdo da memória física
+typedef struct {
+  // primeiro endereço virtual da faixa, e o seguinte ao último
+  int ini;
+  int fim;
+  // diferença entre o endereço físico e o virtual
+  int desloc;
+  // conteúdo da memória física a partir do endereço físico de 'ini'
+  const int *mem;
+} mmu_janela_t;
+
+// coloca em '*pjanela' a maior faixa de endereços que contém 'endvirt' e
+//   que é traduzida da mesma forma (a página de 'endvirt', ou a memória
+//   toda se não houver tradução), limitada aos endereços físicos existentes
+// marca a página como acessada
+// as leituras feitas pela janela não marcam acesso; a janela deixa de valer
+//   se a tabela de páginas for alterada ou trocada
+// retorna erro se a tradução não for possível ou se o endereço físico
+//   correspondente a 'endvirt' não existir
+err_t mmu_janela(mmu_t *self, int endvirt, cpu_modo_t modo, mmu_janela_t *pjanela);
+
 // coloca na posição apontada por 'pvalor' o valor que está na memória
 //   no endereço físico correspondente ao endereço virtual 'endvirt'
 // marca a página como acessada se o acesso for bem sucedido
@@ -60,4 +92,31 @@ err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo);
 //   à memória sem tradução
 err_t mmu_escreve(mmu_t *self, int endvirt, int valor, cpu_modo_t modo);
 
+// zera o bit de acesso à página na tabela de páginas em uso (ver
+//   tabpag_zera_bit_acesso) e na cópia que a TLB tem dele, sem descartar
+//   as outras traduções
+// o bit pode ser zerado diretamente na tabela, mas aí a MMU não sabe qual
+//   página foi e descarta as cópias de todos os bits de acesso
+void mmu_zera_bit_acesso(mmu_t *self, int pagina);
+
+// coloca nos ponteiros o número de traduções que acertaram e que faltaram na
+//   TLB e o número de vezes em que ela foi esvaziada, desde a criação da MMU
+void mmu_estatisticas_tlb(mmu_t *self, long *pacertos, long *pfaltas,
+                          long *pesvaziamentos);
+
+// inclui uma função a ser avisada de cada escrita na memória física
+//   gerenciada pela MMU, mesmo as que não passam pela MMU, nem por esta MMU
+//   (ver mem_inclui_aviso_escrita); retira com mmu_retira_aviso_escrita
+// usado pela CPU para manter coerente a cache de instruções decodificadas
+bool mmu_inclui_aviso_escrita(mmu_t *self, mem_f_aviso_t func, void *arg);
+void mmu_retira_aviso_escrita(mmu_t *self, void *arg);
+
+// define onde fica a área local da CPU que usa esta MMU
+// os acessos sem tradução (em modo supervisor ou sem tabela de páginas) aos
+//   endereços entre CPU_END_PC e CPU_END_TRATADOR (onde a CPU salva seu
+//   estado nas interrupções) vão para os endereços a partir de 'inicio'
+// quando várias CPUs compartilham a memória, cada uma precisa da sua área;
+//   a área de uma MMU recém criada é a própria faixa a partir de CPU_END_PC
+void mmu_define_area_local(mmu_t *self, int inicio);
+
 #endif // MMU_H
@@ -0,0 +1,161 @@
+// pic.c
+// controlador de interrupções
+// simulador de computador
+// so25b
+
+#include "pic.h"
+#include "imagem.h"
+
+#include <stdlib.h>
+#include <limits.h>
+#include <assert.h>
+#include <stdatomic.h>
+
+struct pic_t {
+  // para cada irq, as linhas ativas (um bit por fonte)
+  atomic_uint linhas[N_IRQ];
+  // pedidos por borda ainda não reconhecidos (um bit por irq)
+  atomic_uint travados;
+  // irqs habilitadas (um bit por irq)
+  atomic_uint mascara;
+  // prioridade de cada irq (menor é mais prioritária)
+  int prioridade[N_IRQ];
+};
+
+pic_t *pic_cria(void)
+{
+  pic_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+
+  for (int irq = 0; irq < N_IRQ; irq++) {
+    atomic_init(&self->linhas[irq], 0);
+    // as que não vêm de dispositivos nunca são pedidas
+    self->prioridade[irq] = INT_MAX;
+  }
+  atomic_init(&self->travados, 0);
+  atomic_init(&self->mascara, PIC_BIT(IRQ_RELOGIO) | PIC_BIT(IRQ_DISCO)
+                            | PIC_BIT(IRQ_TECLADO) | PIC_BIT(IRQ_TELA));
+  self->prioridade[IRQ_RELOGIO] = 0;
+  self->prioridade[IRQ_DISCO] = 1;
+  self->prioridade[IRQ_TECLADO] = 2;
+  self->prioridade[IRQ_TELA] = 3;
+
+  return self;
+}
+
+void pic_destroi(pic_t *self)
+{
+  free(self);
+}
+
+void pic_nivel(pic_t *self, irq_t irq, int fonte, bool ativo)
+{
+  assert(irq >= 0 && irq < N_IRQ && fonte >= 0 && fonte < 32);
+  if (ativo) {
+    atomic_fetch_or(&self->linhas[irq], 1u << fonte);
+  } else {
+    atomic_fetch_and(&self->linhas[irq], ~(1u << fonte));
+  }
+}
+
+void pic_pede(pic_t *self, irq_t irq)
+{
+  assert(irq >= 0 && irq < N_IRQ);
+  atomic_fetch_or(&self->travados, PIC_BIT(irq));
+}
+
+void pic_define_prioridade(pic_t *self, irq_t irq, int prioridade)
+{
+  assert(irq >= 0 && irq < N_IRQ);
+  self->prioridade[irq] = prioridade;
+}
+
+// as irqs pedidas e habilitadas
+static unsigned pic_pendentes(pic_t *self)
+{
+  unsigned pedidas = atomic_load(&self->travados);
+  for (int irq = 0; irq < N_IRQ; irq++) {
+    if (atomic_load(&self->linhas[irq]) != 0) pedidas |= PIC_BIT(irq);
+  }
+  return pedidas & atomic_load(&self->mascara);
+}
+
+bool pic_proxima(pic_t *self, irq_t *pirq)
+{
+  unsigned pendentes = pic_pendentes(self);
+  if (pendentes == 0) return false;
+  int escolhida = -1;
+  for (int irq = 0; irq < N_IRQ; irq++) {
+    if ((pendentes & PIC_BIT(irq)) == 0) continue;
+    if (escolhida < 0 || self->prioridade[irq] < self->prioridade[escolhida]) {
+      escolhida = irq;
+    }
+  }
+  *pirq = escolhida;
+  return true;
+}
+
+
+// E/S
+
+err_t pic_leitura(void *disp, int id, int *pvalor)
+{
+  pic_t *self = disp;
+  err_t err = ERR_OK;
+  switch (id) {
+    case PIC_PENDENTES:
+      *pvalor = pic_pendentes(self);
+      break;
+    case PIC_MASCARA:
+      *pvalor = atomic_load(&self->mascara);
+      break;
+    default:
+      err = ERR_END_INV;
+  }
+  return err;
+}
+
+err_t pic_escrita(void *disp, int id, int valor)
+{
+  pic_t *self = disp;
+  err_t err = ERR_OK;
+  switch (id) {
+    case PIC_MASCARA:
+      atomic_store(&self->mascara, valor);
+      break;
+    case PIC_RECONHECE:
+      if (valor < 0 || valor >= N_IRQ) return ERR_OP_INV;
+      atomic_fetch_and(&self->travados, ~PIC_BIT(valor));
+      break;
+    case PIC_PEDE:
+      if (valor < 0 || valor >= N_IRQ) return ERR_OP_INV;
+      pic_pede(self, valor);
+      break;
+    default:
+      err = ERR_END_INV;
+  }
+  return err;
+}
+
+
+// imagem
+
+bool pic_salva(pic_t *self, FILE *arq)
+{
+  return imagem_escreve_int(arq, atomic_load(&self->travados))
+      && imagem_escreve_int(arq, atomic_load(&self->mascara))
+      && imagem_escreve_vetor(arq, N_IRQ, self->prioridade);
+}
+
+bool pic_recupera(pic_t *self, FILE *arq)
+{
+  int travados, mascara;
+  if (!imagem_le_int(arq, &travados)
+      || !imagem_le_int(arq, &mascara)
+      || !imagem_le_vetor(arq, N_IRQ, self->prioridade)) {
+    return false;
+  }
+  atomic_store(&self->travados, travados);
+  atomic_store(&self->mascara, mascara);
+  return true;
+}
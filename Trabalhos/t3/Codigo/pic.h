@@ -0,0 +1,86 @@
+// pic.h
+// controlador de interrupções
+// simulador de computador
+// so25b
+
+#ifndef PIC_H
+#define PIC_H
+
+// simulação de um controlador de interrupções programável
+//
+// fica entre os dispositivos e a CPU: os dispositivos pedem interrupção ao
+//   controlador, e o controle da CPU (ver controle.c) pergunta a ele, uma vez
+//   por rajada, se tem alguma para entregar à CPU
+// cada CPU tem o seu controlador
+//
+// um dispositivo pode pedir interrupção de duas formas:
+// - por nível: o pedido existe enquanto o dispositivo mantiver a linha ativa
+//   (o relógio, enquanto o timer estiver expirado; um terminal, enquanto
+//   tiver caractere para ler ou puder escrever, se a interrupção estiver
+//   habilitada nele); várias fontes podem compartilhar a mesma irq (os 4
+//   terminais), cada uma com sua linha
+// - por borda: o pedido fica travado no controlador até ser reconhecido pelo
+//   SO (o fim de um acesso ao disco)
+// uma irq só é entregue se estiver habilitada na máscara; se tiver mais de
+//   uma pendente, é entregue a de maior prioridade (menor número); as outras
+//   continuam pendentes, e o SO pode tratá-las todas de uma vez (lendo as
+//   pendentes) ou esperar que sejam entregues depois
+//
+// implementa 4 dispositivos de E/S:
+// - leitura das irqs pendentes e habilitadas (um bit por irq)
+// - leitura ou escrita da máscara (um bit por irq, 1 é habilitada)
+// - escrita de uma irq para reconhecer (desfaz a trava do pedido por borda)
+// - escrita de uma irq para pedir por borda (para pedidos feitos por
+//   software, como o do disco, que é simulado pelo SO)
+//
+// as operações podem ser chamadas por qualquer thread
+
+#include "err.h"
+#include "irq.h"
+#include <stdio.h>
+#include <stdbool.h>
+
+typedef struct pic_t pic_t;
+
+// os 4 dispositivos do controlador
+#define PIC_PENDENTES 0
+#define PIC_MASCARA   1
+#define PIC_RECONHECE 2
+#define PIC_PEDE      3
+
+// o bit de uma irq na máscara e nas pendentes
+#define PIC_BIT(irq) (1u << (irq))
+
+// cria um controlador, com as irqs do relógio, do disco, do teclado e da
+//   tela habilitadas, e prioridade nessa ordem
+pic_t *pic_cria(void);
+
+void pic_destroi(pic_t *self);
+
+// ativa ou desativa a linha 'fonte' (de 0 a 31) da irq 'irq'
+void pic_nivel(pic_t *self, irq_t irq, int fonte, bool ativo);
+
+// pede a irq 'irq' por borda (fica pendente até ser reconhecida)
+void pic_pede(pic_t *self, irq_t irq);
+
+// altera a prioridade da irq 'irq' (menor é mais prioritária)
+void pic_define_prioridade(pic_t *self, irq_t irq, int prioridade);
+
+// retorna true e coloca em *pirq a irq pendente e habilitada de maior
+//   prioridade, se tiver alguma
+// não altera o estado: a irq continua pendente até a fonte desativar a
+//   linha ou o SO reconhecer o pedido
+bool pic_proxima(pic_t *self, irq_t *pirq);
+
+// salva o estado do controlador (pedidos travados, máscara e prioridades)
+//   na imagem 'arq' (ver imagem.h)
+// as linhas não são salvas, cada fonte ativa a sua ao ser recuperada
+bool pic_salva(pic_t *self, FILE *arq);
+bool pic_recupera(pic_t *self, FILE *arq);
+
+// Funções para acessar o controlador como dispositivo de E/S
+// Devem seguir o protocolo f_leitura_t e f_escrita_t declarados em es.h
+err_t pic_leitura(void *disp, int id, int *pvalor);
+err_t pic_escrita(void *disp, int id, int valor);
+
+#endif // PIC_H
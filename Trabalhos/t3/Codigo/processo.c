@@ -1,4 +1,6 @@
 #include "processo.h"
+#include "imagem.h"
+#include "log.h"
 
 #include <stdbool.h>
 #include <stdlib.h>
@@ -32,9 +34,12 @@ processo *processo_cria(int id, int p_id, int pc, int max_quantum) {
     p->prox = NULL;
     p->ultimo_char_para_escrever = 0;
     p->aguardando_leitura = false;
-
+    p->n_buf_escrita = 0;
 
     p->prioridade = 0.5;
+    p->cpu = 0;
+    p->afinidade = AFINIDADE_TODAS;
+    p->prox_fila = NULL;
     p->tabpag = tabpag_cria();
     p->swap_inicio = -1;
     p->n_paginas = 0;
@@ -97,7 +102,7 @@ void muda_estado_proc(processo *proc, metricas *metri, es_t *relogio, enum Estad
     if(proc->estado == novo_estado) {
         return;
     }
-    console_printf("muda estado do processo %d para %d   ", pid, novo_estado);
+    log_depura(LOG_PROC, "muda estado do processo %d para %d   ", pid, novo_estado);
 
     // Marca tempo atual
     int tempo_atual = 0, tempo_inicio = 0;
@@ -127,9 +132,9 @@ void muda_estado_proc(processo *proc, metricas *metri, es_t *relogio, enum Estad
 // BLOQUEIOS DE DISPOSITIVOS DE E/S
 
 bool verifica_bloqueio_leitura(processo *proc, metricas *metrica, es_t *es, int estado, int dispositivo) {
-  console_printf("verificando bloqueio de E/S do dispositivo %d ", dispositivo);
+  log_depura(LOG_ES, "verificando bloqueio de E/S do dispositivo %d ", dispositivo);
   if (estado != 0) return true;
-  console_printf("estado zero   ");
+  log_depura(LOG_ES, "estado zero   ");
   muda_estado_proc(proc, metrica, es, BLOQUEADO);
   proc->esperando_dispositivo = dispositivo;
   return false;
@@ -139,26 +144,26 @@ int verifica_estado_dispositivo(es_t *es, int dispositivo, bool *erro_interno) {
   int estado;
   int dispositivo_ok = dispositivo + 1; // D_TERM_X + 1 = D_TERM_X_OK
   if (es_le(es, dispositivo_ok, &estado) != ERR_OK) {
-    console_printf("SO: problema no acesso ao estado do dispositivo");
+    log_erro(LOG_ES, "SO: problema no acesso ao estado do dispositivo");
     *erro_interno = true;
     return -1;
   }
-  console_printf("estado do dispositivo %d: %d   ", dispositivo_ok, estado);
+  log_depura(LOG_ES, "estado do dispositivo %d: %d   ", dispositivo_ok, estado);
   return estado;
 }
 
 bool trata_bloqueio_disp(processo *proc, metricas *metrica, es_t *es, bool *erro_interno) {
-    console_printf("verificando desbloqueio do processo %d   ", proc->pid-1);
-    console_printf("dispositivo %d   ", proc->esperando_dispositivo);
+    log_depura(LOG_ES, "verificando desbloqueio do processo %d   ", proc->pid-1);
+    log_depura(LOG_ES, "dispositivo %d   ", proc->esperando_dispositivo);
     int estado_disp = verifica_estado_dispositivo(es, proc->esperando_dispositivo, erro_interno);
     if (verifica_bloqueio_leitura(proc, metrica, es, estado_disp, proc->esperando_dispositivo)) { 
-        console_printf("%d pronto", proc->esperando_dispositivo);
+        log_depura(LOG_ES, "%d pronto", proc->esperando_dispositivo);
         
         if(proc->aguardando_leitura == false){
             int dado = proc->ultimo_char_para_escrever;
-            console_printf("escrevendo %c no disp %d", dado, proc->esperando_dispositivo);
+            log_depura(LOG_ES, "escrevendo %c no disp %d", dado, proc->esperando_dispositivo);
             if (es_escreve(es, proc->esperando_dispositivo, dado) != ERR_OK) {
-                console_printf("SO: problema no acesso à tela do dispositivo %d", proc->esperando_dispositivo);
+                log_erro(LOG_ES, "SO: problema no acesso à tela do dispositivo %d", proc->esperando_dispositivo);
                 *erro_interno = true;
                 return false;
             }
@@ -167,11 +172,11 @@ bool trata_bloqueio_disp(processo *proc, metricas *metrica, es_t *es, bool *erro
         else{
             int dado;
             if (es_le(es, proc->esperando_dispositivo, &dado) != ERR_OK) {
-                console_printf("SO: problema no acesso ao teclado do dispositivo %d", proc->esperando_dispositivo);
+                log_erro(LOG_ES, "SO: problema no acesso ao teclado do dispositivo %d", proc->esperando_dispositivo);
                 *erro_interno = true;
                 return false;
             }
-            console_printf("lendo %c do disp %d", dado, proc->esperando_dispositivo);
+            log_depura(LOG_ES, "lendo %c do disp %d", dado, proc->esperando_dispositivo);
             proc->regA = dado;
             proc->aguardando_leitura = false;
         }
@@ -184,3 +189,62 @@ bool trata_bloqueio_disp(processo *proc, metricas *metrica, es_t *es, bool *erro
     return false;              
 }
 
+
+// número de campos inteiros do processo salvos juntos, na ordem abaixo
+#define N_CAMPOS_IMAGEM 22
+
+bool processo_salva(processo *proc, FILE *arq) {
+    int campos[N_CAMPOS_IMAGEM] = {
+        proc->pid, proc->ppid, proc->terminal, proc->estado,
+        proc->regA, proc->regX, proc->regPC, proc->regERRO, proc->quantum,
+        proc->esperando_dispositivo, proc->indice_esperando_pid,
+        proc->memoria_base, proc->memoria_limite, proc->cpu, proc->afinidade,
+        proc->ultimo_char_para_escrever, proc->aguardando_leitura,
+        proc->quadro_livre, proc->swap_inicio, proc->n_paginas,
+        proc->tempo_desbloqueio, proc->n_faltas_pagina,
+    };
+    return imagem_escreve_vetor(arq, N_CAMPOS_IMAGEM, campos)
+        && imagem_escreve_vetor(arq, MAX_PROCESSOS, proc->esperando_pid)
+        && imagem_escreve_int(arq, proc->n_buf_escrita)
+        && imagem_escreve_vetor(arq, proc->n_buf_escrita, proc->buf_escrita)
+        && imagem_escreve_bytes(arq, sizeof(proc->prioridade), &proc->prioridade)
+        && imagem_escreve_bytes(arq, sizeof(proc->lru_counter), proc->lru_counter)
+        && tabpag_salva(proc->tabpag, arq);
+}
+
+processo *processo_recupera(FILE *arq) {
+    int campos[N_CAMPOS_IMAGEM];
+    if (!imagem_le_vetor(arq, N_CAMPOS_IMAGEM, campos)) return NULL;
+    processo *proc = processo_cria(campos[0], campos[1], campos[6], campos[8]);
+    if (proc == NULL) return NULL;
+    proc->terminal = campos[2];
+    proc->estado = campos[3];
+    proc->regA = campos[4];
+    proc->regX = campos[5];
+    proc->regERRO = campos[7];
+    proc->esperando_dispositivo = campos[9];
+    proc->indice_esperando_pid = campos[10];
+    proc->memoria_base = campos[11];
+    proc->memoria_limite = campos[12];
+    proc->cpu = campos[13];
+    proc->afinidade = campos[14];
+    proc->ultimo_char_para_escrever = campos[15];
+    proc->aguardando_leitura = campos[16];
+    proc->quadro_livre = campos[17];
+    proc->swap_inicio = campos[18];
+    proc->n_paginas = campos[19];
+    proc->tempo_desbloqueio = campos[20];
+    proc->n_faltas_pagina = campos[21];
+    if (!imagem_le_vetor(arq, MAX_PROCESSOS, proc->esperando_pid)
+        || !imagem_le_int(arq, &proc->n_buf_escrita)
+        || proc->n_buf_escrita < 0 || proc->n_buf_escrita > TAM_BUF_ESCRITA
+        || !imagem_le_vetor(arq, proc->n_buf_escrita, proc->buf_escrita)
+        || !imagem_le_bytes(arq, sizeof(proc->prioridade), &proc->prioridade)
+        || !imagem_le_bytes(arq, sizeof(proc->lru_counter), proc->lru_counter)
+        || !tabpag_recupera(proc->tabpag, arq)) {
+        tabpag_destroi(proc->tabpag);
+        free(proc);
+        return NULL;
+    }
+    return proc;
+}
@@ -5,11 +5,14 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include "es.h"
 #include "metrica.h"
 #include "tabpag.h"
 
-
+// tamanho do buffer de escrita de cada processo, com a escrita em bloco
+//   (ver so_config_t)
+#define TAM_BUF_ESCRITA 32
 
 typedef struct processo {
     int pid;                    // identificador do processo
@@ -25,9 +28,16 @@ typedef struct processo {
     int memoria_limite;         // limite superior da memória do processo (se/quando implementar)
     struct processo *prox;      // ponteiro para próximo processo na fila (lista encadeada)
     float prioridade;
+    int cpu;                    // CPU em cuja fila de execução o processo está
+    unsigned afinidade;         // CPUs onde o processo pode executar (bit i é a CPU i)
+    struct processo *prox_fila; // próximo processo na fila de execução da CPU
 
     int ultimo_char_para_escrever;
     bool aguardando_leitura; 
+    // caracteres escritos pelo processo que o terminal ainda não aceitou
+    //   (só com a escrita em bloco)
+    int buf_escrita[TAM_BUF_ESCRITA];
+    int n_buf_escrita;
 
     // primeiro quadro da memória que está livre (quadros anteriores estão ocupados)
     // t3: com memória virtual, o controle de memória livre e ocupada deve ser mais
@@ -46,6 +56,9 @@ typedef struct processo {
     unsigned int lru_counter[100]; // contador LRU para cada página (máximo 100 páginas)
 } processo;
 
+// afinidade de um processo que pode executar em qualquer CPU
+#define AFINIDADE_TODAS (~0u)
+
 processo *processo_cria(int id, int p_id, int pc, int max_quantum);
 
 void insere_novo_processo(processo **self, processo *novo);
@@ -62,4 +75,11 @@ int verifica_estado_dispositivo(es_t *es, int dispositivo, bool *erro_interno);
 
 bool trata_bloqueio_disp(processo *proc, metricas *metrica, es_t *es, bool *erro_interno);
 
+// salva o processo (com a tabela de páginas) na imagem (ver imagem.h)
+// os ponteiros para outros processos não são salvos, quem recupera refaz as listas
+bool processo_salva(processo *proc, FILE *arq);
+
+// cria um processo com o que está na imagem; retorna NULL em caso de erro
+processo *processo_recupera(FILE *arq);
+
 #endif // PROCESSO_H
\ No newline at end of file
@@ -0,0 +1,163 @@
+// rastro.c
+// rastro binário de eventos do SO
+// simulador de computador
+// so25b
+
+#include "rastro.h"
+#include "imagem.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// identificação do arquivo e versão do formato
+// o arquivo tem a assinatura, a versão, o tamanho do buffer, o número de
+//   registros perdidos (um long), o número de registros e os registros, do
+//   mais antigo ao mais novo
+#define ASSINATURA "so25b-rastro"
+#define VERSAO 1
+
+struct rastro_t {
+  rastro_registro_t *registros;
+  // tamanho do buffer menos 1 (o tamanho é potência de 2)
+  int mascara;
+  // número de registros já feitos (o próximo vai na posição
+  //   n_total & mascara)
+  long n_total;
+};
+
+static char *nomes[N_RASTRO_EVENTO] = {
+  [RASTRO_IRQ_ENTRA] = "irq_entra",
+  [RASTRO_IRQ_SAI]   = "irq_sai",
+  [RASTRO_CHAMADA]   = "chamada",
+  [RASTRO_FALTA]     = "falta",
+  [RASTRO_SUBSTITUI] = "substitui",
+  [RASTRO_DESPACHO]  = "despacho",
+};
+
+rastro_t *rastro_cria(int tam)
+{
+  assert(tam > 0 && (tam & (tam - 1)) == 0);
+  rastro_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->registros = malloc(tam * sizeof(*self->registros));
+  assert(self->registros != NULL);
+  self->mascara = tam - 1;
+  self->n_total = 0;
+  return self;
+}
+
+void rastro_destroi(rastro_t *self)
+{
+  free(self->registros);
+  free(self);
+}
+
+void rastro_registra(rastro_t *self, int tempo, rastro_evento_t tipo, int cpu,
+                     int pid, int arg1, int arg2)
+{
+  rastro_registro_t *r = &self->registros[self->n_total & self->mascara];
+  r->tempo = tempo;
+  r->tipo = tipo;
+  r->cpu = cpu;
+  r->pid = pid;
+  r->arg1 = arg1;
+  r->arg2 = arg2;
+  self->n_total++;
+}
+
+int rastro_n_registros(rastro_t *self)
+{
+  long tam = self->mascara + 1;
+  return self->n_total < tam ? self->n_total : tam;
+}
+
+long rastro_n_perdidos(rastro_t *self)
+{
+  return self->n_total - rastro_n_registros(self);
+}
+
+rastro_registro_t *rastro_registro(rastro_t *self, int i)
+{
+  assert(i >= 0 && i < rastro_n_registros(self));
+  return &self->registros[(rastro_n_perdidos(self) + i) & self->mascara];
+}
+
+char *rastro_nome_evento(rastro_evento_t tipo)
+{
+  if (tipo < 0 || tipo >= N_RASTRO_EVENTO) return "desconhecido";
+  return nomes[tipo];
+}
+
+
+// ---------------------------------------------------------------------
+// ARQUIVO {{{1
+// ---------------------------------------------------------------------
+
+bool rastro_grava(rastro_t *self, char *nome)
+{
+  FILE *arq = fopen(nome, "wb");
+  if (arq == NULL) return false;
+  long perdidos = rastro_n_perdidos(self);
+  int n = rastro_n_registros(self);
+  bool ok = imagem_escreve_str(arq, ASSINATURA)
+         && imagem_escreve_int(arq, VERSAO)
+         && imagem_escreve_int(arq, self->mascara + 1)
+         && imagem_escreve_bytes(arq, sizeof(perdidos), &perdidos)
+         && imagem_escreve_int(arq, n);
+  // o buffer pode ter dado a volta: os mais antigos estão do início até o
+  //   fim do buffer, e os mais novos do começo do buffer em diante
+  int inicio = perdidos & self->mascara;
+  int n_fim = n - inicio;
+  if (ok && n_fim > 0) {
+    ok = imagem_escreve_bytes(arq, n_fim * sizeof(rastro_registro_t),
+                              &self->registros[inicio]);
+  }
+  if (ok && inicio > 0) {
+    ok = imagem_escreve_bytes(arq, inicio * sizeof(rastro_registro_t),
+                              self->registros);
+  }
+  if (fclose(arq) != 0) ok = false;
+  return ok;
+}
+
+rastro_t *rastro_le(char *nome)
+{
+  FILE *arq = fopen(nome, "rb");
+  if (arq == NULL) return NULL;
+  char assinatura[sizeof(ASSINATURA)];
+  int tam, n;
+  long perdidos;
+  if (!imagem_le_str(arq, sizeof(assinatura), assinatura)
+      || strcmp(assinatura, ASSINATURA) != 0
+      || !imagem_confere_int(arq, VERSAO)
+      || !imagem_le_int(arq, &tam)
+      || tam <= 0 || (tam & (tam - 1)) != 0
+      || !imagem_le_bytes(arq, sizeof(perdidos), &perdidos)
+      || !imagem_le_int(arq, &n)
+      || n < 0 || n > tam || perdidos < 0 || (perdidos > 0 && n < tam)) {
+    fclose(arq);
+    return NULL;
+  }
+  // cada registro volta para a posição onde estava quando foi gravado
+  rastro_t *self = rastro_cria(tam);
+  self->n_total = perdidos + n;
+  int inicio = perdidos & self->mascara;
+  int n_fim = n - inicio;
+  bool ok = true;
+  if (n_fim > 0) {
+    ok = imagem_le_bytes(arq, n_fim * sizeof(rastro_registro_t),
+                         &self->registros[inicio]);
+  }
+  if (ok && inicio > 0) {
+    ok = imagem_le_bytes(arq, inicio * sizeof(rastro_registro_t), self->registros);
+  }
+  fclose(arq);
+  if (!ok) {
+    rastro_destroi(self);
+    return NULL;
+  }
+  return self;
+}
+
+// vim: foldmethod=marker
@@ -0,0 +1,80 @@
+// rastro.h
+// rastro binário de eventos do SO
+// simulador de computador
+// so25b
+
+#ifndef RASTRO_H
+#define RASTRO_H
+
+// o rastro é um buffer circular de tamanho fixo com registros pequenos dos
+//   eventos mais frequentes do SO (entrada e saída do tratamento de
+//   interrupção, chamadas de sistema, faltas de página, substituições e
+//   despachos), para ver o que o SO fez sem o custo de formatar e escrever
+//   uma linha no log para cada um
+// quando o buffer enche, os registros mais antigos são sobrescritos; no fim
+//   da simulação ele pode ser gravado em um arquivo binário, que é
+//   traduzido para texto ou para o formato de rastro do Chrome
+//   (chrome://tracing ou ui.perfetto.dev) pelo programa le_rastro
+//
+// tem um rastro por máquina, usado pelo SO com a trava dele (as funções não
+//   são protegidas contra acesso simultâneo)
+
+#include <stdbool.h>
+
+typedef struct rastro_t rastro_t;
+
+// os tipos de evento, e o significado dos argumentos de cada um
+typedef enum {
+  RASTRO_IRQ_ENTRA,   // entrada no SO: arg1 é a irq
+  RASTRO_IRQ_SAI,     // saída do SO: arg1 é a irq, arg2 é o retorno (0 volta
+                      //   a executar o processo, 1 para a CPU)
+  RASTRO_CHAMADA,     // chamada de sistema: arg1 é a chamada
+  RASTRO_FALTA,       // falta de página: arg1 é a página
+  RASTRO_SUBSTITUI,   // substituição de página: o pid é o do dono da página
+                      //   substituída, arg1 é a página, arg2 é o quadro
+  RASTRO_DESPACHO,    // troca do processo corrente: o pid é o do escolhido,
+                      //   arg1 é o pid do anterior (0 se não tinha)
+  N_RASTRO_EVENTO
+} rastro_evento_t;
+
+// um registro do rastro
+typedef struct {
+  // o relógio (em instruções) da CPU onde aconteceu o evento
+  int tempo;
+  short tipo;
+  short cpu;
+  // o processo corrente (0 se nenhum)
+  int pid;
+  int arg1;
+  int arg2;
+} rastro_registro_t;
+
+// cria um rastro vazio com espaço para 'tam' registros (uma potência de 2)
+rastro_t *rastro_cria(int tam);
+
+void rastro_destroi(rastro_t *self);
+
+// acrescenta um registro ao rastro, sobrescrevendo o mais antigo se estiver
+//   cheio
+void rastro_registra(rastro_t *self, int tempo, rastro_evento_t tipo, int cpu,
+                     int pid, int arg1, int arg2);
+
+// grava o rastro no arquivo 'nome', do registro mais antigo ao mais novo
+// retorna false em caso de erro
+bool rastro_grava(rastro_t *self, char *nome);
+
+// lê um rastro gravado por rastro_grava
+// retorna NULL em caso de erro (ou se não é um rastro desta versão)
+rastro_t *rastro_le(char *nome);
+
+// número de registros no rastro e o registro 'i' (0 é o mais antigo)
+int rastro_n_registros(rastro_t *self);
+rastro_registro_t *rastro_registro(rastro_t *self, int i);
+
+// número de registros que foram sobrescritos por falta de espaço
+long rastro_n_perdidos(rastro_t *self);
+
+// o nome de um tipo de evento
+char *rastro_nome_evento(rastro_evento_t tipo);
+
+#endif // RASTRO_H
@@ -0,0 +1,235 @@
+// registro.c
+// gravação e reprodução das entradas de uma simulação
+// simulador de computador
+// so25b
+
+#include "registro.h"
+#include "console.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// tamanho máximo do dado de uma entrada
+#define TAM_DADO 100
+
+
+// ---------------------------------------------------------------------
+// DECLARAÇÃO {{{1
+// ---------------------------------------------------------------------
+
+typedef struct {
+  char tipo;
+  long ponto;
+  int tempo;
+  char dado[TAM_DADO];
+} entrada_t;
+
+struct registro_t {
+  registro_modo_t modo;
+  relogio_t *relogio;
+  // número de pontos de verificação de entrada até agora
+  long ponto;
+  // gravação: o arquivo sendo gravado
+  FILE *arq;
+  // reprodução: as entradas lidas do arquivo, e a próxima a entregar de
+  //   cada tipo (as de valores são entregues separadas das outras)
+  entrada_t *entradas;
+  int n_entradas;
+  int prox_entrada;
+  int prox_valor;
+  bool divergiu;
+};
+
+
+// ---------------------------------------------------------------------
+// CRIAÇÃO {{{1
+// ---------------------------------------------------------------------
+
+// lê todas as entradas do arquivo
+static bool le_entradas(registro_t *self, FILE *arq)
+{
+  int cap = 0;
+  char linha[TAM_DADO + 50];
+  while (fgets(linha, sizeof(linha), arq) != NULL) {
+    linha[strcspn(linha, "\n")] = '\0';
+    if (linha[0] == '#' || linha[0] == '\0') continue;
+    if (self->n_entradas == cap) {
+      cap = cap == 0 ? 100 : cap * 2;
+      self->entradas = realloc(self->entradas, cap * sizeof(entrada_t));
+      assert(self->entradas != NULL);
+    }
+    entrada_t *e = &self->entradas[self->n_entradas];
+    int n;
+    if (sscanf(linha, "%c %ld %d%n", &e->tipo, &e->ponto, &e->tempo, &n) != 3) {
+      return false;
+    }
+    // o dado é o resto da linha, depois de um espaço
+    char *dado = linha + n;
+    if (*dado == ' ') dado++;
+    strncpy(e->dado, dado, TAM_DADO - 1);
+    e->dado[TAM_DADO - 1] = '\0';
+    self->n_entradas++;
+  }
+  return true;
+}
+
+registro_t *registro_cria(char *nome, registro_modo_t modo, relogio_t *relogio)
+{
+  registro_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->modo = modo;
+  self->relogio = relogio;
+  self->ponto = 0;
+  self->arq = NULL;
+  self->entradas = NULL;
+  self->n_entradas = 0;
+  self->prox_entrada = 0;
+  self->prox_valor = 0;
+  self->divergiu = false;
+
+  if (modo == registro_grava) {
+    self->arq = fopen(nome, "w");
+    if (self->arq == NULL) {
+      free(self);
+      return NULL;
+    }
+    fprintf(self->arq, "# entradas de uma execução do simulador\n");
+    fprintf(self->arq, "# tipo ponto tempo dado\n");
+  } else {
+    FILE *arq = fopen(nome, "r");
+    if (arq == NULL) {
+      free(self);
+      return NULL;
+    }
+    bool ok = le_entradas(self, arq);
+    fclose(arq);
+    if (!ok) {
+      registro_destroi(self);
+      return NULL;
+    }
+  }
+  return self;
+}
+
+void registro_destroi(registro_t *self)
+{
+  if (self->arq != NULL) fclose(self->arq);
+  free(self->entradas);
+  free(self);
+}
+
+registro_modo_t registro_modo(registro_t *self)
+{
+  return self->modo;
+}
+
+
+// ---------------------------------------------------------------------
+// GRAVAÇÃO {{{1
+// ---------------------------------------------------------------------
+
+static int agora(registro_t *self)
+{
+  int tempo;
+  relogio_leitura(self->relogio, 0, &tempo);
+  return tempo;
+}
+
+void registro_ponto(registro_t *self)
+{
+  self->ponto++;
+}
+
+static void grava(registro_t *self, char tipo, char *dado)
+{
+  fprintf(self->arq, "%c %ld %d %s\n", tipo, self->ponto, agora(self), dado);
+}
+
+void registro_grava_entrada(registro_t *self, char tipo, char *dado)
+{
+  if (self->modo != registro_grava) return;
+  grava(self, tipo, dado);
+}
+
+void registro_encerra(registro_t *self)
+{
+  if (self->modo != registro_grava) return;
+  grava(self, 'F', "");
+  fflush(self->arq);
+}
+
+
+// ---------------------------------------------------------------------
+// REPRODUÇÃO {{{1
+// ---------------------------------------------------------------------
+
+// confere se a entrada está sendo reproduzida no mesmo tempo em que foi gravada
+static void confere_tempo(registro_t *self, entrada_t *e)
+{
+  if (self->divergiu || e->tempo == agora(self)) return;
+  self->divergiu = true;
+  console_printf("REGISTRO: entrada '%c' gravada no tempo %d reproduzida no tempo %d",
+                 e->tipo, e->tempo, agora(self));
+}
+
+// avança até a próxima entrada que não é de valor
+static entrada_t *proxima(registro_t *self)
+{
+  while (self->prox_entrada < self->n_entradas) {
+    entrada_t *e = &self->entradas[self->prox_entrada];
+    if (e->tipo != 'R') return e;
+    self->prox_entrada++;
+  }
+  return NULL;
+}
+
+char registro_proxima_entrada(registro_t *self, char *dado, int tam)
+{
+  if (self->modo != registro_reproduz) return '\0';
+  entrada_t *e = proxima(self);
+  if (e == NULL || e->tipo == 'F' || e->ponto > self->ponto) return '\0';
+  confere_tempo(self, e);
+  strncpy(dado, e->dado, tam - 1);
+  dado[tam - 1] = '\0';
+  self->prox_entrada++;
+  return e->tipo;
+}
+
+bool registro_terminou(registro_t *self)
+{
+  if (self->modo != registro_reproduz) return false;
+  entrada_t *e = proxima(self);
+  return e != NULL && e->tipo == 'F' && e->ponto <= self->ponto;
+}
+
+int registro_valor(registro_t *self, int valor)
+{
+  if (self->modo == registro_grava) {
+    char dado[20];
+    sprintf(dado, "%d", valor);
+    grava(self, 'R', dado);
+    return valor;
+  }
+  while (self->prox_valor < self->n_entradas) {
+    entrada_t *e = &self->entradas[self->prox_valor++];
+    if (e->tipo == 'R') {
+      confere_tempo(self, e);
+      return atoi(e->dado);
+    }
+  }
+  // a execução leu mais valores que a gravada
+  if (!self->divergiu) {
+    self->divergiu = true;
+    console_printf("REGISTRO: leitura de tempo real que não foi gravada");
+  }
+  return valor;
+}
+
+bool registro_divergiu(registro_t *self)
+{
+  return self->divergiu;
+}
+
+// vim: foldmethod=marker
@@ -0,0 +1,74 @@
+// registro.h
+// gravação e reprodução das entradas de uma simulação
+// simulador de computador
+// so25b
+
+#ifndef REGISTRO_H
+#define REGISTRO_H
+
+// a simulação é determinística, a não ser pelo que vem de fora: o que o
+//   operador digita na console (comandos e entrada dos terminais), as linhas
+//   dos arquivos de entrada dos terminais e o tempo real lido do relógio
+// na gravação, cada uma dessas entradas é escrita em um arquivo, junto com o
+//   momento em que ela aconteceu; na reprodução, as entradas são lidas do
+//   arquivo e entregues no mesmo momento, e a simulação repete exatamente a
+//   execução gravada, sem tela e sem esperar pelo operador
+//
+// o momento de uma entrada é o número do ponto de verificação de entrada da
+//   console (ela marca um ponto cada vez que verifica o teclado ou os
+//   arquivos, ver registro_ponto); o relógio da CPU também é gravado, e serve
+//   para detectar se a reprodução divergiu da gravação
+// só funciona com uma CPU (com várias, a ordem entre as threads não se repete)
+//
+// o arquivo é texto, uma entrada por linha:
+//   tipo ponto tempo dado
+// com os tipos:
+//   L linha digitada pelo operador na console (dado é a linha)
+//   T linha de um arquivo de entrada de terminal (dado é o terminal e a linha)
+//   C comando externo (dado é o comando)
+//   R valor lido do tempo real (dado é o valor)
+//   F fim da simulação
+
+#include "relogio.h"
+#include <stdbool.h>
+
+typedef struct registro_t registro_t;
+
+typedef enum { registro_grava, registro_reproduz } registro_modo_t;
+
+// cria um registro para gravar ou reproduzir o arquivo 'nome'
+// o tempo das entradas é lido de 'relogio'
+// retorna NULL se o arquivo não puder ser aberto (ou estiver mal formado)
+registro_t *registro_cria(char *nome, registro_modo_t modo, relogio_t *relogio);
+
+// destrói o registro (na gravação, fecha o arquivo)
+void registro_destroi(registro_t *self);
+
+registro_modo_t registro_modo(registro_t *self);
+
+// marca mais um ponto de verificação de entrada
+void registro_ponto(registro_t *self);
+
+// gravação: grava uma entrada do tipo 'tipo' (L, T ou C) no ponto atual
+void registro_grava_entrada(registro_t *self, char tipo, char *dado);
+
+// gravação: grava o fim da simulação
+void registro_encerra(registro_t *self);
+
+// reprodução: se tem uma entrada (L, T ou C) no ponto atual, copia o dado em
+//   'dado' (com até tam-1 caracteres) e retorna o tipo; senão, retorna '\0'
+char registro_proxima_entrada(registro_t *self, char *dado, int tam);
+
+// reprodução: retorna true se a simulação gravada terminou no ponto atual
+bool registro_terminou(registro_t *self);
+
+// valor lido de uma fonte não determinística
+// na gravação, grava e retorna 'valor'; na reprodução, retorna o valor
+//   gravado no lugar dele
+int registro_valor(registro_t *self, int valor);
+
+// retorna true se a reprodução encontrou alguma entrada em um tempo
+//   diferente do gravado (a execução não está sendo igual à gravada)
+bool registro_divergiu(registro_t *self);
+
+#endif // REGISTRO_H
@@ -4,34 +4,111 @@
 // so25b
 
 #include "relogio.h"
+#include "registro.h"
+#include "imagem.h"
+#include "pic.h"
 
 #include <stdbool.h>
 #include <stdlib.h>
 #include <time.h>
 #include <assert.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <pthread.h>
+
+// a identificação de um evento tem o número da sua posição no vetor de
+//   eventos nos bits baixos e a geração da posição (quantas vezes ela foi
+//   usada) nos altos, para que a identificação de um evento já disparado
+//   não cancele outro que foi agendado depois na mesma posição
+#define BITS_POSICAO 20
+#define MASCARA_POSICAO ((1 << BITS_POSICAO) - 1)
+#define MASCARA_GERACAO ((1 << (31 - BITS_POSICAO - 1)) - 1)
+// tamanho inicial do vetor de eventos (dobra quando enche)
+#define EVENTOS_INICIAL 16
+
+// um evento agendado, ou uma posição livre no vetor de eventos
+typedef struct {
+  // instante em que o evento deve ser disparado
+  int quando;
+  // ordem de agendamento, para desempatar eventos no mesmo instante
+  long ordem;
+  relogio_f_evento_t func;
+  void *arg;
+  // posição do evento no heap, ou -1 se a posição está livre
+  int no_heap;
+  // geração da posição (ver BITS_POSICAO)
+  int geracao;
+  // próxima posição livre, se esta estiver livre (-1 se é a última)
+  int prox_livre;
+} evento_t;
 
 struct relogio_t {
   // que horas são (em tics)
-  int agora;
+  // pode ser lido pela thread de outra CPU (ver controle.c)
+  atomic_int agora;
   // quanto tempo até gerar uma interrupção
   int t_ate_interrupcao;
-  // true se está gerando interrupção
+  // true se está gerando interrupção (é a linha do relógio no controlador
+  //   de interrupções)
   bool interrupcao_ativa;
+  pic_t *pic;
+  // quanto tempo passou com a CPU parada (em tics)
+  // também pode ser lido por outra thread (pelo SO, para as métricas)
+  atomic_int ocioso;
+
+  // eventos agendados: ficam em 'eventos' (que cresce quando enche, e tem
+  //   as posições livres encadeadas a partir de 'livre'), e 'heap' tem as
+  //   posições dos 'n_eventos' agendados, com o mais próximo em heap[0]
+  // cada evento sabe onde está no heap, para ser cancelado sem busca
+  // os eventos são protegidos pela trava (o SO pode agendar em uma thread e
+  //   a CPU avançar o relógio em outra); 'prazo' é o instante do primeiro
+  //   evento (INT_MAX se não tem), para que a passagem do tempo só teste um
+  //   inteiro
+  pthread_mutex_t trava;
+  evento_t *eventos;
+  int *heap;
+  int tam_eventos;
+  int n_eventos;
+  int livre;
+  long n_agendados;
+  atomic_int prazo;
+
+  // onde gravar ou reproduzir as leituras do tempo real (ou NULL)
+  registro_t *registro;
 };
 
+static void dispara_eventos(relogio_t *self);
+static void muda_interrupcao(relogio_t *self, bool ativa);
+
 relogio_t *relogio_cria(void)
 {
   relogio_t *self;
   self = malloc(sizeof(relogio_t));
   assert(self != NULL);
 
-  self->agora = 0;
+  atomic_init(&self->agora, 0);
+  self->t_ate_interrupcao = 0;
+  self->interrupcao_ativa = false;
+  self->pic = NULL;
+  atomic_init(&self->ocioso, 0);
+  pthread_mutex_init(&self->trava, NULL);
+  self->eventos = NULL;
+  self->heap = NULL;
+  self->tam_eventos = 0;
+  self->n_eventos = 0;
+  self->livre = -1;
+  self->n_agendados = 0;
+  atomic_init(&self->prazo, INT_MAX);
+  self->registro = NULL;
 
   return self;
 }
 
 void relogio_destroi(relogio_t *self)
 {
+  pthread_mutex_destroy(&self->trava);
+  free(self->eventos);
+  free(self->heap);
   free(self);
 }
 
@@ -42,9 +119,31 @@ void relogio_tictac(relogio_t *self)
   if (self->t_ate_interrupcao != 0) {
     self->t_ate_interrupcao--;
     if (self->t_ate_interrupcao == 0) {
-      self->interrupcao_ativa = true;
+      muda_interrupcao(self, true);
     }
   }
+  if (self->agora >= self->prazo) dispara_eventos(self);
+}
+
+void relogio_tictac_n(relogio_t *self, int n)
+{
+  self->agora += n;
+  // vê se tem que gerar interrupção
+  if (self->t_ate_interrupcao != 0) {
+    if (n >= self->t_ate_interrupcao) {
+      self->t_ate_interrupcao = 0;
+      muda_interrupcao(self, true);
+    } else {
+      self->t_ate_interrupcao -= n;
+    }
+  }
+  if (self->agora >= self->prazo) dispara_eventos(self);
+}
+
+void relogio_tictac_ocioso(relogio_t *self, int n)
+{
+  relogio_tictac_n(self, n);
+  self->ocioso += n;
 }
 
 err_t relogio_leitura(void *disp, int id, int *pvalor)
@@ -57,6 +156,7 @@ err_t relogio_leitura(void *disp, int id, int *pvalor)
       break;
     case 1:
       *pvalor = clock() / (CLOCKS_PER_SEC / 1000);
+      if (self->registro != NULL) *pvalor = registro_valor(self->registro, *pvalor);
       break;
     case 2:
       *pvalor = self->t_ate_interrupcao;
@@ -64,6 +164,9 @@ err_t relogio_leitura(void *disp, int id, int *pvalor)
     case 3:
       *pvalor = self->interrupcao_ativa;
       break;
+    case 4:
+      *pvalor = self->ocioso;
+      break;
     default: 
       err = ERR_END_INV;
   }
@@ -79,10 +182,203 @@ err_t relogio_escrita(void *disp, int id, int pvalor)
       self->t_ate_interrupcao = pvalor;
       break;
     case 3:
-      self->interrupcao_ativa = (pvalor != 0);
+      muda_interrupcao(self, pvalor != 0);
       break;
     default: 
       err = ERR_END_INV;
   }
   return err;
 }
+
+void relogio_define_registro(relogio_t *self, registro_t *registro)
+{
+  self->registro = registro;
+}
+
+void relogio_define_pic(relogio_t *self, pic_t *pic)
+{
+  self->pic = pic;
+  if (pic != NULL) pic_nivel(pic, IRQ_RELOGIO, 0, self->interrupcao_ativa);
+}
+
+// altera o pedido de interrupção, e a linha no controlador
+static void muda_interrupcao(relogio_t *self, bool ativa)
+{
+  self->interrupcao_ativa = ativa;
+  if (self->pic != NULL) pic_nivel(self->pic, IRQ_RELOGIO, 0, ativa);
+}
+
+
+// eventos
+
+// true se o evento na posição a do heap deve ser disparado antes do na b
+static bool antes(relogio_t *self, int a, int b)
+{
+  evento_t *ea = &self->eventos[self->heap[a]];
+  evento_t *eb = &self->eventos[self->heap[b]];
+  if (ea->quando != eb->quando) return ea->quando < eb->quando;
+  return ea->ordem < eb->ordem;
+}
+
+static void troca(relogio_t *self, int i, int j)
+{
+  int t = self->heap[i];
+  self->heap[i] = self->heap[j];
+  self->heap[j] = t;
+  self->eventos[self->heap[i]].no_heap = i;
+  self->eventos[self->heap[j]].no_heap = j;
+}
+
+// reorganiza o heap depois de alterar o evento na posição i
+static void reposiciona(relogio_t *self, int i)
+{
+  while (i > 0 && antes(self, i, (i - 1) / 2)) {
+    troca(self, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+  for (;;) {
+    int menor = i;
+    int esq = 2 * i + 1;
+    int dir = esq + 1;
+    if (esq < self->n_eventos && antes(self, esq, menor)) menor = esq;
+    if (dir < self->n_eventos && antes(self, dir, menor)) menor = dir;
+    if (menor == i) break;
+    troca(self, i, menor);
+    i = menor;
+  }
+}
+
+// dobra o tamanho do vetor de eventos (e do heap), encadeando as novas
+//   posições como livres
+static void cresce(relogio_t *self)
+{
+  int tam = self->tam_eventos == 0 ? EVENTOS_INICIAL : 2 * self->tam_eventos;
+  assert(tam <= MASCARA_POSICAO + 1);
+  self->eventos = realloc(self->eventos, tam * sizeof(*self->eventos));
+  self->heap = realloc(self->heap, tam * sizeof(*self->heap));
+  assert(self->eventos != NULL && self->heap != NULL);
+  for (int i = tam - 1; i >= self->tam_eventos; i--) {
+    self->eventos[i].no_heap = -1;
+    self->eventos[i].geracao = 0;
+    self->eventos[i].prox_livre = self->livre;
+    self->livre = i;
+  }
+  self->tam_eventos = tam;
+}
+
+// retira o evento na posição i do heap, e libera a posição dele
+static void retira(relogio_t *self, int i)
+{
+  evento_t *ev = &self->eventos[self->heap[i]];
+  ev->no_heap = -1;
+  ev->geracao = (ev->geracao + 1) & MASCARA_GERACAO;
+  ev->prox_livre = self->livre;
+  self->livre = self->heap[i];
+  self->n_eventos--;
+  if (i < self->n_eventos) {
+    self->heap[i] = self->heap[self->n_eventos];
+    self->eventos[self->heap[i]].no_heap = i;
+    reposiciona(self, i);
+  }
+}
+
+static void atualiza_prazo(relogio_t *self)
+{
+  self->prazo = self->n_eventos > 0 ? self->eventos[self->heap[0]].quando : INT_MAX;
+}
+
+int relogio_agenda(relogio_t *self, int quando, relogio_f_evento_t func, void *arg)
+{
+  pthread_mutex_lock(&self->trava);
+  if (self->livre < 0) cresce(self);
+  int pos = self->livre;
+  evento_t *ev = &self->eventos[pos];
+  self->livre = ev->prox_livre;
+  ev->quando = quando;
+  ev->ordem = self->n_agendados++;
+  ev->func = func;
+  ev->arg = arg;
+  ev->no_heap = self->n_eventos;
+  self->heap[self->n_eventos] = pos;
+  self->n_eventos++;
+  reposiciona(self, self->n_eventos - 1);
+  atualiza_prazo(self);
+  // a identificação é sempre positiva
+  int id = (ev->geracao << BITS_POSICAO | pos) + 1;
+  pthread_mutex_unlock(&self->trava);
+  return id;
+}
+
+bool relogio_cancela(relogio_t *self, int id)
+{
+  if (id <= 0) return false;
+  int pos = (id - 1) & MASCARA_POSICAO;
+  int geracao = (id - 1) >> BITS_POSICAO;
+  pthread_mutex_lock(&self->trava);
+  bool achou = pos < self->tam_eventos
+            && self->eventos[pos].no_heap >= 0
+            && self->eventos[pos].geracao == geracao;
+  if (achou) {
+    retira(self, self->eventos[pos].no_heap);
+    atualiza_prazo(self);
+  }
+  pthread_mutex_unlock(&self->trava);
+  return achou;
+}
+
+int relogio_proximo_prazo(relogio_t *self)
+{
+  int prazo = self->prazo;
+  if (self->t_ate_interrupcao > 0) {
+    int interrupcao = self->agora + self->t_ate_interrupcao;
+    if (interrupcao < prazo) prazo = interrupcao;
+  }
+  return prazo == INT_MAX ? -1 : prazo;
+}
+
+// dispara os eventos cujo instante já chegou, em ordem
+// a função de cada evento é chamada sem a trava, e pode agendar outros
+static void dispara_eventos(relogio_t *self)
+{
+  pthread_mutex_lock(&self->trava);
+  while (self->n_eventos > 0 && self->eventos[self->heap[0]].quando <= self->agora) {
+    evento_t ev = self->eventos[self->heap[0]];
+    retira(self, 0);
+    atualiza_prazo(self);
+    pthread_mutex_unlock(&self->trava);
+    ev.func(ev.arg, ev.quando);
+    pthread_mutex_lock(&self->trava);
+  }
+  pthread_mutex_unlock(&self->trava);
+}
+
+
+// imagem
+
+bool relogio_salva(relogio_t *self, FILE *arq)
+{
+  return imagem_escreve_int(arq, atomic_load(&self->agora))
+      && imagem_escreve_int(arq, self->t_ate_interrupcao)
+      && imagem_escreve_int(arq, self->interrupcao_ativa)
+      && imagem_escreve_int(arq, atomic_load(&self->ocioso));
+}
+
+bool relogio_recupera(relogio_t *self, FILE *arq)
+{
+  int agora, t_ate_interrupcao, interrupcao_ativa, ocioso;
+  if (!imagem_le_int(arq, &agora)
+      || !imagem_le_int(arq, &t_ate_interrupcao)
+      || !imagem_le_int(arq, &interrupcao_ativa)
+      || !imagem_le_int(arq, &ocioso)) {
+    return false;
+  }
+  atomic_store(&self->agora, agora);
+  self->t_ate_interrupcao = t_ate_interrupcao;
+  muda_interrupcao(self, interrupcao_ativa);
+  atomic_store(&self->ocioso, ocioso);
+  pthread_mutex_lock(&self->trava);
+  while (self->n_eventos > 0) retira(self, self->n_eventos - 1);
+  atualiza_prazo(self);
+  pthread_mutex_unlock(&self->trava);
+  return true;
+}
@@ -8,11 +8,12 @@
 
 // simulador do relógio
 // dispositivo de E/S que registra a passagem do tempo
-// tem 4 dispositivos de leitura (dois deles também de escrita), para:
+// tem 5 dispositivos de leitura (dois deles também de escrita), para:
 // - retornar o número de instruções executadas
 // - retornar o tempo de execução do simulador
 // - retornar (ou programar) o tempo até gerar a próxima interrupção
 // - retornar (ou programar) se uma interrupção está sendo pedida pelo relógio
+// - retornar o tempo passado com a CPU parada
 
 // tem 3 operações:
 // - passagem do tempo (tictac), deve ser chamada após a execução de cada instrução
@@ -20,10 +21,19 @@
 //   dispositivo
 // - escrita de dados, a ser usada pelo controlador de E/S para acessar este
 //   dispositivo
+//
+// além disso, mantém uma fila de eventos: qualquer componente do simulador
+//   (ou o SO) pode agendar uma função para ser chamada em um instante do
+//   relógio; as funções são chamadas pela passagem do tempo, portanto pela
+//   thread que executa a CPU dona do relógio
 
 #include "err.h"
+#include <stdio.h>
+#include <stdbool.h>
 
 typedef struct relogio_t relogio_t;
+struct registro_t;
+struct pic_t;
 
 // cria e inicializa um relógio
 relogio_t *relogio_cria(void);
@@ -36,13 +46,62 @@ void relogio_destroi(relogio_t *self);
 // esta função é chamada pelo controlador após a execução de cada instrução
 void relogio_tictac(relogio_t *self);
 
+// registra a passagem de n unidades de tempo, como n chamadas a relogio_tictac
+void relogio_tictac_n(relogio_t *self, int n);
+
+// registra a passagem de n unidades de tempo com a CPU parada
+// além de passar o tempo como relogio_tictac_n, conta o tempo ocioso
+void relogio_tictac_ocioso(relogio_t *self, int n);
+
 // Funções para acessar o relógio como dispositivo de E/S, com id:
 //   '0' para ler o relógio local (contador de instruções)
 //   '1' para ler o tempo de CPU consumido pelo simulador (em ms)
 //   '2' para ler ou escrever em quanto tempo uma interrupção será gerada
 //   '3' para ler ou escrever se uma interrupção está sendo pedida
+//   '4' para ler o tempo passado com a CPU parada (em instruções)
 // Devem seguir o protocolo f_leitura_t e f_escrita_t declarados em es.h
 err_t relogio_leitura(void *disp, int id, int *pvalor);
 err_t relogio_escrita(void *disp, int id, int pvalor);
 
+// define o registro onde são gravadas (ou de onde são reproduzidas) as
+//   leituras do tempo real (dispositivo '1'), que não se repetem de uma
+//   execução para outra (ver registro.h)
+void relogio_define_registro(relogio_t *self, struct registro_t *registro);
+
+// define o controlador de interrupções onde o relógio pede interrupção
+//   (IRQ_RELOGIO, pela linha 0), enquanto o timer estiver expirado
+void relogio_define_pic(relogio_t *self, struct pic_t *pic);
+
+// tipo da função chamada quando chega o instante de um evento
+// recebe o argumento passado a relogio_agenda e o instante agendado
+typedef void (*relogio_f_evento_t)(void *arg, int quando);
+
+// agenda a chamada de 'func(arg, quando)' quando o relógio chegar no instante
+//   'quando' (absoluto, em tics); um evento no passado é disparado na próxima
+//   passagem do tempo; eventos no mesmo instante são disparados na ordem em
+//   que foram agendados
+// pode ser chamada por qualquer thread, inclusive de dentro de um evento
+// não há limite para o número de eventos agendados; mata o programa em caso
+//   de erro (malloc)
+// retorna a identificação do evento (positiva)
+int relogio_agenda(relogio_t *self, int quando, relogio_f_evento_t func, void *arg);
+
+// cancela o evento com a identificação 'id', sem percorrer a fila
+// retorna false se o evento não existe (ou já foi disparado)
+bool relogio_cancela(relogio_t *self, int id);
+
+// retorna o instante do próximo evento ou da próxima interrupção do relógio,
+//   o que vier primeiro, ou -1 se não tem nenhum dos dois
+// quem avança o relógio pode usar para avançar direto até lá
+int relogio_proximo_prazo(relogio_t *self);
+
+// salva o estado do relógio na imagem 'arq' (ver imagem.h)
+// os eventos agendados não são salvos (são funções, que só valem nesta
+//   execução); quem agendou deve agendar de novo depois de recuperar
+bool relogio_salva(relogio_t *self, FILE *arq);
+
+// recupera o estado do relógio da imagem 'arq'
+// os eventos agendados são descartados
+bool relogio_recupera(relogio_t *self, FILE *arq);
+
 #endif // RELOGIO_H
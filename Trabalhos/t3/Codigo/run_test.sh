@@ -4,16 +4,9 @@
 # Remove log antigo
 rm -f log_da_console
 
-# Executa o simulador com comandos automáticos
-# C = continua (execução contínua)
-# Aguarda 10 segundos para dar tempo de processar
-# F = fim
-{
-    sleep 0.5
-    echo "c"  # Continua
-    sleep 10  # Deixa executar por 10 segundos
-    echo "f"  # Finaliza
-} | timeout 15 ./main
+# Executa o simulador em lote (sem tela), até todos os processos morrerem
+# ou até o limite de instruções; imprime o relatório de desempenho e métricas
+timeout 15 ./main -l -m 10000000
 
 # Mostra o log gerado
 echo "========== LOG DA CONSOLE =========="
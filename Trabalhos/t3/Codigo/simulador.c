@@ -0,0 +1,512 @@
+// simulador.c
+// uma simulação completa: o computador simulado e o SO
+// simulador de computador
+// so25b
+
+#include "simulador.h"
+#include "controle.h"
+#include "programa.h"
+#include "memoria.h"
+#include "mmu.h"
+#include "cpu.h"
+#include "relogio.h"
+#include "pic.h"
+#include "console.h"
+#include "terminal.h"
+#include "es.h"
+#include "dispositivos.h"
+#include "imagem.h"
+#include "rastro.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <time.h>
+
+// número de eventos guardados no rastro (os mais recentes)
+#define RASTRO_TAM 16384
+
+// ---------------------------------------------------------------------
+// DECLARAÇÃO {{{1
+// ---------------------------------------------------------------------
+
+// os componentes de cada CPU
+// as CPUs compartilham a memória e a console; cada uma tem sua MMU, seu
+//   relógio (que gera as interrupções dela), seu controlador de interrupções
+//   e seu controlador de E/S, onde estão registrados os terminais (os mesmos
+//   para todas), o seu relógio e o seu controlador de interrupções
+// os terminais e o disco pedem interrupção ao controlador da CPU 0
+typedef struct {
+  mmu_t *mmu;
+  relogio_t *relogio;
+  pic_t *pic;
+  es_t *es;
+  cpu_t *cpu;
+  controle_t *controle;
+} processador_t;
+
+struct simulador_t {
+  simulador_config_t *config;
+  // o computador simulado
+  mem_t *mem;
+  mem_t *disco;
+  console_t *console;
+  int n_cpus;
+  processador_t cpu[CPU_MAX];
+  registro_t *registro;
+  // o sistema operacional, e o rastro dos seus eventos
+  so_t *so;
+  rastro_t *rastro;
+  // tempo real da execução
+  double tempo;
+};
+
+void simulador_config_padrao(simulador_config_t *config)
+{
+  config->lote = false;
+  config->log = "log_da_console";
+  for (int t = 0; t < 4; t++) config->entrada[t] = NULL;
+  config->limite = 0;
+  config->rajada = RAJADA_MAX;
+  config->n_cpus = 1;
+  config->tam_mem = 10000;
+  config->fila_terminal = 0;
+  config->fila_entrada_terminal = 0;
+  config->historico = 4096;
+  config->registro = NULL;
+  config->modo_registro = registro_grava;
+  config->salva_imagem = NULL;
+  config->recupera_imagem = NULL;
+  config->rastro = NULL;
+  config->metricas = NULL;
+  so_config_padrao(&config->so);
+}
+
+// converte 'valor' em um inteiro entre min e max
+static bool converte_int(char *valor, int min, int max, int *pint)
+{
+  char *fim;
+  long v = strtol(valor, &fim, 10);
+  if (*valor == '\0' || *fim != '\0' || v < min || v > max) return false;
+  *pint = v;
+  return true;
+}
+
+bool simulador_config_define(simulador_config_t *config, char *nome, char *valor)
+{
+  so_config_t *so = &config->so;
+  if (strcmp(nome, "memoria") == 0) {
+    return converte_int(valor, 1000, 1000000, &config->tam_mem);
+  } else if (strcmp(nome, "fila") == 0) {
+    // com fila de saída, o SO passa a escrita dos processos em bloco
+    bool ok = converte_int(valor, 0, 1000, &config->fila_terminal);
+    so->escrita_em_bloco = config->fila_terminal > 0;
+    return ok;
+  } else if (strcmp(nome, "fila_entrada") == 0) {
+    return converte_int(valor, 0, 1000, &config->fila_entrada_terminal);
+  } else if (strcmp(nome, "historico") == 0) {
+    return converte_int(valor, 100, 1000000, &config->historico);
+  } else if (strcmp(nome, "cpus") == 0) {
+    return converte_int(valor, 1, CPU_MAX, &config->n_cpus);
+  } else if (strcmp(nome, "limite") == 0) {
+    return converte_int(valor, 0, INT_MAX, &config->limite);
+  } else if (strcmp(nome, "rajada") == 0) {
+    return converte_int(valor, 1, INT_MAX, &config->rajada);
+  } else if (strcmp(nome, "intervalo") == 0) {
+    return converte_int(valor, 1, INT_MAX, &so->intervalo_interrupcao);
+  } else if (strcmp(nome, "quantum") == 0) {
+    return converte_int(valor, 1, INT_MAX, &so->quantum);
+  } else if (strcmp(nome, "escalonador") == 0) {
+    if (strcmp(valor, "rr") == 0) {
+      so->escalonador = ESC_RR;
+    } else if (strcmp(valor, "prioridade") == 0) {
+      so->escalonador = ESC_PRIORIDADE;
+    } else {
+      return false;
+    }
+    return true;
+  } else if (strcmp(nome, "init") == 0) {
+    if (*valor == '\0') return false;
+    so->init = valor;
+    return true;
+  } else if (strcmp(nome, "substituicao") == 0) {
+    if (strcmp(valor, "fifo") == 0) {
+      so->substituicao = MEM_Q_FIFO;
+    } else if (strcmp(valor, "sc") == 0) {
+      so->substituicao = MEM_Q_SC;
+    } else {
+      return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+
+// ---------------------------------------------------------------------
+// CRIAÇÃO {{{1
+// ---------------------------------------------------------------------
+
+// registra no controlador de es os 4 dispositivos do terminal 'id_term'
+//   da console, com valores a partir de n_disp
+static void registra_terminal(simulador_t *self, es_t *es, int n_disp, char id_term)
+{
+  terminal_t *terminal;
+  terminal = console_terminal(self->console, id_term);
+  // por exemplo, depois de registrado, quando o controlador de ES receber um
+  //   pedido de leitura do dispositivo 'n_disp+TERM_TECLADO' (que é 4 para
+  //   o terminal 'B'), vai chamar a função 'terminal_leitura', passando como
+  //   argumentos o valor de 'terminal' (que é o terminal 'B' obtido acima) e
+  //   o valor TERM_TECLADO
+  es_registra_dispositivo(es, n_disp + TERM_TECLADO,    terminal, TERM_TECLADO,    terminal_leitura, NULL);
+  es_registra_dispositivo(es, n_disp + TERM_TECLADO_OK, terminal, TERM_TECLADO_OK, terminal_leitura, terminal_escrita);
+  es_registra_dispositivo(es, n_disp + TERM_TELA,       terminal, TERM_TELA,       NULL, terminal_escrita);
+  es_registra_dispositivo(es, n_disp + TERM_TELA_OK,    terminal, TERM_TELA_OK,    terminal_leitura, terminal_escrita);
+  es_registra_escrita_bloco(es, n_disp + TERM_TELA, terminal_escrita_bloco);
+}
+
+// inicializa a memória ROM com o conteúdo do programa em bios.maq
+static bool inicializa_rom(mem_t *mem)
+{
+  // programa para executar na nossa CPU
+  programa_t *prog = prog_cria("bios.maq");
+  if (prog == NULL) {
+    fprintf(stderr, "Erro na leitura da ROM ('bios.maq')\n");
+    return false;
+  }
+
+  bool ok = false;
+  int end_ini = prog_end_carga(prog);
+  int end_fim = end_ini + prog_tamanho(prog);
+  if (end_ini != CPU_END_RESET) {
+    fprintf(stderr, "ROM não inicia no endereço %d (%d)\n", CPU_END_RESET, end_ini);
+  } else if (end_fim > CPU_END_FIM_ROM) {
+    fprintf(stderr, "conteúdo da ROM muito grande (%d>%d)\n", end_fim, CPU_END_FIM_ROM);
+  } else {
+    ok = true;
+    for (int end = end_ini; end < end_fim; end++) {
+      if (mem_escreve(mem, end, prog_dado(prog, end)) != ERR_OK) {
+        fprintf(stderr, "Erro na carga da memória ROM, endereco %d\n", end);
+        ok = false;
+        break;
+      }
+    }
+  }
+  prog_destroi(prog);
+  return ok;
+}
+
+static void inicializa_disco(mem_t *disco) {
+  for(int i = 0; i < mem_tam(disco); i++) mem_escreve(disco, i, 0);
+}
+
+// cria os componentes da CPU 'n'
+static void cria_processador(simulador_t *self, int n)
+{
+  processador_t *p = &self->cpu[n];
+  // cria a MMU
+  p->mmu = mmu_cria(self->mem);
+  p->relogio = relogio_cria();
+  p->pic = pic_cria();
+  relogio_define_pic(p->relogio, p->pic);
+
+  // cria o controlador de E/S e registra os dispositivos
+  //   por exemplo, o dispositivo 8 do controlador de E/S (e da CPU) será o
+  //   dispositivo 0 do relógio (que é o contador de instruções)
+  p->es = es_cria();
+  // registra os 4 dispositivos de cada terminal
+  registra_terminal(self, p->es, D_TERM_A, 'A');
+  registra_terminal(self, p->es, D_TERM_B, 'B');
+  registra_terminal(self, p->es, D_TERM_C, 'C');
+  registra_terminal(self, p->es, D_TERM_D, 'D');
+  // registra os 4 dispositivos do relógio
+  es_registra_dispositivo(p->es, D_RELOGIO_INSTRUCOES, p->relogio, 0, relogio_leitura, NULL);
+  es_registra_dispositivo(p->es, D_RELOGIO_REAL      , p->relogio, 1, relogio_leitura, NULL);
+  es_registra_dispositivo(p->es, D_RELOGIO_TIMER     , p->relogio, 2, relogio_leitura, relogio_escrita);
+  es_registra_dispositivo(p->es, D_RELOGIO_INTERRUPCAO,p->relogio, 3, relogio_leitura, relogio_escrita);
+  es_registra_dispositivo(p->es, D_RELOGIO_OCIOSO    , p->relogio, 4, relogio_leitura, NULL);
+  // registra os 4 dispositivos do controlador de interrupções
+  es_registra_dispositivo(p->es, D_PIC_PENDENTES, p->pic, PIC_PENDENTES, pic_leitura, NULL);
+  es_registra_dispositivo(p->es, D_PIC_MASCARA  , p->pic, PIC_MASCARA,   pic_leitura, pic_escrita);
+  es_registra_dispositivo(p->es, D_PIC_RECONHECE, p->pic, PIC_RECONHECE, NULL, pic_escrita);
+  es_registra_dispositivo(p->es, D_PIC_PEDE     , p->pic, PIC_PEDE,      NULL, pic_escrita);
+
+  // cria a unidade de execução e inicializa com a MMU e o controlador de E/S
+  p->cpu = cpu_cria(p->mmu, p->es);
+
+  // cria o controlador da CPU e inicializa com a unidade de execução, a console,
+  //   o relógio e o controlador de interrupções; as CPUs secundárias são
+  //   controladas junto com a principal
+  if (n == 0) {
+    p->controle = controle_cria(p->cpu, self->console, p->relogio, p->pic);
+  } else {
+    p->controle = controle_cria_secundario(self->cpu[0].controle, p->cpu,
+                                           p->relogio, p->pic);
+  }
+}
+
+static bool cria_hardware(simulador_t *self)
+{
+  simulador_config_t *config = self->config;
+  // cria a memória
+  self->mem = mem_cria(config->tam_mem);
+  // cria o disco
+  self->disco = mem_cria(config->tam_mem);
+  inicializa_disco(self->disco);
+  // inicializa a ROM
+  if (!inicializa_rom(self->mem)) return false;
+
+  // cria dispositivos de E/S
+  if (config->lote) {
+    self->console = console_cria_sem_tela(config->log);
+    for (int t = 0; t < 4; t++) {
+      if (config->entrada[t] == NULL) continue;
+      if (!console_define_entrada(self->console, 'A' + t, config->entrada[t])) {
+        fprintf(stderr, "Erro na abertura de '%s'\n", config->entrada[t]);
+        return false;
+      }
+    }
+  } else {
+    self->console = console_cria(config->historico);
+  }
+
+  self->n_cpus = config->n_cpus;
+  for (int n = 0; n < self->n_cpus; n++) {
+    cria_processador(self, n);
+  }
+  for (int t = 0; t < 4; t++) {
+    terminal_t *terminal = console_terminal(self->console, 'A' + t);
+    terminal_define_fila(terminal, config->fila_terminal);
+    terminal_define_fila_entrada(terminal, config->fila_entrada_terminal);
+    terminal_define_pic(terminal, self->cpu[0].pic, t);
+  }
+  for (int n = 0; n < self->n_cpus; n++) {
+    controle_define_rajada(self->cpu[n].controle, config->rajada);
+  }
+  controle_define_limite(self->cpu[0].controle, config->limite);
+
+  // as entradas são gravadas ou reproduzidas pela console e pelo relógio
+  if (config->registro != NULL) {
+    self->registro = registro_cria(config->registro, config->modo_registro,
+                                   self->cpu[0].relogio);
+    if (self->registro == NULL) {
+      fprintf(stderr, "Erro na abertura do registro '%s'\n", config->registro);
+      return false;
+    }
+    console_define_registro(self->console, self->registro);
+    relogio_define_registro(self->cpu[0].relogio, self->registro);
+  }
+  return true;
+}
+
+static bool cria_so(simulador_t *self)
+{
+  processador_t *p0 = &self->cpu[0];
+  self->so = so_cria(p0->cpu, self->mem, self->disco, p0->mmu, p0->es,
+                     self->console, p0->relogio, &self->config->so);
+  if (self->config->rastro != NULL) {
+    self->rastro = rastro_cria(RASTRO_TAM);
+    so_define_rastro(self->so, self->rastro);
+  }
+  for (int n = 1; n < self->n_cpus; n++) {
+    processador_t *p = &self->cpu[n];
+    if (!so_adiciona_cpu(self->so, p->cpu, p->mmu, p->es)) {
+      fprintf(stderr, "Erro na inicialização da CPU %d\n", n);
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool recupera_imagem(simulador_t *self, char *nome);
+
+simulador_t *simulador_cria(simulador_config_t *config)
+{
+  simulador_t *self = calloc(1, sizeof(*self));
+  assert(self != NULL);
+  self->config = config;
+
+  if (!cria_hardware(self) || !cria_so(self)
+      || (config->recupera_imagem != NULL
+          && !recupera_imagem(self, config->recupera_imagem))) {
+    simulador_destroi(self);
+    return NULL;
+  }
+  return self;
+}
+
+void simulador_destroi(simulador_t *self)
+{
+  if (self->so != NULL) so_destroi(self->so);
+  for (int n = self->n_cpus - 1; n >= 0; n--) {
+    processador_t *p = &self->cpu[n];
+    controle_destroi(p->controle);
+    cpu_destroi(p->cpu);
+    es_destroi(p->es);
+    relogio_destroi(p->relogio);
+    pic_destroi(p->pic);
+    mmu_destroi(p->mmu);
+  }
+  if (self->console != NULL) console_destroi(self->console);
+  mem_destroi(self->mem);
+  mem_destroi(self->disco);
+  if (self->registro != NULL) registro_destroi(self->registro);
+  if (self->rastro != NULL) rastro_destroi(self->rastro);
+  free(self);
+}
+
+
+// ---------------------------------------------------------------------
+// IMAGEM {{{1
+// ---------------------------------------------------------------------
+
+static double agora(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// salva a imagem da máquina e do SO no arquivo 'nome'
+// a ordem é a mesma em recupera_imagem
+static bool salva_imagem(simulador_t *self, char *nome)
+{
+  processador_t *p0 = &self->cpu[0];
+  FILE *arq = imagem_cria(nome);
+  bool ok = arq != NULL
+         && mem_salva(self->mem, arq)
+         && mem_salva(self->disco, arq)
+         && cpu_salva(p0->cpu, arq)
+         && relogio_salva(p0->relogio, arq)
+         && pic_salva(p0->pic, arq)
+         && console_salva(self->console, arq)
+         && so_salva(self->so, arq);
+  if (arq != NULL && fclose(arq) != 0) ok = false;
+  if (!ok) fprintf(stderr, "Erro na gravação da imagem '%s'\n", nome);
+  return ok;
+}
+
+// recupera a imagem salva no arquivo 'nome', em uma máquina e um SO recém
+//   criados
+static bool recupera_imagem(simulador_t *self, char *nome)
+{
+  processador_t *p0 = &self->cpu[0];
+  double inicio = agora();
+  FILE *arq = imagem_abre(nome);
+  bool ok = arq != NULL
+         && mem_recupera(self->mem, arq)
+         && mem_recupera(self->disco, arq)
+         && cpu_recupera(p0->cpu, arq)
+         && relogio_recupera(p0->relogio, arq)
+         && pic_recupera(p0->pic, arq)
+         && console_recupera(self->console, arq)
+         && so_recupera(self->so, arq);
+  if (arq != NULL) fclose(arq);
+  if (!ok) {
+    fprintf(stderr, "Erro na leitura da imagem '%s'\n", nome);
+    return false;
+  }
+  console_printf("imagem '%s' recuperada em %.1f ms", nome, (agora() - inicio) * 1e3);
+  return true;
+}
+
+
+// ---------------------------------------------------------------------
+// EXECUÇÃO {{{1
+// ---------------------------------------------------------------------
+
+bool simulador_executa(simulador_t *self)
+{
+  console_printf("indo pro laco  ");
+
+  // em lote, não tem operador para mandar começar (na reprodução, o comando
+  //   está gravado)
+  registro_t *registro = self->registro;
+  if (self->config->lote
+      && (registro == NULL || registro_modo(registro) == registro_grava)) {
+    if (registro != NULL) registro_grava_entrada(registro, 'C', "C");
+    console_insere_comando_externo(self->console, 'C');
+  }
+
+  // executa o laço principal do controlador
+  double inicio = agora();
+  controle_laco(self->cpu[0].controle);
+  self->tempo = agora() - inicio;
+  if (registro != NULL) registro_encerra(registro);
+
+  bool ok = true;
+  if (self->rastro != NULL && !rastro_grava(self->rastro, self->config->rastro)) {
+    fprintf(stderr, "Erro na gravação do rastro '%s'\n", self->config->rastro);
+    ok = false;
+  }
+  if (self->config->metricas != NULL
+      && !so_exporta_metricas(self->so, self->config->metricas)) {
+    fprintf(stderr, "Erro na escrita das métricas em '%s'\n", self->config->metricas);
+    ok = false;
+  }
+  if (self->config->salva_imagem != NULL) {
+    ok = salva_imagem(self, self->config->salva_imagem) && ok;
+  }
+  return ok;
+}
+
+long simulador_instrucoes(simulador_t *self)
+{
+  // cada CPU conta o seu tempo no seu relógio, e à parte o tempo em que
+  //   ficou parada (que passa de uma vez, sem executar instruções)
+  long instrucoes = 0;
+  for (int n = 0; n < self->n_cpus; n++) {
+    int agora, ocioso;
+    relogio_leitura(self->cpu[n].relogio, 0, &agora);
+    relogio_leitura(self->cpu[n].relogio, 4, &ocioso);
+    instrucoes += agora - ocioso;
+  }
+  return instrucoes;
+}
+
+long simulador_tempo_simulado(simulador_t *self)
+{
+  long tempo = 0;
+  for (int n = 0; n < self->n_cpus; n++) {
+    int agora;
+    relogio_leitura(self->cpu[n].relogio, 0, &agora);
+    tempo += agora;
+  }
+  return tempo;
+}
+
+double simulador_tempo(simulador_t *self)
+{
+  return self->tempo;
+}
+
+metricas *simulador_metricas(simulador_t *self)
+{
+  return so_metricas(self->so);
+}
+
+void simulador_relatorio(simulador_t *self, FILE *arq)
+{
+  if (self->n_cpus > 1) {
+    for (int n = 0; n < self->n_cpus; n++) {
+      int agora, ocioso;
+      relogio_leitura(self->cpu[n].relogio, 0, &agora);
+      relogio_leitura(self->cpu[n].relogio, 4, &ocioso);
+      fprintf(arq, "CPU %d: %d instruções, %d parada\n", n, agora - ocioso, ocioso);
+    }
+  }
+  long instrucoes = simulador_instrucoes(self);
+  double tempo = self->tempo;
+  fprintf(arq, "tempo simulado: %ld\n", simulador_tempo_simulado(self));
+  fprintf(arq, "instruções executadas: %ld\n", instrucoes);
+  fprintf(arq, "tempo real: %.3f s\n", tempo);
+  fprintf(arq, "instruções por segundo: %.0f\n", tempo > 0 ? instrucoes / tempo : 0);
+  if (self->registro != NULL && registro_modo(self->registro) == registro_reproduz) {
+    fprintf(arq, "reprodução: %s\n", registro_divergiu(self->registro)
+            ? "DIVERGIU da execução gravada" : "igual à execução gravada");
+  }
+  so_imprime_metricas(self->so, arq);
+}
+
+// vim: foldmethod=marker
@@ -0,0 +1,114 @@
+// simulador.h
+// uma simulação completa: o computador simulado e o SO
+// simulador de computador
+// so25b
+
+#ifndef SIMULADOR_H
+#define SIMULADOR_H
+
+// junta a criação do hardware (memória, disco, console, CPUs com suas MMUs,
+//   relógios e controladores de E/S) e do SO, a execução e o relatório
+// tudo que uma simulação usa está no simulador_t (não tem variável global),
+//   então várias simulações podem executar ao mesmo tempo, cada uma na sua
+//   thread (ver varredura.c); só uma pode ter tela
+
+#include "so.h"
+#include "registro.h"
+#include <stdio.h>
+#include <stdbool.h>
+
+typedef struct simulador_t simulador_t;
+
+// configuração de uma simulação
+typedef struct {
+  // execução em lote, sem tela
+  bool lote;
+  // arquivo de log da console, na execução em lote (ou NULL, sem log)
+  char *log;
+  // arquivos com a entrada dos terminais A a D (ou NULL)
+  char *entrada[4];
+  // limite de instruções a simular (0 é sem limite)
+  int limite;
+  // número máximo de instruções em cada rajada do controlador, entre duas
+  //   atualizações dos dispositivos e da console (1 é passo a passo)
+  int rajada;
+  // número de CPUs
+  int n_cpus;
+  // tamanho da memória principal (e do disco)
+  int tam_mem;
+  // tamanho da fila de saída dos terminais (0 é o terminal sem fila, que
+  //   aceita um caractere por vez); com fila, o SO escreve em bloco (ver
+  //   so_config_t)
+  int fila_terminal;
+  // tamanho da fila de entrada dos terminais, caracteres digitados e não
+  //   lidos (0 é o que cabe na linha)
+  int fila_entrada_terminal;
+  // número de linhas da console guardadas para o operador voltar a elas
+  //   (só com tela)
+  int historico;
+  // arquivo onde gravar as entradas da execução, ou de onde reproduzi-las
+  //   (ou NULL)
+  char *registro;
+  registro_modo_t modo_registro;
+  // arquivo onde salvar a imagem da máquina no final, e de onde recuperar
+  //   a imagem antes de começar (ou NULL)
+  char *salva_imagem;
+  char *recupera_imagem;
+  // arquivo onde gravar, no final, o rastro dos eventos do SO (ou NULL,
+  //   sem rastro)
+  char *rastro;
+  // arquivo onde escrever, no final, as métricas do SO em JSON ou CSV (ou
+  //   NULL); ver metrica_exporta
+  char *metricas;
+  // parâmetros do SO
+  so_config_t so;
+} simulador_config_t;
+
+// preenche 'config' com os valores padrão: com tela, uma CPU, sem limite
+void simulador_config_padrao(simulador_config_t *config);
+
+// altera o parâmetro 'nome' da configuração para 'valor' (em texto)
+// os parâmetros são:
+//   memoria      tamanho da memória principal
+//   fila         tamanho da fila de saída dos terminais (0 é sem fila)
+//   fila_entrada tamanho da fila de entrada dos terminais (0 é a linha)
+//   historico    linhas da console guardadas para o operador (com tela)
+//   cpus         número de CPUs
+//   limite       limite de instruções
+//   rajada       instruções por rajada do controlador (1 é passo a passo)
+//   intervalo    intervalo entre interrupções do relógio
+//   quantum      quantum, em interrupções do relógio
+//   escalonador  rr ou prioridade
+//   substituicao fifo ou sc (segunda chance)
+//   init         programa executado pelo primeiro processo
+// 'valor' deve continuar existindo enquanto existir a configuração
+// retorna false se o nome não existe ou o valor é inválido
+bool simulador_config_define(simulador_config_t *config, char *nome, char *valor);
+
+// cria o hardware e o SO de acordo com 'config' (que deve continuar
+//   existindo enquanto existir o simulador)
+// retorna NULL (e imprime o motivo em stderr) se algum arquivo não puder
+//   ser aberto
+simulador_t *simulador_cria(simulador_config_t *config);
+
+void simulador_destroi(simulador_t *self);
+
+// executa a simulação até o fim (todos os processos morreram, o limite foi
+//   atingido ou o operador mandou terminar)
+// retorna false se a imagem final ou o rastro não puderam ser gravados
+bool simulador_executa(simulador_t *self);
+
+// número de instruções executadas (somando todas as CPUs, sem o tempo em
+//   que ficaram paradas), tempo simulado (somando o relógio de todas as
+//   CPUs, inclusive o tempo parado) e tempo real da execução, em segundos
+long simulador_instrucoes(simulador_t *self);
+long simulador_tempo_simulado(simulador_t *self);
+double simulador_tempo(simulador_t *self);
+
+// as métricas do SO
+metricas *simulador_metricas(simulador_t *self);
+
+// escreve o relatório de uma execução em lote em 'arq'
+void simulador_relatorio(simulador_t *self, FILE *arq);
+
+#endif // SIMULADOR_H
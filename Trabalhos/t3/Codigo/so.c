@@ -18,25 +18,29 @@
 #include "memoria_quadros.h"
 #include "swap.h"
 #include "relogio.h"
+#include "pic.h"
 #include "processo.h"
 #include "metrica.h"
+#include "imagem.h"
+#include "rastro.h"
+#include "log.h"
 
 
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <limits.h>
+#include <pthread.h>
 
 
 // ---------------------------------------------------------------------
 // CONSTANTES E TIPOS {{{1
 // ---------------------------------------------------------------------
 
-// intervalo entre interrupções do relógio
+// valores padrão dos parâmetros (ver so_config_t)
 #define INTERVALO_INTERRUPCAO 50   // em instruções executadas
-
 #define QUANTUM 50
-#define MEM_TAM 20000 // tamanho da memória principal
 
 
 // Não tem processos nem memória virtual, mas é preciso usar a paginação,
@@ -65,6 +69,29 @@
 #define MEM_Q_TIPO MEM_Q_SC
 
 
+// o que o SO mantém para cada CPU
+// o SO pode ser executado por várias CPUs, uma de cada vez; quando uma CPU
+//   entra no SO, os dados dela são copiados para os campos correspondentes
+//   do so_t (cpu, mmu, es, processo_corrente, contador_quantum), e copiados
+//   de volta quando ela sai, de forma que o resto do SO vê só a CPU corrente
+typedef struct so_cpu_t {
+  struct so_t *so;
+  // 0 para a CPU principal, que inicializa o sistema
+  int id;
+  cpu_t *cpu;
+  mmu_t *mmu;
+  es_t *es;
+  processo *processo_corrente;
+  int contador_quantum;
+  // instante em que termina o quantum do processo corrente
+  int fim_quantum;
+  // se o timer da CPU está programado (ver so_programa_timer)
+  bool timer_ligado;
+  // fila de execução: os processos vivos atribuídos a esta CPU, encadeados
+  //   por prox_fila; o escalonador da CPU só procura o próximo processo nela
+  processo *fila;
+} so_cpu_t;
+
 typedef struct so_t {
   cpu_t *cpu;
   mem_t *mem;
@@ -94,6 +121,11 @@ typedef struct so_t {
   float prioridade;
   int contador_quantum;
   int quantum;
+  int intervalo_interrupcao;
+  int escalonador;
+  char *programa_init;
+  // ver so_config_t
+  bool escrita_em_bloco;
 
   // alocador global simples de quadros (novo)
   mem_quadros_t *quadros;
@@ -104,11 +136,29 @@ typedef struct so_t {
 
   int proximo_end_livre_disco;
 
+  // pid do próximo processo a ser criado (o init é 1)
+  int proximo_pid;
 
   // Memória secundária e relógio
   swap_t *swap;
   relogio_t *relogio;
 
+  // as CPUs, e a que está executando o SO
+  so_cpu_t cpus[CPU_MAX];
+  int n_cpus;
+  so_cpu_t *cpu_corrente;
+  // só uma CPU executa o SO de cada vez
+  pthread_mutex_t trava;
+  // as CPUs secundárias esperam a principal inicializar o sistema
+  bool inicializado;
+  pthread_cond_t inicializacao;
+  // true depois que o fim da execução foi pedido (todos os processos morreram)
+  bool encerrado;
+  // interrupções habilitadas nos terminais, um bit por dispositivo de
+  //   teclado ou de tela (ver so_programa_terminais); -1 se não se sabe
+  int irq_terminais;
+  // rastro dos eventos (ou NULL, sem rastro)
+  rastro_t *rastro;
 
 } so_t;
 
@@ -140,17 +190,32 @@ static bool so_copia_str_do_processo(so_t *self, int tam, char str[tam],
 // CRIAÇÃO {{{1
 // ---------------------------------------------------------------------
 
+void so_config_padrao(so_config_t *config)
+{
+  config->intervalo_interrupcao = INTERVALO_INTERRUPCAO;
+  config->quantum = QUANTUM;
+  config->escalonador = ESC_TIPO;
+  config->substituicao = MEM_Q_TIPO;
+  config->init = "init.maq";
+  config->escrita_em_bloco = false;
+}
+
 so_t *so_cria(cpu_t *cpu, mem_t *mem, mem_t *disco, mmu_t *mmu,
-              es_t *es, console_t *console, relogio_t *relogio)
+              es_t *es, console_t *console, relogio_t *relogio,
+              so_config_t *config)
 {
-  console_printf("criando  ");
+  log_info(LOG_SO, "criando  ");
   so_t *self = malloc(sizeof(*self));
   if (self == NULL) return NULL;
 
   self->inicio_fila = 0;
   self->fim_fila = 0;
   self->processo_corrente = NULL;
-  self->quantum = QUANTUM;  // define o quantum inicial
+  self->quantum = config->quantum;  // define o quantum inicial
+  self->intervalo_interrupcao = config->intervalo_interrupcao;
+  self->programa_init = config->init;
+  self->escalonador = config->escalonador;
+  self->escrita_em_bloco = config->escrita_em_bloco;
   self->contador_quantum = 0;
   self->next_quadro_livre = 0; 
 
@@ -166,39 +231,77 @@ so_t *so_cria(cpu_t *cpu, mem_t *mem, mem_t *disco, mmu_t *mmu,
   self->erro_interno = false;
   self->relogio = relogio;
 
+  self->n_cpus = 1;
+  self->cpus[0] = (so_cpu_t){ self, 0, cpu, mmu, es, NULL, 0 };
+  self->cpu_corrente = NULL;
+  pthread_mutex_init(&self->trava, NULL);
+  self->inicializado = false;
+  pthread_cond_init(&self->inicializacao, NULL);
+  self->encerrado = false;
+  self->irq_terminais = 0;
+  self->rastro = NULL;
+
   // quando a CPU executar uma instrução CHAMAC, deve chamar a função
-  //   so_trata_interrupcao, com primeiro argumento um ptr para o SO
-  cpu_define_chamaC(self->cpu, so_trata_interrupcao, self);
+  //   so_trata_interrupcao, com primeiro argumento um ptr para os dados do
+  //   SO para a CPU
+  cpu_define_chamaC(self->cpu, so_trata_interrupcao, &self->cpus[0]);
 
   self->metrica = cria_metrica();
+  self->metrica->tam_memoria = mem_tam(mem);
+  self->metrica->tam_pagina = TAM_PAGINA;
 
   self->processo_corrente = NULL; // nenhum processo está executando
 
   self->quadro_livre_pri = 99 / TAM_PAGINA + 1;
   self->quadro_livre_sec = 0;
 
-  self->quadros = mem_quadros_cria(MEM_TAM / TAM_PAGINA, 99 / TAM_PAGINA + 1, MEM_Q_TIPO);
+  self->quadros = mem_quadros_cria(mem_tam(mem) / TAM_PAGINA, 99 / TAM_PAGINA + 1,
+                                   config->substituicao);
   
   // Cria memória secundária (swap) - tamanho generoso para todos os processos
   self->swap = swap_cria(1000, TAM_PAGINA, relogio);
 
   self->proximo_end_livre_disco = 0;
+  self->proximo_pid = 2;
 
-  console_printf("criei   ");
+  log_info(LOG_SO, "criei   ");
 
   return self;
 }
+
+bool so_adiciona_cpu(so_t *self, cpu_t *cpu, mmu_t *mmu, es_t *es)
+{
+  if (self->n_cpus >= CPU_MAX) return false;
+  // a área onde a CPU salva seu estado nas interrupções fica em um quadro
+  //   reservado para ela (a da principal é a original)
+  int quadro = mem_quadros_tem_livre(self->quadros);
+  if (quadro < 0) return false;
+  mem_quadros_reserva(self->quadros, quadro);
+  mmu_define_area_local(mmu, quadro * TAM_PAGINA);
+
+  so_cpu_t *nova = &self->cpus[self->n_cpus];
+  *nova = (so_cpu_t){ self, self->n_cpus, cpu, mmu, es, NULL, 0 };
+  self->n_cpus++;
+  cpu_define_chamaC(cpu, so_trata_interrupcao, nova);
+  log_info(LOG_SO, "SO: CPU %d, área local no quadro %d", nova->id, quadro);
+  return true;
+}
+
 void so_destroi(so_t *self)
 {
-  cpu_define_chamaC(self->cpu, NULL, NULL);
+  for (int i = 0; i < self->n_cpus; i++) {
+    cpu_define_chamaC(self->cpus[i].cpu, NULL, NULL);
+  }
+  pthread_mutex_destroy(&self->trava);
+  pthread_cond_destroy(&self->inicializacao);
   
   // Imprime estatísticas antes de destruir
-  console_printf("\n========== ESTATÍSTICAS DO SISTEMA ==========\n");
+  log_info(LOG_SO, "\n========== ESTATÍSTICAS DO SISTEMA ==========\n");
   
-  console_printf("Tamanho da memória principal: %d palavras (%d páginas)\n",
-                 mem_tam(self->mem), mem_tam(self->mem) / TAM_PAGINA);
-  console_printf("Tamanho de página: %d palavras\n", TAM_PAGINA);
-  console_printf("=============================================\n");
+  log_info(LOG_SO, "Tamanho da memória principal: %d palavras (%d páginas)\n",
+                   mem_tam(self->mem), mem_tam(self->mem) / TAM_PAGINA);
+  log_info(LOG_SO, "Tamanho de página: %d palavras\n", TAM_PAGINA);
+  log_info(LOG_SO, "=============================================\n");
   
   // Libera memória
   if (self->swap) swap_destroi(self->swap);
@@ -207,6 +310,74 @@ void so_destroi(so_t *self)
   free(self);
 }
 
+// lê dos relógios das CPUs o tempo de cada uma e quanto passou parada
+// (o "tempo com a CPU parada" do relatório é o da principal)
+static void so_marca_uso_cpus(so_t *self)
+{
+  marca_cpu_parada(self->metrica, self->cpus[0].es);
+  if (self->n_cpus == 1) return;
+  for (int i = 0; i < self->n_cpus; i++) {
+    marca_uso_cpu(self->metrica, i, self->cpus[i].es);
+  }
+}
+
+void so_imprime_metricas(so_t *self, FILE *arq)
+{
+  if (self->metrica == NULL) return;
+  so_marca_uso_cpus(self);
+  imprime_metricas(self->metrica, arq);
+}
+
+metricas *so_metricas(so_t *self)
+{
+  so_marca_uso_cpus(self);
+  return self->metrica;
+}
+
+// registra nas métricas uma amostra da ocupação dos quadros
+static void so_marca_quadros(so_t *self)
+{
+  int reservados, ocupados;
+  mem_quadros_conta(self->quadros, &reservados, &ocupados);
+  marca_quadros(self->metrica, mem_tam(self->mem) / TAM_PAGINA, reservados, ocupados);
+}
+
+bool so_exporta_metricas(so_t *self, char *nome)
+{
+  if (self->metrica == NULL) return false;
+  so_marca_uso_cpus(self);
+  // com uma CPU, o relatório não tem a parte por CPU, a exportação tem
+  for (int i = 0; i < self->n_cpus; i++) {
+    marca_uso_cpu(self->metrica, i, self->cpus[i].es);
+  }
+  so_marca_quadros(self);
+  return metrica_exporta(self->metrica, nome);
+}
+
+void so_define_escalonador(so_t *self, int id)
+{
+  pthread_mutex_lock(&self->trava);
+  self->escalonador = id;
+  pthread_mutex_unlock(&self->trava);
+}
+
+void so_define_rastro(so_t *self, rastro_t *rastro)
+{
+  self->rastro = rastro;
+}
+
+// registra um evento no rastro, com o tempo e a CPU corrente
+// o pid é o do processo corrente, se 'pid' for -1
+static void so_rastreia(so_t *self, rastro_evento_t tipo, int pid, int arg1, int arg2)
+{
+  if (self->rastro == NULL) return;
+  int agora;
+  es_le(self->es, D_RELOGIO_INSTRUCOES, &agora);
+  if (pid < 0) pid = self->processo_corrente != NULL ? self->processo_corrente->pid : 0;
+  int cpu = self->cpu_corrente != NULL ? self->cpu_corrente->id : 0;
+  rastro_registra(self->rastro, agora, tipo, cpu, pid, arg1, arg2);
+}
+
 
 
 
@@ -238,16 +409,55 @@ static int so_despacha(so_t *self);
 
 
 
+static int so_atende_interrupcao(so_t *self, irq_t irq);
+static void so_atualiza_quantum(so_t *self);
+static void so_programa_timer(so_t *self);
+static void so_programa_terminais(so_t *self);
+static void so_acorda_cpus(so_t *self);
+
+// copia para o SO os dados da CPU que está entrando nele
+static void so_entra(so_t *self, so_cpu_t *cpu)
+{
+  self->cpu_corrente = cpu;
+  self->cpu = cpu->cpu;
+  self->mmu = cpu->mmu;
+  self->es = cpu->es;
+  self->processo_corrente = cpu->processo_corrente;
+  self->contador_quantum = cpu->contador_quantum;
+}
+
+// guarda os dados da CPU que está saindo do SO
+static void so_sai(so_t *self, so_cpu_t *cpu)
+{
+  cpu->processo_corrente = self->processo_corrente;
+  cpu->contador_quantum = self->contador_quantum;
+  self->cpu_corrente = NULL;
+}
+
 static int so_trata_interrupcao(void *argC, int reg_A)
 {
-  console_printf("interrompido   ");
-  so_t *self = argC;
-  irq_t irq = reg_A;
+  so_cpu_t *cpu = argC;
+  so_t *self = cpu->so;
+  pthread_mutex_lock(&self->trava);
+  so_entra(self, cpu);
+  so_rastreia(self, RASTRO_IRQ_ENTRA, -1, reg_A, 0);
+  int retorno = so_atende_interrupcao(self, reg_A);
+  so_rastreia(self, RASTRO_IRQ_SAI, -1, reg_A, retorno);
+  so_sai(self, cpu);
+  pthread_mutex_unlock(&self->trava);
+  return retorno;
+}
+
+// atende a interrupção na CPU corrente
+static int so_atende_interrupcao(so_t *self, irq_t irq)
+{
+  log_depura(LOG_SO, "interrompido   ");
   
-  console_printf("SO: recebi IRQ %d (%s)", irq, irq_nome(irq));
+  log_depura(LOG_SO, "SO: recebi IRQ %d (%s)", irq, irq_nome(irq));
   
   // salva o estado da cpu no descritor do processo que foi interrompido
   so_salva_estado_da_cpu(self);
+  so_atualiza_quantum(self);
   
   // faz o atendimento da interrupção
   so_trata_irq(self, irq);
@@ -257,28 +467,34 @@ static int so_trata_interrupcao(void *argC, int reg_A)
   
   // escolhe o próximo processo a executar
   so_escalona(self);
+
+  // programa o timer para o próximo prazo, e avisa as outras CPUs que
+  //   passaram a ter processo esperando
+  so_programa_timer(self);
+  so_programa_terminais(self);
+  so_acorda_cpus(self);
   
   if(self->tabela_processos == NULL){
-    console_printf("Tabela de processos nula");
+    log_aviso(LOG_SO, "Tabela de processos nula");
     return 1;
   }
   
   // recupera o estado do processo escolhido
   int retorno = so_despacha(self);
-  console_printf("depois despacha   ");
+  log_depura(LOG_SO, "depois despacha   ");
   
   // Debug final - USA OS VALORES DO PROCESSO CORRENTE, NÃO DA MEMÓRIA
   if (self->processo_corrente != NULL) {
-    console_printf("RETORNO DESPACHA: %d, proc=%d regA=%d regPC=%d regERRO=%d regX=%d(%c)",
-                   retorno,
-                   self->processo_corrente->pid,
-                   self->processo_corrente->regA,
-                   self->processo_corrente->regPC,
-                   self->processo_corrente->regERRO,
-                   self->processo_corrente->regX,
-                   self->processo_corrente->regX);
+    log_depura(LOG_SO, "RETORNO DESPACHA: %d, proc=%d regA=%d regPC=%d regERRO=%d regX=%d(%c)",
+                       retorno,
+                       self->processo_corrente->pid,
+                       self->processo_corrente->regA,
+                       self->processo_corrente->regPC,
+                       self->processo_corrente->regERRO,
+                       self->processo_corrente->regX,
+                       self->processo_corrente->regX);
   } else {
-    console_printf("RETORNO DESPACHA: %d (sem processo corrente)", retorno);
+    log_depura(LOG_SO, "RETORNO DESPACHA: %d (sem processo corrente)", retorno);
   }
   
   return retorno;
@@ -291,17 +507,18 @@ static void so_salva_estado_da_cpu(so_t *self)
 {
   // Se não houver processo corrente, não faz nada
   if (self->tabela_processos == NULL || self->processo_corrente == NULL) {
-    console_printf("nenhum processo corrente, nada a salvar   ");
+    log_depura(LOG_SO, "nenhum processo corrente, nada a salvar   ");
     return;
   }
   
   // IMPORTANTE: Lê da MEMÓRIA FÍSICA onde a CPU salvou os registradores
+  // (pela MMU da CPU, em modo supervisor, para acessar a área local dela)
   int a, pc, erro, x;
-  if (mem_le(self->mem, CPU_END_A, &a) != ERR_OK
-      || mem_le(self->mem, CPU_END_PC, &pc) != ERR_OK
-      || mem_le(self->mem, CPU_END_erro, &erro) != ERR_OK
-      || mem_le(self->mem, 59, &x) != ERR_OK) {
-    console_printf("SO: erro na leitura dos registradores");
+  if (mmu_le(self->mmu, CPU_END_A, &a, supervisor) != ERR_OK
+      || mmu_le(self->mmu, CPU_END_PC, &pc, supervisor) != ERR_OK
+      || mmu_le(self->mmu, CPU_END_erro, &erro, supervisor) != ERR_OK
+      || mmu_le(self->mmu, 59, &x, supervisor) != ERR_OK) {
+    log_erro(LOG_SO, "SO: erro na leitura dos registradores");
     self->erro_interno = true;
     return;
   }
@@ -312,28 +529,21 @@ static void so_salva_estado_da_cpu(so_t *self)
   self->processo_corrente->regERRO = erro;
   self->processo_corrente->regX = x;
   
-  console_printf("SO: salvou estado proc=%d A=%d PC=%d X=%d erro=%d",
-                 self->processo_corrente->pid, a, pc, x, erro);
+  log_depura(LOG_SO, "SO: salvou estado proc=%d A=%d PC=%d X=%d erro=%d",
+                     self->processo_corrente->pid, a, pc, x, erro);
 }
 
 static void so_trata_pendencias(so_t *self)
 {
 
   
-  console_printf("tratando pendências   ");
+  log_depura(LOG_SO, "tratando pendências   ");
   if (self->tabela_processos == NULL) return;
   
   verifica_ocioso(self->metrica, self->tabela_processos, self->es);
   
-  processo *proc = self->tabela_processos;
-  while (proc != NULL)
-  {
-    if (proc->esperando_dispositivo >= 0){
-      trata_bloqueio_disp(proc, self->metrica, self->es, &self->erro_interno);
-    }
-    proc = proc->prox;
-  }
-  
+  // os processos bloqueados em um terminal são desbloqueados nas
+  //   interrupções do teclado e da tela (so_trata_irq_terminal)
 }
 
 // AUXILIARES DE ESCALONADOR  
@@ -371,11 +581,167 @@ static void processa_fim_quantum(so_t *self, processo *atual)
     muda_estado_proc(atual, self->metrica, self->es, PRONTO);
 }
 
-// Escolhe o próximo processo PRONTO com menor prioridade
+// FILAS DE EXECUÇÃO
+// cada CPU tem a sua fila, com os processos atribuídos a ela; um processo
+//   novo vai para a fila da CPU menos carregada entre as da sua afinidade
+// uma CPU sem processo pronto na sua fila rouba um da fila com mais prontos;
+//   no fim do quantum, um processo pode passar para uma CPU bem menos
+//   carregada (balanceamento) -- com uma CPU só, nada disso acontece
+
+static bool cpu_permitida(processo *proc, int id)
+{
+    return (proc->afinidade & (1u << id)) != 0;
+}
+
+static void fila_insere(so_cpu_t *cpu, processo *proc)
+{
+    processo **p = &cpu->fila;
+    while (*p != NULL) {
+        p = &(*p)->prox_fila;
+    }
+    *p = proc;
+    proc->prox_fila = NULL;
+    proc->cpu = cpu->id;
+}
+
+static void fila_retira(so_cpu_t *cpu, processo *proc)
+{
+    for (processo **p = &cpu->fila; *p != NULL; p = &(*p)->prox_fila) {
+        if (*p == proc) {
+            *p = proc->prox_fila;
+            proc->prox_fila = NULL;
+            return;
+        }
+    }
+}
+
+// tira da fila os processos que morreram
+static void fila_limpa(so_cpu_t *cpu)
+{
+    processo **p = &cpu->fila;
+    while (*p != NULL) {
+        if ((*p)->estado == MORTO) {
+            *p = (*p)->prox_fila;
+        } else {
+            p = &(*p)->prox_fila;
+        }
+    }
+}
+
+// número de processos da fila no estado 'estado'
+static int fila_conta(so_cpu_t *cpu, enum EstadoProcesso estado)
+{
+    int n = 0;
+    for (processo *p = cpu->fila; p != NULL; p = p->prox_fila) {
+        if (p->estado == estado) n++;
+    }
+    return n;
+}
+
+// carga da CPU: quantos processos querem executar nela
+static int fila_carga(so_cpu_t *cpu)
+{
+    return fila_conta(cpu, PRONTO) + fila_conta(cpu, EXECUTANDO);
+}
+
+// o processo pronto da fila com menor prioridade que pode executar na CPU
+//   'id' (em caso de empate, o que está há mais tempo na fila); no
+//   escalonador circular, o primeiro pronto da fila
+static processo *fila_melhor(so_cpu_t *cpu, int id)
+{
+    processo *proximo = NULL;
+    float menor_prio = 1000.0f;
+    for (processo *p = cpu->fila; p != NULL; p = p->prox_fila) {
+        if (p->estado != PRONTO || !cpu_permitida(p, id)) continue;
+        if (cpu->so->escalonador == ESC_RR) return p;
+        if (p->prioridade < menor_prio) {
+            menor_prio = p->prioridade;
+            proximo = p;
+        }
+    }
+    return proximo;
+}
+
+// a CPU menos carregada onde o processo pode executar (NULL se nenhuma)
+static so_cpu_t *cpu_menos_carregada(so_t *self, processo *proc)
+{
+    so_cpu_t *escolhida = NULL;
+    int menor_carga = 0;
+    for (int i = 0; i < self->n_cpus; i++) {
+        so_cpu_t *cpu = &self->cpus[i];
+        if (!cpu_permitida(proc, cpu->id)) continue;
+        int carga = fila_carga(cpu);
+        if (escolhida == NULL || carga < menor_carga) {
+            escolhida = cpu;
+            menor_carga = carga;
+        }
+    }
+    return escolhida;
+}
+
+// passa o processo para a fila da CPU 'destino'
+static void migra_processo(so_t *self, processo *proc, so_cpu_t *destino, bool roubo)
+{
+    if (proc->cpu == destino->id) return;
+    log_info(LOG_ESC, "SO: processo %d passa da CPU %d para a CPU %d%s", proc->pid,
+                      proc->cpu, destino->id, roubo ? " (roubo)" : "");
+    fila_retira(&self->cpus[proc->cpu], proc);
+    fila_insere(destino, proc);
+    marca_migracao(self->metrica, destino->id, roubo);
+}
+
+// coloca um processo novo na fila de uma CPU
+static void so_atribui_cpu(so_t *self, processo *proc)
+{
+    so_cpu_t *cpu = cpu_menos_carregada(self, proc);
+    if (cpu == NULL) cpu = &self->cpus[0];
+    fila_insere(cpu, proc);
+}
+
+// no fim do quantum, passa o processo para outra CPU se a dele tem pelo
+//   menos dois processos a mais querendo executar
+static void balanceia(so_t *self, processo *proc)
+{
+    if (self->n_cpus == 1 || proc->estado != PRONTO) return;
+    so_cpu_t *destino = cpu_menos_carregada(self, proc);
+    if (destino == NULL || destino->id == proc->cpu) return;
+    if (fila_carga(&self->cpus[proc->cpu]) > fila_carga(destino) + 1) {
+        migra_processo(self, proc, destino, false);
+    }
+}
+
+// pega um processo pronto da fila de outra CPU (a com mais prontos que
+//   podem executar nesta)
+static processo *rouba_processo(so_t *self, so_cpu_t *ladra)
+{
+    so_cpu_t *vitima = NULL;
+    int mais_prontos = 0;
+    for (int i = 0; i < self->n_cpus; i++) {
+        so_cpu_t *cpu = &self->cpus[i];
+        if (cpu == ladra || fila_melhor(cpu, ladra->id) == NULL) continue;
+        int prontos = fila_conta(cpu, PRONTO);
+        if (prontos > mais_prontos) {
+            vitima = cpu;
+            mais_prontos = prontos;
+        }
+    }
+    if (vitima == NULL) return NULL;
+    processo *proc = fila_melhor(vitima, ladra->id);
+    migra_processo(self, proc, ladra, true);
+    return proc;
+}
+
+// Escolhe o próximo processo PRONTO com menor prioridade, da fila da CPU
+//   corrente ou, se não tiver, roubado de outra
 static processo *escolhe_proximo_processo(so_t *self)
 {
-    processo *proximo = encontra_processo_por_menor_prioridade(self->tabela_processos);
-    
+    so_cpu_t *cpu = self->cpu_corrente;
+    fila_limpa(cpu);
+    processo *proximo = fila_melhor(cpu, cpu->id);
+    if (proximo == NULL && self->n_cpus > 1) {
+        proximo = rouba_processo(self, cpu);
+    }
+
     return proximo;
 }
 
@@ -386,29 +752,36 @@ static void ativa_processo(so_t *self, processo *proximo, processo *atual)
         return;
     }
 
-    console_printf("SO: escalonador escolheu processo %d com prioridade %.2f", 
-                 proximo->pid, proximo->prioridade);
+    log_depura(LOG_ESC, "SO: escalonador escolheu processo %d com prioridade %.2f", 
+                      proximo->pid, proximo->prioridade);
     
     muda_estado_proc(proximo, self->metrica, self->es, EXECUTANDO);
+    marca_despacho(self->metrica, self->cpu_corrente->id);
+    so_rastreia(self, RASTRO_DESPACHO, proximo->pid, atual != NULL ? atual->pid : 0, 0);
     
     // Marca preempção se trocou de processo
     if (atual != NULL && atual != proximo) {
-        marca_preempcao(self->metrica, self->es, atual->pid-1, self->quantum - self->contador_quantum);
+        marca_preempcao(self->metrica, atual->pid-1);
     }
     
     self->processo_corrente = proximo;
     self->contador_quantum = self->quantum; // Reseta quantum
+    int agora;
+    es_le(self->es, D_RELOGIO_INSTRUCOES, &agora);
+    self->cpu_corrente->fim_quantum = agora + self->quantum * self->intervalo_interrupcao;
 }
 
 static void so_escalona(so_t *self) {
   if (self->processo_corrente == NULL)
   {
-    console_printf("escalonando sem processo corrente");
+    log_depura(LOG_ESC, "escalonando sem processo corrente");
     processo *proximo = self->tabela_processos;
-    bool acabou = true;
+    // (com várias CPUs, uma secundária pode chegar aqui antes de ter processo)
+    bool acabou = proximo != NULL && !self->encerrado;
     while (proximo != NULL)
     {
-      if(proximo->estado != MORTO)
+      // o que um processo morto deixou no buffer de escrita ainda vai sair
+      if(proximo->estado != MORTO || proximo->n_buf_escrita > 0)
       {
         acabou = false;
         break;
@@ -418,9 +791,11 @@ static void so_escalona(so_t *self) {
     if (acabou)
     {
       // AQUI TU PARA O SO E MOSTRA AS METRICAS
-      console_printf("SO: todos os processos morreram, encerrando o SO");
+      log_info(LOG_ESC, "SO: todos os processos morreram, encerrando o SO");
+      self->encerrado = true;
       // Mostra métricas e solicita finalização do laço do controlador
       if (self->metrica != NULL) {
+        so_marca_uso_cpus(self);
         mostra_metricas(self->metrica);
       }
       if (self->console != NULL) {
@@ -430,7 +805,7 @@ static void so_escalona(so_t *self) {
     
   }
   else {
-    console_printf("escalonando %d", self->processo_corrente->pid);
+    log_depura(LOG_ESC, "escalonando %d", self->processo_corrente->pid);
   }
     
 
@@ -446,6 +821,10 @@ static void so_escalona(so_t *self) {
 
     // 3. Se precisa escolher novo processo
     if (!atual_pode_continuar) {
+        // o que estava executando talvez vá para uma CPU menos carregada
+        if (atual != NULL) {
+            balanceia(self, atual);
+        }
         processo *proximo = escolhe_proximo_processo(self);
         
         if (proximo != NULL) {
@@ -454,47 +833,153 @@ static void so_escalona(so_t *self) {
         } else {
             // Nenhum processo pronto
             self->processo_corrente = NULL;
-            console_printf("SO: nenhum processo pronto para executar");
+            log_depura(LOG_ESC, "SO: nenhum processo pronto para executar");
         }
     } else {
         // 4. Processo atual continua executando
-        console_printf("SO: processo %d continua executando (quantum=%d)", 
-                     atual, self->contador_quantum);
+        log_depura(LOG_ESC, "SO: processo %d continua executando (quantum=%d)", 
+                          atual, self->contador_quantum);
         self->processo_corrente = atual;
     }
 
     // 5. Debug final (com verificação)
     if (self->processo_corrente != NULL) {
-        console_printf("APOS ESCALONAR: proc=%d regA=%d regPC=%d regERRO=%d regX=%d(%c)",
-                     self->processo_corrente->pid,
-                     self->processo_corrente->regA,
-                     self->processo_corrente->regPC,
-                     self->processo_corrente->regERRO,
-                     self->processo_corrente->regX);
+        log_depura(LOG_ESC, "APOS ESCALONAR: proc=%d regA=%d regPC=%d regERRO=%d regX=%d(%c)",
+                          self->processo_corrente->pid,
+                          self->processo_corrente->regA,
+                          self->processo_corrente->regPC,
+                          self->processo_corrente->regERRO,
+                          self->processo_corrente->regX);
+    }
+}
+
+// TIMER
+// o timer não gera interrupções periódicas: é programado, no fim de cada
+//   atendimento, para o próximo prazo que depende dele, e fica desligado
+//   se não tiver nenhum (um processo sozinho executa sem ser interrompido)
+// o quantum é contado em intervalos do relógio, mas pelo instante em que
+//   termina, não pelo número de interrupções
+
+// calcula quanto falta do quantum do processo corrente, em intervalos
+//   (arredondado para cima)
+static void so_atualiza_quantum(so_t *self)
+{
+  if (self->processo_corrente == NULL) return;
+  int agora;
+  if (es_le(self->es, D_RELOGIO_INSTRUCOES, &agora) != ERR_OK) {
+    log_erro(LOG_SO, "SO: problema na leitura do relógio");
+    self->erro_interno = true;
+    return;
+  }
+  int falta = self->cpu_corrente->fim_quantum - agora;
+  int intervalo = self->intervalo_interrupcao;
+  self->contador_quantum = falta > 0 ? (falta + intervalo - 1) / intervalo : 0;
+}
+
+// programa o timer da CPU corrente para o mais próximo entre:
+// - o fim do quantum, se tem outro processo pronto na fila da CPU
+// - a próxima tentativa de roubar processo, se a CPU está ociosa e tem
+//   outras CPUs
+// o fim de um acesso ao disco e os terminais têm interrupções próprias, não
+//   precisam do timer
+static void so_programa_timer(so_t *self)
+{
+  so_cpu_t *cpu = self->cpu_corrente;
+  int agora;
+  if (es_le(self->es, D_RELOGIO_INSTRUCOES, &agora) != ERR_OK) {
+    log_erro(LOG_SO, "SO: problema na leitura do relógio");
+    self->erro_interno = true;
+    return;
+  }
+  int prazo = INT_MAX;
+  int proxima_verificacao = agora + self->intervalo_interrupcao;
+  if (self->processo_corrente != NULL && fila_melhor(cpu, cpu->id) != NULL) {
+    prazo = cpu->fim_quantum;
+  }
+  if (self->processo_corrente == NULL && self->n_cpus > 1
+      && proxima_verificacao < prazo) {
+    prazo = proxima_verificacao;
+  }
+
+  int t = 0;
+  if (prazo != INT_MAX) t = prazo > agora ? prazo - agora : 1;
+  if (es_escreve(self->es, D_RELOGIO_TIMER, t) != ERR_OK) {
+    log_erro(LOG_SO, "SO: problema na programação do timer");
+    self->erro_interno = true;
+    return;
+  }
+  cpu->timer_ligado = t > 0;
+}
+
+// a linha da tela de um terminal fica ativa enquanto ele pode escrever, o
+//   que é quase sempre, e a do teclado enquanto tem caractere digitado, mesmo
+//   que ninguém vá ler; para não ser interrompido à toa, o SO só habilita
+//   em cada terminal a interrupção que algum processo bloqueado espera
+static void so_programa_terminais(so_t *self)
+{
+  int habilitar = 0;
+  for (processo *p = self->tabela_processos; p != NULL; p = p->prox) {
+    if (p->n_buf_escrita > 0) habilitar |= 1 << (p->terminal + TERM_TELA);
+    if (p->estado == MORTO || p->esperando_dispositivo < 0) continue;
+    habilitar |= 1 << p->esperando_dispositivo;
+  }
+  if (habilitar == self->irq_terminais) return;
+  for (int disp = D_TERM_A; disp <= D_TERM_D_TELA; disp++) {
+    if (disp % 4 != TERM_TECLADO && disp % 4 != TERM_TELA) continue;
+    bool hab = (habilitar >> disp) & 1;
+    if (self->irq_terminais >= 0 && ((self->irq_terminais >> disp) & 1) == hab) {
+      continue;
+    }
+    // a interrupção é habilitada no dispositivo de estado, o seguinte
+    if (es_escreve(self->es, disp + 1, hab) != ERR_OK) {
+      log_erro(LOG_ES, "SO: problema na programação da interrupção do dispositivo %d", disp);
+      self->erro_interno = true;
+      return;
+    }
+  }
+  self->irq_terminais = habilitar;
+}
+
+// uma CPU executando um processo com o timer desligado não vê que outro
+//   processo ficou pronto na sua fila (desbloqueado, criado ou migrado por
+//   esta CPU); pede uma interrupção do relógio no controlador dela, para
+//   que reprograme o timer
+static void so_acorda_cpus(so_t *self)
+{
+  for (int i = 0; i < self->n_cpus; i++) {
+    so_cpu_t *cpu = &self->cpus[i];
+    if (cpu == self->cpu_corrente || cpu->timer_ligado) continue;
+    if (fila_melhor(cpu, cpu->id) == NULL) continue;
+    if (es_escreve(cpu->es, D_PIC_PEDE, IRQ_RELOGIO) != ERR_OK) {
+      log_erro(LOG_SO, "SO: problema no pedido de interrupção da CPU %d", cpu->id);
+      self->erro_interno = true;
+      continue;
     }
+    cpu->timer_ligado = true;
+  }
 }
 
 static int so_despacha(so_t *self)
 {
   // Verifica se há processo corrente válido
   if (self->processo_corrente == NULL) {
-    console_printf("SO: sem processo para despachar");
+    log_depura(LOG_ESC, "SO: sem processo para despachar");
     return 1;
   }
   
   
   if (self->processo_corrente->estado == MORTO) {
-    console_printf("SO: processo %d está morto", self->processo_corrente->pid);
+    log_depura(LOG_ESC, "SO: processo %d está morto", self->processo_corrente->pid);
     return 1;
   }
   
   // DIAGNÓSTICO: Antes de configurar MMU
-  console_printf("SO: despachando proc=%d PC=%d (virtual)", 
-                 self->processo_corrente->pid, self->processo_corrente->regPC);
+  log_depura(LOG_ESC, "SO: despachando proc=%d PC=%d (virtual)", 
+                      self->processo_corrente->pid, self->processo_corrente->regPC);
   
   // Verifica tabela de páginas
   if (self->processo_corrente->tabpag == NULL) {
-    console_printf("SO: ERRO - tabela de páginas NULL!");
+    log_erro(LOG_ESC, "SO: ERRO - tabela de páginas NULL!");
     self->erro_interno = true;
     return 1;
   }
@@ -502,8 +987,8 @@ static int so_despacha(so_t *self)
   // Configura MMU com tabela de páginas do processo
   mmu_define_tabpag(self->mmu, self->processo_corrente->tabpag);
   
-  console_printf("SO: MMU configurada com tabpag do processo %d", 
-                 self->processo_corrente->pid);
+  log_depura(LOG_ESC, "SO: MMU configurada com tabpag do processo %d", 
+                      self->processo_corrente->pid);
 // TESTE: Verifica tradução do PC
   int pagina_pc = self->processo_corrente->regPC / TAM_PAGINA;
   int quadro_pc;
@@ -514,29 +999,29 @@ static int so_despacha(so_t *self)
     end_fis = quadro_pc * TAM_PAGINA + (self->processo_corrente->regPC % TAM_PAGINA);
     int valor_fis;
     mem_le(self->mem, end_fis, &valor_fis);
-    console_printf("Teste tradução: PC=%d página=%d quadro=%d end_fis=%d valor=%d",
-                    self->processo_corrente->regPC, pagina_pc, quadro_pc, end_fis, valor_fis);
+    log_depura(LOG_ESC, "Teste tradução: PC=%d página=%d quadro=%d end_fis=%d valor=%d",
+                         self->processo_corrente->regPC, pagina_pc, quadro_pc, end_fis, valor_fis);
   } else {
-    console_printf("Teste tradução: FALHOU - PC=%d página=%d err=%d (FALTA DE PÁGINA!)",
-                    self->processo_corrente->regPC, pagina_pc, err_traduz);
+    log_depura(LOG_ESC, "Teste tradução: FALHOU - PC=%d página=%d err=%d (FALTA DE PÁGINA!)",
+                         self->processo_corrente->regPC, pagina_pc, err_traduz);
   }
   
-  // Escreve na MEMÓRIA FÍSICA de onde a CPU vai ler
-  if (mem_escreve(self->mem, CPU_END_A, self->processo_corrente->regA) != ERR_OK
-      || mem_escreve(self->mem, CPU_END_PC, self->processo_corrente->regPC) != ERR_OK
-      || mem_escreve(self->mem, CPU_END_erro, self->processo_corrente->regERRO) != ERR_OK
-      || mem_escreve(self->mem, 59, self->processo_corrente->regX) != ERR_OK) {
-    console_printf("SO: erro na escrita dos registradores");
+  // Escreve na MEMÓRIA FÍSICA de onde a CPU vai ler (na área local dela)
+  if (mmu_escreve(self->mmu, CPU_END_A, self->processo_corrente->regA, supervisor) != ERR_OK
+      || mmu_escreve(self->mmu, CPU_END_PC, self->processo_corrente->regPC, supervisor) != ERR_OK
+      || mmu_escreve(self->mmu, CPU_END_erro, self->processo_corrente->regERRO, supervisor) != ERR_OK
+      || mmu_escreve(self->mmu, 59, self->processo_corrente->regX, supervisor) != ERR_OK) {
+    log_erro(LOG_ESC, "SO: erro na escrita dos registradores");
     self->erro_interno = true;
     return 1;
   }
   
-  console_printf("SO: despachou proc=%d PC=%d A=%d X=%d erro=%d",
-                 self->processo_corrente->pid,
-                 self->processo_corrente->regPC,
-                 self->processo_corrente->regA,
-                 self->processo_corrente->regX,
-                 self->processo_corrente->regERRO);
+  log_depura(LOG_ESC, "SO: despachou proc=%d PC=%d A=%d X=%d erro=%d",
+                      self->processo_corrente->pid,
+                      self->processo_corrente->regPC,
+                      self->processo_corrente->regA,
+                      self->processo_corrente->regX,
+                      self->processo_corrente->regERRO);
   
   return (self->erro_interno) ? 1 : 0;
 }
@@ -547,6 +1032,7 @@ static int so_despacha(so_t *self)
 
 // funções auxiliares para tratar cada tipo de interrupção
 static void so_trata_reset(so_t *self);
+static void so_trata_reset_secundaria(so_t *self);
 static void so_trata_irq_chamada_sistema(so_t *self);
 static void so_trata_irq_err_cpu(so_t *self);
 static void so_trata_irq_relogio(so_t *self);
@@ -577,7 +1063,7 @@ static int so_aloca_quadro(so_t *self);
 //   }
   
 //   // Programa o relógio
-//   if (es_escreve(self->es, D_RELOGIO_TIMER, INTERVALO_INTERRUPCAO) != ERR_OK) {
+//   if (es_escreve(self->es, D_RELOGIO_TIMER, self->intervalo_interrupcao) != ERR_OK) {
 //     console_printf("SO: problema na programação do timer");
 //     self->erro_interno = true;
 //     return;
@@ -706,42 +1192,87 @@ static int so_aloca_quadro(so_t *self);
 static void so_trata_irq_chamada_sistema(so_t *self);
 static void so_trata_irq_err_cpu(so_t *self);
 static void so_trata_irq_relogio(so_t *self);
+static void so_trata_irq_disco(so_t *self);
+static void so_trata_irq_terminal(so_t *self, int irq);
 static void so_trata_irq_desconhecida(so_t *self, int irq);
+static void so_trata_irqs_pendentes(so_t *self, int irq);
 
 static void so_trata_irq(so_t *self, int irq)
 { 
-  console_printf("tratando IRQ   ");
+  log_depura(LOG_SO, "tratando IRQ   ");
   // verifica o tipo de interrupção que está acontecendo, e atende de acordo
   switch (irq) {
     case IRQ_RESET:
-      so_trata_reset(self);
+      self->metrica->n_interrupcoes_tipo[IRQ_RESET]++;
+      if (self->cpu_corrente->id == 0) {
+        so_trata_reset(self);
+        // libera as CPUs secundárias
+        self->inicializado = true;
+        pthread_cond_broadcast(&self->inicializacao);
+      } else {
+        so_trata_reset_secundaria(self);
+      }
       break;
     case IRQ_SISTEMA:
+      self->metrica->n_interrupcoes_tipo[IRQ_SISTEMA]++;
       so_trata_irq_chamada_sistema(self);
       break;
     case IRQ_ERR_CPU:
+      self->metrica->n_interrupcoes_tipo[IRQ_ERR_CPU]++;
       so_trata_irq_err_cpu(self);
       break;
     case IRQ_RELOGIO:
       so_trata_irq_relogio(self);
+      so_trata_irqs_pendentes(self, irq);
+      break;
+    case IRQ_DISCO:
+      so_trata_irq_disco(self);
+      so_trata_irqs_pendentes(self, irq);
+      break;
+    case IRQ_TECLADO:
+    case IRQ_TELA:
+      so_trata_irq_terminal(self, irq);
+      so_trata_irqs_pendentes(self, irq);
       break;
     default:
+      self->metrica->n_interrupcoes_tipo[N_IRQ]++;
       so_trata_irq_desconhecida(self, irq);
   }
 }
 
+// o controlador de interrupções entrega uma irq por vez; se, na interrupção
+//   de um dispositivo, outras estão pendentes, trata também essas, em vez de
+//   sair e ser interrompido de novo em seguida
+static void so_trata_irqs_pendentes(so_t *self, int irq)
+{
+  int pendentes;
+  if (es_le(self->es, D_PIC_PENDENTES, &pendentes) != ERR_OK) {
+    log_erro(LOG_SO, "SO: problema na leitura do controlador de interrupções");
+    self->erro_interno = true;
+    return;
+  }
+  pendentes &= ~PIC_BIT(irq);
+  if (pendentes & PIC_BIT(IRQ_RELOGIO)) so_trata_irq_relogio(self);
+  if (pendentes & PIC_BIT(IRQ_DISCO)) so_trata_irq_disco(self);
+  if (pendentes & PIC_BIT(IRQ_TECLADO)) so_trata_irq_terminal(self, IRQ_TECLADO);
+  if (pendentes & PIC_BIT(IRQ_TELA)) so_trata_irq_terminal(self, IRQ_TELA);
+}
+
 
 // Trata uma falta de página
 static void so_trata_falta_pagina(so_t *self, processo* proc, int pagina)
 {
-  console_printf("\n========== TRATANDO FALTA DE PÁGINA ==========");
-  console_printf("SO: falta de página %d do processo %d", pagina, proc->pid);
+  log_depura(LOG_MEM, "\n========== TRATANDO FALTA DE PÁGINA ==========");
+  log_depura(LOG_MEM, "SO: falta de página %d do processo %d", pagina, proc->pid);
+  self->metrica->n_faltas_pagina++;
+  self->metrica->n_faltas_pagina_processo[proc->pid - 1]++;
+  so_rastreia(self, RASTRO_FALTA, proc->pid, pagina, 0);
   
   // VERIFICA SE A PÁGINA JÁ ESTÁ MAPEADA (pode acontecer se tratamos duas vezes)
   int quadro_teste;
   if (tabpag_traduz(proc->tabpag, pagina, &quadro_teste) == ERR_OK) {
-    console_printf("SO: página %d JÁ ESTÁ MAPEADA no quadro %d - ignora falta", 
-                   pagina, quadro_teste);
+    log_depura(LOG_MEM, "SO: página %d JÁ ESTÁ MAPEADA no quadro %d - ignora falta", 
+                        pagina, quadro_teste);
     
     // Apenas reseta o erro e retorna
     proc->regERRO = ERR_OK;
@@ -750,8 +1281,8 @@ static void so_trata_falta_pagina(so_t *self, processo* proc, int pagina)
   
   // Verifica se a página é válida para o processo
   if (pagina < 0 || pagina >= proc->n_paginas) {
-    console_printf("SO: ERRO - página %d inválida (processo tem %d páginas)", 
-                   pagina, proc->n_paginas);
+    log_aviso(LOG_MEM, "SO: ERRO - página %d inválida (processo tem %d páginas)", 
+                       pagina, proc->n_paginas);
     proc->estado = MORTO;
     return;
   }
@@ -759,18 +1290,18 @@ static void so_trata_falta_pagina(so_t *self, processo* proc, int pagina)
   // Aloca um quadro (pode fazer substituição)
   int quadro = so_aloca_quadro(self);
   if (quadro < 0) {
-    console_printf("SO: ERRO ao alocar quadro");
+    log_erro(LOG_MEM, "SO: ERRO ao alocar quadro");
     proc->estado = MORTO;
     return;
   }
   
-  console_printf("SO: quadro %d alocado para página %d", quadro, pagina);
+  log_depura(LOG_MEM, "SO: quadro %d alocado para página %d", quadro, pagina);
   
   // Obtém endereço da página na swap
   int end_swap = swap_endereco_pagina(self->swap, proc->pid, pagina);
   
   if (end_swap < 0) {
-    console_printf("SO: ERRO ao obter endereço da página na swap");
+    log_erro(LOG_MEM, "SO: ERRO ao obter endereço da página na swap");
     proc->estado = MORTO;
     return;
   }
@@ -779,14 +1310,15 @@ static void so_trata_falta_pagina(so_t *self, processo* proc, int pagina)
   int dados[TAM_PAGINA];
   int tempo_bloqueio;
   err_t err = swap_le_pagina(self->swap, end_swap, dados, TAM_PAGINA, &tempo_bloqueio);
+  self->metrica->n_leituras_swap++;
   
   if (err != ERR_OK) {
-    console_printf("SO: ERRO ao ler página da swap");
+    log_erro(LOG_MEM, "SO: ERRO ao ler página da swap");
     proc->estado = MORTO;
     return;
   }
   
-  console_printf("SO: dados lidos: %d %d %d %d", dados[0], dados[1], dados[2], dados[3]);
+  log_depura(LOG_MEM, "SO: dados lidos: %d %d %d %d", dados[0], dados[1], dados[2], dados[3]);
   
   // Escreve os dados no quadro da memória principal
   int end_fis = quadro * TAM_PAGINA;
@@ -794,7 +1326,7 @@ static void so_trata_falta_pagina(so_t *self, processo* proc, int pagina)
   for (int i = 0; i < TAM_PAGINA; i++) {
     err_t err_mem = mem_escreve(self->mem, end_fis + i, dados[i]);
     if (err_mem != ERR_OK) {
-      console_printf("SO: ERRO ao escrever na memória offset=%d err=%d", i, err_mem);
+      log_erro(LOG_MEM, "SO: ERRO ao escrever na memória offset=%d err=%d", i, err_mem);
       proc->estado = MORTO;
       return;
     }
@@ -808,8 +1340,8 @@ static void so_trata_falta_pagina(so_t *self, processo* proc, int pagina)
   err_t err_verif = tabpag_traduz(proc->tabpag, pagina, &quadro_mapeado);
   
   if (err_verif != ERR_OK || quadro_mapeado != quadro) {
-    console_printf("SO: ERRO - mapeamento falhou! err=%d quadro_esperado=%d quadro_obtido=%d",
-                   err_verif, quadro, quadro_mapeado);
+    log_erro(LOG_MEM, "SO: ERRO - mapeamento falhou! err=%d quadro_esperado=%d quadro_obtido=%d",
+                      err_verif, quadro, quadro_mapeado);
     proc->estado = MORTO;
     return;
 
@@ -819,7 +1351,7 @@ static void so_trata_falta_pagina(so_t *self, processo* proc, int pagina)
   // Agora sim registra o quadro como ocupado
   mem_quadros_muda_estado(self->quadros, quadro, false, proc->pid, pagina);
   
-  console_printf("SO: página %d mapeada no quadro %d", pagina, quadro);
+  log_depura(LOG_MEM, "SO: página %d mapeada no quadro %d", pagina, quadro);
   
   // CRUCIAL: Reseta o erro para que a CPU possa continuar
   proc->regERRO = ERR_OK;
@@ -827,35 +1359,35 @@ static void so_trata_falta_pagina(so_t *self, processo* proc, int pagina)
   // Incrementa contador de faltas de página
   proc->n_faltas_pagina++;
   
-  console_printf("========== FIM TRATAMENTO FALTA ==========\n");
+  log_depura(LOG_MEM, "========== FIM TRATAMENTO FALTA ==========\n");
 }
 
 
 static void so_trata_irq_err_cpu(so_t *self)
 {
   if (self->processo_corrente == NULL) {
-    console_printf("SO: erro de CPU sem processo corrente");
+    log_erro(LOG_SO, "SO: erro de CPU sem processo corrente");
     return;
   }
 
   processo *proc = self->processo_corrente;
   err_t err = proc->regERRO;
-  mem_le(self->mem, CPU_END_complemento, &self->regComplemento);
+  mmu_le(self->mmu, CPU_END_complemento, &self->regComplemento, supervisor);
   
-  console_printf("SO: IRQ de ERRO na CPU: %s (complemento=%d) proc_idx=%d pid=%d pc=%d",
-                 err_nome(err), self->regComplemento, 
-                 /* índice do processo */ proc->pid, proc->regPC);
+  log_depura(LOG_SO, "SO: IRQ de ERRO na CPU: %s (complemento=%d) proc_idx=%d pid=%d pc=%d",
+                     err_nome(err), self->regComplemento, 
+                     /* índice do processo */ proc->pid, proc->regPC);
   
   if (err == ERR_PAG_AUSENTE) {
     int end_virt = self->regComplemento;
     int pagina = end_virt / TAM_PAGINA;
     
-    console_printf("SO: falta de página %d do processo %d", pagina, proc->pid);
+    log_depura(LOG_MEM, "SO: falta de página %d do processo %d", pagina, proc->pid);
     
     // Verifica se o endereço é válido para o processo
     if (pagina < 0 || pagina >= proc->n_paginas) {
-      console_printf("SO: acesso inválido à página %d (processo tem %d páginas)",
-                     pagina, proc->n_paginas);
+      log_aviso(LOG_MEM, "SO: acesso inválido à página %d (processo tem %d páginas)",
+                         pagina, proc->n_paginas);
       proc->estado = MORTO;
       return;
     }
@@ -871,6 +1403,32 @@ static void so_trata_irq_err_cpu(so_t *self)
   
 }
 
+// retorna true se o processo 'pid' está executando em outra CPU
+static bool so_processo_em_outra_cpu(so_t *self, int pid)
+{
+  for (int i = 0; i < self->n_cpus; i++) {
+    so_cpu_t *cpu = &self->cpus[i];
+    if (cpu != self->cpu_corrente && cpu->processo_corrente != NULL
+        && cpu->processo_corrente->pid == pid) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// evento do relógio: terminou um acesso ao disco
+// o disco não é um dispositivo de verdade, o tempo de acesso é simulado pelo
+//   SO; no fim, o evento faz o papel da controladora do disco, e pede a
+//   interrupção do disco (os processos são desbloqueados no tratamento dela)
+// é chamada pela CPU dona do relógio (a 0), fora de uma interrupção
+static void so_fim_acesso_disco(void *arg, int quando)
+{
+  so_t *self = arg;
+  if (es_escreve(self->cpus[0].es, D_PIC_PEDE, IRQ_DISCO) != ERR_OK) {
+    log_erro(LOG_SO, "SO: problema no pedido de interrupção do disco");
+  }
+}
+
 // Aloca um quadro livre ou libera um ocupado usando substituição de páginas
 static int so_aloca_quadro(so_t *self)
 {
@@ -878,7 +1436,7 @@ static int so_aloca_quadro(so_t *self)
   int quadro = mem_quadros_tem_livre(self->quadros);
   
   if (quadro >= 0) {
-    console_printf("SO: quadro %d alocado (livre)", quadro);
+    log_depura(LOG_MEM, "SO: quadro %d alocado (livre)", quadro);
     
     // IMPORTANTE: Marca o quadro como OCUPADO imediatamente
     // para que não seja alocado novamente antes de ser usado
@@ -888,8 +1446,19 @@ static int so_aloca_quadro(so_t *self)
   }
   
   // Não há quadros livres - precisa substituir uma página
-  console_printf("SO: sem quadros livres, substituindo página (FIFO)");
-  
+  log_depura(LOG_MEM, "SO: sem quadros livres, substituindo página (FIFO)");
+  
+  // Não substitui página de processo que está executando em outra CPU, que
+  //   pode estar usando a página (e ter a tradução na TLB)
+  int n_tentativas = mem_quadros_pega_tam(self->quadros);
+  while (so_processo_em_outra_cpu(self, mem_quadros_pega_dono(self->quadros, -1))) {
+    if (--n_tentativas <= 0) {
+      log_aviso(LOG_MEM, "SO: todos os quadros são de processos em execução");
+      return -1;
+    }
+    mem_quadros_manda_fim_fila(self->quadros);
+  }
+
   // Obtém o quadro a ser liberado (FIFO)
   quadro = mem_quadros_libera_quadro_fifo(self->quadros);
   
@@ -897,13 +1466,15 @@ static int so_aloca_quadro(so_t *self)
   int dono_pid = mem_quadros_pega_dono(self->quadros, quadro);
   int pagina_vitima = mem_quadros_pega_pagina(self->quadros, quadro);
   
-  console_printf("SO: substituindo pag=%d proc=%d quadro=%d", pagina_vitima, dono_pid, quadro);
+  log_depura(LOG_MEM, "SO: substituindo pag=%d proc=%d quadro=%d", pagina_vitima, dono_pid, quadro);
+  so_rastreia(self, RASTRO_SUBSTITUI, dono_pid, pagina_vitima, quadro);
+  self->metrica->n_substituicoes++;
   
   // Encontra o processo dono
   processo *proc_dono = encontra_processo_por_pid(self->tabela_processos, dono_pid);
   
   if (proc_dono == NULL) {
-    console_printf("SO: erro - processo dono %d não encontrado", dono_pid);
+    log_erro(LOG_MEM, "SO: erro - processo dono %d não encontrado", dono_pid);
     return -1;
   }
   
@@ -911,12 +1482,12 @@ static int so_aloca_quadro(so_t *self)
   bool alterada = tabpag_bit_alteracao(proc_dono->tabpag, pagina_vitima);
   
   if (alterada) {
-    console_printf("SO: página alterada, salvando na swap");
+    log_depura(LOG_MEM, "SO: página alterada, salvando na swap");
     
     // Salva página na swap
     int end_swap = swap_endereco_pagina(self->swap, dono_pid, pagina_vitima);
     if (end_swap < 0) {
-      console_printf("SO: erro ao obter endereço na swap");
+      log_erro(LOG_MEM, "SO: erro ao obter endereço na swap");
       return -1;
     }
     
@@ -930,11 +1501,14 @@ static int so_aloca_quadro(so_t *self)
     // Escreve na swap
     int tempo_bloqueio;
     swap_escreve_pagina(self->swap, end_swap, dados, TAM_PAGINA, &tempo_bloqueio);
+    self->metrica->n_escritas_swap++;
     
-    // Bloqueia o processo dono se for diferente do corrente
+    // Bloqueia o processo dono se for diferente do corrente, até o fim da
+    //   escrita no disco (um evento no relógio o desbloqueia)
     if (proc_dono != self->processo_corrente && self->processo_corrente->estado != MORTO) {
-      proc_dono->estado = BLOQUEADO;
+      muda_estado_proc(proc_dono, self->metrica, self->es, BLOQUEADO);
       proc_dono->tempo_desbloqueio = tempo_bloqueio;
+      relogio_agenda(self->relogio, tempo_bloqueio, so_fim_acesso_disco, self);
     }
   }
   
@@ -947,7 +1521,7 @@ static int so_aloca_quadro(so_t *self)
 
 static void so_chamada_le(so_t *self)
 {
-  console_printf("chamada de leitura   ");
+  log_depura(LOG_ES, "chamada de leitura   ");
   int terminal_teclado = self->processo_corrente->terminal; // D_TERM_X_TELA - 2 = D_TERM_X_TECLADO
   int estado;
 
@@ -955,46 +1529,114 @@ static void so_chamada_le(so_t *self)
   if(verifica_bloqueio_leitura(self->processo_corrente, self->metrica, self->es, estado, terminal_teclado)){
     int dado;
     if (es_le(self->es, terminal_teclado, &dado) != ERR_OK) {
-      console_printf("SO: problema no acesso ao teclado");
+      log_erro(LOG_ES, "SO: problema no acesso ao teclado");
       self->erro_interno = true;
       return;
     }
     self->processo_corrente->regA = dado;
   }
   else {
-    self->metrica->n_interrupcoes_tipo[IRQ_TELA]++;
+    self->metrica->n_bloqueios_leitura++;
     self->processo_corrente->aguardando_leitura = true;
   }
   
 }
 
+// ESCRITA EM BLOCO
+// com escrita_em_bloco (terminais com fila de saída), SO_ESCR coloca o
+//   caractere no fim do buffer de escrita do processo, e o buffer é passado
+//   ao terminal em um só acesso (es_escreve_bloco), que aceita o que couber
+//   na fila; o resto fica no buffer, e sai nas interrupções da tela
+// o processo só bloqueia com o buffer cheio, e o caractere que não coube
+//   fica em ultimo_char_para_escrever
+
+// passa ao terminal o que couber do buffer de escrita do processo
+static void so_esvazia_buffer_escrita(so_t *self, processo *proc)
+{
+  if (proc->n_buf_escrita == 0) return;
+  int terminal_tela = proc->terminal + TERM_TELA;
+  int escritos;
+  err_t err = es_escreve_bloco(self->es, terminal_tela, proc->n_buf_escrita,
+                               proc->buf_escrita, &escritos);
+  if (err != ERR_OK && err != ERR_OCUP) {
+    log_erro(LOG_ES, "SO: problema no acesso à tela do dispositivo %d", terminal_tela);
+    self->erro_interno = true;
+    return;
+  }
+  log_depura(LOG_ES, "escritos %d de %d caracteres no disp %d", escritos,
+             proc->n_buf_escrita, terminal_tela);
+  proc->n_buf_escrita -= escritos;
+  memmove(proc->buf_escrita, proc->buf_escrita + escritos,
+          proc->n_buf_escrita * sizeof(proc->buf_escrita[0]));
+}
+
+static void so_chamada_escr_em_bloco(so_t *self)
+{
+  processo *proc = self->processo_corrente;
+  log_depura(LOG_ES, "quer escrever %c no disp %d", proc->regX, proc->terminal + TERM_TELA);
+  if (proc->n_buf_escrita == TAM_BUF_ESCRITA) so_esvazia_buffer_escrita(self, proc);
+  if (proc->n_buf_escrita == TAM_BUF_ESCRITA) {
+    self->metrica->n_bloqueios_escrita++;
+    proc->ultimo_char_para_escrever = proc->regX;
+    proc->aguardando_leitura = false;
+    muda_estado_proc(proc, self->metrica, self->es, BLOQUEADO);
+    proc->esperando_dispositivo = proc->terminal + TERM_TELA;
+    log_depura(LOG_ES, "SO: bloqueando processo %d com o buffer de escrita cheio", proc->pid);
+    return;
+  }
+  proc->buf_escrita[proc->n_buf_escrita++] = proc->regX;
+  so_esvazia_buffer_escrita(self, proc);
+  proc->regA = 0;
+}
+
+// na interrupção da tela: passa mais do buffer ao terminal e, se o processo
+//   estava bloqueado com o buffer cheio e agora cabe o caractere, desbloqueia
+static void so_continua_escrita_em_bloco(so_t *self, processo *proc)
+{
+  so_esvazia_buffer_escrita(self, proc);
+  if (proc->estado != BLOQUEADO || proc->aguardando_leitura
+      || proc->esperando_dispositivo != proc->terminal + TERM_TELA
+      || proc->n_buf_escrita == TAM_BUF_ESCRITA) {
+    return;
+  }
+  proc->buf_escrita[proc->n_buf_escrita++] = proc->ultimo_char_para_escrever;
+  so_esvazia_buffer_escrita(self, proc);
+  proc->regA = 0;
+  proc->esperando_dispositivo = -1;
+  muda_estado_proc(proc, self->metrica, self->es, PRONTO);
+}
+
 // implementação da chamada se sistema SO_ESCR
 // escreve o valor do reg X na saída corrente do processo
 
 static void so_chamada_escr(so_t *self)
 {
-  console_printf("chamada de escrita   ");
+  log_depura(LOG_ES, "chamada de escrita   ");
+  if (self->escrita_em_bloco) {
+    so_chamada_escr_em_bloco(self);
+    return;
+  }
   int terminal_tela = self->processo_corrente->terminal+2; // D_TERM_X_TELA = D_TERM_X + 2
   int estado;
 
   estado = verifica_estado_dispositivo(self->es, terminal_tela, &self->erro_interno);
-  console_printf("quer escrever %c no disp %d", self->processo_corrente->regX, terminal_tela);
+  log_depura(LOG_ES, "quer escrever %c no disp %d", self->processo_corrente->regX, terminal_tela);
   if(verifica_bloqueio_leitura(self->processo_corrente, self->metrica, self->es, estado, terminal_tela)){
     int dado;
     dado = self->processo_corrente->regX;
-    console_printf("escrevendo %c no disp %d", dado, terminal_tela);
+    log_depura(LOG_ES, "escrevendo %c no disp %d", dado, terminal_tela);
     if (es_escreve(self->es, terminal_tela, dado) != ERR_OK) {
-      console_printf("SO: problema no acesso à tela do dispositivo %d", terminal_tela);
+      log_erro(LOG_ES, "SO: problema no acesso à tela do dispositivo %d", terminal_tela);
       self->erro_interno = true;
       return;
     }
     self->processo_corrente->regA = 0;
   }
   else {
-    self->metrica->n_interrupcoes_tipo[IRQ_TECLADO]++;
+    self->metrica->n_bloqueios_escrita++;
     self->processo_corrente->ultimo_char_para_escrever = self->processo_corrente->regX;
-    console_printf("SO: bloqueando processo %d na escrita do dispositivo %d\n", self->processo_corrente->pid, terminal_tela);
-    console_printf("esperando disp %d estado %d", self->processo_corrente->esperando_dispositivo, self->processo_corrente->estado);
+    log_depura(LOG_ES, "SO: bloqueando processo %d na escrita do dispositivo %d\n", self->processo_corrente->pid, terminal_tela);
+    log_depura(LOG_ES, "esperando disp %d estado %d", self->processo_corrente->esperando_dispositivo, self->processo_corrente->estado);
   }
   
 }
@@ -1008,23 +1650,25 @@ static void so_chamada_le(so_t *self);
 static void so_chamada_escr(so_t *self);
 static void so_chamada_cria_proc(so_t *self);
 static void so_chamada_espera_proc(so_t *self);
+static void so_chamada_afinidade(so_t *self);
 
 
 static void so_trata_irq_chamada_sistema(so_t *self)
 {
-  console_printf("chamada de sistema   ");
+  log_depura(LOG_SO, "chamada de sistema   ");
 
   // a identificação da chamada está no registrador A
   // t2: com processos, o reg A deve estar no descritor do processo corrente
 
   if (self->processo_corrente == NULL) {
-    console_printf("SO: processo_corrente inválido em chamada_sistema");
+    log_erro(LOG_SO, "SO: processo_corrente inválido em chamada_sistema");
     self->erro_interno = true;
     return;
   }
 
   int id_chamada = self->processo_corrente->regA;
-  console_printf("SO: chamada de sistema %d", id_chamada);
+  log_depura(LOG_SO, "SO: chamada de sistema %d", id_chamada);
+  so_rastreia(self, RASTRO_CHAMADA, -1, id_chamada, 0);
   switch (id_chamada) {
     case SO_LE:
       so_chamada_le(self);
@@ -1036,14 +1680,17 @@ static void so_trata_irq_chamada_sistema(so_t *self)
       so_chamada_cria_proc(self);
       break;
     case SO_MATA_PROC:
-      console_printf("chamada de mata proc   ");
+      log_depura(LOG_SO, "chamada de mata proc   ");
       so_chamada_mata_proc(self);
       break;
     case SO_ESPERA_PROC:
       so_chamada_espera_proc(self);
       break;
+    case SO_AFINIDADE:
+      so_chamada_afinidade(self);
+      break;
     default:
-      console_printf("SO: chamada de sistema desconhecida (%d)", id_chamada);
+      log_aviso(LOG_SO, "SO: chamada de sistema desconhecida (%d)", id_chamada);
       // t2: deveria matar o processo
       self->erro_interno = true;
   }
@@ -1053,15 +1700,19 @@ static void so_trata_irq_chamada_sistema(so_t *self)
 // interrupção gerada quando o timer expira
 static void so_trata_irq_relogio(so_t *self)
 {
-  console_printf("interrupção do relógio   ");
-  // rearma o interruptor do relógio e reinicializa o timer para a próxima interrupção
+  log_depura(LOG_SO, "interrupção do relógio   ");
+  // desliga o sinalizador de interrupção do relógio, e reconhece o pedido
+  //   feito por outra CPU (ver so_acorda_cpus); o timer é programado de
+  //   novo no fim do atendimento, se tiver algum prazo
   err_t e1, e2;
-  e1 = es_escreve(self->es, D_RELOGIO_INTERRUPCAO, 0); // desliga o sinalizador de interrupção
-  e2 = es_escreve(self->es, D_RELOGIO_TIMER, INTERVALO_INTERRUPCAO);
+  e1 = es_escreve(self->es, D_RELOGIO_INTERRUPCAO, 0);
+  e2 = es_escreve(self->es, D_PIC_RECONHECE, IRQ_RELOGIO);
   if (e1 != ERR_OK || e2 != ERR_OK) {
-    console_printf("SO: problema da reinicialização do timer");
+    log_erro(LOG_SO, "SO: problema da reinicialização do timer");
     self->erro_interno = true;
   }
+  self->metrica->n_interrupcoes_tipo[IRQ_RELOGIO]++;
+  so_marca_quadros(self);
   
   // Envelhecimento LRU para o processo corrente
   if (self->processo_corrente != NULL) {
@@ -1076,32 +1727,82 @@ static void so_trata_irq_relogio(so_t *self)
         // Adiciona bit de acesso no bit mais significativo
         if (tabpag_bit_acesso(proc->tabpag, pag)) {
           proc->lru_counter[pag] |= 0x80000000; // Seta bit mais significativo
-          tabpag_zera_bit_acesso(proc->tabpag, pag); // Zera o bit de acesso
+          mmu_zera_bit_acesso(self->mmu, pag); // Zera o bit de acesso
         }
       }
     }
   }
   
-  // t2: deveria tratar a interrupção
-  //   por exemplo, decrementa o quantum do processo corrente, quando se tem
-  //   um escalonamento com quantum
+  // o quantum restante foi calculado na entrada no SO (so_atualiza_quantum)
   if (self->processo_corrente != NULL) {
-    self->contador_quantum--;
     if (self->contador_quantum <= 0) {
       // Quantum esgotado, força troca de contexto
-      console_printf("SO: quantum esgotado para processo %d", self->processo_corrente->pid);
-      self->processo_corrente->estado = PRONTO;
+      log_depura(LOG_ESC, "SO: quantum esgotado para processo %d", self->processo_corrente->pid);
+      if (self->escalonador == ESC_RR) {
+        // vai para o fim da fila
+        so_cpu_t *cpu = &self->cpus[self->processo_corrente->cpu];
+        fila_retira(cpu, self->processo_corrente);
+        fila_insere(cpu, self->processo_corrente);
+      }
+      muda_estado_proc(self->processo_corrente, self->metrica, self->es, PRONTO);
       self->processo_corrente = NULL;  // força troca de processo
       return;
     }
   }
-  console_printf("SO: interrupção do relógio (não tratada)");
+  log_depura(LOG_SO, "SO: interrupção do relógio (não tratada)");
+}
+
+// interrupção gerada no fim de um acesso ao disco: desbloqueia os processos
+//   cujo acesso já terminou
+// como os pedidos se acumulam no controlador, uma interrupção pode
+//   corresponder ao fim de vários acessos
+static void so_trata_irq_disco(so_t *self)
+{
+  log_depura(LOG_SO, "interrupção do disco   ");
+  int agora;
+  if (es_escreve(self->es, D_PIC_RECONHECE, IRQ_DISCO) != ERR_OK
+      || es_le(self->es, D_RELOGIO_INSTRUCOES, &agora) != ERR_OK) {
+    log_erro(LOG_SO, "SO: problema no atendimento da interrupção do disco");
+    self->erro_interno = true;
+    return;
+  }
+  self->metrica->n_interrupcoes_tipo[IRQ_DISCO]++;
+  for (processo *proc = self->tabela_processos; proc != NULL; proc = proc->prox) {
+    if (proc->estado == BLOQUEADO && proc->tempo_desbloqueio > 0
+        && proc->tempo_desbloqueio <= agora) {
+      log_depura(LOG_MEM, "SO: fim do acesso ao disco, processo %d desbloqueado", proc->pid);
+      proc->tempo_desbloqueio = 0;
+      muda_estado_proc(proc, self->metrica, self->es, PRONTO);
+    }
+  }
+}
+
+// interrupção de um terminal: tem caractere para ler (teclado) ou pode
+//   escrever (tela) em pelo menos um deles; completa a E/S dos processos
+//   bloqueados esperando por isso
+// o pedido é por nível, não precisa ser reconhecido: a linha é desativada
+//   pelo terminal, ou a interrupção é desabilitada nele quando ninguém mais
+//   espera (ver so_programa_terminais)
+static void so_trata_irq_terminal(so_t *self, int irq)
+{
+  log_depura(LOG_ES, "interrupção do terminal (%s)   ", irq_nome(irq));
+  self->metrica->n_interrupcoes_tipo[irq]++;
+  bool leitura = irq == IRQ_TECLADO;
+  for (processo *proc = self->tabela_processos; proc != NULL; proc = proc->prox) {
+    if (!leitura && self->escrita_em_bloco) {
+      so_continua_escrita_em_bloco(self, proc);
+      continue;
+    }
+    if (proc->estado == MORTO || proc->esperando_dispositivo < 0) continue;
+    if (proc->aguardando_leitura != leitura) continue;
+    trata_bloqueio_disp(proc, self->metrica, self->es, &self->erro_interno);
+  }
 }
 
 static void so_trata_irq_desconhecida(so_t *self, int irq)
 {
-  console_printf("tratando IRQ desconhecida   ");
-  console_printf("SO: não sei tratar IRQ %d (%s)", irq, irq_nome(irq));
+  log_depura(LOG_SO, "tratando IRQ desconhecida   ");
+  log_erro(LOG_SO, "SO: não sei tratar IRQ %d (%s)", irq, irq_nome(irq));
   self->erro_interno = true;
 }
 
@@ -1113,11 +1814,11 @@ static void so_trata_irq_desconhecida(so_t *self, int irq)
 // Retorna o endereço virtual inicial ou -1 se erro
 static int so_carrega_programa(so_t *self, char *nome_do_executavel)
 {
-  console_printf("SO: carga de '%s'", nome_do_executavel);
+  log_info(LOG_MEM, "SO: carga de '%s'", nome_do_executavel);
   
   programa_t *prog = prog_cria(nome_do_executavel);
   if (prog == NULL) {
-    console_printf("SO: erro na leitura do programa '%s'", nome_do_executavel);
+    log_erro(LOG_MEM, "SO: erro na leitura do programa '%s'", nome_do_executavel);
     return -1;
   }
 
@@ -1125,21 +1826,21 @@ static int so_carrega_programa(so_t *self, char *nome_do_executavel)
   int tamanho = prog_tamanho(prog);
   int end_virt_fim = end_virt_ini + tamanho;
   
-  console_printf("SO: programa '%s' end_virt=%d-%d tamanho=%d", 
-                 nome_do_executavel, end_virt_ini, end_virt_fim, tamanho);
+  log_depura(LOG_MEM, "SO: programa '%s' end_virt=%d-%d tamanho=%d", 
+                      nome_do_executavel, end_virt_ini, end_virt_fim, tamanho);
 
   // Se for trata_int.maq, carrega DIRETO na memória física (não usa paginação)
   if (strcmp(nome_do_executavel, "trata_int.maq") == 0) {
     for (int end = end_virt_ini; end < end_virt_fim; end++) {
       if (mem_escreve(self->mem, end, prog_dado(prog, end)) != ERR_OK) {
-        console_printf("SO: erro na carga do programa de interrupção");
+        log_erro(LOG_MEM, "SO: erro na carga do programa de interrupção");
         prog_destroi(prog);
         return -1;
       }
     }
     prog_destroi(prog);
-    console_printf("SO: carga física de '%s' em %d-%d", 
-                   nome_do_executavel, end_virt_ini, end_virt_fim);
+    log_depura(LOG_MEM, "SO: carga física de '%s' em %d-%d", 
+                        nome_do_executavel, end_virt_ini, end_virt_fim);
     return end_virt_ini;
   }
 
@@ -1151,7 +1852,7 @@ static int so_carrega_programa(so_t *self, char *nome_do_executavel)
   // quando for criado. Aqui só retornamos o endereço de carga.
   
   prog_destroi(prog);
-  console_printf("SO: programa '%s' precisa de %d páginas", nome_do_executavel, n_paginas);
+  log_depura(LOG_MEM, "SO: programa '%s' precisa de %d páginas", nome_do_executavel, n_paginas);
   
   return end_virt_ini;
 }
@@ -1160,19 +1861,19 @@ static int so_carrega_programa(so_t *self, char *nome_do_executavel)
 static bool so_carrega_programa_na_swap(so_t *self, char *nome_do_executavel, processo *proc)
 {
   if (proc == NULL) {
-    console_printf("SO: processo NULL em carrega_programa_na_swap");
+    log_erro(LOG_MEM, "SO: processo NULL em carrega_programa_na_swap");
     return false;
   }
 
-  console_printf("SO: carregando programa '%s' proc=%d end_virt=%d-%d n_pag=%d", 
-                 nome_do_executavel, proc->pid, 
-                 proc->swap_inicio * TAM_PAGINA,
-                 (proc->swap_inicio + proc->n_paginas) * TAM_PAGINA,
-                 proc->n_paginas);
+  log_info(LOG_MEM, "SO: carregando programa '%s' proc=%d end_virt=%d-%d n_pag=%d", 
+                    nome_do_executavel, proc->pid, 
+                    proc->swap_inicio * TAM_PAGINA,
+                    (proc->swap_inicio + proc->n_paginas) * TAM_PAGINA,
+                    proc->n_paginas);
   
   programa_t *prog = prog_cria(nome_do_executavel);
   if (prog == NULL) {
-    console_printf("SO: erro na leitura do programa '%s'", nome_do_executavel);
+    log_erro(LOG_MEM, "SO: erro na leitura do programa '%s'", nome_do_executavel);
     return false;
   }
 
@@ -1185,7 +1886,7 @@ static bool so_carrega_programa_na_swap(so_t *self, char *nome_do_executavel, pr
   
   int swap_inicio = swap_aloca(self->swap, n_paginas, proc->pid);
   if (swap_inicio < 0) {
-    console_printf("SO: erro ao alocar swap para processo %d", proc->pid);
+    log_erro(LOG_MEM, "SO: erro ao alocar swap para processo %d", proc->pid);
     prog_destroi(prog);
     return false;
   }
@@ -1193,8 +1894,8 @@ static bool so_carrega_programa_na_swap(so_t *self, char *nome_do_executavel, pr
   proc->swap_inicio = swap_inicio;
   proc->n_paginas = n_paginas;
   
-  console_printf("SO: alocado swap[%d..%d] para proc=%d (%d páginas)", 
-                 swap_inicio, swap_inicio + n_paginas - 1, proc->pid, n_paginas);
+  log_depura(LOG_MEM, "SO: alocado swap[%d..%d] para proc=%d (%d páginas)", 
+                      swap_inicio, swap_inicio + n_paginas - 1, proc->pid, n_paginas);
   
   // Carrega cada página do programa na swap
   for (int pag = 0; pag < n_paginas; pag++) {
@@ -1221,24 +1922,25 @@ static bool so_carrega_programa_na_swap(so_t *self, char *nome_do_executavel, pr
     int tempo_bloqueio;
     err_t err = swap_escreve_pagina(self->swap, swap_inicio + pag, 
                                      dados_pagina, TAM_PAGINA, &tempo_bloqueio);
+    self->metrica->n_escritas_swap++;
     
     if (err != ERR_OK) {
-      console_printf("SO: erro ao escrever página %d na swap", pag);
+      log_erro(LOG_MEM, "SO: erro ao escrever página %d na swap", pag);
       prog_destroi(prog);
       return false;
     }
     
     if ((pag + 1) % 10 == 0) {
-      console_printf("SO: página %d/%d carregada na swap[%d]", 
-                     pag + 1, n_paginas, swap_inicio + pag);
+      log_depura(LOG_MEM, "SO: página %d/%d carregada na swap[%d]", 
+                          pag + 1, n_paginas, swap_inicio + pag);
     }
   }
   
-  console_printf("SO: página %d/%d carregada na swap[%d]", 
-                 n_paginas, n_paginas, swap_inicio + n_paginas - 1);
+  log_depura(LOG_MEM, "SO: página %d/%d carregada na swap[%d]", 
+                      n_paginas, n_paginas, swap_inicio + n_paginas - 1);
   
   prog_destroi(prog);
-  console_printf("SO: programa carregado na swap, %d páginas, paginação sob demanda", n_paginas);
+  log_depura(LOG_MEM, "SO: programa carregado na swap, %d páginas, paginação sob demanda", n_paginas);
   
   return true;
 }
@@ -1251,34 +1953,29 @@ static bool so_carrega_programa_na_swap(so_t *self, char *nome_do_executavel, pr
 
 static void so_trata_reset(so_t *self)
 {
-  console_printf("recebi RESET   ");
+  log_info(LOG_SO, "recebi RESET   ");
   
   // Carrega tratador de interrupção DIRETO na memória física
   int ender_trata = so_carrega_programa(self, "trata_int.maq");
   if (ender_trata != CPU_END_TRATADOR) {
-    console_printf("SO: problema na carga do programa de tratamento de interrupção");
+    log_erro(LOG_SO, "SO: problema na carga do programa de tratamento de interrupção");
     self->erro_interno = true;
     return;
   }
   
-  // Programa o relógio
-  if (es_escreve(self->es, D_RELOGIO_TIMER, INTERVALO_INTERRUPCAO) != ERR_OK) {
-    console_printf("SO: problema na programação do timer");
-    self->erro_interno = true;
-    return;
-  }
+  // o relógio é programado no fim do atendimento (so_programa_timer)
 
   // Cria processo init
   processo *p_init = processo_cria(1, -1, 0, self->quantum);
   if (p_init == NULL) {
-    console_printf("SO: erro ao criar processo init");
+    log_erro(LOG_SO, "SO: erro ao criar processo init");
     self->erro_interno = true;
     return;
   }
   
   // Carrega o programa init NA SWAP
-  if (!so_carrega_programa_na_swap(self, "init.maq", p_init)) {
-    console_printf("SO: erro ao carregar init na swap");
+  if (!so_carrega_programa_na_swap(self, self->programa_init, p_init)) {
+    log_erro(LOG_SO, "SO: erro ao carregar init na swap");
     self->erro_interno = true;
     free(p_init);
     return;
@@ -1292,22 +1989,22 @@ static void so_trata_reset(so_t *self)
   p_init->regX = 0;
   p_init->regERRO = ERR_OK;
   
-  console_printf("SO: init criado PC=%d A=%d X=%d erro=%d", 
-                 p_init->regPC, p_init->regA, p_init->regX, p_init->regERRO);
+  log_info(LOG_SO, "SO: init criado PC=%d A=%d X=%d erro=%d", 
+                   p_init->regPC, p_init->regA, p_init->regX, p_init->regERRO);
   
   // Carrega a PRIMEIRA PÁGINA (página 0) do init na memória física
   // para que ele possa começar a executar (paginação sob demanda)
-  console_printf("SO: carregando página inicial 0 do init na memória física");
+  log_depura(LOG_SO, "SO: carregando página inicial 0 do init na memória física");
   
   int quadro = so_aloca_quadro(self);
   if (quadro < 0) {
-    console_printf("SO: erro ao alocar quadro para página inicial");
+    log_erro(LOG_SO, "SO: erro ao alocar quadro para página inicial");
     self->erro_interno = true;
     free(p_init);
     return;
   }
   
-  console_printf("SO: quadro %d alocado (livre)", quadro);
+  log_depura(LOG_SO, "SO: quadro %d alocado (livre)", quadro);
   
   // Lê a página 0 da swap
   int end_swap = swap_endereco_pagina(self->swap, p_init->pid, 0);
@@ -1315,14 +2012,15 @@ static void so_trata_reset(so_t *self)
   int tempo_bloqueio;
   
   err_t err = swap_le_pagina(self->swap, end_swap, dados, TAM_PAGINA, &tempo_bloqueio);
+  self->metrica->n_leituras_swap++;
   if (err != ERR_OK) {
-    console_printf("SO: erro ao ler página inicial da swap");
+    log_erro(LOG_SO, "SO: erro ao ler página inicial da swap");
     self->erro_interno = true;
     free(p_init);
     return;
   }
   
-  console_printf("SO: lido da swap - primeira instrução: %d (esperado: 2 para NOP ou CARGI)", dados[0]);
+  log_depura(LOG_SO, "SO: lido da swap - primeira instrução: %d (esperado: 2 para NOP ou CARGI)", dados[0]);
   
   // Escreve na memória física
   int end_fis = quadro * TAM_PAGINA;
@@ -1330,7 +2028,7 @@ static void so_trata_reset(so_t *self)
     mem_escreve(self->mem, end_fis + i, dados[i]);
   }
   
-  console_printf("SO: página escrita na memória física quadro=%d end_fis=%d", quadro, end_fis);
+  log_depura(LOG_SO, "SO: página escrita na memória física quadro=%d end_fis=%d", quadro, end_fis);
   
   // Mapeia página 0 no quadro alocado
   int pagina_inicial = 0;
@@ -1340,11 +2038,11 @@ static void so_trata_reset(so_t *self)
   int quadro_verificado;
   err_t err_verif = tabpag_traduz(p_init->tabpag, pagina_inicial, &quadro_verificado);
   
-  console_printf("SO: verificação mapeamento - página=%d quadro_esperado=%d quadro_obtido=%d err=%d", 
-                 pagina_inicial, quadro, quadro_verificado, err_verif);
+  log_depura(LOG_SO, "SO: verificação mapeamento - página=%d quadro_esperado=%d quadro_obtido=%d err=%d", 
+                     pagina_inicial, quadro, quadro_verificado, err_verif);
   
   if (err_verif != ERR_OK || quadro_verificado != quadro) {
-    console_printf("SO: ERRO - mapeamento falhou!");
+    log_erro(LOG_SO, "SO: ERRO - mapeamento falhou!");
     self->erro_interno = true;
     free(p_init);
     return;
@@ -1353,42 +2051,59 @@ static void so_trata_reset(so_t *self)
   // Registra quadro como ocupado
   mem_quadros_muda_estado(self->quadros, quadro, false, p_init->pid, pagina_inicial);
   
-  console_printf("SO: página inicial mapeada com sucesso");
+  log_depura(LOG_SO, "SO: página inicial mapeada com sucesso");
   
   // Teste de leitura direta
   int teste_fis;
   mem_le(self->mem, end_fis, &teste_fis);
-  console_printf("SO: teste leitura física end=%d valor=%d", end_fis, teste_fis);
+  log_depura(LOG_SO, "SO: teste leitura física end=%d valor=%d", end_fis, teste_fis);
   
   // CRUCIAL: Configura MMU com a tabela de páginas do processo
   mmu_define_tabpag(self->mmu, p_init->tabpag);
-  console_printf("SO: MMU configurada com tabpag do processo %d", p_init->pid);
+  log_depura(LOG_SO, "SO: MMU configurada com tabpag do processo %d", p_init->pid);
   
   // Testa leitura via MMU
   int valor_virt;
   err_t err_mmu = mmu_le(self->mmu, 0, &valor_virt, supervisor);
-  console_printf("SO: teste leitura MMU end_virt=0 valor=%d err=%d (esperado: 2)", 
-                 valor_virt, err_mmu);
+  log_depura(LOG_SO, "SO: teste leitura MMU end_virt=0 valor=%d err=%d (esperado: 2)", 
+                     valor_virt, err_mmu);
   
   if (err_mmu != ERR_OK || valor_virt != 2) {
-    console_printf("SO: ERRO - MMU não está funcionando corretamente!");
+    log_erro(LOG_SO, "SO: ERRO - MMU não está funcionando corretamente!");
     self->erro_interno = true;
     free(p_init);
     return;
   }
 
   self->processo_corrente = p_init;
+  marca_criacao(self->metrica, self->es, p_init->pid - 1);
   insere_novo_processo(&self->tabela_processos, p_init);
+  fila_insere(self->cpu_corrente, p_init);
+}
+
+// reset de uma CPU secundária: espera a CPU principal inicializar o sistema
+//   (carregar o tratador de interrupção e criar o init) e programa o relógio
+//   desta CPU, que vai executar os processos que estiverem prontos
+static void so_trata_reset_secundaria(so_t *self)
+{
+  so_cpu_t *cpu = self->cpu_corrente;
+  log_info(LOG_SO, "SO: reset da CPU %d", cpu->id);
+  // a espera libera a trava, e outra CPU pode entrar no SO enquanto isso
+  so_sai(self, cpu);
+  while (!self->inicializado) {
+    pthread_cond_wait(&self->inicializacao, &self->trava);
+  }
+  so_entra(self, cpu);
 }
 
 // ---------------------------------------------------------------------
 // CHAMADA DE SISTEMA: CRIA PROCESSO
 static void so_chamada_cria_proc(so_t *self)
 {
-  console_printf("chamada de criação de processo   ");
+  log_depura(LOG_PROC, "chamada de criação de processo   ");
   
   if (self->processo_corrente == NULL) {
-    console_printf("SO: processo_corrente NULL em cria_proc");
+    log_erro(LOG_PROC, "SO: processo_corrente NULL em cria_proc");
     return;
   }
   
@@ -1396,27 +2111,33 @@ static void so_chamada_cria_proc(so_t *self)
   char nome[100];
   
   if (!so_copia_str_do_processo(self, 100, nome, ender_proc, self->processo_corrente)) {
-    console_printf("SO: erro ao copiar nome do programa");
+    log_aviso(LOG_PROC, "SO: erro ao copiar nome do programa");
     self->processo_corrente->regA = -1;
     return;
   }
   
+  // os pids não são reaproveitados, e as métricas são indexadas por eles
+  if (self->proximo_pid > MAX_PROCESSOS) {
+    log_aviso(LOG_PROC, "SO: limite de %d processos atingido", MAX_PROCESSOS);
+    self->processo_corrente->regA = -1;
+    return;
+  }
+
   // Cria o processo
-  static int proximo_pid = 2; // init é 1
-  processo *novo_proc = processo_cria(proximo_pid++, 
+  processo *novo_proc = processo_cria(self->proximo_pid++, 
                                        self->processo_corrente->pid, 
                                        0, 
                                        self->quantum);
   
   if (novo_proc == NULL) {
-    console_printf("SO: erro ao criar processo");
+    log_erro(LOG_PROC, "SO: erro ao criar processo");
     self->processo_corrente->regA = -1;
     return;
   }
   
   // Carrega o programa NA SWAP
   if (!so_carrega_programa_na_swap(self, nome, novo_proc)) {
-    console_printf("SO: erro ao carregar programa '%s' na swap", nome);
+    log_aviso(LOG_PROC, "SO: erro ao carregar programa '%s' na swap", nome);
     self->processo_corrente->regA = -1;
     free(novo_proc);
     return;
@@ -1429,14 +2150,18 @@ static void so_chamada_cria_proc(so_t *self)
   novo_proc->regERRO = ERR_OK;
   novo_proc->estado = PRONTO;
   
-  // Insere na tabela de processos
+  // Insere na tabela de processos e na fila de uma CPU (herda a afinidade
+  //   do criador)
+  novo_proc->afinidade = self->processo_corrente->afinidade;
+  marca_criacao(self->metrica, self->es, novo_proc->pid - 1);
   insere_novo_processo(&self->tabela_processos, novo_proc);
+  so_atribui_cpu(self, novo_proc);
   
   // Retorna PID do filho
   self->processo_corrente->regA = novo_proc->pid;
   
-  console_printf("SO: processo %d criado com sucesso (filho de %d)", 
-                 novo_proc->pid, self->processo_corrente->pid);
+  log_info(LOG_PROC, "SO: processo %d criado com sucesso (filho de %d)", 
+                     novo_proc->pid, self->processo_corrente->pid);
 
   diagnostico_memoria_virtual(self, novo_proc, "após criação do processo");
 }
@@ -1460,7 +2185,7 @@ static bool so_copia_str_do_processo(so_t *self, int tam, char str[tam],
     // Se houver falta de página, trata
     if (err == ERR_PAG_AUSENTE) {
       int pagina = (end_virt + indice_str) / TAM_PAGINA;
-      console_printf("SO: falta de página em copia_str (pag=%d)", pagina);
+      log_depura(LOG_MEM, "SO: falta de página em copia_str (pag=%d)", pagina);
       so_trata_falta_pagina(self, processo, pagina);
       
       // Tenta ler novamente
@@ -1511,7 +2236,7 @@ static void so_chamada_mata_proc(so_t *self)
   if(pid_alvo == 0) {
     pid_alvo = self->processo_corrente->pid;
   }
-  console_printf("SO: chamada de mata processo %d \n", pid_alvo);
+  log_depura(LOG_PROC, "SO: chamada de mata processo %d \n", pid_alvo);
   processo *alvo = encontra_processo_por_pid(self->tabela_processos, pid_alvo);
   
   if (alvo == NULL || alvo->estado == MORTO) {
@@ -1519,16 +2244,14 @@ static void so_chamada_mata_proc(so_t *self)
     return;
   }
   
-  int tempo_inicio = 0;
-  es_le(self->es, D_RELOGIO_INSTRUCOES, &tempo_inicio);
-  self->metrica->tempo_retorno[alvo->pid-1] = tempo_inicio - self->metrica->tempo_retorno[alvo->pid-1];
+  marca_morte(self->metrica, self->es, alvo->pid - 1);
 
-  console_printf("SO: matando processo %d", alvo->pid);
+  log_info(LOG_PROC, "SO: matando processo %d", alvo->pid);
   muda_estado_proc(alvo, self->metrica, self->es, MORTO);
   
   // CRUCIAL: Se matou a si mesmo, anula processo_corrente
   if (alvo == self->processo_corrente) {
-    console_printf("SO: processo %d se matou, anulando processo_corrente", alvo->pid);
+    log_depura(LOG_PROC, "SO: processo %d se matou, anulando processo_corrente", alvo->pid);
     self->processo_corrente = NULL;
   }
   
@@ -1551,7 +2274,7 @@ static void so_chamada_mata_proc(so_t *self)
           }
           
           if (!ainda_esperando) {
-            console_printf("SO: desbloqueando pai %d", pai->pid);
+            log_depura(LOG_PROC, "SO: desbloqueando pai %d", pai->pid);
             muda_estado_proc(pai, self->metrica, self->es, PRONTO);
           }
         }
@@ -1568,10 +2291,16 @@ static void so_chamada_espera_proc(so_t *self)
   int pid_esperado = self->processo_corrente->regX;
   processo *alvo = encontra_processo_por_pid(self->tabela_processos, pid_esperado);
   
-  console_printf("SO: chamada de espera de processo %d \n", pid_esperado);
+  log_depura(LOG_PROC, "SO: chamada de espera de processo %d \n", pid_esperado);
   
   if (alvo == NULL || alvo->estado == MORTO) {
-    console_printf("SO: processo esperado já terminou ou não existe %d \n", pid_esperado);
+    log_depura(LOG_PROC, "SO: processo esperado já terminou ou não existe %d \n", pid_esperado);
+    self->processo_corrente->regA = -1;
+    return;
+  }
+  if (self->processo_corrente->indice_esperando_pid >= MAX_PROCESSOS) {
+    log_aviso(LOG_PROC, "SO: processo %d já esperou por processos demais",
+                        self->processo_corrente->pid);
     self->processo_corrente->regA = -1;
     return;
   }
@@ -1579,10 +2308,6 @@ static void so_chamada_espera_proc(so_t *self)
   // Bloqueia o processo corrente
   muda_estado_proc(self->processo_corrente, self->metrica, self->es, BLOQUEADO);
   
-  // Registra métricas
-  self->metrica->n_entradas_estado[self->processo_corrente->pid-1][BLOQUEADO]++;
-  es_le(self->es, D_RELOGIO_INSTRUCOES, &self->metrica->tempo_estado[self->processo_corrente->pid-1][BLOQUEADO]);
-  
   // Marca que está esperando o processo
   self->processo_corrente->esperando_pid[self->processo_corrente->indice_esperando_pid] = pid_esperado;
   self->processo_corrente->indice_esperando_pid++;
@@ -1590,39 +2315,62 @@ static void so_chamada_espera_proc(so_t *self)
   // CRUCIAL: Anula processo_corrente para forçar escalonamento
   self->processo_corrente = NULL;
   
-  console_printf("SO: processo %d bloqueado esperando processo %d \n", 
-                 self->tabela_processos ? self->tabela_processos->pid : -1, pid_esperado);
+  log_depura(LOG_PROC, "SO: processo %d bloqueado esperando processo %d \n", 
+                       self->tabela_processos ? self->tabela_processos->pid : -1, pid_esperado);
+}
+
+// implementação da chamada se sistema SO_AFINIDADE
+// define as CPUs em que o processo chamador pode executar (X)
+static void so_chamada_afinidade(so_t *self)
+{
+  processo *proc = self->processo_corrente;
+  unsigned afinidade = proc->regX;
+  if (afinidade == 0) afinidade = AFINIDADE_TODAS;
+  if ((afinidade & ((1u << self->n_cpus) - 1)) == 0) {
+    log_aviso(LOG_PROC, "SO: afinidade %#x sem CPU existente", afinidade);
+    proc->regA = -1;
+    return;
+  }
+  proc->afinidade = afinidade;
+  proc->regA = 0;
+  log_info(LOG_PROC, "SO: processo %d com afinidade %#x", proc->pid, afinidade);
+
+  // se não pode ficar nesta CPU, vai para outra no fim desta chamada
+  if (!cpu_permitida(proc, proc->cpu)) {
+    migra_processo(self, proc, cpu_menos_carregada(self, proc), false);
+    self->contador_quantum = 0;
+  }
 }
 
 // Função de diagnóstico para verificar a configuração de memória virtual
 static void diagnostico_memoria_virtual(so_t *self, processo *proc, const char *contexto)
 {
-  console_printf("\n========== DIAGNÓSTICO: %s ==========", contexto);
-  console_printf("Processo PID=%d PC=%d", proc->pid, proc->regPC);
-  console_printf("Swap: inicio=%d n_paginas=%d", proc->swap_inicio, proc->n_paginas);
+  log_depura(LOG_MEM, "\n========== DIAGNÓSTICO: %s ==========", contexto);
+  log_depura(LOG_MEM, "Processo PID=%d PC=%d", proc->pid, proc->regPC);
+  log_depura(LOG_MEM, "Swap: inicio=%d n_paginas=%d", proc->swap_inicio, proc->n_paginas);
   
   // Verifica tabela de páginas
   if (proc->tabpag == NULL) {
-    console_printf("ERRO: tabela de páginas é NULL!");
+    log_erro(LOG_MEM, "ERRO: tabela de páginas é NULL!");
     return;
   }
   
   // Tenta acessar a primeira página (onde está o PC)
   int pagina_pc = proc->regPC / TAM_PAGINA;
-  console_printf("PC=%d está na página %d", proc->regPC, pagina_pc);
+  log_depura(LOG_MEM, "PC=%d está na página %d", proc->regPC, pagina_pc);
   
   // Usa tabpag_traduz para verificar se a página está mapeada
   int quadro_pc;
   err_t err_traduz = tabpag_traduz(proc->tabpag, pagina_pc, &quadro_pc);
   
   if (err_traduz == ERR_OK) {
-    console_printf("Página %d VÁLIDA - mapeada no quadro %d", pagina_pc, quadro_pc);
+    log_depura(LOG_MEM, "Página %d VÁLIDA - mapeada no quadro %d", pagina_pc, quadro_pc);
     
     // Lê diretamente da memória física usando o quadro
     int end_fis = quadro_pc * TAM_PAGINA + (proc->regPC % TAM_PAGINA);
     int valor_fis;
     err_t err_mem = mem_le(self->mem, end_fis, &valor_fis);
-    console_printf("Leitura física: end=%d valor=%d err=%d", end_fis, valor_fis, err_mem);
+    log_depura(LOG_MEM, "Leitura física: end=%d valor=%d err=%d", end_fis, valor_fis, err_mem);
     
     // Mostra primeiros valores do quadro
     int val0, val1, val2, val3;
@@ -1630,26 +2378,141 @@ static void diagnostico_memoria_virtual(so_t *self, processo *proc, const char *
     mem_le(self->mem, quadro_pc * TAM_PAGINA + 1, &val1);
     mem_le(self->mem, quadro_pc * TAM_PAGINA + 2, &val2);
     mem_le(self->mem, quadro_pc * TAM_PAGINA + 3, &val3);
-    console_printf("Primeiros valores no quadro físico: %d %d %d %d", val0, val1, val2, val3);
+    log_depura(LOG_MEM, "Primeiros valores no quadro físico: %d %d %d %d", val0, val1, val2, val3);
   } else {
-    console_printf("Página %d AUSENTE (err=%d) - está apenas na swap", pagina_pc, err_traduz);
+    log_depura(LOG_MEM, "Página %d AUSENTE (err=%d) - está apenas na swap", pagina_pc, err_traduz);
   }
   
   // Verifica swap
   int end_swap = swap_endereco_pagina(self->swap, proc->pid, pagina_pc);
-  console_printf("Endereço na swap: %d", end_swap);
+  log_depura(LOG_MEM, "Endereço na swap: %d", end_swap);
   
   if (end_swap >= 0) {
     int dados[TAM_PAGINA];
     int tempo;
     err_t err = swap_le_pagina(self->swap, end_swap, dados, TAM_PAGINA, &tempo);
-    console_printf("Leitura swap: err=%d primeiro_valor=%d", err, dados[0]);
+    log_depura(LOG_MEM, "Leitura swap: err=%d primeiro_valor=%d", err, dados[0]);
     
     // Mostra primeiros valores
-    console_printf("Primeiros valores na swap: %d %d %d %d", 
-                   dados[0], dados[1], dados[2], dados[3]);
+    log_depura(LOG_MEM, "Primeiros valores na swap: %d %d %d %d", 
+                        dados[0], dados[1], dados[2], dados[3]);
   }
   
-  console_printf("========== FIM DIAGNÓSTICO ==========\n");
+  log_depura(LOG_MEM, "========== FIM DIAGNÓSTICO ==========\n");
+}
+
+
+// ---------------------------------------------------------------------
+// IMAGEM {{{1
+// ---------------------------------------------------------------------
+
+// marca para conferir que a parte do SO na imagem começa e termina onde devia
+#define MARCA_IMAGEM_SO 0x50533235
+
+bool so_salva(so_t *self, FILE *arq)
+{
+  // com mais de uma CPU, as outras podem estar dentro do SO
+  if (self->n_cpus != 1) return false;
+  so_cpu_t *cpu = &self->cpus[0];
+
+  int n_proc = 0;
+  for (processo *p = self->tabela_processos; p != NULL; p = p->prox) n_proc++;
+  int n_fila = 0;
+  for (processo *p = cpu->fila; p != NULL; p = p->prox_fila) n_fila++;
+  int corrente = cpu->processo_corrente == NULL ? 0 : cpu->processo_corrente->pid;
+
+  bool ok = imagem_escreve_int(arq, MARCA_IMAGEM_SO)
+         && imagem_escreve_int(arq, self->quantum)
+         && imagem_escreve_int(arq, cpu->contador_quantum)
+         && imagem_escreve_int(arq, cpu->fim_quantum)
+         && imagem_escreve_int(arq, self->proximo_pid)
+         && imagem_escreve_int(arq, self->next_quadro_livre)
+         && imagem_escreve_int(arq, self->quadro_livre_pri)
+         && imagem_escreve_int(arq, self->quadro_livre_sec)
+         && imagem_escreve_int(arq, self->proximo_end_livre_disco)
+         && imagem_escreve_int(arq, self->inicializado)
+         && imagem_escreve_int(arq, self->encerrado)
+         && imagem_escreve_int(arq, self->erro_interno)
+         && metrica_salva(self->metrica, arq)
+         && mem_quadros_salva(self->quadros, arq)
+         && swap_salva(self->swap, arq)
+         && imagem_escreve_int(arq, n_proc);
+  for (processo *p = self->tabela_processos; ok && p != NULL; p = p->prox) {
+    ok = processo_salva(p, arq);
+  }
+  // a fila de execução vai como a sequência dos pids
+  ok = ok && imagem_escreve_int(arq, n_fila);
+  for (processo *p = cpu->fila; ok && p != NULL; p = p->prox_fila) {
+    ok = imagem_escreve_int(arq, p->pid);
+  }
+  return ok
+      && imagem_escreve_int(arq, corrente)
+      && imagem_escreve_int(arq, MARCA_IMAGEM_SO);
+}
+
+bool so_recupera(so_t *self, FILE *arq)
+{
+  if (self->n_cpus != 1 || self->tabela_processos != NULL) return false;
+  so_cpu_t *cpu = &self->cpus[0];
+
+  int inicializado, encerrado, erro_interno, n_proc;
+  if (!imagem_confere_int(arq, MARCA_IMAGEM_SO)
+      || !imagem_le_int(arq, &self->quantum)
+      || !imagem_le_int(arq, &cpu->contador_quantum)
+      || !imagem_le_int(arq, &cpu->fim_quantum)
+      || !imagem_le_int(arq, &self->proximo_pid)
+      || !imagem_le_int(arq, &self->next_quadro_livre)
+      || !imagem_le_int(arq, &self->quadro_livre_pri)
+      || !imagem_le_int(arq, &self->quadro_livre_sec)
+      || !imagem_le_int(arq, &self->proximo_end_livre_disco)
+      || !imagem_le_int(arq, &inicializado)
+      || !imagem_le_int(arq, &encerrado)
+      || !imagem_le_int(arq, &erro_interno)
+      || !metrica_recupera(self->metrica, arq)
+      || !mem_quadros_recupera(self->quadros, arq)
+      || !swap_recupera(self->swap, arq)
+      || !imagem_le_int(arq, &n_proc)) {
+    return false;
+  }
+  self->inicializado = inicializado;
+  self->encerrado = encerrado;
+  self->erro_interno = erro_interno;
+  // as interrupções habilitadas estão nos terminais recuperados
+  self->irq_terminais = -1;
+
+  for (int i = 0; i < n_proc; i++) {
+    processo *p = processo_recupera(arq);
+    if (p == NULL) return false;
+    insere_novo_processo(&self->tabela_processos, p);
+  }
+
+  int n_fila, pid;
+  if (!imagem_le_int(arq, &n_fila)) return false;
+  cpu->fila = NULL;
+  for (int i = 0; i < n_fila; i++) {
+    if (!imagem_le_int(arq, &pid)) return false;
+    processo *p = encontra_processo_por_pid(self->tabela_processos, pid);
+    if (p == NULL) return false;
+    fila_insere(cpu, p);
+  }
+
+  if (!imagem_le_int(arq, &pid) || !imagem_confere_int(arq, MARCA_IMAGEM_SO)) {
+    return false;
+  }
+  cpu->processo_corrente = encontra_processo_por_pid(self->tabela_processos, pid);
+  self->processo_corrente = cpu->processo_corrente;
+  self->contador_quantum = cpu->contador_quantum;
+  if (cpu->processo_corrente != NULL) {
+    mmu_define_tabpag(cpu->mmu, cpu->processo_corrente->tabpag);
+  }
+
+  // os eventos do relógio não estão na imagem: agenda de novo o fim dos
+  //   acessos ao disco que estavam em andamento
+  for (processo *p = self->tabela_processos; p != NULL; p = p->prox) {
+    if (p->estado == BLOQUEADO && p->tempo_desbloqueio > 0) {
+      relogio_agenda(self->relogio, p->tempo_desbloqueio, so_fim_acesso_disco, self);
+    }
+  }
+  return true;
 }
 // vim: foldmethod=marker
@@ -14,14 +14,83 @@ typedef struct so_t so_t;
 #include "es.h"
 #include "console.h" // só para uma gambiarra
 #include "relogio.h"
+#include "memoria_quadros.h"
+#include "metrica.h"
+#include "rastro.h"
+#include <stdio.h>
+
+// escalonadores
+#define ESC_RR         1  // circular: o primeiro pronto da fila, e quem
+                          //   esgota o quantum vai para o fim da fila
+#define ESC_PRIORIDADE 2  // o pronto com menor prioridade (a prioridade é a
+                          //   média da fração do quantum usada)
+
+// parâmetros do SO que podem mudar de uma simulação para outra
+// (o tamanho da memória é o da memória passada a so_cria)
+typedef struct {
+  // intervalo do relógio, em instruções: a unidade do quantum e o período
+  //   de verificação dos terminais
+  int intervalo_interrupcao;
+  // quantum, em intervalos do relógio
+  int quantum;
+  // ESC_RR ou ESC_PRIORIDADE
+  int escalonador;
+  // algoritmo de substituição de páginas
+  mem_q_tipo_t substituicao;
+  // programa executado pelo primeiro processo
+  char *init;
+  // escrita em bloco, para terminais com fila de saída: SO_ESCR coloca o
+  //   caractere no buffer do processo, que é passado ao terminal em um só
+  //   acesso, e o processo só bloqueia com o buffer cheio; sem, cada SO_ESCR
+  //   escreve um caractere, e bloqueia se o terminal não aceitar
+  bool escrita_em_bloco;
+} so_config_t;
+
+// preenche 'config' com os valores usados quando não se escolhe nada
+void so_config_padrao(so_config_t *config);
 
 so_t *so_cria(cpu_t *cpu, mem_t *mem, mem_t *disco, mmu_t *mmu,
-              es_t *es, console_t *console, relogio_t *relogio);
+              es_t *es, console_t *console, relogio_t *relogio,
+              so_config_t *config);
 void so_destroi(so_t *self);
 
-// permite escolher o escalonador em runtime (1=RR, 2=prioridade)
+// acrescenta uma CPU que compartilha a memória com a CPU passada a so_cria,
+//   com sua própria MMU e controlador de E/S (com o relógio dela)
+// o SO reserva um quadro da memória para a área local da CPU (onde ela salva
+//   seu estado nas interrupções) e passa a ser chamado pelo CHAMAC dela
+// deve ser chamada antes de as CPUs começarem a executar
+// retorna false se não for possível (CPUs demais)
+bool so_adiciona_cpu(so_t *self, cpu_t *cpu, mmu_t *mmu, es_t *es);
+
+// permite escolher o escalonador em runtime (ESC_RR ou ESC_PRIORIDADE)
 void so_define_escalonador(so_t *self, int id);
 
+// passa a registrar os eventos do SO em 'rastro' (ver rastro.h)
+// deve ser chamada antes de as CPUs começarem a executar
+void so_define_rastro(so_t *self, rastro_t *rastro);
+
+// escreve as métricas do SO no arquivo (o mesmo que é mostrado na console
+//   quando todos os processos morrem)
+void so_imprime_metricas(so_t *self, FILE *arq);
+
+// retorna as métricas do SO, atualizadas com o tempo das CPUs
+metricas *so_metricas(so_t *self);
+
+// escreve as métricas do SO no arquivo 'nome', em JSON ou CSV (ver
+//   metrica_exporta), com a ocupação dos quadros e o tempo das CPUs de agora
+// retorna false se o arquivo não puder ser escrito
+bool so_exporta_metricas(so_t *self, char *nome);
+
+// salva o estado do SO (processos, quadros, swap, métricas) na imagem 'arq'
+//   (ver imagem.h)
+// só com uma CPU, e com ela fora do SO (entre rajadas de execução)
+bool so_salva(so_t *self, FILE *arq);
+
+// recupera o estado do SO da imagem 'arq'
+// o SO deve ter acabado de ser criado (com uma CPU, sem processos); a
+//   memória, a CPU e o relógio devem ser recuperados junto, da mesma imagem
+bool so_recupera(so_t *self, FILE *arq);
+
 // Chamadas de sistema
 // Uma chamada de sistema é realizada colocando a identificação da
 //   chamada (um dos valores abaixo) no registrador A e executando a
@@ -81,4 +150,13 @@ void so_define_escalonador(so_t *self, int id);
 // retorna sem bloquear, com erro, se não existir processo com esse pid
 #define SO_ESPERA_PROC 9
 
+// define em que CPUs o processo chamador pode executar
+// recebe em X o conjunto de CPUs (o bit i representa a CPU i), ou 0 para
+//   todas; os processos que ele criar depois herdam esse conjunto
+// retorna em A: 0 se OK ou um código de erro negativo (se o conjunto não
+//   tem nenhuma CPU existente)
+// se a CPU em que o processo está não pertence ao conjunto, ele passa para
+//   uma que pertence
+#define SO_AFINIDADE  10
+
 #endif // SO_H
@@ -4,7 +4,8 @@
 // so25b
 
 #include "swap.h"
-#include "console.h"
+#include "log.h"
+#include "imagem.h"
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -31,14 +32,14 @@ struct swap_t {
 // UTILIZA A FILA DE ALOCACAO
 
 alocacao_t *cria_alocacao(int processo, int end_inicio, int n_paginas) {
-    console_printf("SWAP: criando alocação proc=%d end=%d pags=%d", processo, end_inicio, n_paginas);
+    log_depura(LOG_MEM, "SWAP: criando alocação proc=%d end=%d pags=%d", processo, end_inicio, n_paginas);
     alocacao_t *aloc = malloc(sizeof(alocacao_t));
     assert(aloc != NULL);
     aloc->processo = processo;
     aloc->end_inicio = end_inicio;
     aloc->n_paginas = n_paginas;
     aloc->prox = NULL;
-    console_printf("SWAP: alocação criada proc=%d end=%d pags=%d", processo, end_inicio, n_paginas);
+    log_depura(LOG_MEM, "SWAP: alocação criada proc=%d end=%d pags=%d", processo, end_inicio, n_paginas);
     return aloc;
 }
 
@@ -47,7 +48,7 @@ void destroi_alocacao(alocacao_t *aloc) {
 }
 
 void insere_final_alocacao(swap_t *self, alocacao_t *aloc) {
-    console_printf("SWAP: inserindo alocação proc=%d end=%d pags=%d", aloc->processo, aloc->end_inicio, aloc->n_paginas);
+    log_depura(LOG_MEM, "SWAP: inserindo alocação proc=%d end=%d pags=%d", aloc->processo, aloc->end_inicio, aloc->n_paginas);
     if(self->alocacoes == NULL) {
         self->alocacoes = aloc;
         return;
@@ -57,12 +58,12 @@ void insere_final_alocacao(swap_t *self, alocacao_t *aloc) {
         atual = atual->prox;
     }
     atual->prox = aloc;
-    console_printf("SWAP: alocação inserida proc=%d end=%d pags=%d", aloc->processo, aloc->end_inicio, aloc->n_paginas);
+    log_depura(LOG_MEM, "SWAP: alocação inserida proc=%d end=%d pags=%d", aloc->processo, aloc->end_inicio, aloc->n_paginas);
 }
 
 swap_t *swap_cria(int n_paginas, int tam_pagina, relogio_t *relogio)
 {
-    console_printf("SWAP: criando swap com %d páginas de %d palavras", n_paginas, tam_pagina);
+    log_info(LOG_MEM, "SWAP: criando swap com %d páginas de %d palavras", n_paginas, tam_pagina);
     swap_t *self = malloc(sizeof(*self));
     assert(self != NULL);
     
@@ -79,7 +80,7 @@ swap_t *swap_cria(int n_paginas, int tam_pagina, relogio_t *relogio)
     self->relogio = relogio;
     self->disco_livre_em = 0;
     self->alocacoes = NULL;
-    console_printf("SWAP: swap criada com sucesso");
+    log_depura(LOG_MEM, "SWAP: swap criada com sucesso");
     return self;
 }
 
@@ -102,9 +103,9 @@ void swap_destroi(swap_t *self)
 
 int swap_aloca(swap_t *self, int n_paginas, int processo)
 {
-    console_printf("SWAP: solicitada alocação proc=%d pags=%d", processo, n_paginas);
+    log_depura(LOG_MEM, "SWAP: solicitada alocação proc=%d pags=%d", processo, n_paginas);
     if (self->prox_livre + n_paginas > self->n_paginas) {
-        console_printf("SWAP: sem espaço para alocar %d páginas", n_paginas);
+        log_aviso(LOG_MEM, "SWAP: sem espaço para alocar %d páginas", n_paginas);
         return -1;
     }
     
@@ -116,7 +117,7 @@ int swap_aloca(swap_t *self, int n_paginas, int processo)
     
     insere_final_alocacao(self, aloc);
     
-    console_printf("SWAP: alocado proc=%d pags=%d end=%d", processo, n_paginas, end_inicio);
+    log_depura(LOG_MEM, "SWAP: alocado proc=%d pags=%d end=%d", processo, n_paginas, end_inicio);
     return end_inicio;
 }
 
@@ -127,7 +128,7 @@ void swap_libera_processo(swap_t *self, int processo)
         if ((*pp)->processo == processo) {
             alocacao_t *temp = *pp;
             *pp = (*pp)->prox;
-            console_printf("SWAP: liberado proc=%d", processo);
+            log_depura(LOG_MEM, "SWAP: liberado proc=%d", processo);
             free(temp);
         } else {
             pp = &(*pp)->prox;
@@ -138,7 +139,7 @@ void swap_libera_processo(swap_t *self, int processo)
 err_t swap_escreve_pagina(swap_t *self, int end_swap, int *dados, int tam, int *tempo_bloqueio)
 {
     if (end_swap < 0 || end_swap >= self->n_paginas) {
-        console_printf("SWAP: endereço inválido %d", end_swap);
+        log_erro(LOG_MEM, "SWAP: endereço inválido %d", end_swap);
         return ERR_END_INV;
     }
     
@@ -161,14 +162,14 @@ err_t swap_escreve_pagina(swap_t *self, int end_swap, int *dados, int tam, int *
     
     *tempo_bloqueio = self->disco_livre_em;
     
-    console_printf("SWAP: escrita end=%d tam=%d bloq_ate=%d", end_swap, tam, *tempo_bloqueio);
+    log_depura(LOG_MEM, "SWAP: escrita end=%d tam=%d bloq_ate=%d", end_swap, tam, *tempo_bloqueio);
     return ERR_OK;
 }
 
 err_t swap_le_pagina(swap_t *self, int end_swap, int *dados, int tam, int *tempo_bloqueio)
 {
     if (end_swap < 0 || end_swap >= self->n_paginas) {
-        console_printf("SWAP: endereço inválido %d", end_swap);
+        log_erro(LOG_MEM, "SWAP: endereço inválido %d", end_swap);
         return ERR_END_INV;
     }
     
@@ -191,7 +192,7 @@ err_t swap_le_pagina(swap_t *self, int end_swap, int *dados, int tam, int *tempo
     
     *tempo_bloqueio = self->disco_livre_em;
     
-    console_printf("SWAP: leitura end=%d tam=%d bloq_ate=%d", end_swap, tam, *tempo_bloqueio);
+    log_depura(LOG_MEM, "SWAP: leitura end=%d tam=%d bloq_ate=%d", end_swap, tam, *tempo_bloqueio);
     return ERR_OK;
 }
 
@@ -210,3 +211,51 @@ int swap_endereco_pagina(swap_t *self, int processo, int pagina)
     }
     return -1;
 }
+
+bool swap_salva(swap_t *self, FILE *arq) {
+    if (!imagem_escreve_vetor(arq, self->capacidade, self->dados)
+        || !imagem_escreve_int(arq, self->prox_livre)
+        || !imagem_escreve_int(arq, self->disco_livre_em)) {
+        return false;
+    }
+    int n = 0;
+    for (alocacao_t *aloc = self->alocacoes; aloc != NULL; aloc = aloc->prox) n++;
+    if (!imagem_escreve_int(arq, n)) return false;
+    for (alocacao_t *aloc = self->alocacoes; aloc != NULL; aloc = aloc->prox) {
+        if (!imagem_escreve_int(arq, aloc->processo)
+            || !imagem_escreve_int(arq, aloc->end_inicio)
+            || !imagem_escreve_int(arq, aloc->n_paginas)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool swap_recupera(swap_t *self, FILE *arq) {
+    if (!imagem_le_vetor(arq, self->capacidade, self->dados)
+        || !imagem_le_int(arq, &self->prox_livre)
+        || !imagem_le_int(arq, &self->disco_livre_em)) {
+        return false;
+    }
+    while (self->alocacoes != NULL) {
+        alocacao_t *aloc = self->alocacoes;
+        self->alocacoes = aloc->prox;
+        destroi_alocacao(aloc);
+    }
+    int n;
+    if (!imagem_le_int(arq, &n)) return false;
+    alocacao_t **fim = &self->alocacoes;
+    for (int i = 0; i < n; i++) {
+        alocacao_t *aloc = malloc(sizeof(alocacao_t));
+        assert(aloc != NULL);
+        aloc->prox = NULL;
+        *fim = aloc;
+        fim = &aloc->prox;
+        if (!imagem_le_int(arq, &aloc->processo)
+            || !imagem_le_int(arq, &aloc->end_inicio)
+            || !imagem_le_int(arq, &aloc->n_paginas)) {
+            return false;
+        }
+    }
+    return true;
+}
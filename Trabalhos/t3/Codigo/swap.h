@@ -8,6 +8,8 @@
 
 #include "err.h"
 #include "relogio.h"
+#include <stdio.h>
+#include <stdbool.h>
 
 typedef struct swap_t swap_t;
 
@@ -38,4 +40,10 @@ err_t swap_le_pagina(swap_t *self, int end_swap, int *dados, int tam, int *tempo
 // Retorna o endereço na memória secundária para uma página de um processo
 int swap_endereco_pagina(swap_t *self, int processo, int pagina);
 
+// Salva o conteúdo e as alocações da memória secundária na imagem (ver imagem.h)
+bool swap_salva(swap_t *self, FILE *arq);
+
+// Recupera o conteúdo e as alocações da imagem; a capacidade deve ser a mesma
+bool swap_recupera(swap_t *self, FILE *arq);
+
 #endif // SWAP_H
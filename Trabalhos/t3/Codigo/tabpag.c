@@ -4,8 +4,10 @@
 // so25b
 
 #include "tabpag.h"
+#include "imagem.h"
 #include <stdlib.h>
 #include <assert.h>
+#include <stdatomic.h>
 
 // estrutura auxiliar, contém informação sobre uma página
 typedef struct {
@@ -26,14 +28,29 @@ struct tabpag_t {
   // o último descritor do vetor sempre contém uma página válida
   // pode ser NULL (se tam_tab == 0)
   descritor_t *tabela;
+  // versões da tabela (ver tabpag_versao)
+  tabpag_versao_t versao;
 };
 
+// gerador de versões, comum a todas as tabelas, para que duas tabelas
+//   (mesmo uma destruída e outra criada no mesmo lugar) nunca tenham a
+//   mesma versão
+// é atômico porque várias simulações podem executar ao mesmo tempo
+static atomic_uint ultima_versao = 0;
+
+static void tabpag__nova_versao(tabpag_t *self)
+{
+  self->versao.mapa = atomic_fetch_add(&ultima_versao, 1) + 1;
+}
+
 tabpag_t *tabpag_cria(void)
 {
   tabpag_t *self = malloc(sizeof(*self));
   assert(self != NULL);
   self->tam_tab = 0;
   self->tabela = NULL;
+  tabpag__nova_versao(self);
+  self->versao.acesso = 0;
   return self;
 }
 
@@ -56,6 +73,7 @@ void tabpag_invalida_pagina(tabpag_t *self, int pagina)
 {
   // página já é inválida -- não faz nada
   if (!tabpag__pagina_valida(self, pagina)) return;
+  tabpag__nova_versao(self);
   // página não é a última da tabela -- marca como inválida
   if (pagina < self->tam_tab - 1) {
     self->tabela[pagina].valida = false;
@@ -100,6 +118,7 @@ void tabpag_define_quadro(tabpag_t *self, int pagina, int quadro)
   self->tabela[pagina].valida = true;
   self->tabela[pagina].acessada = false;
   self->tabela[pagina].alterada = false;
+  tabpag__nova_versao(self);
 }
 
 void tabpag_marca_bit_acesso(tabpag_t *self, int pagina, bool alteracao)
@@ -114,7 +133,9 @@ void tabpag_marca_bit_acesso(tabpag_t *self, int pagina, bool alteracao)
 void tabpag_zera_bit_acesso(tabpag_t *self, int pagina)
 {
   if (!tabpag__pagina_valida(self, pagina)) return;
+  if (!self->tabela[pagina].acessada) return;
   self->tabela[pagina].acessada = false;
+  self->versao.acesso++;
 }
 
 bool tabpag_bit_acesso(tabpag_t *self, int pagina)
@@ -135,3 +156,51 @@ err_t tabpag_traduz(tabpag_t *self, int pagina, int *pquadro)
   *pquadro = self->tabela[pagina].quadro;
   return ERR_OK;
 }
+
+const tabpag_versao_t *tabpag_versao(tabpag_t *self)
+{
+  return &self->versao;
+}
+
+bool tabpag_salva(tabpag_t *self, FILE *arq)
+{
+  if (!imagem_escreve_int(arq, self->tam_tab)) return false;
+  for (int pagina = 0; pagina < self->tam_tab; pagina++) {
+    descritor_t *d = &self->tabela[pagina];
+    if (!imagem_escreve_int(arq, d->quadro)
+        || !imagem_escreve_int(arq, d->valida)
+        || !imagem_escreve_int(arq, d->acessada)
+        || !imagem_escreve_int(arq, d->alterada)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool tabpag_recupera(tabpag_t *self, FILE *arq)
+{
+  int tam_tab;
+  if (!imagem_le_int(arq, &tam_tab) || tam_tab < 0) return false;
+  free(self->tabela);
+  self->tabela = NULL;
+  self->tam_tab = 0;
+  tabpag__nova_versao(self);
+  if (tam_tab == 0) return true;
+  self->tabela = malloc(tam_tab * sizeof(descritor_t));
+  assert(self->tabela != NULL);
+  self->tam_tab = tam_tab;
+  for (int pagina = 0; pagina < tam_tab; pagina++) {
+    descritor_t *d = &self->tabela[pagina];
+    int valida, acessada, alterada;
+    if (!imagem_le_int(arq, &d->quadro)
+        || !imagem_le_int(arq, &valida)
+        || !imagem_le_int(arq, &acessada)
+        || !imagem_le_int(arq, &alterada)) {
+      return false;
+    }
+    d->valida = valida;
+    d->acessada = acessada;
+    d->alterada = alterada;
+  }
+  return true;
+}
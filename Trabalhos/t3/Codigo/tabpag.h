@@ -13,6 +13,7 @@
 // mantém para cada página mapeada um bit de acesso e um bit de alteração
 
 #include "err.h"
+#include <stdio.h>
 #include <stdbool.h>
 
 // tipo opaco que representa a tabela de páginas
@@ -61,4 +62,27 @@ bool tabpag_bit_alteracao(tabpag_t *self, int pagina);
 // retorna ERR_PAG_AUSENTE (e não altera '*pquadro') se a página for inválida
 err_t tabpag_traduz(tabpag_t *self, int pagina, int *pquadro);
 
+// versões da tabela, para quem guarda traduções ou bits dela (a TLB da MMU)
+// 'mapa' muda quando uma página é definida ou invalidada: as traduções
+//   guardadas devem ser descartadas; tabelas diferentes nunca têm o mesmo
+//   'mapa'
+// 'acesso' muda quando algum bit de acesso é zerado: as traduções continuam
+//   valendo, mas as cópias do bit de acesso não
+typedef struct {
+  unsigned mapa;
+  unsigned acesso;
+} tabpag_versao_t;
+
+// retorna as versões da tabela
+// o ponteiro vale enquanto a tabela existir, e sempre aponta para as versões
+//   atuais, para que a versão possa ser conferida sem chamar esta função
+const tabpag_versao_t *tabpag_versao(tabpag_t *self);
+
+// salva a tabela na imagem 'arq' (ver imagem.h)
+bool tabpag_salva(tabpag_t *self, FILE *arq);
+
+// substitui o conteúdo da tabela pelo que está na imagem 'arq'
+// a tabela passa a ter uma nova versão
+bool tabpag_recupera(tabpag_t *self, FILE *arq);
+
 #endif // TABPAG_H
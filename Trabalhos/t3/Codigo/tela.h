@@ -35,7 +35,12 @@ void tela_puts(int cor, char *str);
 // limpa a linha do cursor até o final
 void tela_limpa_linha();
 
+// teclas especiais retornadas por tela_tecla
+#define TELA_PAG_ACIMA   2  // page up ou ^B
+#define TELA_PAG_ABAIXO  6  // page down ou ^F
+
 // retorna a próxima tecla digitada, ou 0 se não houver
+// as teclas especiais que não estão definidas acima são ignoradas
 char tela_tecla(void);
 
 // envia para a tela o que foi escrito
@@ -17,6 +17,7 @@ void tela_init(void)
   cbreak();      // lê cada char, não espera enter
   noecho();      // não mostra o que é digitado
   timeout(5);    // t max a esperar por tecla, retorna ERR se nada foi digitado
+  keypad(stdscr, TRUE);  // teclas especiais (page up etc) viram um só código
   // inicializa algumas cores
   start_color();
   init_pair(COR_TXT_PAR,      COLOR_GREEN,  COLOR_BLACK );
@@ -59,7 +60,14 @@ void tela_limpa_linha()
 char tela_tecla(void)
 {
   int ch = getch();
-  if (ch == ERR) return 0;
+  switch (ch) {
+    case ERR:           return 0;
+    case KEY_PPAGE:     return TELA_PAG_ACIMA;
+    case KEY_NPAGE:     return TELA_PAG_ABAIXO;
+    case KEY_BACKSPACE: return '\b';
+    case KEY_ENTER:     return '\n';
+  }
+  if (ch > 255) return 0;
   return ch;
 }
 
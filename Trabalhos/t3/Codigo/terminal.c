@@ -4,10 +4,13 @@
 // so25b
 
 #include "terminal.h"
+#include "imagem.h"
+#include "pic.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 
 // TERMINAL
 
@@ -15,8 +18,10 @@
 struct terminal_t {
   // número de caracteres que cabem em uma linha
   int tam_linha;
-  // texto já digitado no terminal, esperando para ser lido
+  // texto já digitado no terminal, esperando para ser lido, com no máximo
+  //   'tam_entrada' caracteres (ver terminal_define_fila_entrada)
   char *entrada;
+  int tam_entrada;
   // texto sendo mostrado na saída do terminal
   char *saida;
   // estado da saída do terminal, que pode ser:
@@ -33,8 +38,28 @@ struct terminal_t {
   enum { normal, rolando, limpando } estado_saida;
   // posicao do caractere que está sendo movido durante uma rolagem
   int pos_rolagem;
+  // fila de saída: caracteres escritos e ainda não colocados na linha
+  //   (ver terminal_define_fila); circular, 'n_fila' caracteres a partir
+  //   de 'ini_fila'; com 'tam_fila' 0, o terminal não tem fila
+  char *fila;
+  int tam_fila;
+  int ini_fila;
+  int n_fila;
+  // controlador onde são pedidas as interrupções de teclado e tela (ou NULL),
+  //   e a linha deste terminal nele
+  pic_t *pic;
+  int fonte;
+  // se as interrupções de teclado e de tela estão habilitadas no terminal
+  //   (escritas nos dispositivos de estado)
+  bool irq_teclado;
+  bool irq_tela;
+  // o terminal é acessado pela console e pelas CPUs, que podem estar em
+  //   threads diferentes
+  pthread_mutex_t trava;
 };
 
+static void terminal_sinaliza(terminal_t *self);
+
 
 terminal_t *terminal_cria(int tam_linha)
 {
@@ -47,13 +72,24 @@ terminal_t *terminal_cria(int tam_linha)
   self->entrada = calloc(1, tam_linha + 1);
   assert(self->saida != NULL && self->entrada != NULL);
 
+  self->tam_entrada = tam_linha - 2;
   self->estado_saida = normal;
+  self->fila = NULL;
+  self->tam_fila = 0;
+  self->ini_fila = 0;
+  self->n_fila = 0;
+  self->pic = NULL;
+  self->irq_teclado = false;
+  self->irq_tela = false;
+  pthread_mutex_init(&self->trava, NULL);
 
   return self;
 }
 
 void terminal_destroi(terminal_t *self)
 {
+  pthread_mutex_destroy(&self->trava);
+  free(self->fila);
   free(self->entrada);
   free(self->saida);
   free(self);
@@ -75,12 +111,16 @@ static err_t terminal_le_char(terminal_t *self, int *pch)
 
 void terminal_insere_char(terminal_t *self, char ch)
 {
+  pthread_mutex_lock(&self->trava);
   char *p = self->entrada;
   int tam = strlen(p);
   // se não cabe, ignora silenciosamente
-  if (tam >= self->tam_linha - 2) return;
-  p[tam] = ch;
-  p[tam + 1] = '\0';
+  if (tam < self->tam_entrada) {
+    p[tam] = ch;
+    p[tam + 1] = '\0';
+  }
+  terminal_sinaliza(self);
+  pthread_mutex_unlock(&self->trava);
 }
 
 static bool terminal_pode_imprimir(terminal_t *self)
@@ -88,6 +128,79 @@ static bool terminal_pode_imprimir(terminal_t *self)
   return self->estado_saida == normal;
 }
 
+// se um caractere pode ser escrito: na linha, sem fila; na fila, com
+static bool terminal_pode_escrever(terminal_t *self)
+{
+  if (self->tam_fila == 0) return terminal_pode_imprimir(self);
+  return self->n_fila < self->tam_fila;
+}
+
+// atualiza as linhas do terminal no controlador de interrupções: teclado
+//   enquanto tiver caractere para ler, tela enquanto puder escrever, cada
+//   uma se a interrupção estiver habilitada
+// deve ser chamada com a trava, depois de cada alteração
+static void terminal_sinaliza(terminal_t *self)
+{
+  if (self->pic == NULL) return;
+  pic_nivel(self->pic, IRQ_TECLADO, self->fonte,
+            self->irq_teclado && !terminal_entrada_vazia(self));
+  pic_nivel(self->pic, IRQ_TELA, self->fonte,
+            self->irq_tela && terminal_pode_escrever(self));
+}
+
+int terminal_prazo_tela(terminal_t *self)
+{
+  pthread_mutex_lock(&self->trava);
+  int prazo = -1;
+  if (self->irq_tela && !terminal_pode_escrever(self)) {
+    // a limpeza tira um caractere por vez; nos outros casos, não se sabe
+    //   sem simular, mas é pelo menos 1
+    prazo = 1;
+    if (self->estado_saida == limpando) {
+      int tam = strlen(self->saida);
+      if (tam > prazo) prazo = tam;
+    }
+  }
+  pthread_mutex_unlock(&self->trava);
+  return prazo;
+}
+
+void terminal_define_fila(terminal_t *self, int tam)
+{
+  pthread_mutex_lock(&self->trava);
+  free(self->fila);
+  self->fila = NULL;
+  if (tam > 0) {
+    self->fila = malloc(tam);
+    assert(self->fila != NULL);
+  }
+  self->tam_fila = tam;
+  self->ini_fila = 0;
+  self->n_fila = 0;
+  terminal_sinaliza(self);
+  pthread_mutex_unlock(&self->trava);
+}
+
+void terminal_define_fila_entrada(terminal_t *self, int tam)
+{
+  pthread_mutex_lock(&self->trava);
+  // a entrada é mostrada na linha do terminal, não pode ser maior que ela
+  if (tam <= 0 || tam > self->tam_linha - 2) tam = self->tam_linha - 2;
+  self->tam_entrada = tam;
+  self->entrada[0] = '\0';
+  terminal_sinaliza(self);
+  pthread_mutex_unlock(&self->trava);
+}
+
+void terminal_define_pic(terminal_t *self, pic_t *pic, int fonte)
+{
+  pthread_mutex_lock(&self->trava);
+  self->pic = pic;
+  self->fonte = fonte;
+  terminal_sinaliza(self);
+  pthread_mutex_unlock(&self->trava);
+}
+
 static err_t terminal_imprime(terminal_t *self, char ch)
 {
   if (!terminal_pode_imprimir(self)) return ERR_OCUP;
@@ -110,10 +223,32 @@ static err_t terminal_imprime(terminal_t *self, char ch)
   return ERR_OK;
 }
 
+// escreve um caractere: direto na linha sem fila, no fim da fila com
+static err_t terminal_escreve_char(terminal_t *self, char ch)
+{
+  if (self->tam_fila == 0) return terminal_imprime(self, ch);
+  if (self->n_fila >= self->tam_fila) return ERR_OCUP;
+  self->fila[(self->ini_fila + self->n_fila) % self->tam_fila] = ch;
+  self->n_fila++;
+  return ERR_OK;
+}
+
+// passa o primeiro caractere da fila para a linha
+static void terminal_esvazia_fila(terminal_t *self)
+{
+  if (self->n_fila == 0 || !terminal_pode_imprimir(self)) return;
+  terminal_imprime(self, self->fila[self->ini_fila]);
+  self->ini_fila = (self->ini_fila + 1) % self->tam_fila;
+  self->n_fila--;
+}
+
 void terminal_limpa_saida(terminal_t *self)
 {
+  pthread_mutex_lock(&self->trava);
   self->saida[0] = '\0';
   self->estado_saida = normal;
+  terminal_sinaliza(self);
+  pthread_mutex_unlock(&self->trava);
 }
 
 static void terminal_atualiza_rolagem(terminal_t *self)
@@ -141,11 +276,26 @@ static void terminal_atualiza_limpeza(terminal_t *self)
   if (tam <= 0) self->estado_saida = normal;
 }
 
-// altera a string de saída em 1 caractere, se estiver rolando ou limpando
+// altera a string de saída em 1 caractere, se estiver rolando ou limpando,
+//   ou passa para ela um caractere da fila
 void terminal_tictac(terminal_t *self)
 {
-  terminal_atualiza_rolagem(self);
-  terminal_atualiza_limpeza(self);
+  terminal_tictac_n(self, 1);
+}
+
+void terminal_tictac_n(terminal_t *self, int n)
+{
+  pthread_mutex_lock(&self->trava);
+  for (int i = 0; i < n && (self->estado_saida != normal || self->n_fila > 0); i++) {
+    if (self->estado_saida == normal) {
+      terminal_esvazia_fila(self);
+    } else {
+      terminal_atualiza_rolagem(self);
+      terminal_atualiza_limpeza(self);
+    }
+  }
+  terminal_sinaliza(self);
+  pthread_mutex_unlock(&self->trava);
 }
 
 char *terminal_txt_entrada(terminal_t *self)
@@ -165,28 +315,126 @@ err_t terminal_leitura(void *disp, int id, int *pvalor)
 {
   terminal_t *self = disp;
   int subdisp = id % 4;
+  err_t err = ERR_OK;
+  pthread_mutex_lock(&self->trava);
   switch (subdisp) {
     case TERM_TECLADO: // leitura do teclado
-      return terminal_le_char(self, pvalor);
+      err = terminal_le_char(self, pvalor);
+      terminal_sinaliza(self);
+      break;
     case TERM_TECLADO_OK: // estado do teclado
       *pvalor = !terminal_entrada_vazia(self);
       break;
     case TERM_TELA: // escrita na tela (proibido ler)
-      return ERR_OP_INV;
+      err = ERR_OP_INV;
+      break;
     case TERM_TELA_OK: // estado da tela
-      *pvalor = terminal_pode_imprimir(self);
+      *pvalor = terminal_pode_escrever(self);
       break;
     default:
-      return ERR_DISP_INV;
+      err = ERR_DISP_INV;
   }
-  return ERR_OK;
+  pthread_mutex_unlock(&self->trava);
+  return err;
 }
 
 err_t terminal_escrita(void *disp, int id, int valor)
 {
   terminal_t *self = disp;
   int subdisp = id % 4;
-  // só pode escrever na tela
+  err_t err = ERR_OK;
+  pthread_mutex_lock(&self->trava);
+  switch (subdisp) {
+    case TERM_TECLADO_OK: // habilita a interrupção do teclado
+      self->irq_teclado = valor != 0;
+      break;
+    case TERM_TELA: // escrita na tela
+      err = terminal_escreve_char(self, valor);
+      break;
+    case TERM_TELA_OK: // habilita a interrupção da tela
+      self->irq_tela = valor != 0;
+      break;
+    default: // não pode escrever no teclado
+      err = ERR_OP_INV;
+  }
+  terminal_sinaliza(self);
+  pthread_mutex_unlock(&self->trava);
+  return err;
+}
+
+err_t terminal_escrita_bloco(void *disp, int id, int n, const int *valores,
+                             int *pn_escritos)
+{
+  terminal_t *self = disp;
+  int subdisp = id % 4;
+  *pn_escritos = 0;
   if (subdisp != TERM_TELA) return ERR_OP_INV;
-  return terminal_imprime(self, valor);
+  pthread_mutex_lock(&self->trava);
+  err_t err = ERR_OK;
+  while (*pn_escritos < n) {
+    err = terminal_escreve_char(self, valores[*pn_escritos]);
+    if (err != ERR_OK) break;
+    (*pn_escritos)++;
+  }
+  terminal_sinaliza(self);
+  pthread_mutex_unlock(&self->trava);
+  return err;
+}
+
+
+// IMAGEM
+
+// as linhas são salvas inteiras, a rolagem deixa caracteres depois do fim
+//   da string; a fila é salva a partir do primeiro caractere
+bool terminal_salva(terminal_t *self, FILE *arq)
+{
+  pthread_mutex_lock(&self->trava);
+  bool ok = imagem_escreve_bytes(arq, self->tam_linha + 1, self->entrada)
+         && imagem_escreve_bytes(arq, self->tam_linha + 1, self->saida)
+         && imagem_escreve_int(arq, self->estado_saida)
+         && imagem_escreve_int(arq, self->pos_rolagem)
+         && imagem_escreve_int(arq, self->irq_teclado)
+         && imagem_escreve_int(arq, self->irq_tela)
+         && imagem_escreve_int(arq, self->tam_entrada)
+         && imagem_escreve_int(arq, self->tam_fila)
+         && imagem_escreve_int(arq, self->n_fila);
+  for (int i = 0; ok && i < self->n_fila; i++) {
+    ok = imagem_escreve_int(arq, self->fila[(self->ini_fila + i) % self->tam_fila]);
+  }
+  pthread_mutex_unlock(&self->trava);
+  return ok;
+}
+
+bool terminal_recupera(terminal_t *self, FILE *arq)
+{
+  int estado, pos, irq_teclado, irq_tela, n_fila;
+  pthread_mutex_lock(&self->trava);
+  bool ok = imagem_le_bytes(arq, self->tam_linha + 1, self->entrada)
+         && imagem_le_bytes(arq, self->tam_linha + 1, self->saida)
+         && imagem_le_int(arq, &estado)
+         && imagem_le_int(arq, &pos)
+         && imagem_le_int(arq, &irq_teclado)
+         && imagem_le_int(arq, &irq_tela)
+         && imagem_confere_int(arq, self->tam_entrada)
+         && imagem_confere_int(arq, self->tam_fila)
+         && imagem_le_int(arq, &n_fila)
+         && n_fila >= 0 && n_fila <= self->tam_fila;
+  if (ok) {
+    self->entrada[self->tam_linha] = '\0';
+    self->saida[self->tam_linha] = '\0';
+    self->estado_saida = estado;
+    self->pos_rolagem = pos;
+    self->irq_teclado = irq_teclado;
+    self->irq_tela = irq_tela;
+    self->ini_fila = 0;
+    self->n_fila = n_fila;
+    for (int i = 0; ok && i < n_fila; i++) {
+      int ch;
+      ok = imagem_le_int(arq, &ch);
+      self->fila[i] = ch;
+    }
+  }
+  terminal_sinaliza(self);
+  pthread_mutex_unlock(&self->trava);
+  return ok;
 }
@@ -13,12 +13,15 @@
 //
 // implementa 4 dispositivos associados a um terminal:
 // - leitura do próximo caractere de entrada
-// - leitura do estado da entrada (se tem caractere disponível ou não)
+// - leitura do estado da entrada (se tem caractere disponível ou não), e
+//   escrita para habilitar (1) ou desabilitar (0) a interrupção do teclado
 // - escrita de um caractere na saída
-// - leitura do estado da saída (se um caractere pode ser escrito ou não)
+// - leitura do estado da saída (se um caractere pode ser escrito ou não), e
+//   escrita para habilitar ou desabilitar a interrupção da tela
 //
 // a leitura não é possível quando não existir caractere na entrada
-// existe um limite para caracteres digitados e não lidos; caracteres adicionais
+// existe um limite para caracteres digitados e não lidos (o tamanho da fila
+//   de entrada, ver terminal_define_fila_entrada); caracteres adicionais
 //   são ignorados
 // o número de caracteres na saída é limitado ao tamanho da linha. um caractere
 //   adicional causa a "rolagem", que remove o primeiro caractere da linha para
@@ -26,17 +29,30 @@
 // a escrita não é possível se a saída estiver rolando ou sendo limpa, o que é
 //   feito um caractere por vez (a cada chamada a tictac).
 //
+// o terminal pode ter uma fila de saída (ver terminal_define_fila): a escrita
+//   coloca o caractere no fim da fila, e só não é possível com a fila cheia;
+//   a cada chamada a tictac em que a linha não está rolando nem sendo limpa,
+//   o primeiro caractere da fila passa para a linha. com a fila, a escrita
+//   também pode ser feita em bloco (terminal_escrita_bloco), vários
+//   caracteres em um só acesso; sem fila, o terminal é o de um caractere
+//   por vez.
+//
 // além das funções que implementam as operações de E/S acessadas pelo controlador
 //   de E/S, contém as funções para o controle do terminal, realizado pela console.
 // a E/S efetiva é realizada pela console. ela obtém acesso às linhas de entrada e
 //   saída chamando terminal_txt_entrada ou terminal_txt_saida. a console insere
 //   caracteres digitados no terminal chamando terminal_insere_char, e limpa a
 //   linha de saída com terminal_limpa_saida.
+// as operações podem ser chamadas por threads diferentes (a da console e as
+//   das CPUs); as linhas obtidas com terminal_txt_* podem estar sendo
+//   alteradas por outra thread, servem só para serem mostradas.
 
+#include <stdio.h>
 #include <stdbool.h>
 #include "err.h"
 
 typedef struct terminal_t terminal_t;
+struct pic_t;
 
 // os 4 dispositivos associados a um terminal
 #define TERM_TECLADO    0
@@ -65,10 +81,49 @@ void terminal_limpa_saida(terminal_t *self);
 // esta função deve ser chamada periodicamente
 void terminal_tictac(terminal_t *self);
 
+// registra a passagem de n unidades de tempo, como n chamadas a terminal_tictac
+void terminal_tictac_n(terminal_t *self, int n);
+
+// define o tamanho da fila de saída do terminal (o que estiver nela é
+//   descartado); com 0 (o padrão), o terminal não tem fila e aceita um
+//   caractere por vez, quando a linha não está rolando nem sendo limpa
+void terminal_define_fila(terminal_t *self, int tam);
+
+// define o tamanho da fila de entrada do terminal, o número máximo de
+//   caracteres digitados e ainda não lidos (o que estiver nela é
+//   descartado); com 0 (o padrão), ou com mais do que cabe, é o que cabe na
+//   linha de entrada
+void terminal_define_fila_entrada(terminal_t *self, int tam);
+
+// retorna em quanto tempo, no mínimo, a passagem do tempo vai fazer o terminal
+//   pedir a interrupção da tela, que está habilitada e ainda não pedida
+//   (a saída está rolando, sendo limpa ou com a fila cheia), ou -1 se não
+//   vai (não está habilitada ou já está pedida)
+// quem avança o tempo com a CPU parada pode usar para não passar de lá
+int terminal_prazo_tela(terminal_t *self);
+
+// define o controlador de interrupções onde o terminal pede interrupção, pela
+//   linha 'fonte': IRQ_TECLADO enquanto tiver caractere para ser lido e
+//   IRQ_TELA enquanto puder receber um caractere, cada uma só se estiver
+//   habilitada no terminal (as duas começam desabilitadas)
+void terminal_define_pic(terminal_t *self, struct pic_t *pic, int fonte);
+
+// salva o estado do terminal (linhas de entrada e saída, interrupções
+//   habilitadas) na imagem 'arq'
+//   (ver imagem.h)
+bool terminal_salva(terminal_t *self, FILE *arq);
+
+// recupera o estado do terminal da imagem 'arq'
+// o terminal deve ter o mesmo tamanho de linha e de filas do que foi salvo
+bool terminal_recupera(terminal_t *self, FILE *arq);
+
 // Funções para implementar o protocolo de acesso a um dispositivo pelo
 //   controlador de E/S
 // Devem seguir o protocolo f_leitura_t e f_escrita_t declarados em es.h
 err_t terminal_leitura(void *disp, int id, int *pvalor);
 err_t terminal_escrita(void *disp, int id, int valor);
+// escrita em bloco na tela, segue f_escrita_bloco_t (es.h)
+err_t terminal_escrita_bloco(void *disp, int id, int n, const int *valores,
+                             int *pn_escritos);
 
 #endif // TERMINAL_H
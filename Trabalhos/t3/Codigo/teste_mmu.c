@@ -50,8 +50,97 @@ void teste_mmu_basico(void)
   printf("========== FIM TESTE ==========\n\n");
 }
 
+void teste_mmu_tlb(void)
+{
+  printf("\n========== TESTE TLB ==========\n");
+
+  mem_t *mem = mem_cria(1000);
+  tabpag_t *tabpag = tabpag_cria();
+  mmu_t *mmu = mmu_cria(mem);
+  mmu_define_tabpag(mmu, tabpag);
+  int falhas = 0;
+
+  // página 0 no quadro 10, página 1 no quadro 20
+  tabpag_define_quadro(tabpag, 0, 10);
+  tabpag_define_quadro(tabpag, 1, 20);
+  mem_escreve(mem, 10 * TAM_PAGINA + 3, 11);
+  mem_escreve(mem, 20 * TAM_PAGINA + 3, 22);
+  mem_escreve(mem, 30 * TAM_PAGINA + 3, 33);
+
+  // várias leituras na mesma página: uma falta, o resto acertos
+  long acertos, faltas, esvaziamentos;
+  int valor;
+  for (int i = 0; i < 5; i++) {
+    mmu_le(mmu, 3, &valor, usuario);
+  }
+  mmu_estatisticas_tlb(mmu, &acertos, &faltas, &esvaziamentos);
+  printf("5 leituras: acertos=%ld faltas=%ld\n", acertos, faltas);
+  if (acertos != 4 || faltas != 1) falhas++;
+
+  // o bit de alteração é marcado mesmo com a página na TLB
+  mmu_escreve(mmu, 4, 44, usuario);
+  printf("alteração após escrita: %d\n", tabpag_bit_alteracao(tabpag, 0));
+  if (!tabpag_bit_alteracao(tabpag, 0)) falhas++;
+
+  // bit de acesso zerado pelo SO volta a ser marcado no próximo acesso
+  tabpag_zera_bit_acesso(tabpag, 0);
+  mmu_le(mmu, 3, &valor, usuario);
+  printf("acesso após zerar e ler: %d\n", tabpag_bit_acesso(tabpag, 0));
+  if (!tabpag_bit_acesso(tabpag, 0)) falhas++;
+
+  // zerado pela MMU, volta a ser marcado sem esvaziar a TLB
+  long esvaziamentos_antes;
+  mmu_estatisticas_tlb(mmu, &acertos, &faltas, &esvaziamentos_antes);
+  mmu_zera_bit_acesso(mmu, 0);
+  mmu_le(mmu, 3, &valor, usuario);
+  mmu_estatisticas_tlb(mmu, &acertos, &faltas, &esvaziamentos);
+  printf("acesso após zerar pela MMU e ler: %d (esvaziamentos %ld -> %ld)\n",
+         tabpag_bit_acesso(tabpag, 0), esvaziamentos_antes, esvaziamentos);
+  if (!tabpag_bit_acesso(tabpag, 0)) falhas++;
+  if (esvaziamentos != esvaziamentos_antes) falhas++;
+
+  // mudança de quadro na tabela é vista pela MMU
+  tabpag_define_quadro(tabpag, 0, 30);
+  mmu_le(mmu, 3, &valor, usuario);
+  printf("após remapear: valor=%d (esperado 33)\n", valor);
+  if (valor != 33) falhas++;
+
+  // página invalidada não é mais traduzida
+  tabpag_invalida_pagina(tabpag, 0);
+  err_t err = mmu_le(mmu, 3, &valor, usuario);
+  printf("após invalidar: err=%d (esperado %d)\n", err, ERR_PAG_AUSENTE);
+  if (err != ERR_PAG_AUSENTE) falhas++;
+
+  // outra tabela, com a mesma página em outro quadro
+  tabpag_t *tabpag2 = tabpag_cria();
+  tabpag_define_quadro(tabpag2, 1, 10);
+  mmu_le(mmu, TAM_PAGINA + 3, &valor, usuario);
+  mmu_define_tabpag(mmu, tabpag2);
+  mmu_le(mmu, TAM_PAGINA + 3, &valor, usuario);
+  printf("outra tabela: valor=%d (esperado 11)\n", valor);
+  if (valor != 11) falhas++;
+
+  mmu_estatisticas_tlb(mmu, &acertos, &faltas, &esvaziamentos);
+  printf("acertos=%ld faltas=%ld esvaziamentos=%ld\n",
+         acertos, faltas, esvaziamentos);
+
+  if (falhas == 0) {
+    printf("✓ SUCESSO: TLB coerente com a tabela de páginas!\n");
+  } else {
+    printf("✗ ERRO: %d verificações falharam\n", falhas);
+  }
+
+  mmu_destroi(mmu);
+  tabpag_destroi(tabpag2);
+  tabpag_destroi(tabpag);
+  mem_destroi(mem);
+
+  printf("========== FIM TESTE ==========\n\n");
+}
+
 int main(void)
 {
   teste_mmu_basico();
+  teste_mmu_tlb();
   return 0;
 }
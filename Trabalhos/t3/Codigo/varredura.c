@@ -0,0 +1,275 @@
+// varredura.c
+// executa o simulador para uma grade de configurações, em paralelo
+// simulador de computador
+// so25b
+
+// cada argumento é um eixo da grade, no formato nome=v1,v2,... (os nomes
+//   são os de simulador_config_define); é executada uma simulação em lote
+//   para cada combinação dos valores, em um conjunto de threads, e o
+//   resultado de todas vai para um arquivo CSV, uma linha por simulação, na
+//   ordem da grade (o último eixo varia mais rápido)
+//
+// exemplo:
+//   ./varredura -j 4 -o q.csv quantum=1,2,5,10 substituicao=fifo,sc
+
+#include "simulador.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define MAX_EIXOS   8
+#define MAX_VALORES 16
+
+// um eixo da grade
+typedef struct {
+  char *nome;
+  int n_valores;
+  char *valores[MAX_VALORES];
+} eixo_t;
+
+// o resultado de uma simulação
+typedef struct {
+  bool ok;
+  long instrucoes;
+  double tempo;
+  metricas metricas;
+} resultado_t;
+
+typedef struct {
+  eixo_t eixos[MAX_EIXOS];
+  int n_eixos;
+  int n_pontos;
+  // limite de instruções de cada simulação (0 é sem)
+  int limite;
+  // próximo ponto da grade a simular (as threads pegam daqui)
+  atomic_int prox_ponto;
+  resultado_t *resultados;
+} varredura_t;
+
+
+// ---------------------------------------------------------------------
+// GRADE {{{1
+// ---------------------------------------------------------------------
+
+// separa "nome=v1,v2,..." em um eixo (altera 'arg')
+static bool le_eixo(char *arg, eixo_t *eixo)
+{
+  char *valores = strchr(arg, '=');
+  if (valores == NULL) return false;
+  *valores++ = '\0';
+  eixo->nome = arg;
+  eixo->n_valores = 0;
+  for (char *v = strtok(valores, ","); v != NULL; v = strtok(NULL, ",")) {
+    if (eixo->n_valores >= MAX_VALORES) return false;
+    eixo->valores[eixo->n_valores++] = v;
+  }
+  return eixo->n_valores > 0;
+}
+
+// o índice no eixo 'e' do valor do ponto 'ponto' da grade
+static int indice_no_eixo(varredura_t *self, int ponto, int e)
+{
+  for (int i = self->n_eixos - 1; i > e; i--) {
+    ponto /= self->eixos[i].n_valores;
+  }
+  return ponto % self->eixos[e].n_valores;
+}
+
+// preenche a configuração do ponto 'ponto' da grade
+static bool configura_ponto(varredura_t *self, int ponto, simulador_config_t *config)
+{
+  simulador_config_padrao(config);
+  config->lote = true;
+  config->log = NULL;
+  config->limite = self->limite;
+  for (int e = 0; e < self->n_eixos; e++) {
+    eixo_t *eixo = &self->eixos[e];
+    char *valor = eixo->valores[indice_no_eixo(self, ponto, e)];
+    if (!simulador_config_define(config, eixo->nome, valor)) {
+      fprintf(stderr, "valor inválido para '%s': '%s'\n", eixo->nome, valor);
+      return false;
+    }
+  }
+  return true;
+}
+
+
+// ---------------------------------------------------------------------
+// EXECUÇÃO {{{1
+// ---------------------------------------------------------------------
+
+static void simula_ponto(varredura_t *self, int ponto)
+{
+  resultado_t *r = &self->resultados[ponto];
+  simulador_config_t config;
+  r->ok = false;
+  if (!configura_ponto(self, ponto, &config)) return;
+  simulador_t *sim = simulador_cria(&config);
+  if (sim == NULL) return;
+  r->ok = simulador_executa(sim);
+  r->instrucoes = simulador_instrucoes(sim);
+  r->tempo = simulador_tempo(sim);
+  r->metricas = *simulador_metricas(sim);
+  simulador_destroi(sim);
+}
+
+// cada thread simula os pontos ainda não simulados, até acabarem
+static void *trabalhador(void *arg)
+{
+  varredura_t *self = arg;
+  int ponto;
+  while ((ponto = atomic_fetch_add(&self->prox_ponto, 1)) < self->n_pontos) {
+    simula_ponto(self, ponto);
+  }
+  return NULL;
+}
+
+static void executa(varredura_t *self, int n_threads)
+{
+  if (n_threads > self->n_pontos) n_threads = self->n_pontos;
+  pthread_t threads[n_threads];
+  atomic_init(&self->prox_ponto, 0);
+  for (int i = 0; i < n_threads; i++) {
+    int r = pthread_create(&threads[i], NULL, trabalhador, self);
+    assert(r == 0);
+  }
+  for (int i = 0; i < n_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+}
+
+
+// ---------------------------------------------------------------------
+// RESULTADO {{{1
+// ---------------------------------------------------------------------
+
+static void escreve_csv(varredura_t *self, FILE *arq)
+{
+  for (int e = 0; e < self->n_eixos; e++) {
+    fprintf(arq, "%s,", self->eixos[e].nome);
+  }
+  fprintf(arq, "ok,instrucoes,tempo_real,processos_criados,tempo_ocioso,"
+               "tempo_cpu_parada,preempcoes,retorno_medio,resposta_media\n");
+  for (int p = 0; p < self->n_pontos; p++) {
+    resultado_t *r = &self->resultados[p];
+    metricas *m = &r->metricas;
+    for (int e = 0; e < self->n_eixos; e++) {
+      fprintf(arq, "%s,", self->eixos[e].valores[indice_no_eixo(self, p, e)]);
+    }
+    if (!r->ok) {
+      fprintf(arq, "0,,,,,,,,\n");
+      continue;
+    }
+    // médias entre os processos que existiram
+    long retorno = 0, resposta = 0;
+    int n_proc = 0;
+    for (int i = 0; i < MAX_PROCESSOS; i++) {
+      int entradas = m->n_entradas_estado[i][PRONTO] + m->n_entradas_estado[i][EXECUTANDO];
+      if (entradas == 0) continue;
+      n_proc++;
+      retorno += m->tempo_retorno[i];
+      int bloqueios = m->n_entradas_estado[i][BLOQUEADO];
+      if (bloqueios > 0) resposta += m->tempo_estado[i][BLOQUEADO] / bloqueios;
+    }
+    fprintf(arq, "1,%ld,%.6f,%d,%d,%d,%d,%.1f,%.1f\n", r->instrucoes, r->tempo,
+            m->n_processos_criados, m->tempo_total_ocioso, m->tempo_cpu_parada,
+            m->n_preempcao, n_proc > 0 ? (double)retorno / n_proc : 0,
+            n_proc > 0 ? (double)resposta / n_proc : 0);
+  }
+}
+
+
+// ---------------------------------------------------------------------
+// MAIN {{{1
+// ---------------------------------------------------------------------
+
+static void uso(char *nome)
+{
+  fprintf(stderr, "uso: %s [-j threads] [-m limite] [-o saida.csv] nome=v1,v2,... ...\n", nome);
+  fprintf(stderr, "  executa uma simulação em lote para cada combinação dos valores\n");
+  fprintf(stderr, "  -j        número de simulações ao mesmo tempo (padrão: número de\n");
+  fprintf(stderr, "            processadores)\n");
+  fprintf(stderr, "  -m        limite de instruções de cada simulação\n");
+  fprintf(stderr, "  -o        arquivo CSV com o resultado (padrão: a saída padrão)\n");
+  fprintf(stderr, "  os nomes são memoria, cpus, limite, rajada, intervalo, quantum,\n");
+  fprintf(stderr, "  escalonador (rr ou prioridade), substituicao (fifo ou sc), fila\n");
+  fprintf(stderr, "  (de saída dos terminais, 0 é sem fila), fila_entrada (caracteres\n");
+  fprintf(stderr, "  digitados e não lidos, 0 é o que cabe na linha), historico\n");
+  fprintf(stderr, "  (linhas da console guardadas, sem efeito em lote) e init\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  varredura_t self = { .n_eixos = 0, .limite = 0 };
+  int n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  char *saida = NULL;
+  int opt;
+  // as simulações não têm tela nem log, as mensagens do SO não iriam para
+  //   lugar nenhum
+  log_define_niveis("nada");
+  while ((opt = getopt(argc, argv, "j:m:o:")) != -1) {
+    switch (opt) {
+      case 'j':
+        n_threads = atoi(optarg);
+        if (n_threads < 1) uso(argv[0]);
+        break;
+      case 'm':
+        self.limite = atoi(optarg);
+        if (self.limite < 0) uso(argv[0]);
+        break;
+      case 'o':
+        saida = optarg;
+        break;
+      default:
+        uso(argv[0]);
+    }
+  }
+  if (n_threads < 1) n_threads = 1;
+
+  self.n_pontos = 1;
+  for (int i = optind; i < argc; i++) {
+    if (self.n_eixos >= MAX_EIXOS || !le_eixo(argv[i], &self.eixos[self.n_eixos])) {
+      uso(argv[0]);
+    }
+    self.n_pontos *= self.eixos[self.n_eixos].n_valores;
+    self.n_eixos++;
+  }
+  // confere toda a grade antes de começar
+  for (int p = 0; p < self.n_pontos; p++) {
+    simulador_config_t config;
+    if (!configura_ponto(&self, p, &config)) exit(1);
+  }
+
+  FILE *arq = stdout;
+  if (saida != NULL) {
+    arq = fopen(saida, "w");
+    if (arq == NULL) {
+      fprintf(stderr, "Erro na abertura de '%s'\n", saida);
+      exit(1);
+    }
+  }
+
+  self.resultados = calloc(self.n_pontos, sizeof(resultado_t));
+  assert(self.resultados != NULL);
+  executa(&self, n_threads);
+  escreve_csv(&self, arq);
+  if (arq != stdout) fclose(arq);
+
+  int falhas = 0;
+  for (int p = 0; p < self.n_pontos; p++) {
+    if (!self.resultados[p].ok) falhas++;
+  }
+  if (falhas > 0) fprintf(stderr, "%d simulações falharam\n", falhas);
+  free(self.resultados);
+  return falhas > 0 ? 1 : 0;
+}
+
+// vim: foldmethod=marker